@@ -0,0 +1,132 @@
+//
+// AiSkiers.cpp
+//
+// The AI racers, steered by the flow field. See AiSkiers.h.
+//
+
+#include "AiSkiers.h"
+#include "FlowField.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+static const int SkiersPerRow = 8;
+static const float RowSpacing = 2.0f;
+static const float ColumnSpacing = 3.0f;
+static const float FirstRowZ = 1.0f;        // The player starts at z = 0
+
+void AiSkiers::Spawn(int count)
+{
+    skiers.resize(count);
+    unsigned int hash = 12345;
+    for (int i = 0; i < count; i++) {
+        hash = hash * 1664525u + 1013904223u;
+        Skier& s = skiers[i];
+        s.x = ((float)(i % SkiersPerRow) - 0.5f * (float)(SkiersPerRow - 1)) * ColumnSpacing;
+        s.z = FirstRowZ + (float)(i / SkiersPerRow) * RowSpacing;
+        s.vx = s.vz = 0.0f;
+        s.topSpeed = MinTopSpeed + (MaxTopSpeed - MinTopSpeed) * (float)(hash >> 16) / 65536.0f;
+        s.lod = Far;            // Until the first step chooses
+        s.lastTick = s.nextTick = 0;
+    }
+    tick = 0;
+}
+
+void AiSkiers::Tick(const FlowField& field, const float* observers, int numObservers)
+{
+    static const int Interval[NumLods] = { 1, ReducedInterval, FarInterval };
+    tick++;
+    numAtLod[Full] = numAtLod[Reduced] = numAtLod[Far] = 0;
+    numAdvanced = 0;
+    for (int i = 0; i < (int)skiers.size(); i++) {
+        Skier& s = skiers[i];
+        if (lodEnabled && tick < s.nextTick) {
+            numAtLod[s.lod]++;
+            continue;
+        }
+        float distSq = FLT_MAX;         // To the nearest observer
+        for (int k = 0; k < numObservers; k++) {
+            float dx = s.x - observers[2 * k];
+            float dz = s.z - observers[2 * k + 1];
+            distSq = std::min(distSq, dx * dx + dz * dz);
+        }
+        Lod lod = (!lodEnabled || distSq < FullDistance * FullDistance) ? Full
+            : (distSq < ReducedDistance * ReducedDistance ? Reduced : Far);
+        Advance(s, field, tick - s.lastTick, lod);
+        s.lod = lod;
+        s.lastTick = tick;
+        // Skier i is advanced at the steps equal to i modulo the interval.
+        int n = Interval[lod];
+        s.nextTick = (tick / n + 1) * n + i % n;
+        if (s.nextTick - tick > n) {
+            s.nextTick -= n;
+        }
+        numAtLod[lod]++;
+        numAdvanced++;
+    }
+}
+
+// Advances the skier by a number of steps.
+void AiSkiers::Advance(Skier& s, const FlowField& field, int steps, Lod lod)
+{
+    float dirX, dirZ;
+    field.GetDirection(s.x, s.z, &dirX, &dirZ);
+    if (lod == Far) {
+        // The fitted path: along the flow, at top speed
+        s.vx = dirX * s.topSpeed;
+        s.vz = dirZ * s.topSpeed;
+        s.x += s.vx * steps;
+        s.z += s.vz * steps;
+        return;
+    }
+
+    float speed = std::min(s.topSpeed, sqrtf(s.vx * s.vx + s.vz * s.vz) + Acceleration * steps);
+    // Turn towards the direction, carving: the turn keeps the speed.
+    //    Over several steps, the turn is as much as the steps would make.
+    float rate = (steps == 1) ? SteerRate : 1.0f - powf(1.0f - SteerRate, (float)steps);
+    float vx = s.vx + (dirX * speed - s.vx) * rate;
+    float vz = s.vz + (dirZ * speed - s.vz) * rate;
+    float len = sqrtf(vx * vx + vz * vz);
+    s.vx = (len > 0.0f) ? vx * speed / len : 0.0f;
+    s.vz = (len > 0.0f) ? vz * speed / len : 0.0f;
+    if (lod == Reduced) {
+        s.x += s.vx * steps;
+        s.z += s.vz * steps;
+        return;
+    }
+
+    // Full detail: one step, sliding along the trunks, with a loss of speed.
+    float x1 = s.x + s.vx * steps;
+    float z1 = s.z + s.vz * steps;
+    if (!field.IsBlocked(x1, z1)) {
+        s.x = x1;
+        s.z = z1;
+    }
+    else if (!field.IsBlocked(x1, s.z)) {
+        s.x = x1;
+        s.vz *= 0.5f;
+    }
+    else if (!field.IsBlocked(s.x, z1)) {
+        s.z = z1;
+        s.vx *= 0.5f;
+    }
+    else {
+        s.vx *= 0.5f;
+        s.vz *= 0.5f;
+    }
+}
+
+bool AiSkiers::GetExtentZ(float* top, float* bottom) const
+{
+    bool any = false;
+    for (const Skier& s : skiers) {
+        if (s.lod == Far && lodEnabled) {
+            continue;
+        }
+        *top = any ? std::max(*top, s.z) : s.z;
+        *bottom = any ? std::min(*bottom, s.z) : s.z;
+        any = true;
+    }
+    return any;
+}
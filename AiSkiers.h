@@ -0,0 +1,88 @@
+//
+// AiSkiers.h
+//
+// The AI racers, skiing down through the forest.
+//
+//   Each simulation step, a skier looks up its direction in the flow field
+//   (see FlowField.h), once, and steers towards it: the velocity turns
+//   towards the direction, at a speed that builds up to the skier's top
+//   speed. So the cost of finding the way is the same for one skier or a
+//   thousand: the paths are found once per chunk, by the flow field.
+//
+//   Simulation level of detail: only the skiers near an observer (one of
+//   the players) are simulated every step, with collisions against the trunks.
+//   Farther skiers are advanced every ReducedInterval steps, by that many
+//   steps at once, without collisions (the flow field keeps them clear of
+//   the trunks anyway). The farthest follow a path fitted to the flow field:
+//   a straight line at their top speed, along the flow field's direction,
+//   refitted every FarInterval steps. The skiers at each interval are spread
+//   evenly over the steps, so the cost is smooth. A skier's level is chosen
+//   when it is advanced: it keeps its position and velocity, so it goes up
+//   to full detail without a jump when it comes near. So the cost of a step
+//   depends on how many skiers are near, hardly on how many there are.
+//
+//   The skiers start in rows above the start gate. Velocities and speeds
+//   are per simulation step, as for the player.
+//
+// How to use:
+//    * Spawn() the skiers.
+//    * Each simulation step, Update() the flow field with GetExtentZ(), then Tick().
+//
+
+#pragma once
+#ifndef AI_SKIERS_H
+#define AI_SKIERS_H
+
+#include <vector>
+
+class FlowField;
+
+class AiSkiers {
+public:
+    static constexpr float Acceleration = 0.0005f;  // As the player's
+    static constexpr float MinTopSpeed = 0.08f;
+    static constexpr float MaxTopSpeed = 0.11f;
+    static constexpr float SteerRate = 0.15f;       // Fraction of the velocity change made per step
+
+    // Simulation level of detail, by distance from the nearest observer
+    enum Lod { Full, Reduced, Far, NumLods };
+    static constexpr float FullDistance = 40.0f;
+    static constexpr float ReducedDistance = 120.0f;
+    static const int ReducedInterval = 4;           // Steps between updates
+    static const int FarInterval = 16;
+
+    struct Skier {
+        float x, z;
+        float vx, vz;
+        float topSpeed;
+        Lod lod;
+        int lastTick;           // The step it was last advanced to
+        int nextTick;           // The step it is next advanced at
+    };
+
+    void Spawn(int count);
+    void Tick(const FlowField& field, const float* observers, int numObservers);    // Observers are x, z pairs
+
+    int GetNumSkiers() const { return (int)skiers.size(); }
+    const Skier& GetSkier(int i) const { return skiers[i]; }
+    Skier& GetSkier(int i) { return skiers[i]; }            // For collisions
+    // The range of z of the skiers that are not at Far detail: where the flow field is needed.
+    //    False if there are none.
+    bool GetExtentZ(float* top, float* bottom) const;
+
+    void SetLodEnabled(bool enabled) { lodEnabled = enabled; }     // Otherwise all are at Full detail
+    bool IsLodEnabled() const { return lodEnabled; }
+    int GetNumAtLod(Lod lod) const { return numAtLod[lod]; }
+    int GetNumAdvanced() const { return numAdvanced; }  // Skiers advanced by the last Tick()
+
+private:
+    void Advance(Skier& s, const FlowField& field, int steps, Lod lod);
+
+    std::vector<Skier> skiers;
+    int tick = 0;
+    bool lodEnabled = true;
+    int numAtLod[NumLods] = { 0, 0, 0 };
+    int numAdvanced = 0;
+};
+
+#endif  // AI_SKIERS_H
@@ -52,9 +52,6 @@ const unsigned int phUseFresnel_loc = 8;               // Corresponds to "locati
  * Functions for uniform variable locations
  * *** */
 
-unsigned int phGetProjMatLoc(unsigned int programID) {
-    return glGetUniformLocation(programID, phProjMatName);
-}
 unsigned int phGetModelviewMatLoc(unsigned int programID) {
     return glGetUniformLocation(programID, phModelviewMatName);
 }
@@ -64,6 +61,7 @@ unsigned int phGetApplyTextureLoc(unsigned int programID) {
 
 const char* globallightBlockName= "phGlobal";       // Name of the global light uniform block
 const char* lightsBlockName = "phLightArray";       // Name of the light array uniform block
+const char* frameBlockName = "phFrame";             // Name of the per-frame uniform block
 
 
 /*
@@ -95,6 +93,15 @@ int lightsBlockSize;                // Size of data for a single light
 int lightsBlockOffset;              // Offset for the light block in the uniform buffer object
 int lightStride;                    // Stride between light blocks in the shader.
 
+unsigned int frameUBO;              // Uniform Buffer Object for the per-frame data
+const int numFrameData = 4;         // Number of entries in the phFrame block
+const char* frameNames[numFrameData] = {
+    "projectionMatrix", "currentTime", "fogColor", "fogRange"
+};
+bool frameLayoutKnown = false;      // Has the phFrame block already been analyzed?
+GLint offsetsFrame[numFrameData];   // Offsets into the UBO data for phFrame data items.
+int frameBlockSize;                 // Size of the phFrame buffer in bytes
+
 /*
 * Build and compile two shader programs
 *  One is for Phong lighting with Phong shading
@@ -103,14 +110,14 @@ int lightStride;                    // Stride between light blocks in the shader
 void setup_phong_shaders() {
     GlShaderMgr::LoadShaderSource("EduPhong.glsl");
 
-    unsigned int shader_VPG = GlShaderMgr::CompileShader("vertexShader_PhongGouraud", "calcPhongLighting");
-    unsigned int shader_FPG = GlShaderMgr::CompileShader("fragmentShader_PhongGouraud", "applyTextureMap");
+    unsigned int shader_VPG = GlShaderMgr::CompileShader("vertexShader_PhongGouraud", "phFrame", "calcPhongLighting");
+    unsigned int shader_FPG = GlShaderMgr::CompileShader("fragmentShader_PhongGouraud", "phFrame", "applyTextureMap");
     unsigned int shaders_PG[2] = { shader_VPG, shader_FPG };
     phShaderPhongGouraud = GlShaderMgr::LinkShaderProgram(2, shaders_PG);
     phRegisterShaderProgram(phShaderPhongGouraud);
 
-    unsigned int shader_VPP = GlShaderMgr::CompileShader("vertexShader_PhongPhong");
-    unsigned int shader_FPP = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "calcPhongLighting", "applyTextureMap");
+    unsigned int shader_VPP = GlShaderMgr::CompileShader("vertexShader_PhongPhong", "phFrame");
+    unsigned int shader_FPP = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLighting", "applyTextureMap");
     unsigned int shaders_PP[2] = { shader_VPP, shader_FPP };
     phShaderPhongPhong = GlShaderMgr::LinkShaderProgram(2, shaders_PP);
     phRegisterShaderProgram(phShaderPhongPhong);
@@ -133,6 +140,9 @@ bool phRegisterShaderProgram(unsigned int programID)
     }
     glUniformBlockBinding(programID, globallightBlockIndex, 0);      // Buffer binding 0 for global lights
     glUniformBlockBinding(programID, lightsBlockIndex, 1);           // Buffer binding 1 for lights
+    if (!phBindFrameBlock(programID)) {                              // Buffer binding 2 for the per-frame data
+        return false;
+    }
 
     glUseProgram(programID);
     unsigned int applyTextureLocation = phGetApplyTextureLoc(programID);
@@ -180,6 +190,37 @@ bool phRegisterShaderProgram(unsigned int programID)
     return true;
 }
 
+// **** 
+// Binds the phFrame block of a shader program to its buffer.
+//    Called by phRegisterShaderProgram(); call it directly for a program with
+//    the phFrame block but not the lighting blocks, such as a depth-only program.
+// ****
+bool phBindFrameBlock(unsigned int programID)
+{
+    unsigned int frameBlockIndex = glGetUniformBlockIndex(programID, frameBlockName);
+    if (frameBlockIndex == GL_INVALID_INDEX) {
+        fprintf(stderr, "phBindFrameBlock: The phFrame uniform block is missing!\n");
+        return false;
+    }
+    glUniformBlockBinding(programID, frameBlockIndex, phFrameBinding);
+
+    if (frameLayoutKnown) {
+        return true;
+    }
+    frameLayoutKnown = true;
+
+    glGetActiveUniformBlockiv(programID, frameBlockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &frameBlockSize);
+    glGenBuffers(1, &frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, frameBlockSize, 0, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, phFrameBinding, frameUBO);
+
+    GLuint indicesFrame[numFrameData];
+    glGetUniformIndices(programID, numFrameData, frameNames, indicesFrame);
+    glGetActiveUniformsiv(programID, numFrameData, indicesFrame, GL_UNIFORM_OFFSET, offsetsFrame);
+    return true;
+}
+
 void phMaterial::LoadIntoShaders()
 {
     float vecEntries[3];
@@ -237,6 +278,23 @@ void phLight::LoadIntoShaders(int lightNumber) {
 }
 
 
+void phFrame::LoadIntoShaders()
+{
+    if (!frameLayoutKnown) {
+        return;
+    }
+    char* buffer = new char[frameBlockSize];
+    ProjectionMatrix.DumpByColumns((float*)(buffer + offsetsFrame[0]));
+    memcpy(buffer + offsetsFrame[1], &CurrentTime, sizeof(float));
+    FogColor.Dump((float*)(buffer + offsetsFrame[2]));
+    float fogRange[2] = { FogStart, FogEnd };
+    memcpy(buffer + offsetsFrame[3], fogRange, sizeof(fogRange));
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, frameBlockSize, buffer);
+
+    delete[] buffer;
+}
+
 bool phLight::CheckCorrectness()
 {
     // If it is directional,  the position is instead the direction, and should be a unit vector.
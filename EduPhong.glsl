@@ -29,6 +29,9 @@
 //    applyTextureMap 
 //         - defines the function applyTextureFunction()
 //           which applies a bitmapped texture map
+//    phFrame
+//         - declares the phFrame uniform block, of the per-frame data,
+//           and defines ApplyProjection(), CurrentTime() and ApplyFog()
 
 
 
@@ -59,13 +62,14 @@ out float matSpecExponent;
 out vec2 theTexCoords;
 out float useFresnel;
 
-uniform mat4 projectionMatrix;        // The projection matrix
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // The same depths in the depth prepass programs, as it tests GL_EQUAL
 uniform mat4 modelviewMatrix;         // The modelview matrix
 
 void main()
 {
     vec4 mvPos4 = modelviewMatrix * vec4(vertPos.x, vertPos.y, vertPos.z, 1.0); 
-    gl_Position = projectionMatrix * mvPos4; 
+    gl_Position = ApplyProjection(mvPos4); 
     mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
     mvNormalFront = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); // Unit normal from the surface 
     matEmissive = EmissiveColor;
@@ -130,6 +134,11 @@ vec3 mvNormal;
 in vec2 theTexCoords;          // Texture coordinates (interpolated from vertex shader) 
 uniform bool applyTexture;     // Set true if the function applyTextureFunction() is to be called
 // uniform sampler2D theTextureMap; // Declared as needed in applyTextureFunction()
+uniform sampler2D ssaoTexture; // Screen-space ambient occlusion, at the resolution of the render target (see Ssao.h)
+uniform bool applySsao;        // Set true if ssaoTexture holds this frame's occlusion
+float ambientOcclusion;        // Scales the ambient terms in CalculatePhongLighting()
+
+vec3 ApplyFog(vec3 color, float distance);     // In the phFrame code block
 
 vec3 nonspecColor;
 vec3 specularColor;  
@@ -145,12 +154,14 @@ void main() {
     else {
         mvNormal = -mvNormalFront;
     }
+    ambientOcclusion = applySsao ? texelFetch(ssaoTexture, ivec2(gl_FragCoord.xy), 0).r : 1.0;
 
     CalculatePhongLighting();       // Calculates: nonspecColor and specularColor. 
     fragmentColor = vec4(nonspecColor+specularColor, 1.0f);   // Add alpha value of 1.0.
     if ( applyTexture ) { 
         fragmentColor = applyTextureFunction();
     }
+    fragmentColor.rgb = ApplyFog(fragmentColor.rgb, 1.0/gl_FragCoord.w);     // 1/w is the distance
 }
 #endglsl
 
@@ -207,7 +218,8 @@ layout (std140) uniform phLightArray {
     phLight Lights[MaxLights];
 };
 
-uniform mat4 projectionMatrix;        // The projection matrix
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
 uniform mat4 modelviewMatrix;         // The modelview matrix
 
 vec3 mvPos;   // Vertex position in modelview coordinates
@@ -218,12 +230,13 @@ vec3 matDiffuse;
 vec3 matSpecular;
 float matSpecExponent;
 float useFresnel;
+const float ambientOcclusion = 1.0;   // No screen-space ambient occlusion at the vertices
 void CalculatePhongLighting();
 
 void main()
 {
     vec4 mvPos4 = modelviewMatrix * vec4(vertPos.x, vertPos.y, vertPos.z, 1.0); 
-    gl_Position = projectionMatrix * mvPos4; 
+    gl_Position = ApplyProjection(mvPos4); 
     mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
     mvNormal = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); 
     matEmissive = EmissiveColor;
@@ -254,6 +267,8 @@ out vec4 fragmentColor;    // Color that will be used for the fragment
 uniform bool applyTexture; // Set true if the function applyTextureFunction() is to be called
 // uniform sampler2D theTextureMap; // Declared as needed in applyTextureFunction()
 
+vec3 ApplyFog(vec3 color, float distance);     // In the phFrame code block
+
 vec4 applyTextureFunction();
 
 void main()
@@ -262,6 +277,7 @@ void main()
     if ( applyTexture ) { 
         fragmentColor = applyTextureFunction();
     }
+    fragmentColor.rgb = ApplyFog(fragmentColor.rgb, 1.0/gl_FragCoord.w);     // 1/w is the distance
 }
 #endglsl
 
@@ -272,6 +288,7 @@ void main()
 //     (a) Material properties (mvPos through useFresnel).
 //     (b) Global light properties (phGlobal uniform structure)
 //     (c) Individual light properties (phLightArray, with phLight structures)
+//     (d) ambientOcclusion, scaling the ambient terms
 //   Outputs:
 //     (a) nonspecColor (combined non-specular components of the color)
 //     (b) specularColor (specular component of the color)
@@ -286,7 +303,7 @@ void CalculatePhongLighting() {
        nonspecColor = matEmissive; 
     }
     if ( EnableAmbient ) { 
-         nonspecColor += matAmbient*GlobalAmbientColor; 
+         nonspecColor += ambientOcclusion*matAmbient*GlobalAmbientColor; 
     } 
     // vVector =  unit vector towards view direction
     vec3 vVector = LocalViewer ? -mvPos : vec3(0.0, 0.0, 1.0);
@@ -342,7 +359,7 @@ void CalculatePhongLighting() {
                 }
             }
             if ( EnableAmbient ) { 
-                nonspecColorLt += matAmbient*Lights[i].AmbientColor; 
+                nonspecColorLt += ambientOcclusion*matAmbient*Lights[i].AmbientColor; 
             } 
             if ( Lights[i].IsAttenuated ) { 
                 float dist = distance(mvPos,Lights[i].Position); 
@@ -374,3 +391,40 @@ vec4 applyTextureFunction()
     return vec4(nonspecColor, 1.0f)*texture(theTextureMap, theTexCoords) + vec4(specularColor,0.0);
 }
 #endglsl
+
+// *****************************
+// phFrame - code block
+//   The per-frame data shared by all programs, at binding point 2: the phFrame
+//   class in EduPhong.h loads it, with one buffer write per frame.
+//   Compiled into each shader that uses it, which declares the function it calls:
+//     ApplyProjection() - from modelview coordinates to clip coordinates
+//     CurrentTime() - the animation time, in seconds
+//     ApplyFog() - mixes a color toward fogColor, by its distance from the camera
+// *****************************
+#beginglsl codeblock phFrame
+layout (std140) uniform phFrame {
+    mat4 projectionMatrix;          // The projection matrix, the same for every view
+    float currentTime;              // The animation time, in seconds
+    vec3 fogColor;
+    vec2 fogRange;                  // Distances where the fog starts and where it is total: none unless increasing
+};
+
+vec4 ApplyProjection(vec4 mvPos)
+{
+    return projectionMatrix * mvPos;
+}
+
+float CurrentTime()
+{
+    return currentTime;
+}
+
+vec3 ApplyFog(vec3 color, float distance)
+{
+    if ( fogRange.y <= fogRange.x ) {
+        return color;
+    }
+    float fog = clamp((distance - fogRange.x)/(fogRange.y - fogRange.x), 0.0, 1.0);
+    return mix(color, fogColor, fog);
+}
+#endglsl
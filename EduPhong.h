@@ -23,6 +23,7 @@
 #include "LinearR4.h"
 
 constexpr int phMaxNumLights = 8;           // Needs to match the number in the shaders
+constexpr unsigned int phFrameBinding = 2;  // Uniform buffer binding point of the phFrame block (0 and 1 are the lights)
 
 // ********
 // phMaterial - 
@@ -107,6 +108,28 @@ public:
     void LoadIntoShaders();               // Load the global lighting data into the shaders
 };
 
+// ********
+// phFrame - 
+//   The data that changes once per frame, shared by every EduPhong shader program:
+//   the projection matrix, the animation time and the fog.
+//   These are the phFrame uniform block (the phFrame code block of EduPhong.glsl),
+//   at binding point phFrameBinding, loaded with one buffer write per frame,
+//   instead of a uniform per program. Only data shared by all the split-screen
+//   views belongs here: the view matrices stay in each program's modelviewMatrix.
+// ********
+class phFrame {
+public:
+    LinearMapR4 ProjectionMatrix;
+    float CurrentTime;              // Animation time, in seconds (default 0)
+    VectorR3 FogColor;
+    float FogStart;                 // Distances from the camera where the fog starts, and where it is total.
+    float FogEnd;                   //    No fog unless FogEnd > FogStart (default is no fog)
+
+    phFrame();                      // Constructor
+
+    void LoadIntoShaders();         // Load the frame data into the shaders
+};
+
 // ***********************************************************
 // Externals for Phong lighting -- and Phong lighting or Gouraud shading.
 // ***********************************************************
@@ -127,12 +150,11 @@ extern const unsigned int UseFresnel_loc;                  // Corresponds to "lo
 
 void setup_phong_shaders();                     // Reads from EduPhong.glsl. Compiles and links the two "standard" shader programs
 bool phRegisterShaderProgram(unsigned int programID);
+bool phBindFrameBlock(unsigned int programID);  // For programs with the phFrame block but not the lights (done by phRegisterShaderProgram)
 
-unsigned int phGetProjMatLoc(unsigned int programID);
 unsigned int phGetModelviewMatLoc(unsigned int programID);
 unsigned int phGetApplyTextureLoc(unsigned int programID);
 
-constexpr const char* phProjMatName = "projectionMatrix";		// Name of the uniform variable projectionMatrix
 constexpr const char* phModelviewMatName = "modelviewMatrix";	// Name of the uniform variable modelviewMatrix
 constexpr const char* phApplyTextureName = "applyTexture";	    // Name of the uniform variable applyTexture
 
@@ -179,6 +201,16 @@ inline phGlobal::phGlobal() :
     UseHalfwayVector(false)
 {};
 
+// Constructor for phFrame: sets default values
+inline phFrame::phFrame() :
+    CurrentTime(0.0f),
+    FogColor{ 1.0f, 1.0f, 1.0f },
+    FogStart(0.0f),
+    FogEnd(0.0f)
+{
+    ProjectionMatrix.SetIdentity();
+}
+
 // Set the light's position: The position transformed
 //     by the modelview matrix.  The modelview matrix must be an affine mapping.
 // The IsDirectional flag is reset to make sure the light is positional.
@@ -38,10 +38,33 @@
 #include "GlGeomSphere.h"
 #include "GlGeomCylinder.h"
 #include "GlGeomTorus.h"
+#include "GlGeomMeshCache.h"
+#include "TreeVariantPool.h"
+#include "TerrainChunks.h"
+#include "TreeGpuCuller.h"
+#include "VertexPullPool.h"
+#include "TextureStreamer.h"
+#include "FrameGraph.h"
+#include "PostProcess.h"
+#include "Ssao.h"
+#include "Hud.h"
+#include "SlalomCourse.h"
+#include "FlowField.h"
+#include "AiSkiers.h"
+#include "SweepAndPrune.h"
+#include "ObstacleGrid.h"
+#include "Profiler.h"
+#include "NetServer.h"
+#include "NetClient.h"
 
 // Enable standard input and output via printf(), etc.
 // Put this include *after* the includes for glew and GLFW!
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <chrono>
+#include <thread>
 
 #include "FinalProject.h"
 #include "SceneRenderer.h"
@@ -61,6 +84,7 @@ LinearMapR4 viewMatrix;		// The current view matrix, based on viewAzimuth and vi
 
 // Control Phong lighting modes
 phGlobal globalPhongData;
+phFrame framePhongData;         // The per-frame data of all the EduPhong programs: projection, time and fog
 
 // These two variables control how triangles are rendered.
 bool wireframeMode = false;
@@ -72,16 +96,61 @@ int meshRes=20;             // Resolution of the meshes (slices, stacks, and rin
 
 // These variables control the animation's state and speed.
 // YOUR CODE WILL NOT USE THIS UNLESS YOU ADD ANIMATION  
-double animateIncrement = 0.01;   // Make bigger to speed up animation, smaller to slow it down.
+double animateIncrement = 1.0/60.0;   // Seconds per frame. Make bigger to speed up animation, smaller to slow it down.
 double currentTime = 0.0;         // Current "time" for the animation.
 bool spinMode = true;       // Controls whether running or paused.
 double currentDelta = 0.0;        // Current state of the animation (YOUR CODE MAY NOT WANT TO USE THIS.)
 
-// Player position, velocity, and acceleration
-double xPos = 0.0;
-double zPos = 0.0;
-double xVel = 0.0;
-double zVel = 0.0;
+// The players: one, or two to four in split screen, each in its own view.
+//    Player 1 steers with A and D, player 2 with the left and right arrow keys,
+//    and players 2 to 4 with the first three joysticks or gamepads.
+struct Player {
+    double xPos = 0.0;              // Position and velocity: the world is drawn offset by (xPos, zPos)
+    double zPos = 0.0;
+    double xVel = 0.0;
+    double zVel = 0.0;
+    SlalomCourse run;               // A copy of the course, timing the player's run
+    int body = -1;                  // In the broadphase
+    int viewport[4] = { 0, 0, 1, 1 };   // Its part of the window, set by myLayoutViews()
+};
+Player players[MaxSceneViews];
+int numPlayers = 1;
+const double StartSpacing = 2.0;    // Across the slope, between the players at the start
+
+// The simulation runs in fixed steps, independent of the frame rate.
+//    The velocities above are per step.
+const double SimTickSeconds = 1.0 / 60.0;
+const int MaxTicksPerFrame = 8;         // After a longer stall, the simulation falls behind rather than catching up
+double simTime = 0.0;                   // Time of the simulation, in seconds
+double simMs = 0.0;                     // Running average of the simulation's time per frame, in milliseconds
+int numAiSkiers = 8;
+
+// The skiers collide with each other, as circles. The broadphase finds the pairs near enough.
+//    Its bodies are the AI skiers, by index, then the players.
+const float SkierCollisionRadius = 0.8f;
+SweepAndPrune skierBroadphase;
+
+// Line of sight from the AI skiers at full detail to the players, checked each step as one batch.
+std::vector<ObstacleGrid::Ray> sightRays;
+std::vector<unsigned char> sightBlocked;
+int numAiSeeingPlayer = 0;              // That see at least one player
+
+// Networked races (see NetServer.h and NetClient.h). With --server, this program runs the race,
+//    headless: the same simulation, with each connected client's player in its slot. With
+//    --connect, it is one of the players, predicted, and the other skiers come from the server.
+//    The simulation's time, simTime, is also the network's clock.
+NetServer netServer;
+NetClient netClient;
+bool headless = false;                  // No window, and no OpenGL
+bool networked = false;                 // The players' states are quantized as in the snapshots, so prediction is exact
+uint32_t serverTick = 0;
+const uint16_t DefaultNetPort = 27960;
+double netLatencyMs = 0.0;              // Simulated on the links, to test over localhost
+double netJitterMs = 0.0;
+double netLoss = 0.0;                   // Fraction of the packets dropped
+int numMispredicted = 0;                // Client: snapshots that moved the player
+double netCorrection = 0.0;             // Client: how far, the largest
+std::vector<NetClient::Skier> interpolatedSkiers;
 
 // ************************
 // General data helping with setting up VAO (Vertex Array Objects)
@@ -90,10 +159,38 @@ double zVel = 0.0;
 
 unsigned int shaderProgramBitmap;       // The shader program that applies a bitmapped texture map (from a file)
 unsigned int shaderProgramProc ;       // The shader program that applies a procedural texture map
+unsigned int shaderProgramWind;        // Like shaderProgramBitmap, but sways trees in the wind
+unsigned int shaderProgramWindInstanced;   // Like shaderProgramWind, for trees culled by TreeGpuCuller
+unsigned int shaderProgramFoliage;     // Like shaderProgramWind, for alpha-tested leaf cards
+unsigned int shaderProgramFoliageInstanced;   // Like shaderProgramWindInstanced, for alpha-tested leaf cards
+unsigned int shaderProgramPulled = 0;  // Like shaderProgramBitmap, with vertex pulling (see VertexPullPool.h); 0 before OpenGL 4.3
+unsigned int shaderProgramWindGouraud; // Like shaderProgramWind, lit per vertex; phShaderPhongGouraud is shaderProgramBitmap's
+unsigned int shaderProgramBaked;       // Like shaderProgramBitmap, with baked lighting (see LightBaker.h), for the terrain chunks
+unsigned int shaderProgramWindBaked;   // Like shaderProgramWind, with the tree variants' baked lighting
+unsigned int shaderProgramWindInstancedBaked;     // Like shaderProgramWindInstanced, with baked lighting
+unsigned int shaderProgramFoliageBaked;           // Like shaderProgramFoliage, with baked lighting
+unsigned int shaderProgramFoliageInstancedBaked;  // Like shaderProgramFoliageInstanced, with baked lighting
+bool multisampled = false;             // Whether the scene is multisampled this frame, for alpha to coverage
+
+// Depth-only twins of the shader programs above, for the depth prepass: the same vertex shaders
+//    with fragmentShader_DepthOnly. While depthOnlyPass is true, selectShaderProgram() selects them.
+unsigned int depthProgramBitmap;       // Also used for shaderProgramProc
+unsigned int depthProgramWind;
+unsigned int depthProgramWindInstanced;
+unsigned int depthProgramGouraud;      // For phShaderPhongGouraud
+unsigned int depthProgramWindGouraud;
+unsigned int depthProgramBaked;
+unsigned int depthProgramWindBaked;
+unsigned int depthProgramWindInstancedBaked;
+bool depthOnlyPass = false;
+
+FrameGraph frameGraph;                 // The render passes of the current frame
+int hudMode = 1;                       // 0: no HUD, 1: speed, distance and time, 2: also the performance overlay
 
 unsigned int modelviewMatLocation;					// Location of the modelviewMatrix in the currently active shader program
 unsigned int applyTextureLocation; 					// Location of the applyTexture bool in the currently active shader program
-unsigned int timeLoc;
+unsigned int windPhaseLoc;                          // Locations of the wind uniforms in the currently active shader program
+unsigned int windParamsLoc;
 
 //  The Projection matrix: Controls the "camera view/field-of-view" transformation
 //     Generally is the same for all objects in the scene.
@@ -156,29 +253,93 @@ void mySetViewMatrix() {
 // *************************************
 void myRenderScene() {
 
-    xPos += xVel;
-    zPos += zVel;
-    if (zVel < 0.1) {
-        zVel += 0.0005;
+    // Run the simulation steps due since the last frame.
+    static double simClock = -1.0;
+    double now = glfwGetTime();
+    if (simClock < 0.0) {
+        simClock = now;
     }
+    int numTicks = 0;
+    double simStart = glfwGetTime();
+    while (simClock + SimTickSeconds <= now) {
+        if (numTicks == MaxTicksPerFrame) {
+            simClock = now;
+            break;
+        }
+        mySimulateTick();
+        simClock += SimTickSeconds;
+        numTicks++;
+    }
+    simMs += (1000.0 * (glfwGetTime() - simStart) - simMs) / 16.0;
 
     // std::cout << "pos: (" << xPos << ", " << zPos << ")" << endl;
 
-    selectShaderProgram(shaderProgramProc);
-    glUniform1f(timeLoc, (float)currentTime);
+    if (spinMode) {
+        currentTime += animateIncrement;
+    }
+    // The projection and the time, for every program at once: one write of the phFrame uniform block.
+    framePhongData.CurrentTime = (float)currentTime;
+    framePhongData.LoadIntoShaders();
    
+    // The frame is a graph of render passes (see FrameGraph.h): they are declared here
+    //    and by RenderScene(), then run in Execute(). The scene is rendered into
+    //    the post-processing stage's targets, which then writes the window.
+    frameGraph.Reset(screenWidth, screenHeight);
+    PostProcess::BeginFrame(frameGraph, screenWidth, screenHeight);
+    Ssao::BeginFrame(frameGraph);
+    multisampled = PostProcess::IsMultisampled();
+    int sceneColor = PostProcess::GetSceneColor();
+    int sceneDepth = PostProcess::GetSceneDepth();
+
     // Clear the rendering window
-    static const float black[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    static const float white[] = { 1.0f, 1.0f, 1.0f, 0.0f };
-    const float clearDepth = 1.0f;
-    glClearBufferfv(GL_COLOR, 0, white);
-    glClearBufferfv(GL_DEPTH, 0, &clearDepth);	// Must pass in a *pointer* to the depth
+    int clearPass = frameGraph.AddPass("Clear", []() {
+        static const float white[] = { 1.0f, 1.0f, 1.0f, 0.0f };
+        const float clearDepth = 1.0f;
+        glClearBufferfv(GL_COLOR, 0, white);
+        glClearBufferfv(GL_DEPTH, 0, &clearDepth);	// Must pass in a *pointer* to the depth
+    });
+    frameGraph.Write(clearPass, sceneColor);
+    frameGraph.Write(clearPass, sceneDepth);
+
+    // Each player's view of the scene, in split screen
+    static SceneView views[MaxSceneViews];
+    for (int k = 0; k < numPlayers; k++) {
+        const Player& p = players[k];
+        views[k].xPos = (float)p.xPos;
+        views[k].zPos = (float)p.zPos;
+        views[k].xVel = (float)p.xVel;
+        views[k].zVel = (float)p.zVel;
+        views[k].firstGate = p.run.GetNextGate();
+        for (int j = 0; j < 4; j++) {
+            views[k].viewport[j] = p.viewport[j];
+        }
+    }
 
-    selectShaderProgram(shaderProgramProc);
-    glUniform1i(applyTextureLocation, false);           // Turn off applying texture
-    MyRenderSpheresForLights();
+    int lightsPass = frameGraph.AddPass("Light spheres", []() {
+        selectShaderProgram(shaderProgramProc);
+        glUniform1i(applyTextureLocation, false);           // Turn off applying texture
+        for (int k = 0; k < numPlayers; k++) {
+            SetSceneViewport(views[k]);
+            MyRenderSpheresForLights();
+        }
+    });
+    frameGraph.Write(lightsPass, sceneColor);
+    frameGraph.Write(lightsPass, sceneDepth);
+
+    std::vector<std::pair<float, float>> locs = RenderScene(views, numPlayers);
+    PostProcess::AddPasses(frameGraph);
+
+    if (hudMode > 0) {
+        myBuildHud();
+        int hudPass = frameGraph.AddPass("HUD", []() {
+            Hud::Draw();
+        });
+        frameGraph.Read(hudPass, frameGraph.GetBackbufferColor());
+        frameGraph.Write(hudPass, frameGraph.GetBackbufferColor());
+    }
 
-    std::vector<std::pair<float, float>> locs = RenderScene(xPos, zPos);
+    frameGraph.Compile();
+    frameGraph.Execute();
 
     // COLLISION DETECTION
     /*std::pair<float, float> loc;
@@ -198,9 +359,495 @@ void myRenderScene() {
         }
     }*/
 
+    Profiler::EndFrame();
+
     check_for_opengl_errors();   // Really a great idea to check for errors -- esp. good for debugging!
 }
 
+// *************************************
+// One step of the simulation: moves the skiers, and times the runs through the course.
+// A player's skier is drawn at x = SkierX, z = 0 in its view, and the world is drawn offset
+//    by (xPos, zPos), so the skier's position in the world is (SkierX - xPos, -zPos).
+// *************************************
+void mySimulateTick() {
+    myPollJoysticks();
+    if (netServer.IsOpen()) {
+        myServerReceive();
+    }
+    if (netClient.IsConnected()) {
+        netClient.Receive(simTime);
+        myApplyCorrection(netClient, players[0]);
+    }
+    float observers[2 * MaxSceneViews];
+    for (int k = 0; k < numPlayers; k++) {
+        Player& p = players[k];
+        float x0 = SkierX - (float)p.xPos;
+        float z0 = -(float)p.zPos;
+        bool moved = myStepPlayer(k);
+        observers[2 * k] = SkierX - (float)p.xPos;
+        observers[2 * k + 1] = -(float)p.zPos;
+        if (!moved) {
+            continue;
+        }
+        SlalomCourse::Event event = p.run.Tick(x0, z0, observers[2 * k], observers[2 * k + 1], simTime, SimTickSeconds);
+
+        int gate = p.run.GetNextGate() - 1;
+        if (event != SlalomCourse::NoEvent && numPlayers > 1) {
+            printf("Player %d: ", k + 1);
+        }
+        switch (event) {
+        case SlalomCourse::Started:
+            printf("Start!\n");
+            break;
+        case SlalomCourse::PassedGate:
+            printf("Gate %d: %.3f s.\n", gate, p.run.GetSplit(gate));
+            break;
+        case SlalomCourse::MissedGate:
+            printf("Missed gate %d.\n", gate);
+            break;
+        case SlalomCourse::Finished:
+            printf("Finish: %.3f s, %d gates missed.\n", p.run.GetSplit(gate), p.run.GetNumMissed());
+            break;
+        default:
+            break;
+        }
+    }
+    simTime += SimTickSeconds;
+
+    // The AI skiers: near a player, at full detail
+    float top, bottom;
+    if (aiSkiers.GetExtentZ(&top, &bottom)) {
+        flowField.Update(top, bottom);
+    }
+    aiSkiers.Tick(flowField, observers, numPlayers);
+    myCollideSkiers();
+    myCheckLineOfSight();
+
+    if (netServer.IsOpen()) {
+        myServerSend();
+    }
+    if (netClient.IsConnected()) {
+        myShowNetworkSkiers();
+    }
+}
+
+// Moves a player one step. On the race server, a connected client's player takes one of the
+//    client's steering commands each step; with none come yet, it waits.
+bool myStepPlayer(int k) {
+    Player& p = players[k];
+    if (netServer.IsOpen()) {
+        float xVel;
+        if (!netServer.PopInput(k, &xVel)) {
+            return false;
+        }
+        p.xVel = xVel;
+    }
+    if (netClient.IsConnected()) {
+        p.xVel = NetSnapshot::Velocity(NetSnapshot::QuantizeVelocity((float)p.xVel));     // As the server will have it
+        netClient.SendInput((float)p.xVel, simTime);
+    }
+    myMovePlayer(p);
+    return true;
+}
+
+// The player's motion. The client's prediction repeats it exactly.
+void myMovePlayer(Player& p) {
+    p.xPos += p.xVel;
+    p.zPos += p.zVel;
+    if (p.zVel < 0.1) {
+        p.zVel += 0.0005;
+    }
+    if (networked) {
+        // Rounded as in the snapshots, so the client, starting from a snapshot, ends where the server does
+        p.xPos = SkierX - NetSnapshot::Position(NetSnapshot::QuantizePosition(SkierX - (float)p.xPos));
+        p.zPos = -NetSnapshot::Position(NetSnapshot::QuantizePosition(-(float)p.zPos));
+        p.zVel = -NetSnapshot::Velocity(NetSnapshot::QuantizeVelocity(-(float)p.zVel));
+    }
+}
+
+// Client: puts the player where the newest snapshot has it, and applies again the commands
+//    the server had not applied yet. Returns how far that moved the player, or -1 with no new snapshot.
+double myApplyCorrection(NetClient& client, Player& p) {
+    NetClient::Skier server;
+    uint32_t lastApplied;
+    if (!client.TakeCorrection(&server, &lastApplied)) {
+        return -1.0;
+    }
+    double predictedX = p.xPos, predictedZ = p.zPos;
+    double steering = p.xVel;
+    p.xPos = SkierX - server.x;
+    p.zPos = -server.z;
+    p.xVel = -server.vx;
+    p.zVel = -server.vz;
+    float commands[NetClient::NumCommands];
+    int n = client.GetCommandsSince(lastApplied, commands, NetClient::NumCommands);
+    for (int i = 0; i < n; i++) {
+        p.xVel = commands[i];
+        myMovePlayer(p);
+    }
+    p.xVel = steering;
+    double error = sqrt((p.xPos - predictedX) * (p.xPos - predictedX) + (p.zPos - predictedZ) * (p.zPos - predictedZ));
+    if (&client == &netClient && error > 0.0) {
+        numMispredicted++;
+        netCorrection = std::max(netCorrection, error);
+    }
+    return error;
+}
+
+// Client: the other skiers, interpolated, for drawing.
+void myShowNetworkSkiers() {
+    netClient.GetInterpolated(simTime, interpolatedSkiers);
+    networkSkiers.resize(interpolatedSkiers.size());
+    for (int i = 0; i < (int)interpolatedSkiers.size(); i++) {
+        const NetClient::Skier& s = interpolatedSkiers[i];
+        NetworkSkier& n = networkSkiers[i];
+        n.x = s.x;
+        n.z = s.z;
+        n.vx = s.vx;
+        n.vz = s.vz;
+        n.player = s.id < NetSnapshot::MaxPlayers;
+    }
+}
+
+// Server: takes the clients' packets. A newly connected client's player starts at the top,
+//    and the players simulated are those up to the last connected.
+void myServerReceive() {
+    static bool wasConnected[NetServer::MaxClients];
+    netServer.Receive(simTime);
+    int lastConnected = 0;
+    for (int k = 0; k < NetServer::MaxClients; k++) {
+        bool connected = netServer.IsConnected(k);
+        if (connected && !wasConnected[k]) {
+            Player& p = players[k];
+            p.xPos = StartSpacing * k;
+            p.zPos = 0.0;
+            p.xVel = p.zVel = 0.0;
+            p.run = slalomCourse;
+            p.run.Reset();
+        }
+        wasConnected[k] = connected;
+        if (connected) {
+            lastConnected = k + 1;
+        }
+    }
+    if (std::max(lastConnected, 1) != numPlayers) {
+        numPlayers = std::max(lastConnected, 1);
+        mySetupBroadphase();
+    }
+}
+
+// Server: sends the skiers to the clients, in the snapshots' quantized units.
+void myServerSend() {
+    static std::vector<NetSkier> skiers;
+    skiers.clear();
+    for (int k = 0; k < numPlayers; k++) {
+        const Player& p = players[k];
+        NetSkier s = { k, NetSnapshot::QuantizePosition(SkierX - (float)p.xPos), NetSnapshot::QuantizePosition(-(float)p.zPos),
+            NetSnapshot::QuantizeVelocity(-(float)p.xVel), NetSnapshot::QuantizeVelocity(-(float)p.zVel) };
+        skiers.push_back(s);
+    }
+    for (int i = 0; i < aiSkiers.GetNumSkiers(); i++) {
+        const AiSkiers::Skier& a = aiSkiers.GetSkier(i);
+        NetSkier s = { NetSnapshot::MaxPlayers + i, NetSnapshot::QuantizePosition(a.x), NetSnapshot::QuantizePosition(a.z),
+            NetSnapshot::QuantizeVelocity(a.vx), NetSnapshot::QuantizeVelocity(a.vz) };
+        skiers.push_back(s);
+    }
+    serverTick++;
+    netServer.SendSnapshots(serverTick, skiers, simTime);
+}
+
+// Steers players 2 to 4 with the first three joysticks, by the x axis of the left stick.
+void myPollJoysticks() {
+    if (headless) {
+        return;
+    }
+    const float DeadZone = 0.15f;
+    const double SteerRate = 0.002;     // Change in xVel per step, at full deflection
+    for (int k = 1; k < numPlayers; k++) {
+        int joystick = GLFW_JOYSTICK_1 + k - 1;
+        int numAxes = 0;
+        const float* axes = glfwJoystickPresent(joystick) ? glfwGetJoystickAxes(joystick, &numAxes) : 0;
+        if (numAxes < 1 || fabsf(axes[0]) < DeadZone) {
+            continue;
+        }
+        Player& p = players[k];
+        p.xVel = std::max(-0.1, std::min(0.1, p.xVel - SteerRate * axes[0]));      // Stick right, skier right
+    }
+}
+
+// Puts the skiers back at the top, for a new run.
+void myRestartRun() {
+    for (int k = 0; k < MaxSceneViews; k++) {
+        Player& p = players[k];
+        p.xPos = StartSpacing * k;
+        p.zPos = 0.0;
+        p.xVel = p.zVel = 0.0;
+        p.run = slalomCourse;
+        p.run.Reset();
+    }
+    if (netClient.IsConnected()) {
+        players[0].xPos = StartSpacing * netClient.GetSlot();      // Where the server starts the player
+    }
+    aiSkiers.Spawn(numAiSkiers);
+    mySetupBroadphase();
+}
+
+// Splits the window between the players: in halves, one above the other, for two,
+//    and in quarters for three or four. All the views have the same size.
+void myLayoutViews() {
+    int columns = (numPlayers > 2) ? 2 : 1;
+    int rows = (numPlayers > 1) ? 2 : 1;
+    int w = screenWidth / columns;
+    int h = screenHeight / rows;
+    for (int k = 0; k < MaxSceneViews; k++) {
+        int column = k % columns;
+        int row = (k / columns) % rows;             // From the top
+        players[k].viewport[0] = column * w;
+        players[k].viewport[1] = screenHeight - (row + 1) * h;
+        players[k].viewport[2] = (w > 0) ? w : 1;
+        players[k].viewport[3] = (h > 0) ? h : 1;
+    }
+}
+
+// Casts a segment from each AI skier at full detail to each player, head to head.
+void myCheckLineOfSight() {
+    const float HeadHeight = 3.0f;
+    sightRays.clear();
+    for (int i = 0; i < aiSkiers.GetNumSkiers(); i++) {
+        const AiSkiers::Skier& s = aiSkiers.GetSkier(i);
+        if (s.lod != AiSkiers::Full) {
+            continue;
+        }
+        for (int k = 0; k < numPlayers; k++) {
+            float x = SkierX - (float)players[k].xPos;
+            float z = -(float)players[k].zPos;
+            ObstacleGrid::Ray ray = { { s.x, HeadHeight, s.z }, { x - s.x, 0.0f, z - s.z }, 1.0f };
+            sightRays.push_back(ray);
+        }
+    }
+    sightBlocked.resize(sightRays.size());
+    obstacleGrid.IsBlockedBatch(sightRays.data(), (int)sightRays.size(), sightBlocked.data());
+    numAiSeeingPlayer = 0;
+    for (int i = 0; i < (int)sightBlocked.size(); i += numPlayers) {
+        bool seen = false;
+        for (int k = 0; k < numPlayers; k++) {
+            seen = seen || !sightBlocked[i + k];
+        }
+        numAiSeeingPlayer += seen;
+    }
+}
+
+// Adds the skiers to the broadphase, after they are spawned or the players change.
+void mySetupBroadphase() {
+    const float r = SkierCollisionRadius;
+    skierBroadphase.Clear();
+    for (int i = 0; i < aiSkiers.GetNumSkiers(); i++) {
+        const AiSkiers::Skier& s = aiSkiers.GetSkier(i);
+        skierBroadphase.AddBody(s.x - r, s.x + r, s.z - r, s.z + r);
+    }
+    for (int k = 0; k < numPlayers; k++) {
+        float x = SkierX - (float)players[k].xPos;
+        float z = -(float)players[k].zPos;
+        players[k].body = skierBroadphase.AddBody(x - r, x + r, z - r, z + r);
+    }
+}
+
+// Pushes apart the skiers that overlap, and swaps their velocities along the line between them.
+//    Only the AI skiers at full detail collide: the others are too far to be seen.
+void myCollideSkiers() {
+    const float r = SkierCollisionRadius;
+    const int numAi = aiSkiers.GetNumSkiers();
+    for (int i = 0; i < numAi; i++) {
+        const AiSkiers::Skier& s = aiSkiers.GetSkier(i);
+        skierBroadphase.SetBox(i, s.x - r, s.x + r, s.z - r, s.z + r);
+    }
+    float player[MaxSceneViews][4];     // Position and velocity in the world
+    bool playerHit[MaxSceneViews];
+    for (int k = 0; k < numPlayers; k++) {
+        const Player& p = players[k];
+        player[k][0] = SkierX - (float)p.xPos;
+        player[k][1] = -(float)p.zPos;
+        player[k][2] = -(float)p.xVel;
+        player[k][3] = -(float)p.zVel;
+        playerHit[k] = false;
+        skierBroadphase.SetBox(p.body, player[k][0] - r, player[k][0] + r, player[k][1] - r, player[k][1] + r);
+    }
+    skierBroadphase.Update();
+
+    // A body's position and velocity in the world: x, z, vx, vz.
+    auto getBody = [&](int b, float* v) {
+        if (b >= numAi) {
+            for (int j = 0; j < 4; j++) {
+                v[j] = player[b - numAi][j];
+            }
+            return true;
+        }
+        const AiSkiers::Skier& s = aiSkiers.GetSkier(b);
+        v[0] = s.x;
+        v[1] = s.z;
+        v[2] = s.vx;
+        v[3] = s.vz;
+        return s.lod == AiSkiers::Full;
+    };
+    auto setBody = [&](int b, const float* v) {
+        if (b >= numAi) {
+            for (int j = 0; j < 4; j++) {
+                player[b - numAi][j] = v[j];
+            }
+            playerHit[b - numAi] = true;
+            return;
+        }
+        AiSkiers::Skier& s = aiSkiers.GetSkier(b);
+        s.x = v[0];
+        s.z = v[1];
+        s.vx = v[2];
+        s.vz = v[3];
+    };
+
+    for (int k = 0; k < skierBroadphase.GetNumOverlaps(); k++) {
+        const std::pair<int, int>& pair = skierBroadphase.GetOverlap(k);
+        float a[4], b[4];
+        if (!getBody(pair.first, a) || !getBody(pair.second, b)) {
+            continue;
+        }
+        float dx = b[0] - a[0];
+        float dz = b[1] - a[1];
+        float dist = sqrtf(dx * dx + dz * dz);
+        if (dist >= 2.0f * r || dist == 0.0f) {
+            continue;
+        }
+        float nx = dx / dist, nz = dz / dist;
+        float push = 0.5f * (2.0f * r - dist);
+        a[0] -= nx * push;
+        a[1] -= nz * push;
+        b[0] += nx * push;
+        b[1] += nz * push;
+        float closing = (b[2] - a[2]) * nx + (b[3] - a[3]) * nz;
+        if (closing < 0.0f) {
+            a[2] += nx * closing;
+            a[3] += nz * closing;
+            b[2] -= nx * closing;
+            b[3] -= nz * closing;
+        }
+        setBody(pair.first, a);
+        setBody(pair.second, b);
+    }
+    for (int k = 0; k < numPlayers; k++) {
+        if (playerHit[k]) {
+            Player& p = players[k];
+            p.xPos = SkierX - player[k][0];
+            p.zPos = -player[k][1];
+            p.xVel = -player[k][2];
+            p.zVel = -player[k][3];
+        }
+    }
+}
+
+// *************************************
+// Lays out the HUD for this frame: each player's speed, distance and time, in the corner
+//    of its view, and with hudMode 2, the frame times and all the Profiler's counters.
+//    Drawn later, by the "HUD" pass.
+// *************************************
+void myBuildHud() {
+    static const unsigned int White = 0xFFFFFFFF;
+    static const unsigned int Yellow = 0xFF40E0FF;
+    static const unsigned int Shade = 0x90000000;
+    static double lastFrameTime = 0.0;
+    static double frameMs = 0.0;        // Running average of the time between frames
+    double now = glfwGetTime();
+    if (lastFrameTime > 0.0) {
+        frameMs += (1000.0 * (now - lastFrameTime) - frameMs) / 16.0;
+    }
+    lastFrameTime = now;
+
+    const int scale = 2;
+    const int margin = 8;
+    const int line = Hud::LineHeight * scale;
+    Hud::Begin(screenWidth, screenHeight);
+    int x = margin, y = margin;
+    for (int k = numPlayers - 1; k >= 0; k--) {     // The first player's panel last, at the top left
+        const Player& p = players[k];
+        int numLines = (numPlayers > 1) ? 5 : 4;
+        if (k == 0 && hudMode == 2) {
+            numLines += 9 + Profiler::GetNumCounters() + netClient.IsConnected();
+        }
+        int left = p.viewport[0];
+        int top = screenHeight - (p.viewport[1] + p.viewport[3]);
+        Hud::Panel(left, top, 2 * margin + 44 * Hud::Advance * scale, 2 * margin + numLines * line, Shade);
+
+        x = left + margin;
+        y = top + margin;
+        if (numPlayers > 1) {
+            Hud::Text(x, y, scale, White, "PLAYER %d", k + 1);
+            y += line;
+        }
+        double speed = sqrt(p.xVel * p.xVel + p.zVel * p.zVel) / animateIncrement;     // Per second of animation time
+        double runTime = p.run.GetRunTime(simTime);
+        int minutes = (int)(runTime / 60.0);
+        Hud::Text(x, y, scale, White, "SPEED    %6.1f", speed);
+        y += line;
+        Hud::Text(x, y, scale, White, "DISTANCE %6.0f", p.zPos);
+        y += line;
+        Hud::Text(x, y, scale, White, "TIME   %02d:%06.3f", minutes, runTime - 60.0 * minutes);
+        y += line;
+        int lastGate = p.run.GetLastGateTimed();
+        Hud::Text(x, y, scale, p.run.GetNumMissed() > 0 ? Yellow : White, "GATE %2d/%-2d MISSED %d  SPLIT %.3f",
+            p.run.GetNextGate(), p.run.GetNumGates(), p.run.GetNumMissed(),
+            lastGate >= 0 ? p.run.GetSplit(lastGate) : 0.0);
+        y += line;
+    }
+    if (hudMode < 2) {
+        return;
+    }
+
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "FRAME %6.2f MS  %4.0f FPS", frameMs, frameMs > 0.0 ? 1000.0 / frameMs : 0.0);
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "GPU   %6.2f MS  SCALE %.3f", frameGraph.GetGpuTime(), PostProcess::GetRenderScale());
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "SIM   %6.3f MS  AI %d  FLOW %d", simMs, aiSkiers.GetNumSkiers(),
+        flowField.GetNumChunksBuilt());
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "AI LOD %s  %d/%d/%d  %d/STEP", aiSkiers.IsLodEnabled() ? "ON " : "OFF",
+        aiSkiers.GetNumAtLod(AiSkiers::Full), aiSkiers.GetNumAtLod(AiSkiers::Reduced),
+        aiSkiers.GetNumAtLod(AiSkiers::Far), aiSkiers.GetNumAdvanced());
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "BROADPHASE %d PAIRS %d SWAPS", skierBroadphase.GetNumPairs(),
+        skierBroadphase.GetNumSwaps());
+    y += line;
+    Hud::Text(x, y, scale, Yellow, "SIGHT %d/%d AI  CUTAWAY %d TREES", numAiSeeingPlayer,
+        (int)sightRays.size() / numPlayers, numCutawayTrees);
+    y += line;
+    double cullMs[MaxSceneViews] = { 0.0, 0.0, 0.0, 0.0 };
+    for (int k = 0; k < numPlayers; k++) {
+        cullMs[k] = GetViewCullTime(k);
+    }
+    Hud::Text(x, y, scale, Yellow, "VIEWS %d  CULL %.2f %.2f %.2f %.2f", numPlayers, cullMs[0], cullMs[1],
+        cullMs[2], cullMs[3]);
+    y += line;
+    if (netClient.IsConnected()) {
+        double kbits = simTime > 0.0 ? 0.008 * netClient.GetLink().GetBytesReceived() / simTime : 0.0;
+        Hud::Text(x, y, scale, Yellow, "NET %5.1f KBIT/S  FIXED %d  %.3f", kbits, numMispredicted, netCorrection);
+        y += line;
+    }
+    int hudTimer = FrameGraph::PassTimer("HUD");
+    Hud::Text(x, y, scale, Yellow, "HUD   %6.3f MS CPU %6.3f MS GPU", Hud::GetCpuTime(),
+        Profiler::HasValue(hudTimer) ? Profiler::GetValue(hudTimer) : 0.0);
+    y += line;
+    for (int i = 0; i < Profiler::GetNumCounters(); i++) {
+        if (!Profiler::HasValue(i)) {
+            Hud::Text(x, y, scale, White, "%-28.28s      -", Profiler::GetName(i));
+        }
+        else if (Profiler::IsTimer(i)) {
+            Hud::Text(x, y, scale, White, "%-28.28s %6.3f MS", Profiler::GetName(i), Profiler::GetValue(i));
+        }
+        else {
+            Hud::Text(x, y, scale, White, "%-28.28s %9.0f", Profiler::GetName(i), Profiler::GetValue(i));
+        }
+        y += line;
+    }
+}
+
 void my_setup_SceneData() {
 
     GlShaderMgr::LoadShaderSource("EduPhong.glsl");
@@ -211,24 +858,130 @@ void my_setup_SceneData() {
     // These two shaders differ only in the third part of the code used for the fragment shader!
 
     // The first shader program applies a texture map (a bitmap)
-    unsigned int vertexShader1 = GlShaderMgr::CompileShader("vertexShader_PhongPhong");
-    unsigned int fragmentShader1 = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "calcPhongLighting", "applyTextureMap");
+    unsigned int vertexShader1 = GlShaderMgr::CompileShader("vertexShader_PhongPhong", "phFrame");
+    unsigned int fragmentShader1 = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLighting", "applyTextureMap");
     unsigned int shaderList1[2] = { vertexShader1 , fragmentShader1 };
     shaderProgramBitmap = GlShaderMgr::LinkShaderProgram(2, shaderList1);
     phRegisterShaderProgram(shaderProgramBitmap);
 
     // The second shader program applies a procedural texture map -- Defined in MyShaders.glsl
     // FOR PROJECT 6: YOU WILL RE_WRITE THE SHADER CODE IN MyShaders.glsl.
-    unsigned int fragmentShader2 = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "calcPhongLighting", "MyProcTexture");
+    unsigned int fragmentShader2 = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLighting", "MyProcTexture");
     unsigned int shaderList2[2] = { vertexShader1 , fragmentShader2 };
     shaderProgramProc = GlShaderMgr::LinkShaderProgram(2, shaderList2);
     phRegisterShaderProgram(shaderProgramProc);
 
-    timeLoc = glGetUniformLocation(shaderProgramProc, "currentTime");
+    // The third shader program is the first one, with a vertex shader that sways trees in the wind.
+    unsigned int vertexShader3 = GlShaderMgr::CompileShader("vertexShader_Wind", "phFrame", "windSway");
+    unsigned int shaderList3[2] = { vertexShader3 , fragmentShader1 };
+    shaderProgramWind = GlShaderMgr::LinkShaderProgram(2, shaderList3);
+    phRegisterShaderProgram(shaderProgramWind);
+
+    // The fourth shader program is the third one, for instanced drawing of trees culled on the GPU.
+    unsigned int vertexShader4 = GlShaderMgr::CompileShader("vertexShader_WindInstanced", "phFrame", "windSway");
+    unsigned int shaderList4[2] = { vertexShader4 , fragmentShader1 };
+    shaderProgramWindInstanced = GlShaderMgr::LinkShaderProgram(2, shaderList4);
+    phRegisterShaderProgram(shaderProgramWindInstanced);
+
+    // The leaf cards use the wind vertex shaders, with a fragment shader that alpha tests an RGBA texture.
+    //    They are never drawn in the depth prepass, so they need no depth-only twins.
+    unsigned int fragmentShaderFoliage = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLighting", "applyTextureMapAlphaTest");
+    unsigned int shaderList5[2] = { vertexShader3 , fragmentShaderFoliage };
+    shaderProgramFoliage = GlShaderMgr::LinkShaderProgram(2, shaderList5);
+    phRegisterShaderProgram(shaderProgramFoliage);
+    unsigned int shaderList6[2] = { vertexShader4 , fragmentShaderFoliage };
+    shaderProgramFoliageInstanced = GlShaderMgr::LinkShaderProgram(2, shaderList6);
+    phRegisterShaderProgram(shaderProgramFoliageInstanced);
+
+    // The shading level of detail: the draw items beyond gouraudDistance are lit per vertex,
+    //    with EduPhong's Gouraud shaders, and a wind-swaying version of its vertex shader.
+    unsigned int vertexShaderGouraud = GlShaderMgr::CompileShader("vertexShader_PhongGouraud", "phFrame", "calcPhongLighting");
+    unsigned int fragmentShaderGouraud = GlShaderMgr::CompileShader("fragmentShader_PhongGouraud", "phFrame", "applyTextureMap");
+    unsigned int shaderListGouraud[2] = { vertexShaderGouraud, fragmentShaderGouraud };
+    phShaderPhongGouraud = GlShaderMgr::LinkShaderProgram(2, shaderListGouraud);
+    phRegisterShaderProgram(phShaderPhongGouraud);
+    unsigned int vertexShaderWindGouraud = GlShaderMgr::CompileShader("vertexShader_WindGouraud", "phFrame", "windSway", "calcPhongLighting");
+    unsigned int shaderListWindGouraud[2] = { vertexShaderWindGouraud, fragmentShaderGouraud };
+    shaderProgramWindGouraud = GlShaderMgr::LinkShaderProgram(2, shaderListWindGouraud);
+    phRegisterShaderProgram(shaderProgramWindGouraud);
+
+    // Baked lighting (see LightBaker.h): the terrain chunks, and the tree variants once they are baked.
+    //    The vertex shaders pass on the baked lighting, and calcPhongLightingBaked uses it for light 0.
+    unsigned int vertexShaderBaked = GlShaderMgr::CompileShader("vertexShader_Baked", "phFrame");
+    unsigned int vertexShaderWindBaked = GlShaderMgr::CompileShader("vertexShader_WindBaked", "phFrame", "windSway");
+    unsigned int vertexShaderWindInstancedBaked = GlShaderMgr::CompileShader("vertexShader_WindInstancedBaked", "phFrame", "windSway");
+    unsigned int fragmentShaderBaked = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLightingBaked", "applyTextureMap");
+    unsigned int fragmentShaderFoliageBaked = GlShaderMgr::CompileShader("fragmentShader_PhongPhong", "phFrame", "calcPhongLightingBaked", "applyTextureMapAlphaTest");
+    unsigned int shaderListBaked[2] = { vertexShaderBaked, fragmentShaderBaked };
+    shaderProgramBaked = GlShaderMgr::LinkShaderProgram(2, shaderListBaked);
+    unsigned int shaderListWindBaked[2] = { vertexShaderWindBaked, fragmentShaderBaked };
+    shaderProgramWindBaked = GlShaderMgr::LinkShaderProgram(2, shaderListWindBaked);
+    unsigned int shaderListWindInstancedBaked[2] = { vertexShaderWindInstancedBaked, fragmentShaderBaked };
+    shaderProgramWindInstancedBaked = GlShaderMgr::LinkShaderProgram(2, shaderListWindInstancedBaked);
+    unsigned int shaderListFoliageBaked[2] = { vertexShaderWindBaked, fragmentShaderFoliageBaked };
+    shaderProgramFoliageBaked = GlShaderMgr::LinkShaderProgram(2, shaderListFoliageBaked);
+    unsigned int shaderListFoliageInstancedBaked[2] = { vertexShaderWindInstancedBaked, fragmentShaderFoliageBaked };
+    shaderProgramFoliageInstancedBaked = GlShaderMgr::LinkShaderProgram(2, shaderListFoliageInstancedBaked);
+    unsigned int bakedPrograms[5] = { shaderProgramBaked, shaderProgramWindBaked, shaderProgramWindInstancedBaked,
+        shaderProgramFoliageBaked, shaderProgramFoliageInstancedBaked };
+    for (unsigned int program : bakedPrograms) {
+        phRegisterShaderProgram(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "NumBakedLights"), 1);
+    }
+
+    // Vertex pulling from shader storage buffers needs OpenGL 4.3. Only the vertex shader differs.
+    if (VertexPullPool::IsSupported()) {
+        unsigned int vertexShaderPulled = GlShaderMgr::CompileShader("vertexShader_Pulled", "phFrame");
+        unsigned int shaderListPulled[2] = { vertexShaderPulled , fragmentShader1 };
+        shaderProgramPulled = GlShaderMgr::LinkShaderProgram(2, shaderListPulled);
+        phRegisterShaderProgram(shaderProgramPulled);
+    }
+
+    // The programs lit per fragment scale their ambient terms by the screen-space ambient occlusion (see Ssao.h).
+    unsigned int ssaoPrograms[12] = { shaderProgramBitmap, shaderProgramProc, shaderProgramWind, shaderProgramWindInstanced,
+        shaderProgramFoliage, shaderProgramFoliageInstanced, shaderProgramBaked, shaderProgramWindBaked,
+        shaderProgramWindInstancedBaked, shaderProgramFoliageBaked, shaderProgramFoliageInstancedBaked, shaderProgramPulled };
+    for (unsigned int program : ssaoPrograms) {
+        Ssao::RegisterProgram(program);
+    }
 
+    // The depth-only twins, for the depth prepass. They share the vertex shaders, which declare
+    //    gl_Position invariant, so that separately linked programs give exactly the same depths,
+    //    as needed for the GL_EQUAL depth test in the lighting pass.
+    unsigned int fragmentShaderDepth = GlShaderMgr::CompileShader("fragmentShader_DepthOnly");
+    unsigned int depthList1[2] = { vertexShader1, fragmentShaderDepth };
+    depthProgramBitmap = GlShaderMgr::LinkShaderProgram(2, depthList1);
+    unsigned int depthList3[2] = { vertexShader3, fragmentShaderDepth };
+    depthProgramWind = GlShaderMgr::LinkShaderProgram(2, depthList3);
+    unsigned int depthList4[2] = { vertexShader4, fragmentShaderDepth };
+    depthProgramWindInstanced = GlShaderMgr::LinkShaderProgram(2, depthList4);
+    unsigned int depthListGouraud[2] = { vertexShaderGouraud, fragmentShaderDepth };
+    depthProgramGouraud = GlShaderMgr::LinkShaderProgram(2, depthListGouraud);
+    unsigned int depthListWindGouraud[2] = { vertexShaderWindGouraud, fragmentShaderDepth };
+    depthProgramWindGouraud = GlShaderMgr::LinkShaderProgram(2, depthListWindGouraud);
+    unsigned int depthListBaked[2] = { vertexShaderBaked, fragmentShaderDepth };
+    depthProgramBaked = GlShaderMgr::LinkShaderProgram(2, depthListBaked);
+    unsigned int depthListWindBaked[2] = { vertexShaderWindBaked, fragmentShaderDepth };
+    depthProgramWindBaked = GlShaderMgr::LinkShaderProgram(2, depthListWindBaked);
+    unsigned int depthListWindInstancedBaked[2] = { vertexShaderWindInstancedBaked, fragmentShaderDepth };
+    depthProgramWindInstancedBaked = GlShaderMgr::LinkShaderProgram(2, depthListWindInstancedBaked);
+    unsigned int depthPrograms[8] = { depthProgramBitmap, depthProgramWind, depthProgramWindInstanced,
+        depthProgramGouraud, depthProgramWindGouraud, depthProgramBaked, depthProgramWindBaked, depthProgramWindInstancedBaked };
+    for (unsigned int program : depthPrograms) {
+        phBindFrameBlock(program);      // Their vertex shaders read the projection and the time from the phFrame block
+    }
+
+    // Generated meshes are cached on disk, so later launches upload them without recomputing.
+    GlGeomMeshCache::Open("meshcache.bin");
     mySetupGeometries();
     check_for_opengl_errors();
     SetupForTextures();   // The shader programs should be compiled and linked before setting up textures.
+    SetupCourse(netClient.IsConnected() && netClient.IsGiantSlalom());
+    SetupObstacleGrid();
+    SetupTerrain();
+    SetupAiSkiers(numAiSkiers);
+    myRestartRun();
     check_for_opengl_errors();
 
     MySetupGlobalLight();
@@ -236,14 +989,39 @@ void my_setup_SceneData() {
     LoadAllLights();
     MySetupMaterials();
 
+    // All GlGeom meshes have been loaded by now: write out any that were not already cached.
+    if (GlGeomMeshCache::GetNumMisses() > 0) {
+        GlGeomMeshCache::Save();
+    }
+
 	check_for_opengl_errors();   // Really a great idea to check for errors -- esp. good for debugging!
 }
 
 void selectShaderProgram(unsigned int shaderProgram) {
-    assert(shaderProgram == shaderProgramBitmap || shaderProgram == shaderProgramProc);
+    assert(shaderProgram == shaderProgramBitmap || shaderProgram == shaderProgramProc
+        || shaderProgram == shaderProgramWind || shaderProgram == shaderProgramWindInstanced
+        || shaderProgram == shaderProgramFoliage || shaderProgram == shaderProgramFoliageInstanced
+        || shaderProgram == phShaderPhongGouraud || shaderProgram == shaderProgramWindGouraud
+        || shaderProgram == shaderProgramBaked || shaderProgram == shaderProgramWindBaked
+        || shaderProgram == shaderProgramWindInstancedBaked || shaderProgram == shaderProgramFoliageBaked
+        || shaderProgram == shaderProgramFoliageInstancedBaked
+        || (shaderProgram == shaderProgramPulled && shaderProgram != 0));
+    if (depthOnlyPass) {
+        assert(shaderProgram != shaderProgramFoliage && shaderProgram != shaderProgramFoliageInstanced
+            && shaderProgram != shaderProgramFoliageBaked && shaderProgram != shaderProgramFoliageInstancedBaked);
+        shaderProgram = (shaderProgram == shaderProgramWind) ? depthProgramWind
+            : (shaderProgram == shaderProgramWindInstanced) ? depthProgramWindInstanced
+            : (shaderProgram == phShaderPhongGouraud) ? depthProgramGouraud
+            : (shaderProgram == shaderProgramWindGouraud) ? depthProgramWindGouraud
+            : (shaderProgram == shaderProgramBaked) ? depthProgramBaked
+            : (shaderProgram == shaderProgramWindBaked) ? depthProgramWindBaked
+            : (shaderProgram == shaderProgramWindInstancedBaked) ? depthProgramWindInstancedBaked : depthProgramBitmap;
+    }
     glUseProgram(shaderProgram);
     modelviewMatLocation = phGetModelviewMatLoc(shaderProgram);
     applyTextureLocation = phGetApplyTextureLoc(shaderProgram);
+    windPhaseLoc = glGetUniformLocation(shaderProgram, "windPhase");
+    windParamsLoc = glGetUniformLocation(shaderProgram, "windParams");
 }
 
 // *******************************************************
@@ -255,21 +1033,155 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (action == GLFW_RELEASE) {
         return;			// Ignore key up (key release) events
     }
+    if (netClient.IsConnected() && (key == 'R' || key == 'N' || key == 'I' || key == 'J')) {
+        printf("In a networked race, the server controls the run, the course and the AI skiers.\n");
+        return;
+    }
     bool viewChanged = false;
     switch (key) {
     case GLFW_KEY_ESCAPE:
         glfwSetWindowShouldClose(window, true);
         return;
     case 'A':
-        if (xVel < 0.1) {
-            xVel += 0.01;
+    case GLFW_KEY_LEFT:
+        if (key == 'A' || numPlayers > 1) {
+            Player& p = players[key == 'A' ? 0 : 1];
+            if (p.xVel < 0.1) {
+                p.xVel += 0.01;
+            }
         }
         return;
     case 'D':
-        if (xVel > -0.1) {
-            xVel -= 0.01;
+    case GLFW_KEY_RIGHT:
+        if (key == 'D' || numPlayers > 1) {
+            Player& p = players[key == 'D' ? 0 : 1];
+            if (p.xVel > -0.1) {
+                p.xVel -= 0.01;
+            }
         }
         return;
+    case 'J':
+        // Cycle through 1 to 4 players, in split screen. The run restarts, with everyone at the top.
+        numPlayers = numPlayers % MaxSceneViews + 1;
+        myRestartRun();
+        myLayoutViews();
+        setProjectionMatrix();
+        printf("%d player%s.\n", numPlayers, numPlayers > 1 ? "s, in split screen" : "");
+        return;
+    case 'O':
+        occlusionCulling = !occlusionCulling;
+        PrintCullingStats();
+        return;
+    case 'C':
+        PrintCullingStats();
+        return;
+    case 'G':
+        if (!TreeGpuCuller::IsSupported()) {
+            printf("GPU culling needs OpenGL 4.3: the trees are culled on the CPU.\n");
+            return;
+        }
+        gpuCulling = !gpuCulling;
+        printf("Trees are culled on the %s.\n", gpuCulling ? "GPU" : "CPU");
+        return;
+    case 'Z':
+        depthPrepass = !depthPrepass;
+        printf("Depth prepass is %s.\n", depthPrepass ? "on" : "off");
+        return;
+    case 'V':
+        PrintOverdrawStats();
+        return;
+    case 'F':
+        frameGraph.PrintStats();
+        return;
+    case 'T':
+        TextureStreamer::PrintStats();
+        return;
+    case 'B': {
+        // Cycle the texture budget through 64, 16 and 4 MB
+        size_t budget = TextureStreamer::GetBudget() >> 2;
+        TextureStreamer::SetBudget(budget < ((size_t)4 << 20) ? (size_t)64 << 20 : budget);
+        printf("Texture budget is %d MB.\n", (int)(TextureStreamer::GetBudget() >> 20));
+        return;
+    }
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+        PostProcess::ToggleEffect(1 << (key - '1'));
+        return;
+    case 'P':
+        PostProcess::PrintStatus();
+        return;
+    case 'Q':
+        Ssao::CycleQuality();
+        return;
+    case 'U': {
+        // A haze toward the white of the sky, from the fog of the phFrame block
+        const float hazeStart = 25.0f, hazeEnd = 80.0f;
+        bool haze = framePhongData.FogEnd <= framePhongData.FogStart;
+        framePhongData.FogStart = haze ? hazeStart : 0.0f;
+        framePhongData.FogEnd = haze ? hazeEnd : 0.0f;
+        printf("Distance haze is %s.\n", haze ? "on" : "off");
+        return;
+    }
+    case 'H':
+        hudMode = (hudMode + 1) % 3;
+        return;
+    case 'K':
+        RunRenderBenchmark();
+        return;
+    case 'R':
+        myRestartRun();
+        return;
+    case 'I':
+        // Cycle the number of AI skiers through 8, 64, 512 and 4096
+        numAiSkiers = (numAiSkiers >= 4096) ? 8 : 8 * numAiSkiers;
+        aiSkiers.Spawn(numAiSkiers);
+        mySetupBroadphase();
+        printf("%d AI skiers.\n", numAiSkiers);
+        return;
+    case 'L':
+        aiSkiers.SetLodEnabled(!aiSkiers.IsLodEnabled());
+        printf("AI skiers' simulation level of detail is %s.\n", aiSkiers.IsLodEnabled() ? "on" : "off");
+        return;
+    case 'X':
+        cameraCutaway = !cameraCutaway;
+        printf("Trees blocking the view of the skier are %s.\n", cameraCutaway ? "cut away" : "drawn");
+        return;
+    case 'N':
+        SetupCourse(slalomCourse.GetDiscipline() == SlalomCourse::Slalom);
+        myRestartRun();
+        printf("New %s course, %d gates.\n",
+            slalomCourse.GetDiscipline() == SlalomCourse::Slalom ? "slalom" : "giant slalom", slalomCourse.GetNumGates() - 2);
+        return;
+    case 'S':
+        // Cycle the shading level of detail's distance: 15, 25, 35, off (all Phong), and 0 (all Gouraud)
+        gouraudDistance = (gouraudDistance == 0.0f) ? 15.0f : (gouraudDistance >= FLT_MAX) ? 0.0f
+            : (gouraudDistance >= 35.0f) ? FLT_MAX : gouraudDistance + 10.0f;
+        if (gouraudDistance >= FLT_MAX) {
+            printf("Everything is lit per fragment (Phong shading).\n");
+        }
+        else {
+            printf("Objects beyond %.0f units are lit per vertex (Gouraud shading).\n", gouraudDistance);
+        }
+        return;
+    case 'W':
+        RunShadingBenchmark();
+        return;
+    case 'E':
+        bakedLighting = !bakedLighting;
+        printf("Baked lighting is %s.\n", bakedLighting ? "on" : "off");
+        PrintBakeStats();
+        return;
+    case 'M':
+        if (!multisampled) {
+            printf("Alpha to coverage needs multisampling: the leaf cards are alpha tested.\n");
+            return;
+        }
+        alphaToCoverage = !alphaToCoverage;
+        printf("Leaf cards use %s.\n", alphaToCoverage ? "alpha to coverage" : "alpha testing");
+        return;
     }
     if (viewChanged) {
         mySetViewMatrix();
@@ -294,6 +1206,7 @@ void window_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
     screenWidth = width == 0 ? 1 : width;
     screenHeight = height==0 ? 1 : height;
+    myLayoutViews();
     setProjectionMatrix();
 }
 
@@ -301,8 +1214,9 @@ void setProjectionMatrix() {
 	// Setup the projection matrix as a perspective view.
 	// The complication is that the aspect ratio of the window may not match the
 	//		aspect ratio of the scene we want to view.
-	double w = (double)screenWidth;
-	double h = (double)screenHeight;
+	// In split screen, all the views have the size of the first player's view.
+	double w = (double)players[0].viewport[2];
+	double h = (double)players[0].viewport[3];
 	double windowXmax, windowYmax;
     double aspectFactor = w * Ymax / (h * Xmax);   // == (w/h)/(Xmax/Ymax), ratio of aspect ratios
 	if (aspectFactor>1) {
@@ -324,15 +1238,8 @@ void setProjectionMatrix() {
                                       -windowYmax * scale, windowYmax * scale, zNear, zFar);
     float matEntries[16];
     theProjectionMatrix.DumpByColumns(matEntries);
-    if (glIsProgram(shaderProgramBitmap)) {
-        check_for_opengl_errors();
-        glUseProgram(shaderProgramBitmap);
-        glUniformMatrix4fv(phGetProjMatLoc(shaderProgramBitmap), 1, false, matEntries);
-    }
-    if (glIsProgram(shaderProgramProc)) {
-        glUseProgram(shaderProgramProc);
-        glUniformMatrix4fv(phGetProjMatLoc(shaderProgramProc), 1, false, matEntries);
-    }
+    Ssao::SetProjection(matEntries[0], matEntries[5], (float)zNear, (float)zFar);
+    framePhongData.ProjectionMatrix = theProjectionMatrix;      // Loaded into the shaders with the next frame
 
     check_for_opengl_errors();   // Really a great idea to check for errors -- esp. good for debugging!
 }
@@ -368,17 +1275,247 @@ void setup_callbacks(GLFWwindow* window) {
 	// glfwSetMouseButtonCallback(window, mouse_button_callback);
 }
 
-int main() {
+// *************************************************
+// Networked races, without a window: the server, and the test over localhost.
+// *************************************************
+
+// Sets up the simulation without OpenGL, and opens the race server.
+bool myStartServer(uint16_t port) {
+    headless = true;
+    networked = true;
+    setupRNG();
+    SetupCourse(false);
+    SetupObstacleGrid();
+    SetupAiSkiers(numAiSkiers);
+    myRestartRun();
+    if (!netServer.Open(port, forestSeed, false)) {
+        return false;
+    }
+    netServer.GetLink().SetConditions(netLatencyMs, netJitterMs, netLoss);
+    printf("Race server on port %d: forest %u, %d AI skiers, %.0f ms latency, %.0f ms jitter, %.0f%% loss.\n",
+        port, forestSeed, numAiSkiers, netLatencyMs, netJitterMs, 100.0 * netLoss);
+    return true;
+}
+
+// One step of the server, timed. Returns its milliseconds.
+double myServerTick() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    mySimulateTick();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Prints each client's bandwidth, and the server's cost per step and per player, since the last call.
+void myPrintServerStats(double tickMs, int numTicks) {
+    static uint64_t lastBytes[NetServer::MaxClients];
+    static double lastTime = 0.0;
+    double seconds = simTime - lastTime;
+    int numConnected = netServer.GetNumConnected();
+    printf("%.0f s: %d player%s, %.3f ms per step, %.3f ms per player.", simTime, numConnected,
+        numConnected == 1 ? "" : "s", tickMs / numTicks, tickMs / numTicks / std::max(numConnected, 1));
+    for (int k = 0; k < NetServer::MaxClients; k++) {
+        if (netServer.IsConnected(k) && seconds > 0.0) {
+            printf("  Player %d: %.1f kbit/s.", k + 1, 0.008 * (netServer.GetBytesSent(k) - lastBytes[k]) / seconds);
+        }
+        lastBytes[k] = netServer.GetBytesSent(k);
+    }
+    printf("\n");
+    lastTime = simTime;
+}
+
+// Runs the race server until killed, a step every SimTickSeconds.
+int myRunServer(uint16_t port) {
+    const double StatsSeconds = 5.0;
+    if (!myStartServer(port)) {
+        return -1;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double tickMs = 0.0;
+    int numTicks = 0;
+    for (;;) {
+        double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (simTime + SimTickSeconds > now) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (simTime + MaxTicksPerFrame * SimTickSeconds < now) {
+            simTime = now;          // Fell behind: skip the steps, as the game does
+        }
+        tickMs += myServerTick();
+        numTicks++;
+        if (numTicks >= StatsSeconds / SimTickSeconds) {
+            myPrintServerStats(tickMs, numTicks);
+            tickMs = 0.0;
+            numTicks = 0;
+        }
+    }
+}
+
+// Runs a race over localhost, as fast as it goes: the server, and numClients clients in
+//    this program, each steering back and forth, over links with the latency and loss set.
+//    Time is the simulation's, so the simulated latency holds however fast it runs. Reports the
+//    bandwidth and the server's cost, and checks every snapshot decoded. Returns 0 if all went well.
+int myRunNetTest(int numClients, double seconds, uint16_t port) {
+    if (!myStartServer(port)) {
+        return -1;
+    }
+    NetClient clients[NetServer::MaxClients];
+    Player predicted[NetServer::MaxClients];
+    int numCorrections[NetServer::MaxClients] = { 0, 0, 0, 0 };
+    double maxCorrection[NetServer::MaxClients] = { 0.0, 0.0, 0.0, 0.0 };
+    std::vector<NetClient::Skier> shown;
+    size_t numShown = 0;
+    for (int c = 0; c < numClients; c++) {
+        if (!clients[c].Start("127.0.0.1", port, SimTickSeconds, simTime)) {
+            return -1;
+        }
+        clients[c].GetLink().SetConditions(netLatencyMs, netJitterMs, netLoss);
+    }
+
+    double tickMs = 0.0;
+    int numTicks = 0;
+    double totalMs = 0.0;
+    int totalTicks = 0;
+    while (simTime < seconds) {
+        for (int c = 0; c < numClients; c++) {
+            NetClient& client = clients[c];
+            client.Receive(simTime);
+            if (!client.IsConnected()) {
+                continue;
+            }
+            Player& p = predicted[c];
+            double error = myApplyCorrection(client, p);
+            if (error > 0.0) {
+                numCorrections[c]++;
+                maxCorrection[c] = std::max(maxCorrection[c], error);
+            }
+            p.xVel = 0.05 * sin(0.5 * simTime + c);
+            p.xVel = NetSnapshot::Velocity(NetSnapshot::QuantizeVelocity((float)p.xVel));
+            client.SendInput((float)p.xVel, simTime);
+            myMovePlayer(p);
+            client.GetInterpolated(simTime, shown);
+            numShown += shown.size();
+        }
+        double ms = myServerTick();
+        tickMs += ms;
+        totalMs += ms;
+        numTicks++;
+        totalTicks++;
+        if (numTicks >= 5.0 / SimTickSeconds) {
+            myPrintServerStats(tickMs, numTicks);
+            tickMs = 0.0;
+            numTicks = 0;
+        }
+    }
+
+    bool passed = true;
+    printf("Network test: %d clients, %.0f s, %d AI skiers, %.0f ms latency, %.0f ms jitter, %.0f%% loss.\n",
+        numClients, seconds, numAiSkiers, netLatencyMs, netJitterMs, 100.0 * netLoss);
+    for (int c = 0; c < numClients; c++) {
+        const NetClient& client = clients[c];
+        int k = client.GetSlot();
+        if (!client.IsConnected() || k < 0) {
+            printf("  Client %d did not connect.\n", c + 1);
+            passed = false;
+            continue;
+        }
+        printf("  Player %d: down %.1f kbit/s, up %.1f kbit/s, %d snapshots, %d undecodable, %d corrections (largest %.3f).\n",
+            k + 1, 0.008 * netServer.GetBytesSent(k) / seconds, 0.008 * clients[c].GetLink().GetBytesSent() / seconds,
+            client.GetNumSnapshots(), client.GetNumUndecodable(), numCorrections[c], maxCorrection[c]);
+        passed = passed && client.GetNumSnapshots() > 0 && client.GetNumUndecodable() == 0;
+    }
+    printf("  Server: %.3f ms per step, %.3f ms per player. Dropped %d of %d packets.\n", totalMs / totalTicks,
+        totalMs / totalTicks / std::max(netServer.GetNumConnected(), 1), (int)netServer.GetLink().GetPacketsDropped(),
+        (int)netServer.GetLink().GetPacketsSent());
+    printf("  Other skiers shown per client step: %.1f.\n", numShown / (double)std::max(totalTicks * numClients, 1));
+    printf("Network test %s.\n", passed ? "passed" : "failed");
+    for (int c = 0; c < numClients; c++) {
+        clients[c].Disconnect(simTime);
+    }
+    netServer.Close();
+    return passed ? 0 : 1;
+}
+
+// Command line, for networked races:
+//    --server [port]           Runs the race server, headless.
+//    --connect host [port]     Joins the race on that server.
+//    --nettest [clients]       Runs a race over localhost, with the clients in this program, and reports.
+//    --latency ms, --jitter ms, --loss percent     Simulated on this end's link.
+//    --ai count                The server's number of AI skiers.
+int main(int argc, char* argv[]) {
+    const char* serverHost = 0;
+    uint16_t port = DefaultNetPort;
+    bool runServer = false;
+    int numTestClients = 0;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+        if (strcmp(argv[i], "--server") == 0) {
+            runServer = true;
+            if (hasValue) {
+                port = (uint16_t)atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--connect") == 0 && hasValue) {
+            serverHost = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                port = (uint16_t)atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--nettest") == 0) {
+            numTestClients = hasValue ? atoi(argv[++i]) : 3;
+            numTestClients = (numTestClients < 1) ? 1 : (numTestClients > NetServer::MaxClients) ? NetServer::MaxClients : numTestClients;
+        }
+        else if (strcmp(argv[i], "--latency") == 0 && hasValue) {
+            netLatencyMs = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--jitter") == 0 && hasValue) {
+            netJitterMs = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--loss") == 0 && hasValue) {
+            netLoss = 0.01 * atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ai") == 0 && hasValue) {
+            numAiSkiers = std::max(0, atoi(argv[++i]));
+        }
+        else {
+            printf("Unknown option %s.\n", argv[i]);
+            return -1;
+        }
+    }
+    if (numTestClients > 0) {
+        return myRunNetTest(numTestClients, 30.0, port);
+    }
+    if (runServer) {
+        return myRunServer(port);
+    }
+    if (serverHost) {
+        // Join before opening the window: the server chooses the forest and the course.
+        if (!netClient.Start(serverHost, port, SimTickSeconds, 0.0) || !netClient.WaitForConnection(0.0, 5.0)) {
+            return -1;
+        }
+        netClient.GetLink().SetConditions(netLatencyMs, netJitterMs, netLoss);
+        networked = true;
+        forestSeed = netClient.GetForestSeed();
+        numAiSkiers = 0;                    // The server's come in the snapshots
+        printf("Joined the race at %s as player %d.\n", serverHost, netClient.GetSlot() + 1);
+    }
+
 	glfwSetErrorCallback(error_callback);	// Supposed to be called in event of errors. (doesn't work?)
 	glfwInit();
 #if defined(__APPLE__) || defined(__linux__)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // Ask for OpenGL 4.3, for culling trees on the GPU. Fall back to 3.3 if it is not available.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
 	GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Final Project", NULL, NULL);
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(screenWidth, screenHeight, "Final Project", NULL, NULL);
+    }
+#else
+	GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Final Project", NULL, NULL);
+#endif
 	if (window == NULL) {
 		printf("Failed to create GLFW window!\n");
 		return -1;
@@ -398,13 +1535,38 @@ int main() {
 #endif
     printf("Using GLEW version %s.\n", glewGetString(GLEW_VERSION));
 
-    printf("Press or hold A to move left and D to move right.");
+    printf("Press or hold A to move left and D to move right.\n");
+    printf("Press O to toggle occlusion culling, C to print culling statistics.\n");
+    if (TreeGpuCuller::IsSupported()) {
+        printf("Press G to switch between culling trees on the GPU and on the CPU.\n");
+    }
+    printf("Press Z to toggle the depth prepass, V to print overdraw statistics.\n");
+    printf("Press T to print texture streaming statistics, B to change the texture budget.\n");
+    printf("Press F to print the render passes and their GPU times.\n");
+    printf("Press 1 to 5 to toggle tonemapping, color grading, vignette, FXAA and dynamic resolution,\n");
+    printf("    P to print the post-processing status.\n");
+    printf("Press Q to cycle the ambient occlusion (SSAO, with the depth prepass): off, low, medium and high.\n");
+    printf("Press U to toggle the distance haze.\n");
+    printf("Press H to cycle the HUD: off, on, and with the performance overlay.\n");
+    printf("Press R to restart the run, N to switch between slalom and giant slalom.\n");
+    printf("Press I to change the number of AI skiers, L to toggle their simulation level of detail.\n");
+    printf("Press X to toggle cutting away the trees between the camera and the skier.\n");
+    if (VertexPullPool::IsSupported()) {
+        printf("Press K to benchmark drawing with VAOs against vertex pulling.\n");
+    }
+    printf("Press M to switch the leaf cards between alpha to coverage and alpha testing.\n");
+    printf("Press S to change the distance to switch from Phong to Gouraud shading, W to measure the saving.\n");
+    printf("Press E to toggle the baked lighting of the trees and the snow, and print the bake's statistics.\n");
+    printf("Run with --server to host a networked race, --connect <host> to join one, --nettest to test over localhost.\n");
 	
     setup_callbacks(window);
    
 	// Initialize OpenGL, the scene and the shaders
     my_setup_OpenGL();
 	my_setup_SceneData();
+    PostProcess::Setup();
+    Ssao::Setup();
+    Hud::Setup();
  	window_size_callback(window, screenWidth, screenHeight);
 
     // Loop while program is not terminated.
@@ -419,6 +1581,13 @@ int main() {
 		// glfwPollEvents();					// Use this version when animating as fast as possible
 	}
 
+	if (netClient.IsConnected()) {
+        netClient.Disconnect(simTime);
+    }
+    StopCullWorkers();
+	TreeVariantPool::Shutdown();     // Wait for any trees still being built
+    TerrainChunks::Shutdown();
+    TextureStreamer::Shutdown();
 	glfwTerminate();
 	return 0;
 }
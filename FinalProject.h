@@ -11,9 +11,13 @@
 #include <GL/glew.h> 
 #include <GLFW/glfw3.h>
 
+#include <stdint.h>
 #include <vector>
 
 class LinearMapR4;      // Used in the function prototypes, declared in LinearMapR4.h
+class FrameGraph;
+class NetClient;
+struct Player;
 
 //
 // External variables.  Can be be used by other .cpp files.
@@ -36,6 +40,9 @@ extern double animateIncrement;   // Make bigger to speed up animation, smaller
 extern double currentTime;         // Current "time" for the animation.
 extern double currentDelta;        // Current state of the animation (YOUR CODE MAY NOT WANT TO USE THIS.)
 
+extern int screenWidth, screenHeight;   // Size of the window, in pixels
+
+extern LinearMapR4 theProjectionMatrix;	// The projection matrix, set by setProjectionMatrix()
 extern LinearMapR4 viewMatrix;		// The current view matrix, based on viewAzimuth and viewDirection.
 // Comment: This viewMatrix changes only when the view changes.
 // The modelViewMatrix is updated to render objects in the desired position and orientation.
@@ -44,12 +51,30 @@ extern LinearMapR4 viewMatrix;		// The current view matrix, based on viewAzimuth
 // Global variables that let program access the shader programs:
 extern unsigned int shaderProgramBitmap;     // The shader program that applies a bitmapped texture map (from a file)
 extern unsigned int shaderProgramProc;       // The shader program that applies a procedural texture map
+extern unsigned int shaderProgramWind;       // Like shaderProgramBitmap, but sways trees in the wind
+extern unsigned int shaderProgramWindInstanced;  // Like shaderProgramWind, for trees culled by TreeGpuCuller
+extern unsigned int shaderProgramFoliage;    // Like shaderProgramWind, for alpha-tested leaf cards
+extern unsigned int shaderProgramFoliageInstanced;  // Like shaderProgramWindInstanced, for alpha-tested leaf cards
+extern unsigned int shaderProgramPulled;     // Like shaderProgramBitmap, with vertex pulling; 0 before OpenGL 4.3
+extern unsigned int shaderProgramWindGouraud;  // Like shaderProgramWind, lit per vertex (Gouraud shading)
+extern unsigned int shaderProgramBaked;      // Like shaderProgramBitmap, with baked lighting (see LightBaker.h)
+extern unsigned int shaderProgramWindBaked;  // Like shaderProgramWind, with baked lighting
+extern unsigned int shaderProgramWindInstancedBaked;
+extern unsigned int shaderProgramFoliageBaked;
+extern unsigned int shaderProgramFoliageInstancedBaked;
+extern bool multisampled;                    // Whether the framebuffer has multisampling
+extern bool depthOnlyPass;                   // While true, selectShaderProgram() selects depth-only programs
+extern FrameGraph frameGraph;                // The render passes of the current frame
+extern unsigned int windPhaseLoc;            // Locations of the wind uniforms in the currently active shader program
+extern unsigned int windParamsLoc;
 extern unsigned int modelviewMatLocation;
 extern unsigned int applyTextureLocation;
 
 constexpr unsigned int vertPos_loc = 0;         // "location = 0" in the vertex shader definition
 constexpr unsigned int vertNormal_loc = 1;      // "location = 1" in the vertex shader definition
 constexpr unsigned int vertTexCoords_loc = 2;   // "location = 2" in the vertex shader definition
+constexpr unsigned int treeInstance_loc = 9;    // "location = 9" in vertexShader_WindInstanced
+constexpr unsigned int bakedLight_loc = 10;     // "location = 10" in the baked vertex shaders (see LightBaker.h)
 
 
 
@@ -63,6 +88,26 @@ void mySetupGeometries();
 void mySetViewMatrix();  
 
 void myRenderScene();
+void mySimulateTick();
+void myPollJoysticks();
+void myRestartRun();
+void myLayoutViews();
+void mySetupBroadphase();
+void myCollideSkiers();
+void myCheckLineOfSight();
+void myBuildHud();
+
+bool myStepPlayer(int k);
+void myMovePlayer(Player& p);
+double myApplyCorrection(NetClient& client, Player& p);
+void myShowNetworkSkiers();
+void myServerReceive();
+void myServerSend();
+bool myStartServer(uint16_t port);
+double myServerTick();
+void myPrintServerStats(double tickMs, int numTicks);
+int myRunServer(uint16_t port);
+int myRunNetTest(int numClients, double seconds, uint16_t port);
 
 void my_setup_SceneData();
 void my_setup_OpenGL();
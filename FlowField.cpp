@@ -0,0 +1,248 @@
+//
+// FlowField.cpp
+//
+// Steering directions for the AI skiers, built chunk by chunk. See FlowField.h.
+//
+
+#include "FlowField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+
+static const float NearPenalty = 4.0f;      // Extra cost of a cell next to a trunk
+static const float Diagonal = 1.41421356f;
+
+FlowField::FlowField()
+{
+    const int numCells = Columns * Rows;
+    for (Chunk& c : chunks) {
+        c.built = false;
+        c.id = 0;
+        c.seeded = false;
+        c.cost.resize(numCells);
+        c.integration.resize(numCells);
+        c.dirX.resize(numCells);
+        c.dirZ.resize(numCells);
+    }
+    heap.reserve(8 * numCells);
+    nextChunk = 0;
+    numChunksBuilt = 0;
+    buildTime = 0.0;
+}
+
+void FlowField::Setup(const std::vector<std::pair<float, float>>& treeLocs)
+{
+    trees = treeLocs;
+    std::sort(trees.begin(), trees.end(),
+        [](const std::pair<float, float>& a, const std::pair<float, float>& b) { return a.second < b.second; });
+    for (Chunk& c : chunks) {
+        c.built = false;
+    }
+    numChunksBuilt = 0;
+    buildTime = 0.0;
+}
+
+int FlowField::ChunkId(float z)
+{
+    return (int)floorf(z / (float)ChunkDepth);
+}
+
+FlowField::Chunk* FlowField::FindChunk(int id)
+{
+    Chunk& c = chunks[((id % MaxChunks) + MaxChunks) % MaxChunks];
+    return (c.built && c.id == id) ? &c : nullptr;
+}
+
+const FlowField::Chunk* FlowField::FindChunk(int id) const
+{
+    const Chunk& c = chunks[((id % MaxChunks) + MaxChunks) % MaxChunks];
+    return (c.built && c.id == id) ? &c : nullptr;
+}
+
+int FlowField::Update(float topZ, float bottomZ)
+{
+    int top = ChunkId(topZ);
+    int bottom = ChunkId(bottomZ) - 1;          // One chunk of look ahead
+    if (FindChunk(top) == nullptr || nextChunk > top) {
+        nextChunk = top;                        // Starting, or the skiers went back up
+    }
+    int numBuilt = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (nextChunk >= bottom && numBuilt < MaxChunksPerUpdate) {
+        int id = nextChunk--;
+        if (FindChunk(id) != nullptr) {
+            continue;
+        }
+        Chunk& c = chunks[((id % MaxChunks) + MaxChunks) % MaxChunks];
+        c.built = true;
+        c.id = id;
+        BuildCosts(c);
+        Integrate(c, FindChunk(id - 1));
+        Chunk* above = FindChunk(id + 1);
+        if (above != nullptr && !above->seeded) {
+            Integrate(*above, &c);
+        }
+        numBuilt++;
+    }
+    if (numBuilt > 0) {
+        numChunksBuilt += numBuilt;
+        buildTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return numBuilt;
+}
+
+// Each trunk raises the cost of the cells around it, and blocks the nearest.
+void FlowField::BuildCosts(Chunk& c)
+{
+    std::fill(c.cost.begin(), c.cost.end(), 1.0f);
+    float z0 = (float)(c.id * ChunkDepth);
+    float reach = TrunkRadius + NearDistance;
+    std::vector<std::pair<float, float>>::const_iterator it = std::lower_bound(trees.begin(), trees.end(), z0 - reach,
+        [](const std::pair<float, float>& t, float z) { return t.second < z; });
+    for (; it != trees.end() && it->second < z0 + ChunkDepth + reach; ++it) {
+        int col0 = std::max(0, (int)floorf((it->first - reach + HalfWidth) / CellSize));
+        int col1 = std::min(Columns - 1, (int)floorf((it->first + reach + HalfWidth) / CellSize));
+        int row0 = std::max(0, (int)floorf((it->second - reach - z0) / CellSize));
+        int row1 = std::min(Rows - 1, (int)floorf((it->second + reach - z0) / CellSize));
+        for (int row = row0; row <= row1; row++) {
+            for (int col = col0; col <= col1; col++) {
+                float dx = -HalfWidth + (col + 0.5f) * CellSize - it->first;
+                float dz = z0 + (row + 0.5f) * CellSize - it->second;
+                float clearance = sqrtf(dx * dx + dz * dz) - TrunkRadius;
+                float& cost = c.cost[row * Columns + col];
+                if (clearance < SkierRadius) {
+                    cost = FLT_MAX;
+                }
+                else if (clearance < NearDistance && cost != FLT_MAX) {
+                    cost = std::max(cost, 1.0f + NearPenalty * (1.0f - clearance / NearDistance));
+                }
+            }
+        }
+    }
+}
+
+// Dijkstra's algorithm, from the bottom edge of the chunk up. Then the directions.
+void FlowField::Integrate(Chunk& c, const Chunk* below)
+{
+    const int numCells = Columns * Rows;
+    std::fill(c.integration.begin(), c.integration.end(), FLT_MAX);
+    c.seeded = (below != nullptr);
+    const float* seed = below ? &below->integration[(Rows - 1) * Columns] : nullptr;
+
+    // The cells of the bottom row step down onto the seeds.
+    heap.clear();
+    for (int col = 0; col < Columns; col++) {
+        if (c.cost[col] == FLT_MAX) {
+            continue;
+        }
+        float best = FLT_MAX;
+        for (int dc = -1; dc <= 1; dc++) {
+            int j = col + dc;
+            if (j < 0 || j >= Columns || (seed && seed[j] == FLT_MAX)) {
+                continue;
+            }
+            best = std::min(best, (seed ? seed[j] : 0.0f) + (dc != 0 ? Diagonal : 1.0f) * c.cost[col]);
+        }
+        if (best < FLT_MAX) {
+            c.integration[col] = best;
+            heap.push_back(std::make_pair(-best, col));         // Negated: std::push_heap makes a max-heap
+        }
+    }
+    std::make_heap(heap.begin(), heap.end());
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        float d = -heap.back().first;
+        int cell = heap.back().second;
+        heap.pop_back();
+        if (d > c.integration[cell]) {
+            continue;           // Already reached more cheaply
+        }
+        int row = cell / Columns;
+        int col = cell % Columns;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int r = row + dr, k = col + dc;
+                if ((dr == 0 && dc == 0) || r < 0 || r >= Rows || k < 0 || k >= Columns) {
+                    continue;
+                }
+                int from = r * Columns + k;
+                if (c.cost[from] == FLT_MAX) {
+                    continue;
+                }
+                // The step from the neighbor to this cell: uphill if this cell is higher.
+                float step = (dr != 0 && dc != 0 ? Diagonal : 1.0f) * c.cost[from] * (dr < 0 ? UphillPenalty : 1.0f);
+                if (d + step < c.integration[from]) {
+                    c.integration[from] = d + step;
+                    heap.push_back(std::make_pair(-(d + step), from));
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+        }
+    }
+
+    // Each cell steps towards the neighbor where the way down is cheapest.
+    //    Blocked cells step out the cheapest way, so a skier pushed into one gets out.
+    for (int cell = 0; cell < numCells; cell++) {
+        int row = cell / Columns;
+        int col = cell % Columns;
+        float leave = (c.cost[cell] == FLT_MAX) ? 1.0f : c.cost[cell];
+        float best = FLT_MAX;
+        int bestDr = -1, bestDc = 0;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int r = row + dr, k = col + dc;
+                if ((dr == 0 && dc == 0) || r >= Rows || k < 0 || k >= Columns) {
+                    continue;
+                }
+                float value = (r < 0) ? (seed ? seed[k] : 0.0f) : c.integration[r * Columns + k];
+                if (value == FLT_MAX) {
+                    continue;
+                }
+                value += (dr != 0 && dc != 0 ? Diagonal : 1.0f) * leave * (dr > 0 ? UphillPenalty : 1.0f);
+                if (value < best) {
+                    best = value;
+                    bestDr = dr;
+                    bestDc = dc;
+                }
+            }
+        }
+        c.dirX[cell] = (signed char)bestDc;
+        c.dirZ[cell] = (signed char)bestDr;
+    }
+}
+
+void FlowField::GetDirection(float x, float z, float* dirX, float* dirZ) const
+{
+    int id = ChunkId(z);
+    const Chunk* c = FindChunk(id);
+    int col = (int)floorf((x + HalfWidth) / CellSize);
+    if (c == nullptr || col < 0 || col >= Columns) {
+        // Straight down, or back into the field
+        float dx = (col < 0) ? 1.0f : (col >= Columns ? -1.0f : 0.0f);
+        float len = sqrtf(dx * dx + 1.0f);
+        *dirX = dx / len;
+        *dirZ = -1.0f / len;
+        return;
+    }
+    int row = std::min(Rows - 1, std::max(0, (int)floorf((z - (float)(id * ChunkDepth)) / CellSize)));
+    int cell = row * Columns + col;
+    float dx = (float)c->dirX[cell];
+    float dz = (float)c->dirZ[cell];
+    float scale = (dx != 0.0f && dz != 0.0f) ? 1.0f / Diagonal : 1.0f;
+    *dirX = dx * scale;
+    *dirZ = dz * scale;
+}
+
+bool FlowField::IsBlocked(float x, float z) const
+{
+    int id = ChunkId(z);
+    const Chunk* c = FindChunk(id);
+    int col = (int)floorf((x + HalfWidth) / CellSize);
+    if (c == nullptr || col < 0 || col >= Columns) {
+        return false;
+    }
+    int row = std::min(Rows - 1, std::max(0, (int)floorf((z - (float)(id * ChunkDepth)) / CellSize)));
+    return c->cost[row * Columns + col] == FLT_MAX;
+}
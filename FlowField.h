@@ -0,0 +1,96 @@
+//
+// FlowField.h
+//
+// Steering directions down the slope, through the forest, for the AI skiers.
+//
+//   The slope is divided into chunks along z (ChunkDepth deep, as in
+//   TreeGpuCuller), each a grid of CellSize cells across the field. A chunk
+//   is built when the skiers near it: first its cost grid, from the trunks
+//   (cells too near a trunk are blocked, cells close to one cost more), then
+//   its integration field: the cost of the cheapest way from each cell down
+//   to the chunk's bottom edge, found with Dijkstra's algorithm. Going uphill
+//   costs UphillPenalty times more, so the paths go down the slope. Each cell
+//   stores the direction to its cheapest neighbor.
+//
+//   The chunks are built incrementally, from the top down, at most
+//   MaxChunksPerUpdate per Update(). The bottom edge of a new chunk is
+//   free; once the chunk below it is built, the chunk's bottom edge is
+//   seeded with the costs of the top row of the chunk below, and its
+//   integration field is computed again, so paths join across the chunks.
+//   So building a chunk costs about two chunks of Dijkstra's algorithm,
+//   for any number of skiers.
+//
+//   The chunks are kept in a ring of MaxChunks: nothing is allocated after
+//   the constructor. A skier's direction is one lookup in its cell; outside
+//   the built chunks, the direction is straight downhill.
+//
+//   Coordinates are world x and z, with the slope going down towards -z.
+//
+// How to use:
+//    * Setup() with the tree positions.
+//    * Each simulation step, Update() with the range of z where skiers are.
+//    * GetDirection() for each skier.
+//
+
+#pragma once
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <utility>
+#include <vector>
+
+class FlowField {
+public:
+    static const int ChunkDepth = 20;           // Extent of a chunk along z
+    static const int MaxChunks = 16;            // Chunks kept at a time
+    static const int MaxChunksPerUpdate = 1;
+    static constexpr float CellSize = 1.0f;
+    static constexpr float HalfWidth = 24.0f;   // The field spans x from -HalfWidth to HalfWidth
+    static constexpr float TrunkRadius = 0.5f;  // As drawn by renderTrunk()
+    static constexpr float SkierRadius = 0.5f;  // Cells nearer the trunk than this are blocked
+    static constexpr float NearDistance = 2.5f; // Cells nearer the trunk than this cost more
+    static constexpr float UphillPenalty = 4.0f;
+
+    static const int Columns = (int)(2.0f * HalfWidth / CellSize);
+    static const int Rows = (int)(ChunkDepth / CellSize);
+
+    FlowField();
+
+    void Setup(const std::vector<std::pair<float, float>>& trees);
+
+    // Builds the chunks from topZ down to below bottomZ, that are not built yet.
+    //    Returns the number of chunks built.
+    int Update(float topZ, float bottomZ);
+
+    // The direction to steer at (x, z): a unit vector.
+    void GetDirection(float x, float z, float* dirX, float* dirZ) const;
+    bool IsBlocked(float x, float z) const;
+
+    int GetNumChunksBuilt() const { return numChunksBuilt; }
+    double GetBuildTime() const { return buildTime; }      // Milliseconds, for all the chunks built so far
+
+private:
+    struct Chunk {
+        bool built;
+        int id;                             // floor(z / ChunkDepth) of the chunk
+        bool seeded;                        // Whether the bottom edge has the costs of the chunk below
+        std::vector<float> cost;            // Per cell, row by row, from the bottom row up: FLT_MAX if blocked
+        std::vector<float> integration;
+        std::vector<signed char> dirX, dirZ;    // Step to the cheapest neighbor, -1, 0 or 1
+    };
+
+    static int ChunkId(float z);
+    Chunk* FindChunk(int id);
+    const Chunk* FindChunk(int id) const;
+    void BuildCosts(Chunk& c);
+    void Integrate(Chunk& c, const Chunk* below);
+
+    std::vector<std::pair<float, float>> trees;     // Sorted by z
+    Chunk chunks[MaxChunks];
+    int nextChunk;                          // The next chunk to build, going down
+    std::vector<std::pair<float, int>> heap;        // For Dijkstra's algorithm
+    int numChunksBuilt;
+    double buildTime;
+};
+
+#endif  // FLOW_FIELD_H
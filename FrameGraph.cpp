@@ -0,0 +1,453 @@
+//
+// FrameGraph.cpp
+//
+// A small frame graph of render passes. See FrameGraph.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "FrameGraph.h"
+#include "Profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+FrameGraph::FrameGraph()
+{
+    backbufferColor = backbufferDepth = -1;
+    windowWidth = windowHeight = 1;
+    frame = 0;
+    gpuTime = 0.0;
+}
+
+void FrameGraph::Reset(int width, int height)
+{
+    resources.clear();
+    passes.clear();
+    order.clear();
+    windowWidth = width;
+    windowHeight = height;
+    frame++;
+
+    Resource r;
+    r.kind = ImportedTexture;
+    r.desc.width = width;
+    r.desc.height = height;
+    r.desc.samples = 0;
+    r.target = -1;
+    r.firstUse = r.lastUse = -1;
+    r.name = "Window color";
+    r.desc.internalFormat = GL_RGBA8;
+    resources.push_back(r);
+    backbufferColor = 0;
+    r.name = "Window depth";
+    r.desc.internalFormat = GL_DEPTH_COMPONENT24;
+    resources.push_back(r);
+    backbufferDepth = 1;
+}
+
+int FrameGraph::CreateTexture(const char* name, const TextureDesc& desc)
+{
+    Resource r;
+    r.name = name;
+    r.kind = TransientTexture;
+    r.desc = desc;
+    r.firstUse = r.lastUse = -1;
+    r.target = -1;
+    resources.push_back(r);
+    return (int)resources.size() - 1;
+}
+
+int FrameGraph::CreateVirtual(const char* name)
+{
+    Resource r;
+    r.name = name;
+    r.kind = VirtualResource;
+    r.desc.width = r.desc.height = 0;
+    r.desc.internalFormat = 0;
+    r.desc.samples = 0;
+    r.firstUse = r.lastUse = -1;
+    r.target = -1;
+    resources.push_back(r);
+    return (int)resources.size() - 1;
+}
+
+int FrameGraph::AddPass(const char* name, std::function<void()> execute)
+{
+    Pass p;
+    p.name = name;
+    p.execute = execute;
+    p.sideEffect = false;
+    p.live = false;
+    p.timer = -1;
+    passes.push_back(p);
+    return (int)passes.size() - 1;
+}
+
+void FrameGraph::Read(int pass, int resource)
+{
+    passes[pass].reads.push_back(resource);
+}
+
+void FrameGraph::Write(int pass, int resource)
+{
+    passes[pass].writes.push_back(resource);
+}
+
+void FrameGraph::SetSideEffect(int pass)
+{
+    passes[pass].sideEffect = true;
+}
+
+// Dependencies, for passes i < j touching the same resource:
+//    j reads what i writes:   j runs after i, and needs i (a data dependency).
+//    both write it:           j runs after i, and needs i, since j draws over i's results.
+//    i reads what j writes:   j runs after i (j must not overwrite it first).
+//    A pass reading a resource that no earlier pass writes needs its first later writer instead.
+void FrameGraph::Compile()
+{
+    const int n = (int)passes.size();
+    std::vector<std::vector<int>> after(n);         // after[i]: passes that must run after i
+    std::vector<std::vector<int>> needs(n);         // needs[j]: passes whose results j uses
+    std::vector<int> numBefore(n, 0);
+    auto touches = [](const std::vector<int>& list, int r) {
+        for (int x : list) {
+            if (x == r) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (int j = 0; j < n; j++) {
+        for (int r : passes[j].reads) {
+            bool found = false;
+            for (int i = 0; i < j; i++) {
+                if (touches(passes[i].writes, r)) {
+                    after[i].push_back(j);
+                    needs[j].push_back(i);
+                    found = true;
+                }
+            }
+            for (int i = j + 1; i < n && !found; i++) {
+                if (touches(passes[i].writes, r)) {
+                    after[i].push_back(j);
+                    needs[j].push_back(i);
+                    found = true;
+                }
+            }
+        }
+        for (int r : passes[j].writes) {
+            for (int i = 0; i < j; i++) {
+                bool iWrites = touches(passes[i].writes, r);
+                if (iWrites) {
+                    needs[j].push_back(i);
+                }
+                if ((iWrites || touches(passes[i].reads, r)) && !touches(needs[i], j)) {
+                    after[i].push_back(j);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j : after[i]) {
+            numBefore[j]++;
+        }
+    }
+
+    // Culling: mark the passes that are needed, starting from those with visible results.
+    std::vector<int> stack;
+    for (int i = 0; i < n; i++) {
+        Pass& p = passes[i];
+        p.live = p.sideEffect;
+        for (int r : p.writes) {
+            p.live = p.live || resources[r].kind == ImportedTexture;
+        }
+        if (p.live) {
+            stack.push_back(i);
+        }
+    }
+    while (!stack.empty()) {
+        int j = stack.back();
+        stack.pop_back();
+        for (int i : needs[j]) {
+            if (!passes[i].live) {
+                passes[i].live = true;
+                stack.push_back(i);
+            }
+        }
+    }
+
+    // Ordering: repeatedly take the earliest added pass whose predecessors have all run.
+    order.clear();
+    std::vector<bool> done(n, false);
+    for (int k = 0; k < n; k++) {
+        int next = -1;
+        for (int i = 0; i < n && next < 0; i++) {
+            if (!done[i] && numBefore[i] == 0) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            fprintf(stderr, "FrameGraph: the passes have a cycle of dependencies.\n");
+            break;
+        }
+        done[next] = true;
+        for (int j : after[next]) {
+            numBefore[j]--;
+        }
+        if (passes[next].live) {
+            order.push_back(next);
+        }
+    }
+
+    // Lifetimes, then allocation of the transient textures in execution order.
+    for (int k = 0; k < (int)order.size(); k++) {
+        const Pass& p = passes[order[k]];
+        for (int pass = 0; pass < 2; pass++) {
+            for (int r : (pass == 0) ? p.reads : p.writes) {
+                Resource& res = resources[r];
+                res.firstUse = (res.firstUse < 0) ? k : res.firstUse;
+                res.lastUse = k;
+            }
+        }
+    }
+    for (RenderTarget& t : pool) {
+        t.busyUntil = -1;
+    }
+    for (int k = 0; k < (int)order.size(); k++) {
+        for (Resource& res : resources) {
+            if (res.kind == TransientTexture && res.firstUse == k) {
+                res.target = AllocateTarget(res.desc, k);
+                pool[res.target].busyUntil = res.lastUse;
+            }
+        }
+    }
+
+    // Free the pooled textures unused for a while, e.g. after the window was resized.
+    for (int i = (int)pool.size() - 1; i >= 0; i--) {
+        if (frame - pool[i].lastFrameUsed > FramesToKeepUnused) {
+            for (auto it = framebuffers.begin(); it != framebuffers.end(); ) {
+                bool uses = false;
+                for (unsigned int t : it->first) {
+                    uses = uses || t == pool[i].texture;
+                }
+                if (uses) {
+                    glDeleteFramebuffers(1, &it->second);
+                    it = framebuffers.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            glDeleteTextures(1, &pool[i].texture);
+            pool.erase(pool.begin() + i);
+            for (Resource& res : resources) {
+                if (res.target > i) {
+                    res.target--;
+                }
+            }
+        }
+    }
+}
+
+bool FrameGraph::IsDepthFormat(unsigned int internalFormat) const
+{
+    return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24
+        || internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH24_STENCIL8;
+}
+
+// Approximate size of a texel, for the statistics.
+double FrameGraph::TexelBytes(unsigned int internalFormat) const
+{
+    switch (internalFormat) {
+    case GL_RGBA16F:
+        return 8.0;
+    case GL_RGBA32F:
+        return 16.0;
+    case GL_R8:
+        return 1.0;
+    case GL_DEPTH_COMPONENT16:
+        return 2.0;
+    default:
+        return 4.0;
+    }
+}
+
+// Returns the index of a pooled texture that is free from execution position firstUse on.
+int FrameGraph::AllocateTarget(const TextureDesc& desc, int firstUse)
+{
+    for (int i = 0; i < (int)pool.size(); i++) {
+        if (pool[i].desc == desc && pool[i].busyUntil < firstUse) {
+            pool[i].lastFrameUsed = frame;
+            return i;
+        }
+    }
+    RenderTarget t;
+    t.desc = desc;
+    t.lastFrameUsed = frame;
+    t.busyUntil = -1;
+    glGenTextures(1, &t.texture);
+    bool depth = IsDepthFormat(desc.internalFormat);
+    if (desc.samples > 0) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, t.texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width, desc.height, GL_TRUE);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D, t.texture);
+        GLenum format = depth ? GL_DEPTH_COMPONENT : GL_RGBA;
+        GLenum type = depth ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        if (desc.internalFormat == GL_DEPTH24_STENCIL8) {
+            format = GL_DEPTH_STENCIL;
+            type = GL_UNSIGNED_INT_24_8;
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    pool.push_back(t);
+    return (int)pool.size() - 1;
+}
+
+// The framebuffer with the transient textures written by the pass, or 0 for the window's.
+unsigned int FrameGraph::GetFramebuffer(const Pass& pass)
+{
+    std::vector<unsigned int> colors;
+    unsigned int depth = 0;
+    bool window = false;
+    for (int r : pass.writes) {
+        const Resource& res = resources[r];
+        if (res.kind == ImportedTexture) {
+            window = true;
+        }
+        else if (res.kind == TransientTexture) {
+            if (IsDepthFormat(res.desc.internalFormat)) {
+                depth = pool[res.target].texture;
+            }
+            else {
+                colors.push_back(pool[res.target].texture);
+            }
+        }
+    }
+    assert(!window || (colors.empty() && depth == 0));
+    if (window || (colors.empty() && depth == 0)) {
+        return 0;
+    }
+
+    std::vector<unsigned int> key = colors;
+    key.push_back(depth);
+    auto it = framebuffers.find(key);
+    if (it != framebuffers.end()) {
+        return it->second;
+    }
+    unsigned int fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (int i = 0; i < (int)colors.size(); i++) {
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, colors[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    if (depth != 0) {
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0);
+    }
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+    }
+    else {
+        glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "FrameGraph: the framebuffer for pass \"%s\" is incomplete.\n", pass.name.c_str());
+    }
+    framebuffers[key] = fbo;
+    return fbo;
+}
+
+void FrameGraph::Execute()
+{
+    for (int i : order) {
+        Pass& p = passes[i];
+        unsigned int fbo = GetFramebuffer(p);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        int width = windowWidth, height = windowHeight;
+        for (int r : p.writes) {
+            if (resources[r].kind == TransientTexture) {
+                width = resources[r].desc.width;
+                height = resources[r].desc.height;
+            }
+        }
+        glViewport(0, 0, width, height);
+        if (p.timer < 0) {
+            p.timer = PassTimer(p.name.c_str());
+        }
+        Profiler::Begin(p.timer);
+        p.execute();
+        Profiler::End(p.timer);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+
+    gpuTime = 0.0;
+    for (int i : order) {
+        if (Profiler::HasValue(passes[i].timer)) {
+            gpuTime += Profiler::GetValue(passes[i].timer);
+        }
+    }
+}
+
+unsigned int FrameGraph::GetTexture(int resource) const
+{
+    const Resource& res = resources[resource];
+    assert(res.kind == TransientTexture && res.target >= 0);
+    return pool[res.target].texture;
+}
+
+int FrameGraph::PassTimer(const char* passName)
+{
+    return Profiler::Register((std::string(passName) + " (GPU)").c_str(), GL_TIME_ELAPSED);
+}
+
+void FrameGraph::PrintStats() const
+{
+    printf("Frame graph: %d passes, %d culled.\n", (int)order.size(), (int)(passes.size() - order.size()));
+    for (int i : order) {
+        int timer = PassTimer(passes[i].name.c_str());
+        if (Profiler::HasValue(timer)) {
+            printf("  %-28s %10.3f ms\n", passes[i].name.c_str(), Profiler::GetValue(timer));
+        }
+        else {
+            printf("  %-28s  (no data)\n", passes[i].name.c_str());
+        }
+    }
+    for (const Pass& p : passes) {
+        if (!p.live) {
+            printf("  %-28s  (culled)\n", p.name.c_str());
+        }
+    }
+    int numTransient = 0;
+    double bytesDeclared = 0.0, bytesAllocated = 0.0;
+    for (const Resource& res : resources) {
+        if (res.kind == TransientTexture && res.target >= 0) {
+            numTransient++;
+            int samples = res.desc.samples > 0 ? res.desc.samples : 1;
+            bytesDeclared += TexelBytes(res.desc.internalFormat) * res.desc.width * res.desc.height * samples;
+            printf("  %-28s %5dx%-5d texture %d, passes %d to %d\n", res.name.c_str(),
+                res.desc.width, res.desc.height, (int)pool[res.target].texture, res.firstUse, res.lastUse);
+        }
+    }
+    for (const RenderTarget& t : pool) {
+        if (t.lastFrameUsed == frame) {
+            int samples = t.desc.samples > 0 ? t.desc.samples : 1;
+            bytesAllocated += TexelBytes(t.desc.internalFormat) * t.desc.width * t.desc.height * samples;
+        }
+    }
+    printf("  %d transient textures, %.1f MB, in %.1f MB of render targets.\n",
+        numTransient, bytesDeclared / (1 << 20), bytesAllocated / (1 << 20));
+}
@@ -0,0 +1,123 @@
+//
+// FrameGraph.h
+//
+// A small frame graph: the frame is a list of render passes, each declaring
+//    the resources it reads and writes.
+//
+//   The graph is rebuilt every frame. Compile() then
+//     * orders the passes so that each runs after the passes producing what
+//       it reads, keeping the order they were added in where it is free,
+//     * culls the passes whose results are never used: a pass is kept only
+//       if it writes an imported resource (the window's framebuffer), has
+//       side effects, or produces something read by a kept pass,
+//     * allocates the transient render targets. Two transient resources with
+//       the same description whose lifetimes do not overlap share one texture.
+//
+//   Resources are either textures or "virtual" resources with no storage,
+//   such as the draw lists written by a compute shader: they only order passes.
+//   Textures are transient (allocated by the graph from a pool kept from
+//   frame to frame) or imported (the window's color and depth buffers).
+//
+//   Execute() runs the passes, each with its framebuffer bound: the window's,
+//   or one with the transient textures it writes attached. A pass must not
+//   write both. Each pass is timed on the GPU with the Profiler, as "<name> (GPU)".
+//
+// How to use, each frame:
+//    * Reset() with the size of the window.
+//    * AddPass() each pass, then Read() and Write() its resources.
+//    * Compile() and Execute(). During Execute(), a pass can call GetTexture()
+//          for a texture it reads.
+//
+
+#pragma once
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class FrameGraph {
+public:
+    struct TextureDesc {
+        int width, height;
+        unsigned int internalFormat;        // E.g., GL_RGBA8, GL_DEPTH_COMPONENT24
+        int samples;                        // 0 for a texture that is not multisampled
+        bool operator==(const TextureDesc& other) const {
+            return width == other.width && height == other.height
+                && internalFormat == other.internalFormat && samples == other.samples;
+        }
+    };
+
+    static const int FramesToKeepUnused = 60;   // Pooled textures unused this long are deleted
+
+    FrameGraph();
+
+    void Reset(int windowWidth, int windowHeight);
+    int GetBackbufferColor() const { return backbufferColor; }
+    int GetBackbufferDepth() const { return backbufferDepth; }
+
+    int CreateTexture(const char* name, const TextureDesc& desc);
+    int CreateVirtual(const char* name);
+
+    int AddPass(const char* name, std::function<void()> execute);
+    void Read(int pass, int resource);
+    void Write(int pass, int resource);
+    void SetSideEffect(int pass);           // Keep the pass even if nothing reads its results
+
+    void Compile();
+    void Execute();
+
+    unsigned int GetTexture(int resource) const;
+    const TextureDesc& GetDesc(int resource) const { return resources[resource].desc; }
+
+    // The GPU time of all the passes run by the last Execute(), in milliseconds,
+    //    from the Profiler's running averages.
+    double GetGpuTime() const { return gpuTime; }
+
+    static int PassTimer(const char* passName);     // The Profiler counter for a pass
+    void PrintStats() const;
+
+private:
+    enum ResourceKind { TransientTexture, ImportedTexture, VirtualResource };
+    struct Resource {
+        std::string name;
+        ResourceKind kind;
+        TextureDesc desc;
+        int firstUse, lastUse;              // Positions in the execution order
+        int target;                         // Index into the pool, for a transient texture
+    };
+    struct Pass {
+        std::string name;
+        std::function<void()> execute;
+        std::vector<int> reads, writes;
+        bool sideEffect;
+        bool live;
+        int timer;
+    };
+    struct RenderTarget {                   // A pooled texture
+        TextureDesc desc;
+        unsigned int texture;
+        int lastFrameUsed;
+        int busyUntil;                      // Last use this frame, in the execution order
+    };
+
+    bool IsDepthFormat(unsigned int internalFormat) const;
+    double TexelBytes(unsigned int internalFormat) const;
+    int AllocateTarget(const TextureDesc& desc, int firstUse);
+    unsigned int GetFramebuffer(const Pass& pass);
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<int> order;                 // Live passes, in execution order
+    int backbufferColor, backbufferDepth;
+    int windowWidth, windowHeight;
+    int frame;
+    double gpuTime;
+
+    std::vector<RenderTarget> pool;
+    std::map<std::vector<unsigned int>, unsigned int> framebuffers;    // By attached textures
+};
+
+#endif  // FRAME_GRAPH_H
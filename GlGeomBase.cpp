@@ -25,8 +25,11 @@
 
 
 #include "GlGeomBase.h"
+#include "GlGeomMeshCache.h"
 #include "assert.h"
 
+#include <vector>
+
 // Use the static library (so glew32.dll is not needed):
 #define GLEW_STATIC
 #include <GL/glew.h> 
@@ -76,20 +79,49 @@ void GlGeomBase::InitializeAttribLocations(
 }
 
 // Load the data into the VBO and EBO arrays.
-// This invokes the appropriate CalVBOandEBO method
+// This invokes the appropriate CalVBOandEBO method,
+//    unless the mesh is found in the mesh cache.
 void GlGeomBase::CalcVBOandEBO_Base() {
 
-	// Calculate the buffer data - map and the unmap the two buffers.
     glBindVertexArray(theVAO);
     glBindBuffer(GL_ARRAY_BUFFER, theVBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theEBO);
-    float* VBOdata = (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    unsigned int* EBOdata = (unsigned int*)glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
     int normalOffset = UseNormals() ? NormalOffset() : -1;
     int tcOffset = UseTexCoords() ? TexOffset() : -1;
-    CalcVboAndEbo(VBOdata, EBOdata, 0, normalOffset, tcOffset, StrideVal());
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+
+    GlGeomMeshKey key;
+    if (GlGeomMeshCache::IsOpen() && GetMeshCacheKey(&key)) {
+        // Upload directly from the (memory mapped) cache, generating and storing the mesh first if needed.
+        key.layout[0] = 0;
+        key.layout[1] = normalOffset;
+        key.layout[2] = tcOffset;
+        key.layout[3] = StrideVal();
+        int numVertices = UseTexCoords() ? GetNumVerticesTexCoords() : GetNumVerticesNoTexCoords();
+        uint32_t numVboFloats = StrideVal() * numVertices;
+        uint32_t numElements = GetNumElementsMax();
+        const float* VBOdata;
+        const unsigned int* EBOdata;
+        std::vector<float> VBOgenerated;
+        std::vector<unsigned int> EBOgenerated;
+        if (!GlGeomMeshCache::Find(key, numVboFloats, numElements, &VBOdata, &EBOdata)) {
+            VBOgenerated.resize(numVboFloats);
+            EBOgenerated.resize(numElements);
+            CalcVboAndEbo(VBOgenerated.data(), EBOgenerated.data(), 0, normalOffset, tcOffset, StrideVal());
+            GlGeomMeshCache::Store(key, VBOgenerated.data(), numVboFloats, EBOgenerated.data(), numElements);
+            VBOdata = VBOgenerated.data();
+            EBOdata = EBOgenerated.data();
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numVboFloats * sizeof(float), VBOdata);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, numElements * sizeof(unsigned int), EBOdata);
+    }
+    else {
+        // Calculate the buffer data - map and the unmap the two buffers.
+        float* VBOdata = (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+        unsigned int* EBOdata = (unsigned int*)glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
+        CalcVboAndEbo(VBOdata, EBOdata, 0, normalOffset, tcOffset, StrideVal());
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
  
     // Good practice to unbind things: helps with debugging if nothing else
     glBindVertexArray(0); 
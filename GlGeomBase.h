@@ -30,6 +30,8 @@
 #include <limits.h>
 #include <assert.h>
 
+struct GlGeomMeshKey;   // Declared in GlGeomMeshCache.h
+
 // GlGeomBase
 //     Handles all the OpenGL rendering for the GlGeomShape classes.
 // Supports the following:
@@ -92,10 +94,18 @@ public:
     //   CalcVboAndEbo( vboPtr, eboPtr, 0, -1, -1, 3); // positions only, tightly packed
     //   CalcVboAndEbo( vboPtr, eboPtr, 0, -1, 3, 5); // positions, then (s,t) texture coords, tightly packed
     //   CalcVboAndEbo( vboPtr, eboPtr, 0, 3, 6, 8); // positions, normals, then (s,t) texture coords, tightly packed
+    // The tightly packed layouts are generated by code specialized at compile time
+    //    for that layout (see GlGeomLayout.h). Any other offsets and stride use the general code.
     virtual void CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
             int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset,
             unsigned int stride) = 0;
 
+    // GetMeshCacheKey identifies the mesh for the on-disk mesh cache (see GlGeomMeshCache.h).
+    //    It sets the shape, generator version and mesh parameters, and returns true.
+    //    The layout part of the key is filled in by GlGeomBase.
+    //    Shapes which do not override it are never cached.
+    virtual bool GetMeshCacheKey(GlGeomMeshKey* /*key*/) const { return false; }
+
 protected:
     // Allocate the VAO, VBO, and EBO.
     // Set up info about the Vertex Attribute Locations
@@ -25,6 +25,8 @@
 #include <GLFW/glfw3.h>
 
 #include "GlGeomCone.h"
+#include "GlGeomLayout.h"
+#include "GlGeomMeshCache.h"
 #include "MathMisc.h"
 #include "assert.h"
 
@@ -43,14 +45,23 @@ void GlGeomCone::Remesh(int slices, int stacks, int rings)
 void GlGeomCone::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
     int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, unsigned int stride)
 {
-    assert(vertPosOffset >= 0 && stride > 0);
-    bool calcNormals = (vertNormalOffset >= 0);       // Should normals be calculated?
-    bool calcTexCoords = (vertTexCoordsOffset >= 0);  // Should texture coordinates be calculated?
+    GlGeomDispatchLayout(*this, VBOdataBuffer, EBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+}
+
+template<class VertLayout>
+void GlGeomCone::CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout)
+{
+    const int stride = layout.Stride();
+    const int vertPosOffset = layout.PosOffset();
+    const int vertNormalOffset = layout.NormalOffset();
+    const int vertTexCoordsOffset = layout.TexOffset();
+    const bool calcNormals = layout.HasNormals();       // Should normals be calculated?
+    const bool calcTexCoords = layout.HasTexCoords();   // Should texture coordinates be calculated?
 
     // VBO Data is laid out: base vertices, then side vertices including apex vertices
 
     // Set base center vertices
-    SetBaseVert(0.0, 0.0, 0, 0, VBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+    SetBaseVert(0.0, 0.0, 0, 0, VBOdataBuffer, layout);
     int stopSlices = calcTexCoords ? numSlices : numSlices - 1;
     for (int i = 0; i <= stopSlices; i++) {
         // Handle a slice of vertices.
@@ -62,7 +73,7 @@ void GlGeomCone::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer
             // Base vertex position and normal and texture coordinates
             for (int j = 1; j <= numRings; j++) {
                 float radius = (float)j / (float)numRings;
-                SetBaseVert(s * radius, c * radius, i, j, VBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+                SetBaseVert(s * radius, c * radius, i, j, VBOdataBuffer, layout);
             }
         }
         // sidePtr points to vertex data entries
@@ -154,31 +165,42 @@ void GlGeomCone::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer
 }
 
 // Set a vertex in the base.
-void GlGeomCone::SetBaseVert(float x, float z, int i, int j, float* VBOdataBuffer,
-    int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, int stride)
+template<class VertLayout>
+void GlGeomCone::SetBaseVert(float x, float z, int i, int j, float* VBOdataBuffer, const VertLayout& layout)
 {
     // i is the slice number, j is the ring number.
     // j==0 means the center point.  In this case, i must equal 0. (Not checked)
-    float* basePtrBottom = VBOdataBuffer + stride * (i * numRings + j);
-    float* vPtrBottom = basePtrBottom + vertPosOffset;
+    float* basePtrBottom = VBOdataBuffer + layout.Stride() * (i * numRings + j);
+    float* vPtrBottom = basePtrBottom + layout.PosOffset();
     *(vPtrBottom++) = x;
     *(vPtrBottom++) = 0.0;
     *vPtrBottom = z;
-    if (vertNormalOffset >= 0) {
-        float* nPtrBottom = basePtrBottom + vertNormalOffset;
+    if (layout.HasNormals()) {
+        float* nPtrBottom = basePtrBottom + layout.NormalOffset();
         *(nPtrBottom++) = 0.0;
         *(nPtrBottom++) = -1.0;
         *nPtrBottom = 0.0;
     }
-    if (vertTexCoordsOffset >= 0) {
+    if (layout.HasTexCoords()) {
         float sCoord = 0.5f * (1.0f - x);
         float tCoord = 0.5f * (1.0f - z);
-        float* tcPtrBottom = basePtrBottom + vertTexCoordsOffset;
-        *(tcPtrBottom++) = 0.5f * (1.0f - x);      // s - Coordinate
-            * tcPtrBottom = 0.5f * (1.0f - z);     // t-Coordinate
+        float* tcPtrBottom = basePtrBottom + layout.TexOffset();
+        *(tcPtrBottom++) = sCoord;
+        *tcPtrBottom = tCoord;
     }
 }
 
+bool GlGeomCone::GetMeshCacheKey(GlGeomMeshKey* key) const
+{
+    key->shapeId = GlGeomMeshShape_Cone;
+    key->generatorVersion = MeshGeneratorVersion;
+    key->params[0] = numSlices;
+    key->params[1] = numStacks;
+    key->params[2] = numRings;
+    key->params[3] = 0;
+    return true;
+}
+
 void GlGeomCone::InitializeAttribLocations(
     unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc)
 {
@@ -224,6 +246,4 @@ void GlGeomCone::RenderSide()
     GlGeomBase::RenderEBO(GL_TRIANGLES, GetNumElementsSide(), GetNumElementsDisk());
 }
 
-
-
-
+GLGEOM_INSTANTIATE_LAYOUTS(GlGeomCone)
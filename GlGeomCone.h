@@ -95,6 +95,15 @@ public:
         int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset,
         unsigned int stride);
 
+    // CalcVboAndEboLayout - the generator behind CalcVboAndEbo, for one vertex layout.
+    //    VertLayout is one of the GlGeomLayout<> types, or GlGeomRuntimeLayout. See GlGeomLayout.h.
+    template<class VertLayout>
+    void CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout);
+
+    // Mesh cache support. Increment MeshGeneratorVersion whenever the generated data changes.
+    static const unsigned int MeshGeneratorVersion = 1;
+    bool GetMeshCacheKey(GlGeomMeshKey* key) const;
+
 private: 
 
     // Disable all copy and assignment operators.
@@ -118,8 +127,8 @@ private:
 
     void PreRender();
 
-    void SetBaseVert(float x, float z, int i, int j, float* VBOdataBuffer,
-        int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, int stride);
+    template<class VertLayout>
+    void SetBaseVert(float x, float z, int i, int j, float* VBOdataBuffer, const VertLayout& layout);
  };
 
 // Constructor
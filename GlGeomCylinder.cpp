@@ -25,6 +25,8 @@
 #include <GLFW/glfw3.h>
 
 #include "GlGeomCylinder.h"
+#include "GlGeomLayout.h"
+#include "GlGeomMeshCache.h"
 #include "MathMisc.h"
 #include "assert.h"
 
@@ -45,14 +47,23 @@ void GlGeomCylinder::Remesh(int slices, int stacks, int rings)
 void GlGeomCylinder::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
     int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, unsigned int stride)
 {
-    assert(vertPosOffset >= 0 && stride > 0);
-    bool calcNormals = (vertNormalOffset >= 0);       // Should normals be calculated?
-    bool calcTexCoords = (vertTexCoordsOffset >= 0);  // Should texture coordinates be calculated?
+    GlGeomDispatchLayout(*this, VBOdataBuffer, EBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+}
+
+template<class VertLayout>
+void GlGeomCylinder::CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout)
+{
+    const int stride = layout.Stride();
+    const int vertPosOffset = layout.PosOffset();
+    const int vertNormalOffset = layout.NormalOffset();
+    const int vertTexCoordsOffset = layout.TexOffset();
+    const bool calcNormals = layout.HasNormals();       // Should normals be calculated?
+    const bool calcTexCoords = layout.HasTexCoords();   // Should texture coordinates be calculated?
 
     // VBO Data is laid out: top face vertices, then bottom face vertices, then side vertices
 
     // Set top and bottom center vertices
-    SetDiscVerts(0.0, 0.0, 0, 0, VBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+    SetDiscVerts(0.0, 0.0, 0, 0, VBOdataBuffer, layout);
     int stopSlices = calcTexCoords ? numSlices : numSlices - 1;
     for (int i = 0; i <= stopSlices; i++) {
         // Handle a slice of vertices.
@@ -64,7 +75,7 @@ void GlGeomCylinder::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBu
             // Top & bottom face vertices, positions and normals and texture coordinates
             for (int j = 1; j <= numRings; j++) {
                 float radius = (float)j / (float)numRings;
-                SetDiscVerts(s * radius, c * radius, i, j, VBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+                SetDiscVerts(s * radius, c * radius, i, j, VBOdataBuffer, layout);
             }
         }
         float* basePtr = VBOdataBuffer + (2*GetNumVerticesDisk()+ i*(numStacks + 1))*stride;
@@ -144,14 +155,15 @@ void GlGeomCylinder::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBu
     }
 }
 
-void GlGeomCylinder::SetDiscVerts(float x, float z, int i, int j, float* VBOdataBuffer,
-    int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, int stride)
+template<class VertLayout>
+void GlGeomCylinder::SetDiscVerts(float x, float z, int i, int j, float* VBOdataBuffer, const VertLayout& layout)
 {
+    const int stride = layout.Stride();
     // i is the slice number, j is the ring number.
     // j==0 means the center point.  In this case, i must equal 0. (Not checked)
     float* basePtrBottom = VBOdataBuffer + stride*(i*numRings + j);
     int delta = GetNumVerticesDisk()*stride;
-    float* vPtrBottom = basePtrBottom + vertPosOffset;
+    float* vPtrBottom = basePtrBottom + layout.PosOffset();
     float* vPtrTop = vPtrBottom + delta;
     *(vPtrBottom++) = x;
     *(vPtrBottom++) = -1.0;
@@ -159,8 +171,8 @@ void GlGeomCylinder::SetDiscVerts(float x, float z, int i, int j, float* VBOdata
     *(vPtrTop++) = x;
     *(vPtrTop++) = 1.0;
     *vPtrTop = z;
-    if (vertNormalOffset>=0) {
-        float* nPtrBottom = basePtrBottom + vertNormalOffset;
+    if (layout.HasNormals()) {
+        float* nPtrBottom = basePtrBottom + layout.NormalOffset();
         float* nPtrTop = nPtrBottom + delta;
         *(nPtrBottom++) = 0.0;
         *(nPtrBottom++) = -1.0;
@@ -169,10 +181,10 @@ void GlGeomCylinder::SetDiscVerts(float x, float z, int i, int j, float* VBOdata
         *(nPtrTop++) = 1.0;
         *nPtrTop = 0.0;
     }
-    if (vertTexCoordsOffset>=0) {
+    if (layout.HasTexCoords()) {
         float sCoord = 0.5f*(x + 1.0f);
         float tCoord = 0.5f*(-z + 1.0f);
-        float* tcPtrBottom = basePtrBottom + vertTexCoordsOffset;
+        float* tcPtrBottom = basePtrBottom + layout.TexOffset();
         float* tcPtrTop = tcPtrBottom + delta;
         *(tcPtrBottom++) = 1.0f - sCoord;
         *tcPtrBottom = tCoord;
@@ -182,6 +194,17 @@ void GlGeomCylinder::SetDiscVerts(float x, float z, int i, int j, float* VBOdata
 }
 
 
+bool GlGeomCylinder::GetMeshCacheKey(GlGeomMeshKey* key) const
+{
+    key->shapeId = GlGeomMeshShape_Cylinder;
+    key->generatorVersion = MeshGeneratorVersion;
+    key->params[0] = numSlices;
+    key->params[1] = numStacks;
+    key->params[2] = numRings;
+    key->params[3] = 0;
+    return true;
+}
+
 void GlGeomCylinder::InitializeAttribLocations(
     unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc)
 {
@@ -235,5 +258,4 @@ void GlGeomCylinder::RenderSide()
     GlGeomBase::RenderEBO(GL_TRIANGLES, GetNumElementsSide(), 2 * GetNumElementsDisk());
 }
 
-
-
+GLGEOM_INSTANTIATE_LAYOUTS(GlGeomCylinder)
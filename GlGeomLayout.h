@@ -0,0 +1,132 @@
+/*
+* GlGeomLayout.h
+*
+* Vertex layouts for the CalcVboAndEbo generators of the GlGeomShape classes.
+*
+*   GlGeomLayout<Normals,TexCoords> is a compile-time layout: positions,
+*      then (optionally) normals, then (optionally) texture coordinates,
+*      tightly packed. All of its offsets and flags are constants, so
+*      a generator instantiated with it has no layout tests left in its loops.
+*   GlGeomRuntimeLayout holds arbitrary offsets and a stride, exactly as
+*      passed to CalcVboAndEbo(). It is the fallback for any other layout.
+*
+*   Both classes have the same interface, so a generator written as
+*      template<class VertLayout> CalcVboAndEboLayout(..., const VertLayout& layout)
+*   works for either one.
+*/
+
+#pragma once
+#ifndef GLGEOM_LAYOUT_H
+#define GLGEOM_LAYOUT_H
+
+#include <assert.h>
+
+template<bool Normals, bool TexCoords>
+class GlGeomLayout
+{
+public:
+    static constexpr bool HasNormals() { return Normals; }
+    static constexpr bool HasTexCoords() { return TexCoords; }
+    static constexpr int PosOffset() { return 0; }
+    static constexpr int NormalOffset() { return Normals ? 3 : -1; }
+    static constexpr int TexOffset() { return TexCoords ? (Normals ? 6 : 3) : -1; }
+    static constexpr int Stride() { return 3 + (Normals ? 3 : 0) + (TexCoords ? 2 : 0); }
+};
+
+typedef GlGeomLayout<false, false> GlGeomLayoutPos;          // x,y,z
+typedef GlGeomLayout<true, false>  GlGeomLayoutPosNormal;    // x,y,z, nx,ny,nz
+typedef GlGeomLayout<false, true>  GlGeomLayoutPosUV;        // x,y,z, s,t
+typedef GlGeomLayout<true, true>   GlGeomLayoutPosNormalUV;  // x,y,z, nx,ny,nz, s,t
+
+class GlGeomRuntimeLayout
+{
+public:
+    GlGeomRuntimeLayout(int posOffset, int normalOffset, int texOffset, int stride)
+        : posOff(posOffset), normalOff(normalOffset), texOff(texOffset), strideVal(stride) {}
+
+    bool HasNormals() const { return normalOff >= 0; }
+    bool HasTexCoords() const { return texOff >= 0; }
+    int PosOffset() const { return posOff; }
+    int NormalOffset() const { return normalOff; }
+    int TexOffset() const { return texOff; }
+    int Stride() const { return strideVal; }
+
+private:
+    int posOff;
+    int normalOff;
+    int texOff;
+    int strideVal;
+};
+
+// Identifies the layouts that have a compile-time specialization.
+enum GlGeomLayoutId {
+    GlGeomLayoutId_Runtime = 0,
+    GlGeomLayoutId_Pos,
+    GlGeomLayoutId_PosNormal,
+    GlGeomLayoutId_PosUV,
+    GlGeomLayoutId_PosNormalUV
+};
+
+template<class VertLayout>
+inline bool GlGeomLayoutMatches(int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, int stride)
+{
+    return vertPosOffset == VertLayout::PosOffset() && vertNormalOffset == VertLayout::NormalOffset()
+        && vertTexCoordsOffset == VertLayout::TexOffset() && stride == VertLayout::Stride();
+}
+
+// Returns which (if any) tightly packed layout the offsets and stride describe.
+inline GlGeomLayoutId GlGeomSelectLayout(int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, int stride)
+{
+    if (GlGeomLayoutMatches<GlGeomLayoutPosNormalUV>(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride)) {
+        return GlGeomLayoutId_PosNormalUV;
+    }
+    if (GlGeomLayoutMatches<GlGeomLayoutPosNormal>(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride)) {
+        return GlGeomLayoutId_PosNormal;
+    }
+    if (GlGeomLayoutMatches<GlGeomLayoutPosUV>(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride)) {
+        return GlGeomLayoutId_PosUV;
+    }
+    if (GlGeomLayoutMatches<GlGeomLayoutPos>(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride)) {
+        return GlGeomLayoutId_Pos;
+    }
+    return GlGeomLayoutId_Runtime;
+}
+
+// Calls shape.CalcVboAndEboLayout() with the compile-time layout matching the
+//    offsets and stride, or with a GlGeomRuntimeLayout if none matches.
+// This is how the CalcVboAndEbo() methods of the GlGeomShape classes are implemented.
+template<class GlGeomShape>
+void GlGeomDispatchLayout(GlGeomShape& shape, float* VBOdataBuffer, unsigned int* EBOdataBuffer,
+    int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, unsigned int stride)
+{
+    assert(vertPosOffset >= 0 && stride > 0);
+    switch (GlGeomSelectLayout(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, (int)stride)) {
+    case GlGeomLayoutId_PosNormalUV:
+        shape.CalcVboAndEboLayout(VBOdataBuffer, EBOdataBuffer, GlGeomLayoutPosNormalUV());
+        break;
+    case GlGeomLayoutId_PosNormal:
+        shape.CalcVboAndEboLayout(VBOdataBuffer, EBOdataBuffer, GlGeomLayoutPosNormal());
+        break;
+    case GlGeomLayoutId_PosUV:
+        shape.CalcVboAndEboLayout(VBOdataBuffer, EBOdataBuffer, GlGeomLayoutPosUV());
+        break;
+    case GlGeomLayoutId_Pos:
+        shape.CalcVboAndEboLayout(VBOdataBuffer, EBOdataBuffer, GlGeomLayoutPos());
+        break;
+    default:
+        shape.CalcVboAndEboLayout(VBOdataBuffer, EBOdataBuffer,
+            GlGeomRuntimeLayout(vertPosOffset, vertNormalOffset, vertTexCoordsOffset, (int)stride));
+        break;
+    }
+}
+
+// Explicitly instantiates a shape's CalcVboAndEboLayout() for every layout,
+//    so it can also be called directly from other source files.
+#define GLGEOM_INSTANTIATE_LAYOUTS(GlGeomShape) \
+    template void GlGeomShape::CalcVboAndEboLayout(float*, unsigned int*, const GlGeomLayoutPos&); \
+    template void GlGeomShape::CalcVboAndEboLayout(float*, unsigned int*, const GlGeomLayoutPosNormal&); \
+    template void GlGeomShape::CalcVboAndEboLayout(float*, unsigned int*, const GlGeomLayoutPosUV&); \
+    template void GlGeomShape::CalcVboAndEboLayout(float*, unsigned int*, const GlGeomLayoutPosNormalUV&); \
+    template void GlGeomShape::CalcVboAndEboLayout(float*, unsigned int*, const GlGeomRuntimeLayout&);
+
+#endif  // GLGEOM_LAYOUT_H
@@ -0,0 +1,219 @@
+//
+// GlGeomMeshCache.cpp
+//
+// On-disk cache of the VBO and EBO data generated by the GlGeomShape classes.
+// See GlGeomMeshCache.h for how it is used.
+//
+
+#define _CRT_SECURE_NO_DEPRECATE 1
+
+#include "GlGeomMeshCache.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char cacheMagic[8] = "GLGMESH";
+static MappedFile cacheFile;            // The mapped cache file, if any
+
+bool GlGeomMeshCache::isOpen = false;
+std::string GlGeomMeshCache::cacheFilename;
+std::vector<GlGeomMeshCache::UsedEntry*> GlGeomMeshCache::usedEntries;
+int GlGeomMeshCache::numHits = 0;
+int GlGeomMeshCache::numMisses = 0;
+
+bool GlGeomMeshCache::Open(const char* filename)
+{
+    Close();
+    isOpen = true;
+    cacheFilename = filename;
+    if (!cacheFile.Open(filename)) {
+        return true;            // No cache file yet: start with an empty cache
+    }
+    const GlGeomMeshCacheHeader* header =
+        (const GlGeomMeshCacheHeader*)cacheFile.DataAt(0, sizeof(GlGeomMeshCacheHeader));
+    bool ok = (header != 0 && memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && header->formatVersion == FormatVersion
+        && cacheFile.DataAt(sizeof(GlGeomMeshCacheHeader),
+            (size_t)header->numEntries * sizeof(GlGeomMeshCacheEntry)) != 0);
+    if (!ok) {
+        fprintf(stderr, "GlGeomMeshCache: Ignoring out of date or invalid cache file %s.\n", filename);
+        cacheFile.Close();
+    }
+    return true;
+}
+
+void GlGeomMeshCache::Close()
+{
+    for (UsedEntry* e : usedEntries) {
+        delete e;
+    }
+    usedEntries.clear();
+    cacheFile.Close();
+    isOpen = false;
+}
+
+const GlGeomMeshCacheEntry* GlGeomMeshCache::FindInFile(const GlGeomMeshKey& key)
+{
+    if (!cacheFile.IsOpen()) {
+        return 0;
+    }
+    const GlGeomMeshCacheHeader* header = (const GlGeomMeshCacheHeader*)cacheFile.Data();
+    const GlGeomMeshCacheEntry* entries = (const GlGeomMeshCacheEntry*)(header + 1);
+    for (uint32_t i = 0; i < header->numEntries; i++) {
+        if (entries[i].key == key) {
+            return entries + i;
+        }
+    }
+    return 0;
+}
+
+GlGeomMeshCache::UsedEntry* GlGeomMeshCache::FindUsed(const GlGeomMeshKey& key)
+{
+    for (UsedEntry* e : usedEntries) {
+        if (e->key == key) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+GlGeomMeshCache::UsedEntry* GlGeomMeshCache::LookUp(const GlGeomMeshKey& key)
+{
+    UsedEntry* used = FindUsed(key);
+    if (used == 0) {
+        const GlGeomMeshCacheEntry* entry = FindInFile(key);
+        if (entry == 0) {
+            return 0;
+        }
+        const float* vbo = (const float*)cacheFile.DataAt(entry->vboOffset, entry->numVboFloats * sizeof(float));
+        const unsigned int* ebo = (const unsigned int*)cacheFile.DataAt(entry->eboOffset, entry->numElements * sizeof(unsigned int));
+        if (vbo == 0 || ebo == 0) {
+            return 0;
+        }
+        used = new UsedEntry;
+        used->key = key;
+        used->vboData = vbo;
+        used->eboData = ebo;
+        used->numVboFloats = entry->numVboFloats;
+        used->numElements = entry->numElements;
+        usedEntries.push_back(used);
+    }
+    return used;
+}
+
+bool GlGeomMeshCache::Find(const GlGeomMeshKey& key, uint32_t numVboFloats, uint32_t numElements,
+    const float** vboData, const unsigned int** eboData)
+{
+    if (!isOpen) {
+        return false;
+    }
+    UsedEntry* used = LookUp(key);
+    if (used == 0 || used->numVboFloats != numVboFloats || used->numElements != numElements) {
+        numMisses++;
+        return false;
+    }
+    numHits++;
+    *vboData = used->vboData;
+    *eboData = used->eboData;
+    return true;
+}
+
+bool GlGeomMeshCache::FindAnySize(const GlGeomMeshKey& key, const float** vboData, uint32_t* numVboFloats,
+    const unsigned int** eboData, uint32_t* numElements)
+{
+    if (!isOpen) {
+        return false;
+    }
+    UsedEntry* used = LookUp(key);
+    if (used == 0) {
+        numMisses++;
+        return false;
+    }
+    numHits++;
+    *vboData = used->vboData;
+    *numVboFloats = used->numVboFloats;
+    *eboData = used->eboData;
+    *numElements = used->numElements;
+    return true;
+}
+
+void GlGeomMeshCache::Store(const GlGeomMeshKey& key, const float* vboData, uint32_t numVboFloats,
+    const unsigned int* eboData, uint32_t numElements)
+{
+    if (!isOpen) {
+        return;
+    }
+    UsedEntry* used = FindUsed(key);
+    if (used == 0) {
+        used = new UsedEntry;
+        used->key = key;
+        usedEntries.push_back(used);
+    }
+    used->vboStore.assign(vboData, vboData + numVboFloats);
+    used->eboStore.assign(eboData, eboData + numElements);
+    used->vboData = used->vboStore.data();
+    used->eboData = used->eboStore.data();
+    used->numVboFloats = numVboFloats;
+    used->numElements = numElements;
+}
+
+bool GlGeomMeshCache::Save()
+{
+    if (!isOpen) {
+        return false;
+    }
+    std::string tempFilename = cacheFilename + ".tmp";
+    FILE* outfile = fopen(tempFilename.c_str(), "wb");
+    if (!outfile) {
+        fprintf(stderr, "GlGeomMeshCache: Unable to write %s.\n", tempFilename.c_str());
+        return false;
+    }
+
+    GlGeomMeshCacheHeader header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.formatVersion = FormatVersion;
+    header.numEntries = (uint32_t)usedEntries.size();
+    bool ok = (fwrite(&header, sizeof(header), 1, outfile) == 1);
+
+    // The table of entries, then the data in the same order.
+    uint32_t dataOffset = (uint32_t)(sizeof(header) + usedEntries.size() * sizeof(GlGeomMeshCacheEntry));
+    for (const UsedEntry* e : usedEntries) {
+        GlGeomMeshCacheEntry entry;
+        entry.key = e->key;
+        entry.numVboFloats = e->numVboFloats;
+        entry.numElements = e->numElements;
+        entry.vboOffset = dataOffset;
+        dataOffset += e->numVboFloats * sizeof(float);
+        entry.eboOffset = dataOffset;
+        dataOffset += e->numElements * sizeof(unsigned int);
+        ok = ok && (fwrite(&entry, sizeof(entry), 1, outfile) == 1);
+    }
+    for (const UsedEntry* e : usedEntries) {
+        ok = ok && (fwrite(e->vboData, sizeof(float), e->numVboFloats, outfile) == e->numVboFloats);
+        ok = ok && (fwrite(e->eboData, sizeof(unsigned int), e->numElements, outfile) == e->numElements);
+    }
+    ok = (fclose(outfile) == 0) && ok;
+
+    // The entries may point into the old mapping, so it is only released now.
+    std::string filename = cacheFilename;
+    std::vector<GlGeomMeshKey> keys;
+    for (const UsedEntry* e : usedEntries) {
+        keys.push_back(e->key);
+    }
+    Close();
+    if (ok) {
+        remove(filename.c_str());
+        ok = (rename(tempFilename.c_str(), filename.c_str()) == 0);
+    }
+    if (!ok) {
+        fprintf(stderr, "GlGeomMeshCache: Error writing %s.\n", filename.c_str());
+        remove(tempFilename.c_str());
+    }
+    Open(filename.c_str());
+    // Everything saved stays in use, so a later Save() (for meshes built later) keeps it.
+    for (const GlGeomMeshKey& key : keys) {
+        LookUp(key);
+    }
+    return ok;
+}
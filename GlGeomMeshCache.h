@@ -0,0 +1,134 @@
+//
+// GlGeomMeshCache.h
+//
+// On-disk cache of the VBO and EBO data generated by the GlGeomShape classes.
+//
+//   Entries are keyed by the shape, its mesh parameters, its generator version,
+//   and the vertex layout in the VBO. The cache file is memory mapped by Open(),
+//   and cached data is uploaded straight from the mapping into the VBO and EBO.
+//   Meshes not found in the cache are generated as usual and added with Store().
+//   Save() rewrites the file with every entry used since Open(), so entries from
+//   an older generator version (or no longer used) are dropped. Save() may be
+//   called again later, for meshes generated after the first Save().
+//   The cache is not thread safe: only call it from the main thread.
+//
+// How to use:
+//    * Call Open() before the first InitializeAttribLocations() call.
+//    * Call Save() once all geometry has been set up.
+//   GlGeomBase does the lookups and stores. Nothing is cached if Open() was not called.
+//
+// File layout (all little endian, as written by this machine):
+//    GlGeomMeshCacheHeader, then numEntries GlGeomMeshCacheEntry's, then the
+//    float and index data the entries point to. All data is 4-byte aligned.
+//
+
+#pragma once
+#ifndef GLGEOM_MESH_CACHE_H
+#define GLGEOM_MESH_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Shape identifiers for GlGeomMeshKey::shapeId
+enum GlGeomMeshShape {
+    GlGeomMeshShape_Cylinder = 1,
+    GlGeomMeshShape_Cone = 2,
+    GlGeomMeshShape_Sphere = 3,
+    GlGeomMeshShape_Torus = 4,
+    GlGeomMeshShape_TreeBark = 5,       // Procedural tree variants (see TreeGenerator.h)
+    GlGeomMeshShape_TreeLeaves = 6,
+};
+
+struct GlGeomMeshKey {
+    uint32_t shapeId;           // A GlGeomMeshShape value
+    uint32_t generatorVersion;  // Bump in a shape class whenever its CalcVboAndEbo output changes
+    int32_t params[4];          // Mesh parameters (slices, stacks, ...); unused entries are zero
+    int32_t layout[4];          // posOffset, normalOffset, texCoordsOffset, stride
+
+    bool operator==(const GlGeomMeshKey& other) const;
+};
+
+struct GlGeomMeshCacheHeader {
+    char magic[8];              // "GLGMESH"
+    uint32_t formatVersion;
+    uint32_t numEntries;
+};
+
+struct GlGeomMeshCacheEntry {
+    GlGeomMeshKey key;
+    uint32_t vboOffset;         // Byte offset of the VBO floats in the file
+    uint32_t numVboFloats;
+    uint32_t eboOffset;         // Byte offset of the EBO elements in the file
+    uint32_t numElements;
+};
+
+class GlGeomMeshCache {
+public:
+    static const uint32_t FormatVersion = 1;
+
+    // Map the cache file. A missing or invalid file just gives an empty cache.
+    static bool Open(const char* filename);
+
+    // Write out every entry used since Open() (or saved before). Returns false on a write error.
+    static bool Save();
+
+    // Unmap the file and discard all entries.
+    static void Close();
+
+    static bool IsOpen() { return isOpen; }
+
+    // Look up a mesh. Returns true if found with exactly the expected sizes,
+    //   setting *vboData and *eboData to point to the cached data.
+    //   The pointers remain valid until the next Save() or Close().
+    static bool Find(const GlGeomMeshKey& key, uint32_t numVboFloats, uint32_t numElements,
+        const float** vboData, const unsigned int** eboData);
+
+    // Look up a mesh whose sizes are not known in advance, such as a procedural tree.
+    //   Returns true if found, setting the data pointers (valid as for Find) and the sizes.
+    static bool FindAnySize(const GlGeomMeshKey& key, const float** vboData, uint32_t* numVboFloats,
+        const unsigned int** eboData, uint32_t* numElements);
+
+    // Add a newly generated mesh. The data is copied.
+    static void Store(const GlGeomMeshKey& key, const float* vboData, uint32_t numVboFloats,
+        const unsigned int* eboData, uint32_t numElements);
+
+    static int GetNumHits() { return numHits; }
+    static int GetNumMisses() { return numMisses; }
+
+private:
+    struct UsedEntry {
+        GlGeomMeshKey key;
+        const float* vboData;           // Points into the mapped file, or into the vectors below
+        const unsigned int* eboData;
+        uint32_t numVboFloats;
+        uint32_t numElements;
+        std::vector<float> vboStore;    // Only used for entries added with Store()
+        std::vector<unsigned int> eboStore;
+    };
+
+    static const GlGeomMeshCacheEntry* FindInFile(const GlGeomMeshKey& key);
+    static UsedEntry* FindUsed(const GlGeomMeshKey& key);
+    static UsedEntry* LookUp(const GlGeomMeshKey& key);     // FindUsed, then the mapped file
+
+    static bool isOpen;
+    static std::string cacheFilename;
+    static std::vector<UsedEntry*> usedEntries;
+    static int numHits;
+    static int numMisses;
+};
+
+inline bool GlGeomMeshKey::operator==(const GlGeomMeshKey& other) const
+{
+    if (shapeId != other.shapeId || generatorVersion != other.generatorVersion) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (params[i] != other.params[i] || layout[i] != other.layout[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif  // GLGEOM_MESH_CACHE_H
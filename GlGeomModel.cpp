@@ -0,0 +1,224 @@
+/*
+* GlGeomModel.cpp
+*
+* C++ class for rendering models loaded from binary ".glgm" files in Modern OpenGL.
+*   See GlGeomModel.h and GlGeomModelFormat.h.
+*/
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "GlGeomModel.h"
+#include "MappedFile.h"
+#include "RgbImage.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Returns a pointer to count items of type T at the byte offset, or null if out of range or misaligned.
+template<class T>
+static const T* GlgmArray(const MappedFile& file, uint32_t offset, size_t count)
+{
+    if ((offset & 3) != 0 || count > SIZE_MAX / sizeof(T)) {
+        return 0;
+    }
+    return (const T*)file.DataAt(offset, count * sizeof(T));
+}
+
+// Returns true if every index of the submesh, plus its base vertex, is less than numVertices.
+//    The submesh's range of indices and its base vertex must already be checked.
+static bool GlgmIndicesInRange(const void* indexData, uint32_t indexSize, const GlgmSubmesh& sm, uint32_t numVertices)
+{
+    uint32_t maxIndex = numVertices - 1 - sm.baseVertex;
+    const unsigned char* p = (const unsigned char*)indexData + (size_t)sm.firstIndex * indexSize;
+    for (uint32_t i = 0; i < sm.numIndices; i++, p += indexSize) {
+        uint32_t index;
+        if (indexSize == 2) {
+            uint16_t shortIndex;
+            memcpy(&shortIndex, p, 2);          // The mapped file need not align the indices
+            index = shortIndex;
+        }
+        else {
+            memcpy(&index, p, 4);
+        }
+        if (index > maxIndex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GlGeomModel::Load(const char* filename,
+    unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc)
+{
+    Reset();
+
+    MappedFile file;
+    if (!file.Open(filename)) {
+        fprintf(stderr, "GlGeomModel: Unable to open model file %s.\n", filename);
+        return false;
+    }
+    const GlgmHeader* header = GlgmArray<GlgmHeader>(file, 0, 1);
+    if (header == 0 || memcmp(header->magic, GlgmMagic, sizeof(GlgmMagic)) != 0
+        || header->version != GlgmVersion || (header->indexSize != 2 && header->indexSize != 4)) {
+        fprintf(stderr, "GlGeomModel: Not a version %u model file: %s.\n", GlgmVersion, filename);
+        return false;
+    }
+    // The counts are checked before they are multiplied, so that a corrupt header cannot wrap the byte counts.
+    if (header->numVertices > UINT32_MAX / GlgmVertexFloats || header->numIndices > SIZE_MAX / header->indexSize) {
+        fprintf(stderr, "GlGeomModel: Corrupt model file: %s.\n", filename);
+        return false;
+    }
+    const size_t vertexFloats = (size_t)header->numVertices * GlgmVertexFloats;
+    const size_t indexBytes = (size_t)header->numIndices * header->indexSize;
+    const float* vertexData = GlgmArray<float>(file, header->vertexOffset, vertexFloats);
+    const void* indexData = file.DataAt(header->indexOffset, indexBytes);
+    const GlgmSubmesh* submeshData = GlgmArray<GlgmSubmesh>(file, header->submeshOffset, header->numSubmeshes);
+    const GlgmMaterial* materialData = GlgmArray<GlgmMaterial>(file, header->materialOffset, header->numMaterials);
+    const GlgmLod* lodData = GlgmArray<GlgmLod>(file, header->lodOffset, header->numLods);
+    if (vertexData == 0 || indexData == 0 || submeshData == 0 || materialData == 0 || lodData == 0
+        || header->numLods == 0) {
+        fprintf(stderr, "GlGeomModel: Truncated or corrupt model file: %s.\n", filename);
+        return false;
+    }
+
+    // Check all ranges once here, so rendering never needs to: this includes every index,
+    //    as glDrawElementsBaseVertex() would read past the vertex buffer for a bad one.
+    for (uint32_t i = 0; i < header->numSubmeshes; i++) {
+        const GlgmSubmesh& sm = submeshData[i];
+        if (sm.firstIndex > header->numIndices || sm.numIndices > header->numIndices - sm.firstIndex
+            || sm.baseVertex >= header->numVertices || sm.materialIndex >= header->numMaterials
+            || !GlgmIndicesInRange(indexData, header->indexSize, sm, header->numVertices)) {
+            fprintf(stderr, "GlGeomModel: Bad submesh %u in model file: %s.\n", i, filename);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->numLods; i++) {
+        const GlgmLod& lod = lodData[i];
+        if (lod.firstSubmesh > header->numSubmeshes || lod.numSubmeshes > header->numSubmeshes - lod.firstSubmesh) {
+            fprintf(stderr, "GlGeomModel: Bad LOD %u in model file: %s.\n", i, filename);
+            return false;
+        }
+    }
+
+    submeshes.assign(submeshData, submeshData + header->numSubmeshes);
+    materials.assign(materialData, materialData + header->numMaterials);
+    for (GlgmMaterial& mat : materials) {
+        mat.textureName[GlgmTextureNameLen - 1] = 0;
+    }
+    lods.assign(lodData, lodData + header->numLods);
+    memcpy(boundsMin, header->boundsMin, sizeof(boundsMin));
+    memcpy(boundsMax, header->boundsMax, sizeof(boundsMax));
+    indexSize = header->indexSize;
+    indexType = (indexSize == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    directory = filename;
+    size_t slash = directory.find_last_of("/\\");
+    directory = (slash == std::string::npos) ? std::string() : directory.substr(0, slash + 1);
+
+    // Upload the vertex and index arrays straight from the mapped file.
+    glGenVertexArrays(1, &theVAO);
+    glGenBuffers(1, &theVBO);
+    glGenBuffers(1, &theEBO);
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, theVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexFloats * sizeof(float), vertexData, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+
+    const int stride = GlgmVertexFloats * sizeof(float);
+    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(pos_loc);
+    if (normal_loc != UINT_MAX) {
+        glVertexAttribPointer(normal_loc, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(normal_loc);
+    }
+    if (texcoords_loc != UINT_MAX) {
+        glVertexAttribPointer(texcoords_loc, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(texcoords_loc);
+    }
+
+    // Good practice to unbind things: helps with debugging if nothing else
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void GlGeomModel::LoadTextures()
+{
+    materialTextures.assign(materials.size(), 0);
+    RgbImage texMap;
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (materials[i].textureName[0] == 0) {
+            continue;
+        }
+        std::string path = directory + materials[i].textureName;
+        if (!texMap.LoadBmpFile(path.c_str())) {
+            continue;
+        }
+        glGenTextures(1, &materialTextures[i]);
+        glBindTexture(GL_TEXTURE_2D, materialTextures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        GLenum format = texMap.HasAlpha() ? GL_RGBA : GL_RGB;
+        glTexImage2D(GL_TEXTURE_2D, 0, format, texMap.GetNumCols(), texMap.GetNumRows(), 0, format, GL_UNSIGNED_BYTE, texMap.ImageData());
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+}
+
+int GlGeomModel::SelectLod(float distance) const
+{
+    for (int i = 0; i < (int)lods.size(); i++) {
+        if (distance <= lods[i].maxDistance) {
+            return i;
+        }
+    }
+    return (int)lods.size() - 1;
+}
+
+void GlGeomModel::Render(int lod)
+{
+    assert(lod >= 0 && lod < (int)lods.size());
+    const GlgmLod& theLod = lods[lod];
+    for (uint32_t i = 0; i < theLod.numSubmeshes; i++) {
+        RenderSubmesh(theLod.firstSubmesh + i);
+    }
+}
+
+void GlGeomModel::RenderSubmesh(int i)
+{
+    assert(theVAO != 0 && "Load must be called before rendering!");
+    const GlgmSubmesh& sm = submeshes[i];
+    glBindVertexArray(theVAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)sm.numIndices, indexType,
+        (void*)((size_t)sm.firstIndex * indexSize), (GLint)sm.baseVertex);
+    glBindVertexArray(0);           // Good practice to unbind: helps with debugging if nothing else
+}
+
+void GlGeomModel::Reset()
+{
+    if (theVAO != 0) {
+        glDeleteVertexArrays(1, &theVAO);
+        glDeleteBuffers(1, &theVBO);
+        glDeleteBuffers(1, &theEBO);
+        theVAO = theVBO = theEBO = 0;
+    }
+    if (!materialTextures.empty()) {
+        glDeleteTextures((GLsizei)materialTextures.size(), materialTextures.data());
+        materialTextures.clear();
+    }
+    submeshes.clear();
+    materials.clear();
+    lods.clear();
+}
+
+GlGeomModel::~GlGeomModel()
+{
+    Reset();
+}
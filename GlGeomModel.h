@@ -0,0 +1,83 @@
+/*
+* GlGeomModel.h
+*
+* C++ class for rendering models loaded from binary ".glgm" files in Modern OpenGL.
+*   A GlGeomModel object encapsulates a VAO, a VBO, and an EBO, like the
+*   GlGeomShape classes, but its data comes from a file instead of being generated.
+*   The file format is described in GlGeomModelFormat.h; files are made with
+*   the offline converter tools/MeshConvert.cpp.
+*/
+
+#pragma once
+#ifndef GLGEOM_MODEL_H
+#define GLGEOM_MODEL_H
+
+#include "GlGeomModelFormat.h"
+#include <limits.h>
+#include <string>
+#include <vector>
+
+// GlGeomModel
+//     Holds the vertices, indices, submeshes, materials and LOD levels of a model.
+// How to use:
+//    * Call Load() with the model file and the attribute locations.
+//          The file is memory mapped and its vertex and index arrays are loaded
+//          into the VBO and EBO directly from the mapping, with no conversion.
+//    * Optionally call LoadTextures() to load the bitmaps named by the materials.
+//    * Call SelectLod() to pick a LOD level for a viewing distance, then
+//          RenderSubmesh() for each submesh of that level, setting up the
+//          submesh's material first. Or call Render() to draw a whole LOD level.
+
+class GlGeomModel
+{
+public:
+    GlGeomModel() {}
+    ~GlGeomModel();
+
+    // Load the model. Returns false (and prints an error) if the file is missing or invalid.
+    bool Load(const char* filename,
+        unsigned int pos_loc, unsigned int normal_loc = UINT_MAX, unsigned int texcoords_loc = UINT_MAX);
+    bool IsLoaded() const { return theVAO != 0; }
+
+    // Load the bitmap for each material that has one. Texture names are relative to the model file.
+    // Materials without a bitmap (or whose bitmap fails to load) get texture name 0.
+    void LoadTextures();
+
+    int GetNumLods() const { return (int)lods.size(); }
+    int GetNumSubmeshes() const { return (int)submeshes.size(); }
+    int GetNumMaterials() const { return (int)materials.size(); }
+    const GlgmLod& GetLod(int lod) const { return lods[lod]; }
+    const GlgmSubmesh& GetSubmesh(int i) const { return submeshes[i]; }
+    const GlgmMaterial& GetMaterial(int i) const { return materials[i]; }
+    unsigned int GetMaterialTexture(int i) const { return i < (int)materialTextures.size() ? materialTextures[i] : 0; }
+    const float* GetBoundsMin() const { return boundsMin; }
+    const float* GetBoundsMax() const { return boundsMax; }
+
+    // Returns the least detailed LOD level whose maxDistance is at least the distance.
+    int SelectLod(float distance) const;
+
+    void Render(int lod = 0);           // Renders every submesh of a LOD level
+    void RenderSubmesh(int i);
+
+private:
+    GlGeomModel(const GlGeomModel&) = delete;
+    GlGeomModel& operator=(const GlGeomModel&) = delete;
+
+    void Reset();
+
+    unsigned int theVAO = 0;        // Vertex Array Object
+    unsigned int theVBO = 0;        // Vertex Buffer Object
+    unsigned int theEBO = 0;        // Element Buffer Object;
+    unsigned int indexType = 0;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int indexSize = 0;
+
+    std::vector<GlgmSubmesh> submeshes;
+    std::vector<GlgmMaterial> materials;
+    std::vector<GlgmLod> lods;
+    std::vector<unsigned int> materialTextures;
+    std::string directory;          // Directory of the model file, for texture names
+    float boundsMin[3] = { 0.0f, 0.0f, 0.0f };
+    float boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+#endif  // GLGEOM_MODEL_H
@@ -0,0 +1,71 @@
+//
+// GlGeomModelFormat.h
+//
+// The binary model container (".glgm" files) read by GlGeomModel
+//    and written by the offline converter tools/MeshConvert.cpp.
+//
+// The file is designed to be memory mapped and handed to OpenGL as is:
+//    * Vertices are interleaved, 8 floats each:
+//          position (x,y,z), normal (nx,ny,nz), texture coordinates (s,t)
+//      matching vertPos_loc, vertNormal_loc and vertTexCoords_loc.
+//    * Indices are 16 bit or 32 bit (GlgmHeader::indexSize), relative
+//      to the baseVertex of their submesh, for GL_TRIANGLES drawing.
+//    * Submeshes are ranges of indices using a single material.
+//    * LOD levels are ranges of submeshes. LOD 0 is the most detailed.
+//
+// File layout (little endian):
+//    GlgmHeader, followed by the arrays it gives offsets to.
+//    All offsets are in bytes from the start of the file and are 4-byte aligned.
+//
+
+#pragma once
+#ifndef GLGEOM_MODEL_FORMAT_H
+#define GLGEOM_MODEL_FORMAT_H
+
+#include <stdint.h>
+
+const char GlgmMagic[4] = { 'G', 'L', 'G', 'M' };
+const uint32_t GlgmVersion = 1;
+const uint32_t GlgmVertexFloats = 8;       // Floats per vertex: position, normal, texture coordinates
+const int GlgmTextureNameLen = 64;
+
+struct GlgmHeader {
+    char magic[4];              // "GLGM"
+    uint32_t version;           // GlgmVersion
+    uint32_t indexSize;         // 2 or 4 bytes per index
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t numSubmeshes;
+    uint32_t numMaterials;
+    uint32_t numLods;
+    uint32_t vertexOffset;      // numVertices*GlgmVertexFloats floats
+    uint32_t indexOffset;       // numIndices indices of indexSize bytes
+    uint32_t submeshOffset;     // numSubmeshes GlgmSubmesh's
+    uint32_t materialOffset;    // numMaterials GlgmMaterial's
+    uint32_t lodOffset;         // numLods GlgmLod's
+    float boundsMin[3];         // Axis aligned bounding box of all vertices
+    float boundsMax[3];
+};
+
+struct GlgmSubmesh {
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    uint32_t baseVertex;        // Added to every index of the submesh
+    uint32_t materialIndex;
+};
+
+struct GlgmMaterial {
+    float ambientColor[3];
+    float diffuseColor[3];
+    float specularColor[3];
+    float specularExponent;
+    char textureName[GlgmTextureNameLen];   // Bitmap file (relative to the model file), or empty
+};
+
+struct GlgmLod {
+    uint32_t firstSubmesh;
+    uint32_t numSubmeshes;
+    float maxDistance;          // Use this LOD up to this viewing distance
+};
+
+#endif  // GLGEOM_MODEL_FORMAT_H
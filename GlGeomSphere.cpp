@@ -29,6 +29,8 @@
 #include "assert.h"
 
 #include "GlGeomSphere.h"
+#include "GlGeomLayout.h"
+#include "GlGeomMeshCache.h"
 
 void GlGeomSphere::Remesh(int slices, int stacks)
 {
@@ -48,9 +50,18 @@ void GlGeomSphere::Remesh(int slices, int stacks)
 void GlGeomSphere::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
     int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, unsigned int stride)
 {
-    assert(vertPosOffset >= 0 && stride>0);
-    bool calcNormals = (vertNormalOffset >= 0);       // Should normals be calculated?
-    bool calcTexCoords = (vertTexCoordsOffset >= 0);  // Should texture coordinates be calculated?
+    GlGeomDispatchLayout(*this, VBOdataBuffer, EBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+}
+
+template<class VertLayout>
+void GlGeomSphere::CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout)
+{
+    const int stride = layout.Stride();
+    const int vertPosOffset = layout.PosOffset();
+    const int vertNormalOffset = layout.NormalOffset();
+    const int vertTexCoordsOffset = layout.TexOffset();
+    const bool calcNormals = layout.HasNormals();       // Should normals be calculated?
+    const bool calcTexCoords = layout.HasTexCoords();   // Should texture coordinates be calculated?
 
      for (int i = 0; i <= numSlices; i++) {
         // Handle a slice of vertices.
@@ -136,6 +147,17 @@ bool GlGeomSphere::GetVertexNumber(int i, int j, bool calcTexCoords, unsigned in
 }
 
 
+bool GlGeomSphere::GetMeshCacheKey(GlGeomMeshKey* key) const
+{
+    key->shapeId = GlGeomMeshShape_Sphere;
+    key->generatorVersion = MeshGeneratorVersion;
+    key->params[0] = numSlices;
+    key->params[1] = numStacks;
+    key->params[2] = 0;
+    key->params[3] = 0;
+    return true;
+}
+
 void GlGeomSphere::InitializeAttribLocations(
 	unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc)
 {
@@ -224,8 +246,4 @@ void GlGeomSphere::RenderNorthPoleFan() {
     GlGeomBase::RenderElements(GL_TRIANGLE_FAN, numSlices + 2, poleElts);
 }
 
-
-
-
-
-
+GLGEOM_INSTANTIATE_LAYOUTS(GlGeomSphere)
@@ -28,8 +28,11 @@
 #include <GLFW/glfw3.h>
 
 #include "GlGeomTorus.h"
+#include "GlGeomLayout.h"
+#include "GlGeomMeshCache.h"
 #include "MathMisc.h"
 #include "assert.h"
+#include <string.h>
 
 
 void GlGeomTorus::Remesh(int rings, int sides, float minorRadius)
@@ -48,9 +51,18 @@ void GlGeomTorus::Remesh(int rings, int sides, float minorRadius)
 void GlGeomTorus::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
     int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset, unsigned int stride)
 {
-    assert(vertPosOffset >= 0 && stride > 0);
-    bool calcNormals = (vertNormalOffset >= 0);       // Should normals be calculated?
-    bool calcTexCoords = (vertTexCoordsOffset >= 0);  // Should texture coordinates be calculated?
+    GlGeomDispatchLayout(*this, VBOdataBuffer, EBOdataBuffer, vertPosOffset, vertNormalOffset, vertTexCoordsOffset, stride);
+}
+
+template<class VertLayout>
+void GlGeomTorus::CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout)
+{
+    const int stride = layout.Stride();
+    const int vertPosOffset = layout.PosOffset();
+    const int vertNormalOffset = layout.NormalOffset();
+    const int vertTexCoordsOffset = layout.TexOffset();
+    const bool calcNormals = layout.HasNormals();       // Should normals be calculated?
+    const bool calcTexCoords = layout.HasTexCoords();   // Should texture coordinates be calculated?
 
     // VBO Data is laid out: Around each ring. Starting with ring at x==0 and z<0.
     //          Each ring starts at the innermost seam of the torus (nearest to the y-axis).
@@ -72,7 +84,7 @@ void GlGeomTorus::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffe
             float phi = (float)PI2 * ((float)(j % numSides)) / (float)(numSides);
             float cphi = -cosf(phi);      // Negated value (start at inner seam)
             float sphi = -sinf(phi);       // Negated, start downward (-y)
-            float* posPtr = toPtr;
+            float* posPtr = toPtr + vertPosOffset;
             *(posPtr++) = s * (1.0f + radius * cphi);    // x coordinate
             *(posPtr++) = radius * sphi;                  // y coordinate
             *posPtr = c * (1.0f + radius * cphi);        // z coordinate
@@ -111,6 +123,17 @@ void GlGeomTorus::CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffe
 }
 
 
+bool GlGeomTorus::GetMeshCacheKey(GlGeomMeshKey* key) const
+{
+    key->shapeId = GlGeomMeshShape_Torus;
+    key->generatorVersion = MeshGeneratorVersion;
+    key->params[0] = numRings;
+    key->params[1] = numSides;
+    memcpy(&key->params[2], &radius, sizeof(float));     // Minor radius, by its bit pattern
+    key->params[3] = 0;
+    return true;
+}
+
 void GlGeomTorus::InitializeAttribLocations(
     unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc)
 {
@@ -178,4 +201,4 @@ void GlGeomTorus::RenderSideStrip(int j)
     delete[] sideElts;
 }
 
-
+GLGEOM_INSTANTIATE_LAYOUTS(GlGeomTorus)
@@ -102,6 +102,15 @@ public:
     void CalcVboAndEbo(float* VBOdataBuffer, unsigned int* EBOdataBuffer,
         int vertPosOffset, int vertNormalOffset, int vertTexCoordsOffset,
         unsigned int stride);
+
+    // CalcVboAndEboLayout - the generator behind CalcVboAndEbo, for one vertex layout.
+    //    VertLayout is one of the GlGeomLayout<> types, or GlGeomRuntimeLayout. See GlGeomLayout.h.
+    template<class VertLayout>
+    void CalcVboAndEboLayout(float* VBOdataBuffer, unsigned int* EBOdataBuffer, const VertLayout& layout);
+
+    // Mesh cache support. Increment MeshGeneratorVersion whenever the generated data changes.
+    static const unsigned int MeshGeneratorVersion = 1;
+    bool GetMeshCacheKey(GlGeomMeshKey* key) const;
  
 private:
 
@@ -45,6 +45,7 @@
 //     vertexshader
 //     fragmentshader
 //     geometryshader
+//     computeshader  (needs OpenGL 4.3)
 //     codeblock    (a part of a shader)
 //  (Other types to be supported in the future.)
 //  <codeblockname> must a unique name for the shader (or block of code).
@@ -52,10 +53,10 @@
 
 // Names are not case sensitive
 std::vector<std::string> GlShaderMgr::shaderTypeName = {
-    "vertexshader", "fragmentshader", "geometryshader", "codeblock" };
+    "vertexshader", "fragmentshader", "geometryshader", "computeshader", "codeblock" };
 
 std::vector<unsigned int> GlShaderMgr::openGLtypes = {
-    GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+    GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_COMPUTE_SHADER };
 
 // Information about all the code blocks,
 //   plus information about the individual compiled shader programs.
@@ -248,6 +249,13 @@ unsigned int GlShaderMgr::CompileShader(const char* shaderCodeName1, const char*
     return CompileShader(3, shaderNames);;
 }
 
+unsigned int GlShaderMgr::CompileShader(const char* shaderCodeName1, const char* shaderCodeName2, const char* shaderCodeName3,
+    const char* shaderCodeName4)
+{
+    const char* shaderNames[4] = { shaderCodeName1, shaderCodeName2, shaderCodeName3, shaderCodeName4 };
+    return CompileShader(4, shaderNames);
+}
+
 unsigned int GlShaderMgr::CompileShader(int numcodeBlocks, const char* shaderCodeNames[])
 {
     ShaderType typeSoFar = code_block;
@@ -80,7 +80,7 @@ public:
     //    If any error occurs, "0" is returned.
     static unsigned int CompileShader(const char* shaderCodeName);
 
-    // Compile a shader from a two or three block of shader code
+    // Compile a shader from two, three or four blocks of shader code
     //    One of the shaders must give the type of the shader,
     //        the other shadesr must be of type "codeblock".
     //    Returns the OpenGL handle (name) for the shader.
@@ -88,6 +88,8 @@ public:
     //    If any error occurs, "0" is returned.
     static unsigned int CompileShader(const char* shaderCodeName1, const char* shaderCodeName2);
     static unsigned int CompileShader(const char* shaderCodeName1, const char* shaderCodeName2, const char* shaderCodeName3);
+    static unsigned int CompileShader(const char* shaderCodeName1, const char* shaderCodeName2, const char* shaderCodeName3,
+        const char* shaderCodeName4);
 
     // Compile a shader formed by concatenating multiple blocks of code.
     //    One of the shaders must give the type of the shader,
@@ -110,7 +112,7 @@ public:
     static unsigned int check_ok_to_link(int numShaders, const unsigned int shaderList[]);
 
 protected:
-    enum ShaderType { vertex_shader, fragment_shader, geometry_shader, code_block };
+    enum ShaderType { vertex_shader, fragment_shader, geometry_shader, compute_shader, code_block };
     static std::vector<std::string> shaderTypeName;
     static std::vector<unsigned int> openGLtypes;
 
@@ -0,0 +1,167 @@
+//
+// HiZCuller.cpp
+//
+// Hierarchical-Z occlusion culling on the CPU. See HiZCuller.h.
+//
+
+#include "HiZCuller.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Anything nearer than this (in front of the camera) is not projected.
+static const float MinDepth = 0.01f;
+
+HiZCuller::HiZCuller()
+{
+    for (int i = 0; i < NumLevels; i++) {
+        levels[i].assign((Width >> i) * (Height >> i), FLT_MAX);
+    }
+    memset(viewProj, 0, sizeof(viewProj));
+    numOccluderPolygons = numTested = numCulled = 0;
+}
+
+void HiZCuller::BeginFrame(const float* theViewProj)
+{
+    memcpy(viewProj, theViewProj, sizeof(viewProj));
+    levels[0].assign(Width * Height, FLT_MAX);
+    numOccluderPolygons = numTested = numCulled = 0;
+}
+
+bool HiZCuller::ToScreen(const float* p, float* x, float* y, float* w) const
+{
+    const float* m = viewProj;
+    float cx = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+    float cy = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+    float cw = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+    if (cw < MinDepth) {
+        return false;
+    }
+    *x = (cx / cw * 0.5f + 0.5f) * (float)Width;
+    *y = (cy / cw * 0.5f + 0.5f) * (float)Height;
+    *w = cw;
+    return true;
+}
+
+void HiZCuller::AddOccluderPolygon(const float* points, int numPoints)
+{
+    assert(numPoints >= 3 && numPoints <= MaxPolygonPoints);
+    float x[MaxPolygonPoints], y[MaxPolygonPoints];
+    float depth = 0.0f;
+    for (int k = 0; k < numPoints; k++) {
+        float w;
+        if (!ToScreen(points + 3 * k, &x[k], &y[k], &w)) {
+            return;             // Crosses the camera plane: just skip it
+        }
+        depth = fmaxf(depth, w);
+    }
+    float area = 0.0f;
+    for (int k = 0; k < numPoints; k++) {
+        int kk = (k + 1) % numPoints;
+        area += x[k] * y[kk] - x[kk] * y[k];
+    }
+    if (area == 0.0f) {
+        return;
+    }
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    // Fill only the pixels entirely inside the polygon: each edge function
+    //   must be positive at all four corners, so at the center by a margin.
+    float margin[MaxPolygonPoints];
+    float xMinF = x[0], xMaxF = x[0], yMinF = y[0], yMaxF = y[0];
+    for (int k = 0; k < numPoints; k++) {
+        int kk = (k + 1) % numPoints;
+        margin[k] = 0.5f * (fabsf(x[kk] - x[k]) + fabsf(y[kk] - y[k]));
+        xMinF = fminf(xMinF, x[k]);
+        xMaxF = fmaxf(xMaxF, x[k]);
+        yMinF = fminf(yMinF, y[k]);
+        yMaxF = fmaxf(yMaxF, y[k]);
+    }
+    int xMin = (int)fmaxf(0.0f, floorf(xMinF));
+    int xMax = (int)fminf((float)(Width - 1), ceilf(xMaxF));
+    int yMin = (int)fmaxf(0.0f, floorf(yMinF));
+    int yMax = (int)fminf((float)(Height - 1), ceilf(yMaxF));
+    std::vector<float>& depths = levels[0];
+    for (int j = yMin; j <= yMax; j++) {
+        float py = (float)j + 0.5f;
+        for (int i = xMin; i <= xMax; i++) {
+            float px = (float)i + 0.5f;
+            bool inside = true;
+            for (int k = 0; k < numPoints && inside; k++) {
+                int kk = (k + 1) % numPoints;
+                float e = sign * ((x[kk] - x[k]) * (py - y[k]) - (y[kk] - y[k]) * (px - x[k]));
+                inside = (e >= margin[k]);
+            }
+            if (inside) {
+                float& d = depths[j * Width + i];
+                d = fminf(d, depth);
+            }
+        }
+    }
+    numOccluderPolygons++;
+}
+
+void HiZCuller::BuildPyramid()
+{
+    for (int k = 1; k < NumLevels; k++) {
+        const std::vector<float>& src = levels[k - 1];
+        std::vector<float>& dst = levels[k];
+        int srcWidth = Width >> (k - 1);
+        int w = Width >> k;
+        int h = Height >> k;
+        for (int j = 0; j < h; j++) {
+            const float* row0 = &src[(2 * j) * srcWidth];
+            const float* row1 = row0 + srcWidth;
+            for (int i = 0; i < w; i++) {
+                dst[j * w + i] = fmaxf(fmaxf(row0[2 * i], row0[2 * i + 1]), fmaxf(row1[2 * i], row1[2 * i + 1]));
+            }
+        }
+    }
+}
+
+bool HiZCuller::IsVisible(const float* boxMin, const float* boxMax)
+{
+    numTested++;
+    float xMin = FLT_MAX, xMax = -FLT_MAX, yMin = FLT_MAX, yMax = -FLT_MAX;
+    float nearest = FLT_MAX;
+    for (int c = 0; c < 8; c++) {
+        float p[3] = { (c & 1) ? boxMax[0] : boxMin[0], (c & 2) ? boxMax[1] : boxMin[1], (c & 4) ? boxMax[2] : boxMin[2] };
+        float x, y, w;
+        if (!ToScreen(p, &x, &y, &w)) {
+            return true;        // Reaches behind the camera: assume visible
+        }
+        xMin = fminf(xMin, x);
+        xMax = fmaxf(xMax, x);
+        yMin = fminf(yMin, y);
+        yMax = fmaxf(yMax, y);
+        nearest = fminf(nearest, w);
+    }
+    if (xMax < 0.0f || yMax < 0.0f || xMin >= (float)Width || yMin >= (float)Height) {
+        numCulled++;            // Entirely off screen
+        return false;
+    }
+    int i0 = (int)fmaxf(0.0f, floorf(xMin));
+    int i1 = (int)fminf((float)(Width - 1), floorf(xMax));
+    int j0 = (int)fmaxf(0.0f, floorf(yMin));
+    int j1 = (int)fminf((float)(Height - 1), floorf(yMax));
+
+    // Go up the pyramid until the rectangle spans at most 2x2 texels.
+    int k = 0;
+    while (k < NumLevels - 1 && (i1 - i0 > 1 || j1 - j0 > 1)) {
+        i0 >>= 1; i1 >>= 1; j0 >>= 1; j1 >>= 1;
+        k++;
+    }
+    const std::vector<float>& depths = levels[k];
+    int w = Width >> k;
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            if (depths[j * w + i] >= nearest) {
+                return true;
+            }
+        }
+    }
+    numCulled++;
+    return false;
+}
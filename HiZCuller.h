@@ -0,0 +1,73 @@
+//
+// HiZCuller.h
+//
+// Hierarchical-Z occlusion culling on the CPU.
+//
+//   Each frame, a few large, near occluders are rasterized into a small
+//   depth buffer (a "depth prepass of near occluders", done in software,
+//   so nothing is read back from the GPU). The buffer is reduced into a
+//   pyramid of maximum depths. Bounding boxes are then tested against the
+//   pyramid level where they cover at most 2x2 texels, so each test reads
+//   only a few texels whatever the size of the box.
+//
+//   Occluders must be conservative: every pixel they cover must really be
+//   covered by solid geometry at least as near. The cross section through
+//   the axis of a solid cone is such a shape.
+//
+//   Depths are clip space w values, i.e., distances in front of the camera.
+//
+// How to use, each frame:
+//    * BeginFrame() with the view-projection matrix.
+//    * AddOccluderPolygon() for each occluder.
+//    * BuildPyramid().
+//    * IsVisible() for each bounding box. Boxes off screen are not visible,
+//          so this also does frustum culling.
+//
+
+#pragma once
+#ifndef HIZ_CULLER_H
+#define HIZ_CULLER_H
+
+#include <vector>
+
+class HiZCuller {
+public:
+    static const int Width = 128;       // Resolution of the occlusion depth buffer
+    static const int Height = 64;
+    static const int NumLevels = 7;     // Down to 2x1 texels
+
+    HiZCuller();
+
+    // viewProj is the projection matrix times the view matrix, by columns (as from DumpByColumns).
+    void BeginFrame(const float* viewProj);
+
+    // Add a convex, planar polygon, given by numPoints (x,y,z) world coordinates.
+    //   It is drawn at the depth of its farthest vertex, so it never hides more
+    //   than the real geometry does. Only pixels entirely inside it are covered.
+    static const int MaxPolygonPoints = 8;
+    void AddOccluderPolygon(const float* points, int numPoints);
+
+    void BuildPyramid();
+
+    // Test an axis aligned box in world coordinates.
+    bool IsVisible(const float* boxMin, const float* boxMax);
+
+    // The pyramid, as built by BuildPyramid(): level k is (Width>>k) x (Height>>k) depths, by rows.
+    const float* GetLevel(int k) const { return levels[k].data(); }
+
+    int GetNumOccluderPolygons() const { return numOccluderPolygons; }
+    int GetNumTested() const { return numTested; }
+    int GetNumCulled() const { return numCulled; }
+
+private:
+    // Transforms a world point to pixel coordinates (x,y) and depth w. Returns false if not in front of the camera.
+    bool ToScreen(const float* p, float* x, float* y, float* w) const;
+
+    float viewProj[16];
+    std::vector<float> levels[NumLevels];   // levels[0] is Width x Height; each next level is half the size
+    int numOccluderPolygons;
+    int numTested;
+    int numCulled;
+};
+
+#endif  // HIZ_CULLER_H
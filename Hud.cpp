@@ -0,0 +1,273 @@
+//
+// Hud.cpp
+//
+// On-screen text and panels, batched into one draw call. See Hud.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "Hud.h"
+#include "GlShaderMgr.h"
+
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+
+// The font: ASCII 32 (space) to 90 ('Z'). Seven rows per glyph, top row first,
+//    the leftmost pixel in bit 4.
+static const int FirstChar = 32, LastChar = 90;
+static const unsigned char Font5x7[LastChar - FirstChar + 1][7] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // space
+    { 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x04 },   // !
+    { 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 },   // "
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },   // #
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 },   // $
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },   // %
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D },   // &
+    { 0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },   // '
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },   // (
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },   // )
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 },   // *
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },   // +
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },   // ,
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },   // -
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },   // .
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },   // /
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },   // 0
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },   // 1
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },   // 2
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },   // 3
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },   // 4
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },   // 5
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },   // 6
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },   // 7
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },   // 8
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },   // 9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },   // :
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },   // ;
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },   // <
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },   // =
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },   // >
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },   // ?
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E },   // @
+    { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },   // A
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },   // B
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },   // C
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },   // D
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },   // E
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },   // F
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },   // G
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },   // H
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },   // I
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },   // J
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },   // K
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },   // L
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },   // M
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },   // N
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },   // O
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },   // P
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },   // Q
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },   // R
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },   // S
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },   // T
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },   // U
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },   // V
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },   // W
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },   // X
+    { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },   // Y
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },   // Z
+};
+
+// The atlas: 8x8 cells, 16 per row. The glyphs, then a solid cell for the panels.
+static const int CellSize = 8, CellsPerRow = 16;
+static const int SolidCell = LastChar - FirstChar + 1;
+static const int AtlasWidth = CellSize * CellsPerRow;
+static const int AtlasHeight = CellSize * (SolidCell / CellsPerRow + 1);
+
+unsigned int Hud::program = 0;
+int Hud::windowSizeLoc = -1;
+int Hud::atlasLoc = -1;
+unsigned int Hud::atlasTexture = 0;
+unsigned int Hud::theVAO = 0;
+unsigned int Hud::vertexBuffer = 0;
+unsigned int Hud::indexBuffer = 0;
+std::vector<Hud::Vertex> Hud::vertices;
+int Hud::windowWidth = 1;
+int Hud::windowHeight = 1;
+double Hud::cpuTime = 0.0;
+double Hud::cpuTimeThisFrame = 0.0;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Hud::Setup()
+{
+    program = GlShaderMgr::CompileAndLinkProgram("vertexShader_Hud", "fragmentShader_Hud");
+    if (program == 0) {
+        fprintf(stderr, "Hud: failed to build the shader program.\n");
+        return false;
+    }
+    windowSizeLoc = glGetUniformLocation(program, "windowSize");
+    atlasLoc = glGetUniformLocation(program, "atlas");
+
+    // The atlas: one byte per texel, 255 where a glyph pixel is set.
+    std::vector<unsigned char> texels(AtlasWidth * AtlasHeight, 0);
+    for (int cell = 0; cell <= SolidCell; cell++) {
+        int x0 = (cell % CellsPerRow) * CellSize;
+        int y0 = (cell / CellsPerRow) * CellSize;
+        for (int row = 0; row < CellSize; row++) {
+            for (int col = 0; col < CellSize; col++) {
+                bool set = (cell == SolidCell)
+                    || (row < GlyphHeight && col < GlyphWidth && ((Font5x7[cell][row] >> (GlyphWidth - 1 - col)) & 1));
+                texels[(y0 + row) * AtlasWidth + x0 + col] = set ? 255 : 0;
+            }
+        }
+    }
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, AtlasWidth, AtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Two triangles per quad, for all the quads at once.
+    std::vector<unsigned short> indices(6 * MaxQuads);
+    for (int i = 0; i < MaxQuads; i++) {
+        unsigned short v = (unsigned short)(4 * i);
+        unsigned short quad[6] = { v, (unsigned short)(v + 1), (unsigned short)(v + 2),
+            v, (unsigned short)(v + 2), (unsigned short)(v + 3) };
+        for (int k = 0; k < 6; k++) {
+            indices[6 * i + k] = quad[k];
+        }
+    }
+
+    glGenVertexArrays(1, &theVAO);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, 4 * MaxQuads * sizeof(Vertex), 0, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    vertices.reserve(4 * MaxQuads);
+    return true;
+}
+
+void Hud::Begin(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    vertices.clear();
+    cpuTimeThisFrame = 0.0;
+}
+
+// Lower case letters use the upper case glyphs. Characters not in the font are drawn as '?'.
+int Hud::GlyphCell(char c)
+{
+    if (c >= 'a' && c <= 'z') {
+        c = c - 'a' + 'A';
+    }
+    if (c < FirstChar || c > LastChar) {
+        c = '?';
+    }
+    return c - FirstChar;
+}
+
+void Hud::AddQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, unsigned int color)
+{
+    if ((int)vertices.size() >= 4 * MaxQuads) {
+        return;
+    }
+    Vertex q[4] = {
+        { x0, y1, u0, v1, color },
+        { x1, y1, u1, v1, color },
+        { x1, y0, u1, v0, color },
+        { x0, y0, u0, v0, color },
+    };
+    vertices.insert(vertices.end(), q, q + 4);
+}
+
+int Hud::Text(int x, int y, int scale, unsigned int color, const char* format, ...)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    int penX = x;
+    for (const char* c = text; *c != 0; c++) {
+        if (*c == '\n') {
+            penX = x;
+            y += LineHeight * scale;
+            continue;
+        }
+        if (*c != ' ') {
+            int cell = GlyphCell(*c);
+            float u0 = (float)((cell % CellsPerRow) * CellSize);
+            float v0 = (float)((cell / CellsPerRow) * CellSize);
+            AddQuad((float)penX, (float)y, (float)(penX + GlyphWidth * scale), (float)(y + GlyphHeight * scale),
+                u0, v0, u0 + GlyphWidth, v0 + GlyphHeight, color);
+        }
+        penX += Advance * scale;
+    }
+    cpuTimeThisFrame += MillisecondsSince(start);
+    return penX - x;
+}
+
+void Hud::Panel(int x, int y, int width, int height, unsigned int color)
+{
+    float u = (float)((SolidCell % CellsPerRow) * CellSize) + 0.5f * CellSize;
+    float v = (float)((SolidCell / CellsPerRow) * CellSize) + 0.5f * CellSize;
+    AddQuad((float)x, (float)y, (float)(x + width), (float)(y + height), u, v, u, v, color);
+}
+
+void Hud::Draw()
+{
+    if (vertices.empty() || program == 0) {
+        cpuTime = cpuTimeThisFrame;
+        return;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // Orphan the buffer: the driver gives new storage if the GPU still reads last frame's.
+    glBufferData(GL_ARRAY_BUFFER, 4 * MaxQuads * sizeof(Vertex), 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), &vertices[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(program);
+    glUniform2f(windowSizeLoc, (float)windowWidth, (float)windowHeight);
+    glUniform1i(atlasLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(theVAO);
+    glDrawElements(GL_TRIANGLES, (GLsizei)(vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, 0);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    cpuTimeThisFrame += MillisecondsSince(start);
+    cpuTime = cpuTimeThisFrame;
+}
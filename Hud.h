@@ -0,0 +1,67 @@
+//
+// Hud.h
+//
+// On-screen text and panels, for the HUD and the performance overlay.
+//
+//   The glyphs come from a small bitmap font (5x7 pixels, upper case,
+//   digits and punctuation; lower case is drawn as upper case), built into
+//   a one-channel atlas texture at Setup(). Each glyph is a textured quad,
+//   scaled by a whole number so the pixels stay sharp. Panels are quads
+//   on a solid cell of the same atlas.
+//
+//   All the quads of a frame are collected on the CPU, then written into
+//   one streaming vertex buffer (orphaned each frame, so the GPU is never
+//   waited for) and drawn with a single glDrawElements(), with a static
+//   index buffer. Nothing is allocated per frame.
+//
+// How to use:
+//    * Call Setup() once, after loading the shaders.
+//    * Each frame, call Begin() with the window size, then Text() and Panel().
+//          Coordinates are in pixels from the top left corner of the window.
+//    * Call Draw() with the window's framebuffer bound.
+//
+
+#pragma once
+#ifndef HUD_H
+#define HUD_H
+
+#include <vector>
+
+class Hud {
+public:
+    static const int MaxQuads = 4096;           // Quads past this are dropped
+    static const int GlyphWidth = 5, GlyphHeight = 7;
+    static const int Advance = 6;               // Glyph spacing, in font pixels
+    static const int LineHeight = 9;
+
+    static bool Setup();
+
+    static void Begin(int windowWidth, int windowHeight);
+    // Colors are 0xAABBGGRR. Returns the width of the text, in pixels.
+    static int Text(int x, int y, int scale, unsigned int color, const char* format, ...);
+    static void Panel(int x, int y, int width, int height, unsigned int color);
+    static void Draw();
+
+    static int GetNumQuads() { return (int)vertices.size() / 4; }
+    static double GetCpuTime() { return cpuTime; }      // Milliseconds in Text() and Draw(), last frame
+
+private:
+    struct Vertex {
+        float x, y;                 // Pixels
+        float u, v;                 // Texels of the atlas
+        unsigned int color;
+    };
+
+    static void AddQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, unsigned int color);
+    static int GlyphCell(char c);
+
+    static unsigned int program;
+    static int windowSizeLoc, atlasLoc;
+    static unsigned int atlasTexture;
+    static unsigned int theVAO, vertexBuffer, indexBuffer;
+    static std::vector<Vertex> vertices;
+    static int windowWidth, windowHeight;
+    static double cpuTime, cpuTimeThisFrame;
+};
+
+#endif  // HUD_H
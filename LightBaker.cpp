@@ -0,0 +1,204 @@
+//
+// LightBaker.cpp
+//
+// Ambient occlusion and shadowed direct light per vertex, from rays through the obstacle grid. See LightBaker.h.
+//
+
+#include "LightBaker.h"
+#include "ObstacleGrid.h"
+
+#include <chrono>
+#include <math.h>
+
+float LightBaker::lightDir[3] = { 0.0f, 1.0f, 0.0f };
+
+static double SecondsNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LightBaker::SetLightDirection(float x, float y, float z)
+{
+    float len = sqrtf(x * x + y * y + z * z);
+    lightDir[0] = x / len;
+    lightDir[1] = y / len;
+    lightDir[2] = z / len;
+}
+
+void LightBaker::Start(const std::vector<Job>& newJobs)
+{
+    Shutdown();
+    jobs = newJobs;
+    nextJob = 0;
+    numJobsDone = 0;
+    numRays = 0;
+    done = false;
+    startTime = SecondsNow();
+    if (jobs.empty()) {
+        done = true;
+        milliseconds = 0.0;
+        return;
+    }
+    // The main thread keeps one core.
+    int numWorkers = (int)std::thread::hardware_concurrency() - 1;
+    numWorkers = numWorkers < 1 ? 1 : (numWorkers > 8 ? 8 : numWorkers);
+    numWorkers = numWorkers > (int)jobs.size() ? (int)jobs.size() : numWorkers;
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::thread(&LightBaker::WorkerMain, this));
+    }
+}
+
+void LightBaker::WorkerMain()
+{
+    for (int j = nextJob++; j < (int)jobs.size(); j = nextJob++) {
+        numRays += Bake(jobs[j]);
+        numJobsDone++;
+    }
+}
+
+bool LightBaker::Update()
+{
+    if (done || workers.empty() || numJobsDone < (int)jobs.size()) {
+        return done;
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    workers.clear();
+    milliseconds = 1000.0 * (SecondsNow() - startTime);
+    done = true;
+    return true;
+}
+
+void LightBaker::Shutdown()
+{
+    nextJob = (int)jobs.size();     // Workers stop after their current job
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    workers.clear();
+}
+
+// How much light gets along the ray: 1 if it meets nothing, LeafTransmittance if it first meets
+//    leaves, 0 if a trunk. With ignoreTrunks, the ray goes on through the trunks.
+static float RayVisibility(const ObstacleGrid& grid, const float* origin, const float* dir, float maxT, bool ignoreTrunks)
+{
+    ObstacleGrid::Ray ray;
+    for (int k = 0; k < 3; k++) {
+        ray.origin[k] = origin[k];
+        ray.dir[k] = dir[k];
+    }
+    ray.maxT = maxT;
+    ObstacleGrid::Hit hit;
+    for (int tries = 0; tries < 4; tries++) {
+        if (!grid.Raycast(ray, &hit)) {
+            return 1.0f;
+        }
+        if (hit.leaves) {
+            return LightBaker::LeafTransmittance;
+        }
+        if (!ignoreTrunks) {
+            return 0.0f;
+        }
+        float t = hit.t + 1.0e-3f;  // Into the trunk, or out of it
+        for (int k = 0; k < 3; k++) {
+            ray.origin[k] += t * ray.dir[k];
+        }
+        ray.maxT -= t;
+        if (ray.maxT <= 0.0f) {
+            return 1.0f;
+        }
+    }
+    return 0.0f;
+}
+
+uint64_t LightBaker::Bake(const Job& job)
+{
+    // The ray directions, cosine weighted about +z: a Hammersley set, turned about z by a different
+    //    angle at each vertex, so that neighboring vertices do not miss the same trees.
+    static const float TwoPi = 6.2831853f;
+    float sampleDirs[NumAoRays][3];
+    for (int k = 0; k < NumAoRays; k++) {
+        float u = (k + 0.5f) / NumAoRays;
+        float v = 0.0f;
+        float bit = 0.5f;
+        for (int n = k; n != 0; n >>= 1, bit *= 0.5f) {
+            v += (n & 1) ? bit : 0.0f;
+        }
+        float r = sqrtf(u);
+        sampleDirs[k][0] = r * cosf(TwoPi * v);
+        sampleDirs[k][1] = r * sinf(TwoPi * v);
+        sampleDirs[k][2] = sqrtf(1.0f - u);
+    }
+
+    uint64_t rays = 0;
+    for (int i = 0; i < job.numVerts; i++) {
+        const float* vert = job.verts + i * job.stride;
+        float p[3], n[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = vert[k] * job.scale[k];
+            n[k] = vert[3 + k] / job.scale[k];      // Normals scale inversely
+        }
+        float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0.0f) {
+            job.baked[2 * i] = 1.0f;
+            job.baked[2 * i + 1] = 0.0f;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            n[k] /= len;
+        }
+
+        // A frame about the normal
+        float t[3], b[3];
+        if (fabsf(n[0]) < 0.6f) {
+            t[0] = 0.0f; t[1] = n[2]; t[2] = -n[1];         // n x (1,0,0)
+        }
+        else {
+            t[0] = -n[2]; t[1] = 0.0f; t[2] = n[0];         // n x (0,1,0)
+        }
+        len = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+        for (int k = 0; k < 3; k++) {
+            t[k] /= len;
+        }
+        b[0] = n[1] * t[2] - n[2] * t[1];
+        b[1] = n[2] * t[0] - n[0] * t[2];
+        b[2] = n[0] * t[1] - n[1] * t[0];
+        float turn = TwoPi * fmodf(i * 0.618034f, 1.0f);
+        float c = cosf(turn), s = sinf(turn);
+
+        // Ambient occlusion. Two-sided vertices send every other ray out of the back.
+        float visible = 0.0f;
+        for (int j = 0; j < NumAoRays; j++) {
+            float x = c * sampleDirs[j][0] - s * sampleDirs[j][1];
+            float y = s * sampleDirs[j][0] + c * sampleDirs[j][1];
+            float z = (job.twoSided && (j & 1)) ? -sampleDirs[j][2] : sampleDirs[j][2];
+            float side = (z < 0.0f) ? -RayOffset : RayOffset;
+            float origin[3], dir[3];
+            for (int k = 0; k < 3; k++) {
+                dir[k] = x * t[k] + y * b[k] + z * n[k];
+                origin[k] = p[k] + side * n[k];
+            }
+            visible += RayVisibility(*job.grid, origin, dir, AoDistance, job.ignoreTrunks);
+        }
+        job.baked[2 * i] = MinAmbient + (1.0f - MinAmbient) * visible / NumAoRays;
+        rays += NumAoRays;
+
+        // Direct light, with its shadow
+        float nDotL = n[0] * lightDir[0] + n[1] * lightDir[1] + n[2] * lightDir[2];
+        float side = (nDotL < 0.0f) ? -RayOffset : RayOffset;
+        if (job.twoSided) {
+            nDotL = fabsf(nDotL);
+        }
+        if (nDotL > 0.0f) {
+            float origin[3];
+            for (int k = 0; k < 3; k++) {
+                origin[k] = p[k] + side * n[k];
+            }
+            nDotL *= RayVisibility(*job.grid, origin, lightDir, ShadowDistance, job.ignoreTrunks);
+            rays++;
+        }
+        job.baked[2 * i + 1] = nDotL > 0.0f ? nDotL : 0.0f;
+    }
+    return rays;
+}
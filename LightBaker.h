@@ -0,0 +1,96 @@
+//
+// LightBaker.h
+//
+// Bakes the static lighting into two numbers per vertex, on worker threads, with rays cast through an ObstacleGrid.
+//
+//   The static light is light 0 of PhongData.cpp. It is far from the trees
+//   compared with their size, so it is baked as a directional light
+//   (SetLightDirection()). For each vertex:
+//     - the ambient occlusion: the fraction of NumAoRays rays, spread over
+//       the hemisphere about the normal with a cosine weighting, that get
+//       AoDistance away without meeting a tree; no lower than MinAmbient;
+//     - the direct light: N.L, times the light let through along a ray toward the light.
+//   A ray whose first hit is the leaves of a tree lets LeafTransmittance through:
+//   the cones of the obstacle grid stand for foliage, not for solid walls.
+//   Two-sided vertices (the leaf cards) are lit from both sides: their rays
+//   cover the whole sphere, and their direct light is |N.L|.
+//
+//   The calcPhongLightingBaked code block (MyShaders.glsl) uses the two numbers
+//   for the ambient and diffuse terms of the baked lights, so only their
+//   specular term, and the lights that are not baked, are lit per fragment.
+//
+//   The queries of an ObstacleGrid change nothing, so the jobs run on
+//   several threads at once, each baking whole meshes.
+//
+// How to use:
+//    * SetLightDirection() once, before any bake.
+//    * Start() with the jobs. Their vertices, grids and outputs must stay put until the bake is done.
+//    * Call Update() once per frame. It returns true once all the jobs are done.
+//    * GetMilliseconds() and GetNumRays() for the statistics.
+//    * Call Shutdown() before exiting, to wait for any worker threads.
+//
+
+#pragma once
+#ifndef LIGHT_BAKER_H
+#define LIGHT_BAKER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class ObstacleGrid;
+
+class LightBaker {
+public:
+    static const int NumAoRays = 24;
+    static constexpr float AoDistance = 10.0f;
+    static constexpr float MinAmbient = 0.25f;
+    static constexpr float ShadowDistance = 60.0f;
+    static constexpr float LeafTransmittance = 0.35f;
+    static constexpr float RayOffset = 0.02f;       // Rays start this far off the surface
+
+    // A mesh to bake: vertices of "stride" floats, starting with the position and the normal.
+    struct Job {
+        const ObstacleGrid* grid;
+        const float* verts;
+        int numVerts;
+        int stride;
+        float scale[3];             // The positions are scaled by these, to fit the mesh to the grid's trees
+        bool twoSided;
+        bool ignoreTrunks;          // For a tree's own vertices: its trunk, in the grid, would hide them
+        float* baked;               // Two floats per vertex: ambient occlusion, direct light
+    };
+
+    // dir points toward the light, in the grid's coordinates.
+    static void SetLightDirection(float x, float y, float z);
+    static const float* GetLightDirection() { return lightDir; }
+
+    void Start(const std::vector<Job>& jobs);
+    bool Update();
+    bool IsBaking() const { return !workers.empty(); }
+    bool IsDone() const { return done; }
+    void Shutdown();
+
+    double GetMilliseconds() const { return milliseconds; }
+    uint64_t GetNumRays() const { return numRays; }
+
+    // Bakes one job on the calling thread. Returns the number of rays cast.
+    static uint64_t Bake(const Job& job);
+
+private:
+    void WorkerMain();
+
+    static float lightDir[3];
+
+    std::vector<Job> jobs;
+    std::vector<std::thread> workers;
+    std::atomic<int> nextJob{ 0 };
+    std::atomic<int> numJobsDone{ 0 };
+    std::atomic<uint64_t> numRays{ 0 };
+    double startTime = 0.0;
+    double milliseconds = 0.0;
+    bool done = false;
+};
+
+#endif  // LIGHT_BAKER_H
@@ -0,0 +1,52 @@
+//
+// MappedFile.h
+//
+// Read-only memory mapping of an entire file.
+//   Uses CreateFileMapping/MapViewOfFile on Windows, and mmap elsewhere.
+//
+
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    // Map the file for reading. Returns false if the file cannot be opened or mapped.
+    //    An empty file cannot be mapped.
+    bool Open(const char* filename);
+    void Close();
+
+    bool IsOpen() const { return data != 0; }
+    const void* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // Pointer to the data at a byte offset, or null if [offset, offset+numBytes) is not in the file.
+    const void* DataAt(size_t offset, size_t numBytes) const;
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* data = 0;
+    size_t size = 0;
+#if defined(_WIN32)
+    void* fileHandle = 0;
+    void* mappingHandle = 0;
+#endif
+};
+
+inline const void* MappedFile::DataAt(size_t offset, size_t numBytes) const
+{
+    if (data == 0 || offset > size || numBytes > size - offset) {
+        return 0;
+    }
+    return (const char*)data + offset;
+}
+
+#endif  // MAPPED_FILE_H
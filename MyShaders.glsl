@@ -71,3 +71,1050 @@ bool InFshape( vec2 pos ) {
 	return true;
 }
 #endglsl
+
+// *****************************
+// windSway - code block
+//    WindSway() sways a vertex in the wind, for the leaves and branches of trees.
+//    All the work is done in the vertex shader, so the whole forest animates
+//    with no per-tree buffer updates.
+//    Inputs:
+//        - pos: the vertex position in model coordinates
+//        - phase: offsets the sway, so trees do not move in lockstep
+//        - CurrentTime() (in the phFrame code block): the animation time, in seconds
+//        - windParams (uniform): x = amplitude, y = height (in model coordinates)
+//             where the sway is zero, z = 1/height of the swaying part.
+//    The sway grows with the square of the height above windParams.y,
+//        so trunks stay planted and tops move the most.
+// *****************************
+#beginglsl codeblock windSway
+uniform vec3 windParams;
+
+const vec3 windDirection = vec3(0.894, 0.0, 0.447);    // Unit vector, horizontal
+
+float CurrentTime();    // In the phFrame code block
+
+vec3 WindSway(vec3 pos, float phase)
+{
+    float h = clamp((pos.y - windParams.y) * windParams.z, 0.0, 1.0);
+    float gust = 0.7 * sin(1.7 * CurrentTime() + phase)
+               + 0.3 * sin(3.1 * CurrentTime() + 1.3 * phase);
+    return pos + (windParams.x * h * h * gust) * windDirection;
+}
+#endglsl
+
+// *****************************
+// applyTextureMapAlphaTest - code block
+//    Replaces applyTextureMap for the leaf cards: an RGBA texture, whose
+//        alpha channel cuts out the shape of the leaves.
+//    alphaToCoverage (uniform) is true when alpha to coverage is enabled,
+//        with multisampling. The alpha is then sharpened to about one pixel
+//        of transition, so the edges are antialiased but not blurry.
+//        Otherwise fragments with alpha below one half are discarded.
+// *****************************
+#beginglsl codeblock applyTextureMapAlphaTest
+
+uniform sampler2D theTextureMap;
+uniform bool alphaToCoverage;
+
+vec4 applyTextureFunction()
+{
+    vec4 texColor = texture(theTextureMap, theTexCoords);
+    float alpha = texColor.a;
+    if ( alphaToCoverage ) {
+        alpha = clamp((alpha - 0.5) / max(fwidth(alpha), 0.0001) + 0.5, 0.0, 1.0);
+    }
+    else if ( alpha < 0.5 ) {
+        discard;
+    }
+    return vec4(nonspecColor*texColor.rgb + specularColor, alpha);
+}
+#endglsl
+
+// *****************************
+// vertexShader_Wind - vertex shader
+//    The same as vertexShader_PhongPhong, but sways the vertices in the wind.
+//    Compile it with the windSway code block.
+//    windPhase (uniform) is the phase of the tree being drawn.
+// *****************************
+#beginglsl vertexshader vertexShader_Wind
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+uniform float windPhase;
+
+vec3 WindSway(vec3 pos, float phase);   // In the windSway code block
+
+void main()
+{
+    vec4 mvPos4 = modelviewMatrix * vec4(WindSway(vertPos, windPhase), 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormalFront = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); // Unit normal from the surface 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+}
+#endglsl
+
+// *****************************
+// vertexShader_WindGouraud - vertex shader
+//    The same as vertexShader_PhongGouraud, but sways the vertices in the wind:
+//    the trees of vertexShader_Wind, lit per vertex, for the shading level of detail.
+//    Compile it with the windSway and calcPhongLighting code blocks, and link it
+//    with fragmentShader_PhongGouraud.
+// *****************************
+#beginglsl vertexshader vertexShader_WindGouraud
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+
+out vec3 nonspecColor;  
+out vec3 specularColor;  
+out vec2 theTexCoords;
+
+layout (std140) uniform phGlobal { 
+    vec3 GlobalAmbientColor;        // Global ambient light color 
+    int NumLights;                  // Number of lights 
+    bool LocalViewer;               // true for local viewer; false for directional viewer 
+    bool EnableEmissive;            // Control whether emissive colors are rendered 
+    bool EnableDiffuse;             // Control whether diffuse colors are rendered 
+    bool EnableAmbient;             // Control whether ambient colors are rendered 
+    bool EnableSpecular;            // Control whether specular colors are rendered 
+	bool UseHalfwayVector;			// Control whether halfway vector is used.
+};
+
+const int MaxLights = 8;         // The maximum number of lights (must match value in C++ code)
+struct phLight { 
+    bool IsEnabled;             // True if light is turned on 
+    bool IsAttenuated;          // True if attenuation is active 
+    bool IsSpotLight;           // True if spotlight 
+    bool IsDirectional;         // True if directional 
+    vec3 Position; 
+    vec3 AmbientColor; 
+    vec3 DiffuseColor; 
+    vec3 SpecularColor; 
+    vec3 SpotDirection;         // Should be unit vector! 
+    float SpotCosCutoff;        // Cosine of cutoff angle 
+    float SpotExponent; 
+    float ConstantAttenuation; 
+    float LinearAttenuation; 
+    float QuadraticAttenuation; 
+};
+layout (std140) uniform phLightArray { 
+    phLight Lights[MaxLights];
+};
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+uniform float windPhase;
+
+vec3 mvPos;   // Vertex position in modelview coordinates
+vec3 mvNormal; // Normal vector to vertex in modelview coordinates
+vec3 matEmissive;
+vec3 matAmbient;
+vec3 matDiffuse;
+vec3 matSpecular;
+float matSpecExponent;
+float useFresnel;
+const float ambientOcclusion = 1.0;   // No screen-space ambient occlusion at the vertices
+void CalculatePhongLighting();
+vec3 WindSway(vec3 pos, float phase);   // In the windSway code block
+
+void main()
+{
+    vec4 mvPos4 = modelviewMatrix * vec4(WindSway(vertPos, windPhase), 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormal = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords; 
+    useFresnel = UseFresnel;
+	
+    CalculatePhongLighting();  // Calculates nonspecColor and specularColor. 
+} 
+#endglsl
+
+// *****************************
+// vertexShader_WindInstanced - vertex shader
+//    The same as vertexShader_Wind, for instanced drawing of the tree variants:
+//    the position and wind phase of each tree come from an instanced attribute,
+//    written by computeShader_TreeCull. Compile it with the windSway code block.
+//    modelviewMatrix holds the view matrix with the player's offset; it must not rotate or scale.
+// *****************************
+#beginglsl vertexshader vertexShader_WindInstanced
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+layout (location = 9) in vec4 treeInstance;    // x, z, wind phase, variant: one per instance
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+
+vec3 WindSway(vec3 pos, float phase);   // In the windSway code block
+
+void main()
+{
+    vec3 pos = WindSway(vertPos, treeInstance.z) + vec3(treeInstance.x, 0.0, treeInstance.y);
+    vec4 mvPos4 = modelviewMatrix * vec4(pos, 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormalFront = normalize(mat3(modelviewMatrix)*vertNormal); // Unit normal from the surface 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+}
+#endglsl
+
+// *****************************
+// calcPhongLightingBaked - code block
+//    Replaces calcPhongLighting for the meshes with baked lighting (see LightBaker.h).
+//    The first NumBakedLights lights, and the global ambient light, are baked:
+//        bakedLight.x (interpolated from the vertex shader) is the ambient
+//        occlusion, and bakedLight.y the diffuse factor, N.L with the shadows.
+//        Only their specular term is calculated here, and none where the bake is in shadow.
+//    The other lights, the dynamic ones, are calculated in full, as in calcPhongLighting.
+// *****************************
+#beginglsl codeblock calcPhongLightingBaked
+in vec2 bakedLight;
+uniform int NumBakedLights;
+
+void CalculatePhongLighting() { 
+    nonspecColor = vec3(0.0, 0.0, 0.0);  
+    specularColor = vec3(0.0, 0.0, 0.0);  
+    if ( EnableEmissive ) { 
+       nonspecColor = matEmissive; 
+    }
+    if ( EnableAmbient ) { 
+         nonspecColor += ambientOcclusion*matAmbient*GlobalAmbientColor*bakedLight.x; 
+    } 
+    vec3 vVector = LocalViewer ? -mvPos : vec3(0.0, 0.0, 1.0);
+    vVector = normalize(vVector);
+    for ( int i=0; i<NumLights; i++ ) {
+        if ( !Lights[i].IsEnabled ) { 
+            continue;
+        }
+        bool isBaked = (i < NumBakedLights);
+        vec3 nonspecColorLt = vec3(0.0, 0.0, 0.0);        
+        vec3 specularColorLt = vec3(0.0, 0.0, 0.0);
+        vec3 ellVector = -Lights[i].Position;  
+        if ( !Lights[i].IsDirectional ) {
+            ellVector = -(ellVector + mvPos);
+        }
+        ellVector = normalize(ellVector); 
+        float dotEllNormal = dot(ellVector, mvNormal); 
+        float diffuseFactor = isBaked ? bakedLight.y : max(dotEllNormal, 0.0);
+        float spotAtten = 1.0;
+        if ( Lights[i].IsSpotLight && !isBaked ) {
+            float spotCosine = -dot(ellVector,Lights[i].SpotDirection);
+            spotAtten = (spotCosine > Lights[i].SpotCosCutoff) ? pow(spotCosine,Lights[i].SpotExponent) : 0.0;
+        }
+        if ( EnableDiffuse ) { 
+            nonspecColorLt += matDiffuse*Lights[i].DiffuseColor*diffuseFactor; 
+        } 
+        if ( EnableSpecular && dotEllNormal > 0.0 && diffuseFactor > 0.0 ) { 
+            float specFactor = 0.0;
+            if ( UseHalfwayVector ) {
+                vec3 hVector = normalize(ellVector+vVector);
+                specFactor = pow( max(dot(hVector,mvNormal), 0.0), matSpecExponent );
+            }
+            else {
+                vec3 rVector = 2.0*dotEllNormal*mvNormal - ellVector;
+                float rDotV = dot(vVector, rVector); 
+                if ( rDotV>0.0 ) {
+                    specFactor = pow( rDotV, matSpecExponent);
+                }
+            }
+            vec3 matspec = matSpecular;
+            if ( useFresnel!=0.0 ) {
+                float d = 1.0 - dotEllNormal;
+                float dd = d*d;
+                matspec = mix(matSpecular, vec3(1.0,1.0,1.0), dd*dd*d*useFresnel);
+            }
+            specularColorLt += specFactor*matspec*Lights[i].SpecularColor; 
+        }
+        nonspecColorLt *= spotAtten; 
+        specularColorLt *= spotAtten;
+        if ( EnableAmbient ) { 
+            nonspecColorLt += ambientOcclusion*matAmbient*Lights[i].AmbientColor*(isBaked ? bakedLight.x : 1.0); 
+        } 
+        if ( Lights[i].IsAttenuated ) { 
+            float dist = distance(mvPos,Lights[i].Position); 
+            float atten = 1.0/(Lights[i].ConstantAttenuation + (Lights[i].LinearAttenuation + Lights[i].QuadraticAttenuation*dist)*dist);
+            nonspecColorLt *= atten; 
+            specularColorLt *= atten;
+        } 
+        nonspecColor += nonspecColorLt;
+        specularColor += specularColorLt;
+    }
+}
+#endglsl
+
+// *****************************
+// vertexShader_Baked - vertex shader
+//    The same as vertexShader_PhongPhong, with the baked lighting of each vertex
+//    in attribute location 10, passed on to the calcPhongLightingBaked code block.
+//    For the terrain chunks (see TerrainChunks.h).
+// *****************************
+#beginglsl vertexshader vertexShader_Baked
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+layout (location = 10) in vec2 BakedLight;     // Ambient occlusion, and diffuse factor (see LightBaker.h)
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+out vec2 bakedLight;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+
+void main()
+{
+    vec4 mvPos4 = modelviewMatrix * vec4(vertPos, 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormalFront = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); // Unit normal from the surface 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+    bakedLight = BakedLight;
+}
+#endglsl
+
+// *****************************
+// vertexShader_WindBaked - vertex shader
+//    The same as vertexShader_Wind, with the baked lighting of vertexShader_Baked.
+//    For the tree variants, once TreeVariantPool::IsBaked(). Compile it with the windSway code block.
+// *****************************
+#beginglsl vertexshader vertexShader_WindBaked
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+layout (location = 10) in vec2 BakedLight;     // Ambient occlusion, and diffuse factor (see LightBaker.h)
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+out vec2 bakedLight;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+uniform float windPhase;
+
+vec3 WindSway(vec3 pos, float phase);   // In the windSway code block
+
+void main()
+{
+    vec4 mvPos4 = modelviewMatrix * vec4(WindSway(vertPos, windPhase), 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormalFront = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); // Unit normal from the surface 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+    bakedLight = BakedLight;
+}
+#endglsl
+
+// *****************************
+// vertexShader_WindInstancedBaked - vertex shader
+//    The same as vertexShader_WindInstanced, with the baked lighting of vertexShader_Baked.
+//    Compile it with the windSway code block.
+// *****************************
+#beginglsl vertexshader vertexShader_WindInstancedBaked
+#version 330 core
+layout (location = 0) in vec3 vertPos;         // Position in attribute location 0
+layout (location = 1) in vec3 vertNormal;      // Surface normal in attribute location 1
+layout (location = 2) in vec2 vertTexCoords;   // Texture coordinates in attribute location 2
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties 
+layout (location = 4) in vec3 AmbientColor; 
+layout (location = 5) in vec3 DiffuseColor; 
+layout (location = 6) in vec3 SpecularColor; 
+layout (location = 7) in float SpecularExponent; 
+layout (location = 8) in float UseFresnel;		// Should be 1.0 (for Fresnel) or 0.0 (for no Fresnel)
+layout (location = 9) in vec4 treeInstance;    // x, z, wind phase, variant: one per instance
+layout (location = 10) in vec2 BakedLight;     // Ambient occlusion, and diffuse factor (see LightBaker.h)
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+out vec2 bakedLight;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+invariant gl_Position;        // As in vertexShader_PhongPhong
+uniform mat4 modelviewMatrix;         // The modelview matrix
+
+vec3 WindSway(vec3 pos, float phase);   // In the windSway code block
+
+void main()
+{
+    vec3 pos = WindSway(vertPos, treeInstance.z) + vec3(treeInstance.x, 0.0, treeInstance.y);
+    vec4 mvPos4 = modelviewMatrix * vec4(pos, 1.0); 
+    gl_Position = ApplyProjection(mvPos4); 
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w; 
+    mvNormalFront = normalize(mat3(modelviewMatrix)*vertNormal); // Unit normal from the surface 
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+    bakedLight = BakedLight;
+}
+#endglsl
+
+// *****************************
+// computeShader_TreeCull - compute shader (OpenGL 4.3)
+//    Culls the tree instances, and fills in the instance counts of the
+//    indirect draw commands. See TreeGpuCuller.h.
+//    One work group per chunk of trees: a chunk whose box is culled is skipped
+//    as a whole. Each visible tree is appended to the visible instance list of
+//    its variant's leaves, and of its bark if it is near enough (distance LOD).
+//    The Hi-Z test mirrors HiZCuller::IsVisible(), on a copy of its pyramid.
+// *****************************
+#beginglsl computeshader computeShader_TreeCull
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct TreeChunk {
+    vec4 boxMin;            // Bounding box of the chunk's trees (w unused)
+    vec4 boxMax;
+    uint firstInstance;
+    uint numInstances;
+    uint pad0, pad1;
+};
+
+struct DrawCommand {        // As read by glMultiDrawElementsIndirect()
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer TreeInstances { vec4 instances[]; };    // x, z, wind phase, variant
+layout (std430, binding = 1) readonly buffer TreeChunks { TreeChunk chunks[]; };
+layout (std430, binding = 2) readonly buffer VariantBounds { vec4 variantBounds[]; };  // Min and max of each variant
+layout (std430, binding = 3) buffer DrawCommands { DrawCommand commands[]; };     // Bark, then leaves
+layout (std430, binding = 4) writeonly buffer VisibleInstances { vec4 visibleInstances[]; };
+
+uniform mat4 viewProj;          // Projection times modelview: from tree coordinates to clip coordinates
+uniform uint numVariants;
+uniform float barkLodDistance;  // Bark is not drawn beyond this distance
+uniform bool useHiZ;
+uniform sampler2D hiZ;          // Maximum depths (clip w), one mipmap level per pyramid level
+
+// Like HiZCuller::IsVisible(). Also returns the nearest depth of the box.
+bool IsBoxVisible(vec3 boxMin, vec3 boxMax, out float nearest)
+{
+    vec2 sMin = vec2(1.0e30);
+    vec2 sMax = vec2(-1.0e30);
+    bool beyondFar = true;
+    nearest = 1.0e30;
+    for (int c = 0; c < 8; c++) {
+        vec3 p = vec3((c & 1) != 0 ? boxMax.x : boxMin.x, (c & 2) != 0 ? boxMax.y : boxMin.y, (c & 4) != 0 ? boxMax.z : boxMin.z);
+        vec4 clip = viewProj * vec4(p, 1.0);
+        if (clip.w < 0.01) {
+            nearest = 0.0;
+            return true;        // Reaches behind the camera: assume visible
+        }
+        sMin = min(sMin, clip.xy / clip.w);
+        sMax = max(sMax, clip.xy / clip.w);
+        beyondFar = beyondFar && (clip.z > clip.w);
+        nearest = min(nearest, clip.w);
+    }
+    if (beyondFar || any(greaterThan(sMin, vec2(1.0))) || any(lessThan(sMax, vec2(-1.0)))) {
+        return false;
+    }
+    if (!useHiZ) {
+        return true;
+    }
+
+    // Go up the pyramid until the rectangle spans at most 2x2 texels.
+    vec2 size = vec2(textureSize(hiZ, 0));
+    ivec2 p0 = ivec2(clamp(floor((sMin * 0.5 + 0.5) * size), vec2(0.0), size - 1.0));
+    ivec2 p1 = ivec2(clamp(floor((sMax * 0.5 + 0.5) * size), vec2(0.0), size - 1.0));
+    int numLevels = textureQueryLevels(hiZ);
+    int k = 0;
+    while (k < numLevels - 1 && (p1.x - p0.x > 1 || p1.y - p0.y > 1)) {
+        p0 >>= 1;
+        p1 >>= 1;
+        k++;
+    }
+    for (int j = p0.y; j <= p1.y; j++) {
+        for (int i = p0.x; i <= p1.x; i++) {
+            if (texelFetch(hiZ, ivec2(i, j), k).r >= nearest) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void AppendInstance(uint command, vec4 instance)
+{
+    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+    visibleInstances[commands[command].baseInstance + slot] = instance;
+}
+
+void main()
+{
+    TreeChunk chunk = chunks[gl_WorkGroupID.x];
+    float nearest;
+    if (!IsBoxVisible(chunk.boxMin.xyz, chunk.boxMax.xyz, nearest)) {
+        return;                 // The same for the whole work group
+    }
+    for (uint i = gl_LocalInvocationID.x; i < chunk.numInstances; i += gl_WorkGroupSize.x) {
+        vec4 instance = instances[chunk.firstInstance + i];
+        uint variant = uint(instance.w);
+        vec3 base = vec3(instance.x, 0.0, instance.y);
+        if (!IsBoxVisible(base + variantBounds[2u * variant].xyz, base + variantBounds[2u * variant + 1u].xyz, nearest)) {
+            continue;
+        }
+        AppendInstance(numVariants + variant, instance);
+        if (nearest < barkLodDistance) {
+            AppendInstance(variant, instance);
+        }
+    }
+}
+#endglsl
+
+// *****************************
+// fragmentShader_DepthOnly - fragment shader
+//    For the depth prepass: link it with any of the vertex shaders above.
+//    Nothing is computed, only the depth is written.
+// *****************************
+#beginglsl fragmentshader fragmentShader_DepthOnly
+#version 330 core
+
+void main()
+{
+}
+#endglsl
+
+// *****************************
+// postVersion - code block
+//    The #version line of fragmentShader_Post: it must come before the
+//        code block of #defines that selects the post effects.
+// *****************************
+#beginglsl codeblock postVersion
+#version 330 core
+#endglsl
+
+// *****************************
+// vertexShader_Fullscreen - vertex shader
+//    A triangle covering the window, made from gl_VertexID: draw three
+//        vertices with no vertex attributes.
+// *****************************
+#beginglsl vertexshader vertexShader_Fullscreen
+#version 330 core
+
+void main()
+{
+    vec2 pos = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
+#endglsl
+
+// *****************************
+// fragmentShader_Post - fragment shader
+//    All the post effects in one pass (see PostProcess.h). Compile it as
+//        postVersion, a code block of #defines, then this shader.
+//    POST_MSAA: sceneColor is multisampled, with numSamples samples. Each
+//        sample is tonemapped, then they are averaged: the resolve.
+//    POST_UPSCALE: sceneColor is smaller than the window, and is upscaled
+//        with a Catmull-Rom filter.
+//    POST_TONEMAP, POST_GRADE, POST_VIGNETTE, POST_FXAA: the effects.
+// *****************************
+#beginglsl fragmentshader fragmentShader_Post
+
+#ifdef POST_MSAA
+uniform sampler2DMS sceneColor;
+uniform int numSamples;
+#else
+uniform sampler2D sceneColor;
+#endif
+uniform vec2 sourceSize;        // Size of sceneColor, in texels
+uniform vec2 outputSize;        // Size of the window, in pixels
+
+out vec4 fragmentColor;
+
+const float toneKnee = 0.8;                     // Colors below this are not changed by the tonemapping
+const float glareThreshold = 0.75;              // Luma where the snow glare starts
+const vec3 glareTint = vec3(0.92, 0.97, 1.06);  // Cool tint of the glare
+const float glareDesaturate = 0.35;
+const float contrast = 1.06;
+const float vignetteStrength = 0.35;
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+// Compresses the brightest channel above toneKnee smoothly towards 1, keeping the hue.
+vec3 tonemap(vec3 c)
+{
+    c = max(c, vec3(0.0));
+#ifdef POST_TONEMAP
+    float m = max(c.r, max(c.g, c.b));
+    if (m > toneKnee) {
+        float range = 1.0 - toneKnee;
+        float mapped = toneKnee + range * (1.0 - exp(-(m - toneKnee) / range));
+        c *= mapped / m;
+    }
+    return c;
+#else
+    return min(c, vec3(1.0));
+#endif
+}
+
+#ifndef POST_MSAA
+vec3 sceneAt(vec2 uv)       // Bilinear, tonemapped
+{
+    return tonemap(texture(sceneColor, uv).rgb);
+}
+
+// Catmull-Rom from five bilinear lookups (the four corner taps, with small weights, are dropped).
+vec3 sceneUpscaled(vec2 uv)
+{
+    vec2 pos = uv * sourceSize;
+    vec2 center = floor(pos - 0.5) + 0.5;
+    vec2 f = pos - center;
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+    vec2 texel = 1.0 / sourceSize;
+    vec2 tc0 = (center - 1.0) * texel;
+    vec2 tc12 = (center + w2 / w12) * texel;
+    vec2 tc3 = (center + 2.0) * texel;
+    float wt0 = w12.x * w0.y;
+    float wl0 = w0.x * w12.y;
+    float wc = w12.x * w12.y;
+    float wr3 = w3.x * w12.y;
+    float wb3 = w12.x * w3.y;
+    vec3 c = texture(sceneColor, vec2(tc12.x, tc0.y)).rgb * wt0
+           + texture(sceneColor, vec2(tc0.x, tc12.y)).rgb * wl0
+           + texture(sceneColor, tc12).rgb * wc
+           + texture(sceneColor, vec2(tc3.x, tc12.y)).rgb * wr3
+           + texture(sceneColor, vec2(tc12.x, tc3.y)).rgb * wb3;
+    return tonemap(c / (wt0 + wl0 + wc + wr3 + wb3));
+}
+#endif
+
+#ifdef POST_FXAA
+// FXAA, in the style of the original "PC console" version: blurs along the
+//    edge direction found from the lumas of the four diagonal neighbors.
+vec3 fxaa(vec2 uv, vec3 rgbM)
+{
+    const float reduceMin = 1.0 / 128.0;
+    const float reduceMul = 1.0 / 8.0;
+    const float spanMax = 8.0;
+    vec2 texel = 1.0 / sourceSize;
+    float lumaNW = luma(sceneAt(uv + vec2(-1.0, -1.0) * texel));
+    float lumaNE = luma(sceneAt(uv + vec2(1.0, -1.0) * texel));
+    float lumaSW = luma(sceneAt(uv + vec2(-1.0, 1.0) * texel));
+    float lumaSE = luma(sceneAt(uv + vec2(1.0, 1.0) * texel));
+    float lumaM = luma(rgbM);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(1.0 / 32.0, lumaMax * 0.125)) {
+        return rgbM;            // Not an edge
+    }
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * reduceMul), reduceMin);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-spanMax), vec2(spanMax)) * texel;
+    vec3 rgbA = 0.5 * (sceneAt(uv + dir * (1.0 / 3.0 - 0.5)) + sceneAt(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = 0.5 * rgbA + 0.25 * (sceneAt(uv - 0.5 * dir) + sceneAt(uv + 0.5 * dir));
+    float lumaB = luma(rgbB);
+    return (lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB;
+}
+#endif
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / outputSize;
+    vec3 color;
+#if defined(POST_MSAA)
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    color = vec3(0.0);
+    for (int i = 0; i < numSamples; i++) {
+        color += tonemap(texelFetch(sceneColor, texel, i).rgb);
+    }
+    color /= float(numSamples);
+#elif defined(POST_UPSCALE)
+    color = sceneUpscaled(uv);
+#else
+    color = tonemap(texelFetch(sceneColor, ivec2(gl_FragCoord.xy), 0).rgb);
+#endif
+#ifdef POST_FXAA
+    color = fxaa(uv, color);
+#endif
+
+#ifdef POST_GRADE
+    // Snow glare: the brightest areas turn cooler and less saturated.
+    float y = luma(color);
+    float glare = smoothstep(glareThreshold, 1.0, y);
+    color = mix(color, vec3(y), glare * glareDesaturate) * mix(vec3(1.0), glareTint, glare);
+    color = (color - 0.5) * contrast + 0.5;
+#endif
+#ifdef POST_VIGNETTE
+    vec2 d = (uv - 0.5) * vec2(outputSize.x / outputSize.y, 1.0);
+    color *= 1.0 - vignetteStrength * smoothstep(0.45, 1.1, length(d));
+#endif
+
+    fragmentColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
+#endglsl
+
+// *****************************
+// ssaoCommon - code block
+//    For fragmentShader_Ssao and fragmentShader_SsaoUpsample (see Ssao.h). Compile
+//        them as postVersion, a code block of #defines, this code block, then the shader.
+//    SSAO_SAMPLES: the number of samples of the occlusion.
+//    SSAO_UPSAMPLE: the width of the upsample, in half resolution texels: 2 or 4.
+//    SSAO_MSAA: sceneDepth is multisampled. Its first sample is used.
+// *****************************
+#beginglsl codeblock ssaoCommon
+#ifdef SSAO_MSAA
+uniform sampler2DMS sceneDepth;
+#else
+uniform sampler2D sceneDepth;
+#endif
+uniform vec4 projInfo;          // Projection matrix entries (0,0) and (1,1), near and far distances
+uniform vec4 viewRect;          // The view in the scene targets: x, y, width, height
+
+// The distance in front of the camera of a texel of the scene depth: the far distance where nothing was drawn.
+float sceneDistance(ivec2 texel)
+{
+    float d = texelFetch(sceneDepth, texel, 0).r;
+    return projInfo.z * projInfo.w / (projInfo.w - d * (projInfo.w - projInfo.z));
+}
+
+// The position, in view coordinates, of a point at texel coordinates p and at a distance in front of the camera.
+vec3 viewPosition(vec2 p, float dist)
+{
+    vec2 ndc = 2.0 * (p - viewRect.xy) / viewRect.zw - 1.0;
+    return vec3(ndc.x * dist / projInfo.x, ndc.y * dist / projInfo.y, -dist);
+}
+
+vec3 viewPositionAt(ivec2 texel)
+{
+    return viewPosition(vec2(texel) + 0.5, sceneDistance(texel));
+}
+#endglsl
+
+// *****************************
+// fragmentShader_Ssao - fragment shader
+//    The occlusion of a half resolution pixel, from the scene depth, and its distance.
+// *****************************
+#beginglsl fragmentshader fragmentShader_Ssao
+
+uniform vec3 aoParams;          // Radius, bias and strength
+
+out vec2 occlusionAndDistance;
+
+// The ordered dither that turns the samples: each block of SSAO_UPSAMPLE texels has every angle once.
+#if SSAO_UPSAMPLE == 2
+const int ditherSize = 2;
+const float dither[4] = float[4](0.0, 2.0, 3.0, 1.0);
+#else
+const int ditherSize = 4;
+const float dither[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+#endif
+
+void main()
+{
+    ivec2 lo = ivec2(viewRect.xy);
+    ivec2 hi = lo + ivec2(viewRect.zw) - 1;
+    ivec2 texel = clamp(2 * ivec2(gl_FragCoord.xy), lo, hi);
+    float dist = sceneDistance(texel);
+    if (dist >= 0.999 * projInfo.w) {
+        occlusionAndDistance = vec2(1.0, dist);     // Nothing drawn
+        return;
+    }
+    vec3 pos = viewPosition(vec2(texel) + 0.5, dist);
+
+    // The normal, from the neighbors on the side where the depth changes least: not across a silhouette.
+    vec3 left = viewPositionAt(max(texel - ivec2(1, 0), lo));
+    vec3 right = viewPositionAt(min(texel + ivec2(1, 0), hi));
+    vec3 down = viewPositionAt(max(texel - ivec2(0, 1), lo));
+    vec3 up = viewPositionAt(min(texel + ivec2(0, 1), hi));
+    bool useRight = texel.x < hi.x && (texel.x == lo.x || abs(right.z - pos.z) < abs(left.z - pos.z));
+    bool useUp = texel.y < hi.y && (texel.y == lo.y || abs(up.z - pos.z) < abs(down.z - pos.z));
+    vec3 normal = normalize(cross(useRight ? right - pos : pos - left, useUp ? up - pos : pos - down));
+    vec3 tangent = normalize(cross(normal, abs(normal.x) < 0.6 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+    vec3 bitangent = cross(normal, tangent);
+
+    ivec2 d = ivec2(gl_FragCoord.xy) % ditherSize;
+    float turn = (dither[d.y * ditherSize + d.x] + 0.5) / float(ditherSize * ditherSize);
+    float occlusion = 0.0;
+    for (int i = 0; i < SSAO_SAMPLES; i++) {
+        // Cosine weighted over the hemisphere, along a spiral; more samples near the pixel
+        float u = (float(i) + 0.5) / float(SSAO_SAMPLES);
+        float phi = 6.2831853 * turn + 2.3999632 * float(i);
+        float r = sqrt(u);
+        vec3 dir = r * cos(phi) * tangent + r * sin(phi) * bitangent + sqrt(1.0 - u) * normal;
+        float scale = fract(0.618034 * float(i) + turn);
+        vec3 s = pos + aoParams.x * mix(0.1, 1.0, scale * scale) * dir;
+
+        vec2 ndc = vec2(s.x * projInfo.x, s.y * projInfo.y) / -s.z;
+        ivec2 sampleTexel = clamp(ivec2(viewRect.xy + (0.5 * ndc + 0.5) * viewRect.zw), lo, hi);
+        float sampleDist = sceneDistance(sampleTexel);
+        float inRange = smoothstep(0.0, 1.0, aoParams.x / (abs(dist - sampleDist) + 1.0e-4));
+        occlusion += (sampleDist < -s.z - aoParams.y) ? inRange : 0.0;
+    }
+    occlusionAndDistance = vec2(clamp(1.0 - aoParams.z * occlusion / float(SSAO_SAMPLES), 0.0, 1.0), dist);
+}
+#endglsl
+
+// *****************************
+// fragmentShader_SsaoUpsample - fragment shader
+//    The occlusion of a scene pixel: the half resolution occlusion around it,
+//        weighted by distance in the texture and by the difference of depth.
+// *****************************
+#beginglsl fragmentshader fragmentShader_SsaoUpsample
+
+uniform sampler2D rawAo;        // From fragmentShader_Ssao
+uniform ivec4 halfRect;         // The view in rawAo: its lowest and highest texels
+uniform float depthFalloff;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    float dist = sceneDistance(ivec2(gl_FragCoord.xy));
+    if (dist >= 0.999 * projInfo.w) {
+        fragmentColor = vec4(1.0);
+        return;
+    }
+    vec2 center = (gl_FragCoord.xy - 0.5) * 0.5;       // In rawAo texels
+    ivec2 base = ivec2(floor(center));
+    const int r = SSAO_UPSAMPLE / 2;
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int j = 1 - r; j <= r; j++) {
+        for (int i = 1 - r; i <= r; i++) {
+            ivec2 t = base + ivec2(i, j);
+            vec2 v = texelFetch(rawAo, clamp(t, halfRect.xy, halfRect.zw), 0).rg;
+            vec2 tent = float(r) - abs(vec2(t) - center);
+            float w = tent.x * tent.y * exp(-depthFalloff * abs(v.y - dist) / dist);
+            sum += w * v.x;
+            weightSum += w;
+        }
+    }
+    if (weightSum < 1.0e-4) {
+        sum = texelFetch(rawAo, clamp(ivec2(center + 0.5), halfRect.xy, halfRect.zw), 0).r;     // No texel at this depth
+        weightSum = 1.0;
+    }
+    fragmentColor = vec4(sum / weightSum);
+}
+#endglsl
+
+// *****************************
+// vertexShader_Hud - vertex shader
+//    For the HUD's text and panels (see Hud.h). The positions are in pixels
+//        from the top left corner of the window, the texture coordinates in
+//        texels of the glyph atlas.
+// *****************************
+#beginglsl vertexshader vertexShader_Hud
+#version 330 core
+layout (location = 0) in vec4 posTexel;        // x, y, u, v
+layout (location = 1) in vec4 color;
+
+uniform vec2 windowSize;
+uniform sampler2D atlas;
+
+out vec2 atlasCoords;
+out vec4 hudColor;
+
+void main()
+{
+    vec2 ndc = posTexel.xy / windowSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    atlasCoords = posTexel.zw / vec2(textureSize(atlas, 0));
+    hudColor = color;
+}
+#endglsl
+
+// *****************************
+// fragmentShader_Hud - fragment shader
+//    The atlas has one channel: 1 on the glyphs' pixels and the solid cell.
+// *****************************
+#beginglsl fragmentshader fragmentShader_Hud
+#version 330 core
+
+in vec2 atlasCoords;
+in vec4 hudColor;
+
+uniform sampler2D atlas;
+
+out vec4 fragmentColor;
+
+void main()
+{
+    float coverage = texture(atlas, atlasCoords).r;
+    if (coverage == 0.0) {
+        discard;
+    }
+    fragmentColor = vec4(hudColor.rgb, hudColor.a * coverage);
+}
+#endglsl
+
+// *****************************
+// vertexShader_Pulled - vertex shader
+//    The same as vertexShader_PhongPhong, but the vertex is pulled from
+//        shader storage buffers (see VertexPullPool.h) instead of vertex
+//        attributes: gl_VertexID is the position in the index buffer.
+//    The materials are still vertex attributes, with no arrays enabled.
+// *****************************
+#beginglsl vertexshader vertexShader_Pulled
+#version 430 core
+layout (location = 3) in vec3 EmissiveColor;   // Surface material properties
+layout (location = 4) in vec3 AmbientColor;
+layout (location = 5) in vec3 DiffuseColor;
+layout (location = 6) in vec3 SpecularColor;
+layout (location = 7) in float SpecularExponent;
+layout (location = 8) in float UseFresnel;
+
+layout (std430, binding = 6) readonly buffer PulledVertices { float pulledVertices[]; };   // 8 floats per vertex
+layout (std430, binding = 7) readonly buffer PulledIndices { uint pulledIndices[]; };
+
+out vec3 mvPos;         // Vertex position in modelview coordinates
+out vec3 mvNormalFront; // Normal vector to vertex in modelview coordinates
+out vec3 matEmissive;
+out vec3 matAmbient;
+out vec3 matDiffuse;
+out vec3 matSpecular;
+out float matSpecExponent;
+out vec2 theTexCoords;
+out float useFresnel;
+
+vec4 ApplyProjection(vec4 mvPos);     // In the phFrame code block
+uniform mat4 modelviewMatrix;         // The modelview matrix
+
+void main()
+{
+    uint base = 8u * pulledIndices[gl_VertexID];
+    vec3 vertPos = vec3(pulledVertices[base], pulledVertices[base + 1u], pulledVertices[base + 2u]);
+    vec3 vertNormal = vec3(pulledVertices[base + 3u], pulledVertices[base + 4u], pulledVertices[base + 5u]);
+    vec2 vertTexCoords = vec2(pulledVertices[base + 6u], pulledVertices[base + 7u]);
+
+    vec4 mvPos4 = modelviewMatrix * vec4(vertPos, 1.0);
+    gl_Position = ApplyProjection(mvPos4);
+    mvPos = vec3(mvPos4.x,mvPos4.y,mvPos4.z)/mvPos4.w;
+    mvNormalFront = normalize(inverse(transpose(mat3(modelviewMatrix)))*vertNormal); // Unit normal from the surface
+    matEmissive = EmissiveColor;
+    matAmbient = AmbientColor;
+    matDiffuse = DiffuseColor;
+    matSpecular = SpecularColor;
+    matSpecExponent = SpecularExponent;
+    theTexCoords = vertTexCoords;
+    useFresnel = UseFresnel;
+}
+#endglsl
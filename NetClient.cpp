@@ -0,0 +1,251 @@
+//
+// NetClient.cpp
+//
+// Connecting, steering commands out, and snapshots in. See NetClient.h.
+//
+
+#include "NetClient.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+
+bool NetClient::Start(const char* host, uint16_t port, double step, double now)
+{
+    if (!NetLink::Resolve(host, port, &server)) {
+        fprintf(stderr, "NetClient: could not find the server \"%s\".\n", host);
+        return false;
+    }
+    if (!link.Open(0)) {
+        return false;
+    }
+    stepSeconds = step;
+    state = Connecting;
+    lastConnectTry = now - ConnectRetrySeconds;
+    slot = -1;
+    for (NetSnapshot& s : snapshots) {
+        s.tick = 0;
+        s.skiers.clear();
+    }
+    latestTick = 0;
+    correctionReady = false;
+    commandSeq = 0;
+    numSnapshots = numUndecodable = 0;
+    Receive(now);
+    return true;
+}
+
+bool NetClient::WaitForConnection(double now, double timeoutSeconds)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (state == Connecting) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed > timeoutSeconds) {
+            fprintf(stderr, "NetClient: the server did not answer.\n");
+            state = Disconnected;
+            return false;
+        }
+        Receive(now + elapsed);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    if (state == Rejected) {
+        fprintf(stderr, "NetClient: the race is full.\n");
+    }
+    return state == Connected;
+}
+
+void NetClient::Disconnect(double now)
+{
+    if (state == Connected) {
+        uint8_t buffer[8];
+        BitWriter out(buffer, sizeof(buffer));
+        out.Write(NetProtocolId, 16);
+        out.Write(NetDisconnect, 4);
+        link.SetConditions(0.0, 0.0, 0.0);          // Not delayed: the link is closed next
+        SendPacket(out, buffer, now);
+    }
+    link.Close();
+    state = Disconnected;
+}
+
+void NetClient::SendPacket(BitWriter& out, const uint8_t* buffer, double now)
+{
+    link.SendTo(server, buffer, out.GetNumBytes(), now);
+}
+
+void NetClient::Receive(double now)
+{
+    link.Flush(now);
+    if (state == Connecting && now - lastConnectTry >= ConnectRetrySeconds) {
+        uint8_t request[8];
+        BitWriter out(request, sizeof(request));
+        out.Write(NetProtocolId, 16);
+        out.Write(NetConnect, 4);
+        SendPacket(out, request, now);
+        lastConnectTry = now;
+    }
+
+    uint8_t buffer[NetLink::MaxPacketSize];
+    NetAddress from;
+    int size;
+    while ((size = link.Receive(&from, buffer, sizeof(buffer))) > 0) {
+        BitReader in(buffer, size);
+        if (from != server || in.Read(16) != NetProtocolId) {
+            continue;
+        }
+        uint32_t type = in.Read(4);
+        if (type == NetReject && state == Connecting) {
+            state = Rejected;
+            continue;
+        }
+        if (type == NetAccept) {
+            int acceptedSlot = (int)in.Read(8);
+            uint32_t seed = in.Read(32);
+            bool giant = in.Read(1) != 0;
+            if (state == Connecting && !in.Overflowed()) {
+                slot = acceptedSlot;
+                forestSeed = seed;
+                giantSlalom = giant;
+                state = Connected;
+            }
+            continue;
+        }
+        if (type != NetSnapshotPacket || state != Connected) {
+            continue;
+        }
+
+        // Find the baseline from the snapshot's header, then decode.
+        uint32_t lastApplied = in.Read(32);
+        BitReader header = in;
+        uint32_t tick = header.Read(32);
+        uint32_t baseAge = header.Read(16);
+        if (header.Overflowed() || tick == 0) {
+            continue;
+        }
+        const NetSnapshot* baseline = 0;
+        if (baseAge != 0) {
+            baseline = &snapshots[(tick - baseAge) % NumSnapshots];
+            if (baseline->tick != tick - baseAge) {
+                numUndecodable++;
+                continue;
+            }
+        }
+        NetSnapshot decoded;
+        if (!DecodeSnapshot(in, baseline, &decoded)) {
+            numUndecodable++;
+            continue;
+        }
+        numSnapshots++;
+        NetSnapshot& slotSnapshot = snapshots[tick % NumSnapshots];
+        if (slotSnapshot.tick > tick) {
+            continue;                   // Older than what is kept there
+        }
+        slotSnapshot = decoded;
+        if (tick <= latestTick) {
+            continue;                   // Arrived out of order: kept, but not the newest
+        }
+        latestTick = tick;
+        double offset = tick * stepSeconds - now;
+        clockOffset = (numSnapshots == 1 || offset > clockOffset) ? offset : clockOffset + 0.1 * (offset - clockOffset);
+        if (decoded.Find(slot)) {
+            correctionReady = true;
+            correctionApplied = lastApplied;
+        }
+    }
+}
+
+uint32_t NetClient::SendInput(float xVel, double now)
+{
+    commandSeq++;
+    commands[commandSeq % NumCommands] = xVel;
+    uint8_t buffer[64];
+    BitWriter out(buffer, sizeof(buffer));
+    out.Write(NetProtocolId, 16);
+    out.Write(NetInput, 4);
+    out.Write(latestTick, 32);
+    out.Write(commandSeq, 32);
+    int count = commandSeq < (uint32_t)InputRedundancy ? (int)commandSeq : InputRedundancy;
+    out.Write(count, 4);
+    for (int i = count - 1; i >= 0; i--) {
+        out.WriteSigned(NetSnapshot::QuantizeVelocity(commands[(commandSeq - i) % NumCommands]));
+    }
+    link.Flush(now);
+    SendPacket(out, buffer, now);
+    return commandSeq;
+}
+
+bool NetClient::TakeCorrection(Skier* player, uint32_t* lastApplied)
+{
+    if (!correctionReady) {
+        return false;
+    }
+    correctionReady = false;
+    const NetSkier* s = snapshots[latestTick % NumSnapshots].Find(slot);
+    player->id = s->id;
+    player->x = NetSnapshot::Position(s->x);
+    player->z = NetSnapshot::Position(s->z);
+    player->vx = NetSnapshot::Velocity(s->vx);
+    player->vz = NetSnapshot::Velocity(s->vz);
+    *lastApplied = correctionApplied;
+    return true;
+}
+
+int NetClient::GetCommandsSince(uint32_t seq, float* xVel, int maxCommands) const
+{
+    int n = 0;
+    for (uint32_t k = seq + 1; k <= commandSeq && n < maxCommands; k++) {
+        if (commandSeq - k < (uint32_t)NumCommands) {
+            xVel[n++] = commands[k % NumCommands];
+        }
+    }
+    return n;
+}
+
+void NetClient::GetInterpolated(double now, std::vector<Skier>& skiers) const
+{
+    skiers.clear();
+    if (latestTick == 0) {
+        return;
+    }
+    // The snapshots just before and after the time to show
+    double showTick = (now + clockOffset) / stepSeconds - InterpolationSteps;
+    const NetSnapshot* before = 0;
+    const NetSnapshot* after = 0;
+    for (const NetSnapshot& s : snapshots) {
+        if (s.tick == 0 || latestTick - s.tick >= (uint32_t)NumSnapshots * InterpolationSteps) {
+            continue;
+        }
+        if (s.tick <= showTick && (before == 0 || s.tick > before->tick)) {
+            before = &s;
+        }
+        if (s.tick > showTick && (after == 0 || s.tick < after->tick)) {
+            after = &s;
+        }
+    }
+    if (before == 0) {
+        before = after;
+    }
+    if (after == 0) {
+        after = before;             // Past the newest: hold, rather than extrapolate
+    }
+    float t = (after == before) ? 0.0f : (float)((showTick - before->tick) / (double)(after->tick - before->tick));
+
+    // The skiers of the later snapshot: a skier just come into it appears there.
+    for (const NetSkier& b : after->skiers) {
+        if (b.id == slot) {
+            continue;
+        }
+        const NetSkier* a = before->Find(b.id);
+        if (a == 0) {
+            a = &b;
+        }
+        Skier s;
+        s.id = b.id;
+        s.x = NetSnapshot::Position(a->x) + t * NetSnapshot::Position(b.x - a->x);
+        s.z = NetSnapshot::Position(a->z) + t * NetSnapshot::Position(b.z - a->z);
+        s.vx = NetSnapshot::Velocity(a->vx) + t * NetSnapshot::Velocity(b.vx - a->vx);
+        s.vz = NetSnapshot::Velocity(a->vz) + t * NetSnapshot::Velocity(b.vz - a->vz);
+        skiers.push_back(s);
+    }
+}
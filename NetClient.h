@@ -0,0 +1,106 @@
+//
+// NetClient.h
+//
+// A player in a networked race: sends the steering, and shows what the server simulated.
+//
+//   The local player is predicted: each step, its steering command is
+//   applied at once, as the server will apply it, and sent to the server.
+//   Each packet repeats the last InputRedundancy commands, so a lost
+//   packet loses none. When a snapshot comes, it has the player's state on
+//   the server after the last command the server applied: the caller puts
+//   the player there, and applies again the commands sent since
+//   (TakeCorrection() and GetCommandsSince()). With no collisions, the
+//   prediction is exact, and nothing moves.
+//
+//   The other skiers are interpolated between the two snapshots around a
+//   time InterpolationSteps behind the newest: two snapshots' worth, so one
+//   lost snapshot does not stop them. The server's clock is estimated from
+//   the snapshots' arrival, smoothed.
+//
+//   Snapshots are decoded against the baselines they were coded against
+//   (see NetSnapshot.h), kept by tick, and acknowledged in the input packets.
+//
+// How to use:
+//    * Start() connecting, then call Receive() until IsConnected(), or WaitForConnection().
+//    * Each step: Receive(); if TakeCorrection(), reset the player and replay the
+//          commands since; apply this step's command and SendInput() it;
+//          GetInterpolated() the other skiers to draw them.
+//    * Disconnect() before exiting.
+//
+
+#pragma once
+#ifndef NET_CLIENT_H
+#define NET_CLIENT_H
+
+#include "NetLink.h"
+#include "NetSnapshot.h"
+
+class NetClient {
+public:
+    static const int InputRedundancy = 8;
+    static const int NumSnapshots = 32;             // Kept as baselines, and for interpolation
+    static const int NumCommands = 64;              // Kept for replay
+    static const int InterpolationSteps = 6;        // Two snapshots, at 20 a second
+    static constexpr double ConnectRetrySeconds = 0.25;
+
+    enum State { Disconnected, Connecting, Connected, Rejected };
+
+    struct Skier {
+        int id;                 // Players below NetSnapshot::MaxPlayers, then the AI skiers
+        float x, z;
+        float vx, vz;           // Per step
+    };
+
+    // stepSeconds is the length of the server's simulation step.
+    bool Start(const char* host, uint16_t port, double stepSeconds, double now);
+    // Blocks, receiving, until connected, rejected, or out of time. now is the caller's clock.
+    bool WaitForConnection(double now, double timeoutSeconds);
+    void Disconnect(double now);
+    NetLink& GetLink() { return link; }
+
+    State GetState() const { return state; }
+    bool IsConnected() const { return state == Connected; }
+    int GetSlot() const { return slot; }
+    uint32_t GetForestSeed() const { return forestSeed; }
+    bool IsGiantSlalom() const { return giantSlalom; }
+
+    void Receive(double now);
+    // Records and sends the command for this step. Returns its number.
+    uint32_t SendInput(float xVel, double now);
+
+    // The player's state from a snapshot newer than the last one taken, and the last command
+    //    applied to it. False if there is none.
+    bool TakeCorrection(Skier* player, uint32_t* lastApplied);
+    // The commands after the given one, oldest first. Returns the number.
+    int GetCommandsSince(uint32_t seq, float* xVel, int maxCommands) const;
+    // The skiers other than the player, as they were a little while ago.
+    void GetInterpolated(double now, std::vector<Skier>& skiers) const;
+
+    int GetNumSnapshots() const { return numSnapshots; }        // Received and decoded
+    int GetNumUndecodable() const { return numUndecodable; }    // Their baseline was not kept
+    uint32_t GetLatestTick() const { return latestTick; }
+
+private:
+    void SendPacket(BitWriter& out, const uint8_t* buffer, double now);
+
+    NetLink link;
+    NetAddress server;
+    State state = Disconnected;
+    double stepSeconds = 1.0 / 60.0;
+    double lastConnectTry = 0.0;
+    int slot = -1;
+    uint32_t forestSeed = 0;
+    bool giantSlalom = false;
+
+    NetSnapshot snapshots[NumSnapshots];            // By tick, modulo NumSnapshots; tick 0 is empty
+    uint32_t latestTick = 0;
+    double clockOffset = 0.0;                       // Server time, less local time, smoothed
+    bool correctionReady = false;
+    uint32_t correctionApplied = 0;
+    uint32_t commandSeq = 0;
+    float commands[NumCommands];                    // By number, modulo NumCommands
+    int numSnapshots = 0;
+    int numUndecodable = 0;
+};
+
+#endif  // NET_CLIENT_H
@@ -0,0 +1,216 @@
+//
+// NetLink.cpp
+//
+// A non-blocking UDP socket, behind a simulated network. See NetLink.h.
+//
+
+#include "NetLink.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#pragma comment(lib,"ws2_32.lib")
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+// Winsock needs starting once, before the first socket.
+static bool StartSockets()
+{
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+    }
+    return started;
+}
+#endif
+
+NetLink::NetLink()
+{
+    socketHandle = -1;
+    latencyMs = jitterMs = lossFraction = 0.0;
+    randomState = 0x2545F491u;
+    bytesSent = bytesReceived = 0;
+    packetsSent = packetsDropped = 0;
+}
+
+NetLink::~NetLink()
+{
+    Close();
+}
+
+bool NetLink::Open(uint16_t port)
+{
+    Close();
+#ifdef _WIN32
+    if (!StartSockets()) {
+        fprintf(stderr, "NetLink: could not start Winsock.\n");
+        return false;
+    }
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        fprintf(stderr, "NetLink: could not create a socket.\n");
+        return false;
+    }
+#else
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) {
+        fprintf(stderr, "NetLink: could not create a socket.\n");
+        return false;
+    }
+#endif
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    bool ok = (bind(s, (sockaddr*)&addr, sizeof(addr)) == 0);
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ok = ok && ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+    ok = ok && fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    socketHandle = (long long)s;
+    if (!ok) {
+        fprintf(stderr, "NetLink: could not bind to port %d.\n", (int)port);
+        Close();
+        return false;
+    }
+    delayed.clear();
+    bytesSent = bytesReceived = 0;
+    packetsSent = packetsDropped = 0;
+    return true;
+}
+
+void NetLink::Close()
+{
+    if (socketHandle < 0) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket((SOCKET)socketHandle);
+#else
+    close((int)socketHandle);
+#endif
+    socketHandle = -1;
+    delayed.clear();
+}
+
+bool NetLink::Resolve(const char* host, uint16_t port, NetAddress* address)
+{
+#ifdef _WIN32
+    if (!StartSockets()) {
+        return false;
+    }
+#endif
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = 0;
+    if (getaddrinfo(host, 0, &hints, &result) != 0 || result == 0) {
+        return false;
+    }
+    address->ip = ntohl(((sockaddr_in*)result->ai_addr)->sin_addr.s_addr);
+    address->port = port;
+    freeaddrinfo(result);
+    return true;
+}
+
+void NetLink::SetConditions(double latency, double jitter, double loss)
+{
+    latencyMs = latency;
+    jitterMs = jitter;
+    lossFraction = loss;
+}
+
+// Uniform in [0,1): xorshift, so the conditions repeat from run to run.
+double NetLink::Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (double)(randomState >> 8) / 16777216.0;
+}
+
+void NetLink::SendTo(const NetAddress& to, const uint8_t* data, int size, double now)
+{
+    if (socketHandle < 0) {
+        return;
+    }
+    bytesSent += size;
+    packetsSent++;
+    if (lossFraction > 0.0 && Random() < lossFraction) {
+        packetsDropped++;
+        return;
+    }
+    if (latencyMs <= 0.0 && jitterMs <= 0.0) {
+        SendNow(to, data, size);
+        return;
+    }
+    Delayed d;
+    d.sendTime = now + 0.001 * (latencyMs + jitterMs * Random());
+    d.to = to;
+    d.data.assign(data, data + size);
+    delayed.push_back(d);
+}
+
+void NetLink::Flush(double now)
+{
+    for (size_t i = 0; i < delayed.size(); ) {
+        if (delayed[i].sendTime > now) {
+            i++;
+            continue;
+        }
+        SendNow(delayed[i].to, delayed[i].data.data(), (int)delayed[i].data.size());
+        delayed[i] = delayed.back();
+        delayed.pop_back();
+    }
+}
+
+void NetLink::SendNow(const NetAddress& to, const uint8_t* data, int size)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(to.ip);
+    addr.sin_port = htons(to.port);
+#ifdef _WIN32
+    sendto((SOCKET)socketHandle, (const char*)data, size, 0, (sockaddr*)&addr, sizeof(addr));
+#else
+    sendto((int)socketHandle, data, size, 0, (sockaddr*)&addr, sizeof(addr));
+#endif
+}
+
+int NetLink::Receive(NetAddress* from, uint8_t* data, int maxSize)
+{
+    if (socketHandle < 0) {
+        return 0;
+    }
+    sockaddr_in addr;
+    socklen_t addrSize = sizeof(addr);
+#ifdef _WIN32
+    int size = recvfrom((SOCKET)socketHandle, (char*)data, maxSize, 0, (sockaddr*)&addr, &addrSize);
+#else
+    int size = (int)recvfrom((int)socketHandle, data, maxSize, 0, (sockaddr*)&addr, &addrSize);
+#endif
+    if (size <= 0) {
+        return 0;           // Nothing waiting (or an error, such as a port unreachable: skipped)
+    }
+    from->ip = ntohl(addr.sin_addr.s_addr);
+    from->port = ntohs(addr.sin_port);
+    bytesReceived += size;
+    return size;
+}
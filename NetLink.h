@@ -0,0 +1,83 @@
+//
+// NetLink.h
+//
+// A UDP socket for the networked races, with a simulated network in front of it.
+//
+//   The socket is non-blocking: Receive() returns at once, with nothing if
+//   no datagram is waiting. Packets are sent through a link conditioner,
+//   which drops a fraction of them and holds the rest for the latency, plus
+//   a random jitter, before they go out. So a race over localhost behaves
+//   like one over a real network, with both ends in one process or in
+//   several. Packets may be reordered by the jitter, as on a real network.
+//
+//   The conditioner works in the caller's time, not the wall clock: a test
+//   can run the network faster than real time by passing its own clock.
+//
+// How to use:
+//    * Open() the socket: a server on its port, a client on port 0 (any free port).
+//    * SetConditions() for simulated latency, jitter and loss (none by default).
+//    * SendTo() packets, and call Flush() often, to send the delayed ones.
+//    * Receive() until it returns 0, each step.
+//
+
+#pragma once
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include <stdint.h>
+#include <vector>
+
+struct NetAddress {
+    uint32_t ip = 0;                // In host byte order
+    uint16_t port = 0;
+
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+class NetLink {
+public:
+    static const int MaxPacketSize = 1200;      // Below the usual MTU, so packets are not fragmented
+
+    NetLink();
+    ~NetLink();
+
+    bool Open(uint16_t port);
+    void Close();
+    bool IsOpen() const { return socketHandle >= 0; }
+
+    // Looks up "host" (a name or a dotted address). False if it is not found.
+    static bool Resolve(const char* host, uint16_t port, NetAddress* address);
+
+    void SetConditions(double latencyMs, double jitterMs, double lossFraction);
+
+    void SendTo(const NetAddress& to, const uint8_t* data, int size, double now);
+    void Flush(double now);
+    // The size of the next datagram, or 0 if there is none.
+    int Receive(NetAddress* from, uint8_t* data, int maxSize);
+
+    // Totals since Open(): what was given to SendTo(), and what was dropped.
+    uint64_t GetBytesSent() const { return bytesSent; }
+    uint64_t GetBytesReceived() const { return bytesReceived; }
+    int GetPacketsSent() const { return packetsSent; }
+    int GetPacketsDropped() const { return packetsDropped; }
+
+private:
+    struct Delayed {
+        double sendTime;
+        NetAddress to;
+        std::vector<uint8_t> data;
+    };
+
+    void SendNow(const NetAddress& to, const uint8_t* data, int size);
+    double Random();
+
+    long long socketHandle;             // -1 when closed
+    double latencyMs, jitterMs, lossFraction;
+    uint32_t randomState;
+    std::vector<Delayed> delayed;       // Not sorted: jitter reorders packets anyway
+    uint64_t bytesSent, bytesReceived;
+    int packetsSent, packetsDropped;
+};
+
+#endif  // NET_LINK_H
@@ -0,0 +1,213 @@
+//
+// NetServer.cpp
+//
+// Connections, steering commands in, and snapshots out. See NetServer.h.
+//
+
+#include "NetServer.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+bool NetServer::Open(uint16_t port, uint32_t forestSeed, bool giant)
+{
+    for (Client& c : clients) {
+        c = Client();
+    }
+    seed = forestSeed;
+    giantSlalom = giant;
+    return link.Open(port);
+}
+
+void NetServer::Close()
+{
+    link.Close();
+    for (Client& c : clients) {
+        c.connected = false;
+    }
+}
+
+int NetServer::GetNumConnected() const
+{
+    int n = 0;
+    for (const Client& c : clients) {
+        n += c.connected;
+    }
+    return n;
+}
+
+void NetServer::Send(const NetAddress& to, BitWriter& out, const uint8_t* buffer, double now, Client* client)
+{
+    if (out.Overflowed()) {
+        fprintf(stderr, "NetServer: a packet is over %d bytes, and was not sent.\n", NetLink::MaxPacketSize);
+        return;
+    }
+    link.SendTo(to, buffer, out.GetNumBytes(), now);
+    if (client) {
+        client->bytesSent += out.GetNumBytes();
+    }
+}
+
+void NetServer::Receive(double now)
+{
+    uint8_t buffer[NetLink::MaxPacketSize];
+    NetAddress from;
+    int size;
+    while ((size = link.Receive(&from, buffer, sizeof(buffer))) > 0) {
+        BitReader in(buffer, size);
+        if (in.Read(16) != NetProtocolId) {
+            continue;
+        }
+        uint32_t type = in.Read(4);
+        int slot = -1;
+        for (int k = 0; k < MaxClients; k++) {
+            if (clients[k].connected && clients[k].address == from) {
+                slot = k;
+            }
+        }
+
+        if (type == NetConnect) {
+            // A new client takes the first free player; a repeated request is answered again.
+            for (int k = 0; k < MaxClients && slot < 0; k++) {
+                if (!clients[k].connected) {
+                    slot = k;
+                    clients[k] = Client();
+                    clients[k].connected = true;
+                    clients[k].address = from;
+                    printf("NetServer: player %d connected.\n", k + 1);
+                }
+            }
+            uint8_t reply[16];
+            BitWriter out(reply, sizeof(reply));
+            out.Write(NetProtocolId, 16);
+            if (slot < 0) {
+                out.Write(NetReject, 4);
+                Send(from, out, reply, now, 0);
+                continue;
+            }
+            clients[slot].lastHeard = now;
+            out.Write(NetAccept, 4);
+            out.Write(slot, 8);
+            out.Write(seed, 32);
+            out.Write(giantSlalom, 1);
+            Send(from, out, reply, now, &clients[slot]);
+            continue;
+        }
+        if (slot < 0) {
+            continue;                   // Not from a client
+        }
+        Client& c = clients[slot];
+        c.lastHeard = now;
+        if (type == NetDisconnect) {
+            c.connected = false;
+            printf("NetServer: player %d disconnected.\n", slot + 1);
+            continue;
+        }
+        if (type != NetInput) {
+            continue;
+        }
+        uint32_t ackTick = in.Read(32);
+        uint32_t lastSeq = in.Read(32);
+        int count = (int)in.Read(4);
+        float xVel[16];
+        for (int i = 0; i < count; i++) {
+            xVel[i] = NetSnapshot::Velocity(in.ReadSigned());
+        }
+        if (in.Overflowed()) {
+            continue;
+        }
+        if (ackTick > c.ackTick) {
+            c.ackTick = ackTick;
+        }
+        // Queue the commands not seen before, oldest first.
+        for (int i = 0; i < count; i++) {
+            uint32_t seq = lastSeq - (count - 1 - i);
+            if (seq > c.lastQueued) {
+                c.inputs.push_back(std::make_pair(seq, xVel[i]));
+                c.lastQueued = seq;
+            }
+        }
+        while ((int)c.inputs.size() > MaxQueuedInputs) {
+            c.inputs.pop_front();
+        }
+    }
+
+    for (int k = 0; k < MaxClients; k++) {
+        if (clients[k].connected && now - clients[k].lastHeard > TimeoutSeconds) {
+            clients[k].connected = false;
+            printf("NetServer: player %d timed out.\n", k + 1);
+        }
+    }
+}
+
+bool NetServer::PopInput(int client, float* xVel)
+{
+    Client& c = clients[client];
+    if (!c.connected || c.inputs.empty()) {
+        return false;
+    }
+    c.lastApplied = c.inputs.front().first;
+    *xVel = c.inputs.front().second;
+    c.inputs.pop_front();
+    return true;
+}
+
+void NetServer::SendSnapshots(uint32_t tick, const std::vector<NetSkier>& skiers, double now)
+{
+    link.Flush(now);
+    if (tick % SnapshotInterval != 0) {
+        return;
+    }
+    const int32_t downhill = NetSnapshot::QuantizePosition(InterestDownhill);
+    const int32_t uphill = NetSnapshot::QuantizePosition(InterestUphill);
+    uint8_t buffer[NetLink::MaxPacketSize];
+    for (int k = 0; k < MaxClients; k++) {
+        Client& c = clients[k];
+        if (!c.connected) {
+            continue;
+        }
+        int32_t playerZ = 0;
+        for (const NetSkier& s : skiers) {
+            if (s.id == k) {
+                playerZ = s.z;
+            }
+        }
+        NetSnapshot& snapshot = c.sent[tick % NumBaselines];
+        snapshot.tick = tick;
+        snapshot.skiers.clear();
+        interesting.clear();
+        for (int i = 0; i < (int)skiers.size(); i++) {
+            const NetSkier& s = skiers[i];
+            if (s.id < NetSnapshot::MaxPlayers) {
+                if (clients[s.id].connected) {
+                    snapshot.skiers.push_back(s);
+                }
+            }
+            else if (s.z > playerZ - downhill && s.z < playerZ + uphill) {
+                interesting.push_back(std::make_pair(std::abs(s.z - playerZ), i));
+            }
+        }
+        // The nearest AI skiers, if there are too many for a packet; back in order of id.
+        if ((int)interesting.size() > MaxSnapshotSkiers) {
+            std::nth_element(interesting.begin(), interesting.begin() + MaxSnapshotSkiers, interesting.end());
+            interesting.resize(MaxSnapshotSkiers);
+            std::sort(interesting.begin(), interesting.end(),
+                [](const std::pair<int32_t, int>& a, const std::pair<int32_t, int>& b) { return a.second < b.second; });
+        }
+        for (const std::pair<int32_t, int>& p : interesting) {
+            snapshot.skiers.push_back(skiers[p.second]);
+        }
+        const NetSnapshot* baseline = &c.sent[c.ackTick % NumBaselines];
+        if (c.ackTick == 0 || baseline->tick != c.ackTick || tick - c.ackTick >= NumBaselines * SnapshotInterval) {
+            baseline = 0;
+        }
+
+        BitWriter out(buffer, sizeof(buffer));
+        out.Write(NetProtocolId, 16);
+        out.Write(NetSnapshotPacket, 4);
+        out.Write(c.lastApplied, 32);
+        EncodeSnapshot(snapshot, baseline, out);
+        Send(c.address, out, buffer, now, &c);
+    }
+}
@@ -0,0 +1,87 @@
+//
+// NetServer.h
+//
+// The authoritative side of a networked race: it runs the simulation and tells the clients what happened.
+//
+//   Each client controls one player. Its packets carry steering commands,
+//   one per client step, numbered; each command is sent in several packets,
+//   so a lost packet loses none. The server queues the commands, and the
+//   simulation applies one per step (PopInput()), so the server's player
+//   follows exactly the commands the client predicted with.
+//
+//   Every SnapshotInterval steps, each client is sent a snapshot of the
+//   skiers (see NetSnapshot.h), coded against the last snapshot it
+//   acknowledged. Interest management leaves out the skiers far down the
+//   slope, or far behind, from the client's player: they cannot be seen.
+//   Of the rest, only the MaxSnapshotSkiers nearest are sent, so a snapshot
+//   always fits in a packet. The other players are always sent. The
+//   snapshot also says which of the client's commands was applied last, so
+//   the client can replay the rest.
+//
+//   A client not heard from for TimeoutSeconds is dropped, and its player is free again.
+//
+// How to use:
+//    * Open() the server, with the seed of the forest and the course.
+//    * Each step: Receive(), then PopInput() for each connected client's player,
+//          simulate, and SendSnapshots() with all the skiers.
+//    * GetNumConnected(), GetBytesSent() and the link's totals for the statistics.
+//
+
+#pragma once
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include "NetLink.h"
+#include "NetSnapshot.h"
+
+#include <deque>
+
+class NetServer {
+public:
+    static const int MaxClients = NetSnapshot::MaxPlayers;
+    static const int SnapshotInterval = 3;              // Steps between snapshots: 20 a second
+    static const int MaxQueuedInputs = 8;               // Older commands are dropped past this
+    static const int NumBaselines = 32;                 // Snapshots kept per client, as baselines
+    static constexpr float InterestDownhill = 150.0f;   // Skiers farther down the slope are not sent
+    static constexpr float InterestUphill = 60.0f;      // Nor skiers farther behind
+    static const int MaxSnapshotSkiers = 96;            // The nearest AI skiers, when more are of interest
+    static constexpr double TimeoutSeconds = 5.0;
+
+    bool Open(uint16_t port, uint32_t forestSeed, bool giantSlalom);
+    void Close();
+    bool IsOpen() const { return link.IsOpen(); }
+    NetLink& GetLink() { return link; }
+
+    void Receive(double now);
+    // The next steering command of the client's player (its xVel), if one is queued.
+    bool PopInput(int client, float* xVel);
+    // skiers is every skier, sorted by id, players first. Sends only every SnapshotInterval steps.
+    void SendSnapshots(uint32_t tick, const std::vector<NetSkier>& skiers, double now);
+
+    bool IsConnected(int client) const { return clients[client].connected; }
+    int GetNumConnected() const;
+    uint64_t GetBytesSent(int client) const { return clients[client].bytesSent; }
+
+private:
+    struct Client {
+        bool connected = false;
+        NetAddress address;
+        double lastHeard = 0.0;
+        std::deque<std::pair<uint32_t, float>> inputs;  // Command number, and xVel
+        uint32_t lastQueued = 0;                        // The last command number queued
+        uint32_t lastApplied = 0;                       // The last command number applied
+        uint32_t ackTick = 0;                           // The last snapshot received, or 0
+        NetSnapshot sent[NumBaselines];                 // By tick, modulo NumBaselines
+        uint64_t bytesSent = 0;
+    };
+
+    void Send(const NetAddress& to, BitWriter& out, const uint8_t* buffer, double now, Client* client);
+
+    NetLink link;
+    Client clients[MaxClients];
+    std::vector<std::pair<int32_t, int>> interesting;   // Distance along the slope, and index of the skier
+    uint32_t seed = 0;
+    bool giantSlalom = false;
+};
+
+#endif  // NET_SERVER_H
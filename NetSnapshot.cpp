@@ -0,0 +1,187 @@
+//
+// NetSnapshot.cpp
+//
+// Bit streams, and the delta coding of skier snapshots. See NetSnapshot.h.
+//
+
+#include "NetSnapshot.h"
+
+#include <math.h>
+#include <string.h>
+
+BitWriter::BitWriter(uint8_t* buffer, int maxBytes)
+{
+    data = buffer;
+    maxBits = 8 * maxBytes;
+    numBits = 0;
+    overflow = false;
+    memset(data, 0, maxBytes);
+}
+
+void BitWriter::Write(uint32_t value, int n)
+{
+    if (numBits + n > maxBits) {
+        overflow = true;
+        return;
+    }
+    for (int i = 0; i < n; i++, numBits++) {
+        if ((value >> i) & 1) {
+            data[numBits >> 3] |= (uint8_t)(1 << (numBits & 7));
+        }
+    }
+}
+
+// Zigzag (0, -1, 1, -2, ... to 0, 1, 2, 3, ...), then a prefix code by size.
+void BitWriter::WriteSigned(int32_t value)
+{
+    uint32_t u = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    if (u == 0) {
+        Write(0, 1);
+    }
+    else if (u < (1u << 4)) {
+        Write(1, 2);            // Prefix 1,0 (low bit first)
+        Write(u, 4);
+    }
+    else if (u < (1u << 10)) {
+        Write(3, 3);            // Prefix 1,1,0
+        Write(u, 10);
+    }
+    else if (u < (1u << 16)) {
+        Write(7, 4);            // Prefix 1,1,1,0
+        Write(u, 16);
+    }
+    else {
+        Write(15, 4);           // Prefix 1,1,1,1
+        Write(u, 32);
+    }
+}
+
+BitReader::BitReader(const uint8_t* buffer, int numBytes)
+{
+    data = buffer;
+    maxBits = 8 * numBytes;
+    numBits = 0;
+    overflow = false;
+}
+
+uint32_t BitReader::Read(int n)
+{
+    if (numBits + n > maxBits) {
+        overflow = true;
+        return 0;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < n; i++, numBits++) {
+        value |= (uint32_t)((data[numBits >> 3] >> (numBits & 7)) & 1) << i;
+    }
+    return value;
+}
+
+int32_t BitReader::ReadSigned()
+{
+    uint32_t u;
+    if (Read(1) == 0) {
+        u = 0;
+    }
+    else if (Read(1) == 0) {
+        u = Read(4);
+    }
+    else if (Read(1) == 0) {
+        u = Read(10);
+    }
+    else if (Read(1) == 0) {
+        u = Read(16);
+    }
+    else {
+        u = Read(32);
+    }
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+int32_t NetSnapshot::QuantizePosition(float p)
+{
+    return (int32_t)floorf(p * PositionScale + 0.5f);
+}
+
+int32_t NetSnapshot::QuantizeVelocity(float v)
+{
+    return (int32_t)floorf(v * VelocityScale + 0.5f);
+}
+
+const NetSkier* NetSnapshot::Find(int id) const
+{
+    int lo = 0, hi = (int)skiers.size();
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (skiers[mid].id < id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return (lo < (int)skiers.size() && skiers[lo].id == id) ? &skiers[lo] : 0;
+}
+
+// The skier's state predicted from the baseline: moved along its velocity for the steps
+//    since the baseline. Integer arithmetic, so both ends predict the same.
+static void Predict(const NetSkier* base, int steps, NetSkier* predicted)
+{
+    if (base == 0) {
+        predicted->x = predicted->z = predicted->vx = predicted->vz = 0;
+        return;
+    }
+    const int32_t perUnit = (int32_t)(NetSnapshot::VelocityScale / NetSnapshot::PositionScale);
+    predicted->x = base->x + (int32_t)((int64_t)base->vx * steps / perUnit);
+    predicted->z = base->z + (int32_t)((int64_t)base->vz * steps / perUnit);
+    predicted->vx = base->vx;
+    predicted->vz = base->vz;
+}
+
+void EncodeSnapshot(const NetSnapshot& snapshot, const NetSnapshot* baseline, BitWriter& out)
+{
+    out.Write(snapshot.tick, 32);
+    out.Write(baseline ? snapshot.tick - baseline->tick : 0, 16);      // 0 for no baseline
+    out.Write((uint32_t)snapshot.skiers.size(), 16);
+    int steps = baseline ? (int)(snapshot.tick - baseline->tick) : 0;
+    int lastId = -1;
+    for (const NetSkier& s : snapshot.skiers) {
+        out.WriteSigned(s.id - lastId - 1);
+        lastId = s.id;
+        NetSkier predicted;
+        Predict(baseline ? baseline->Find(s.id) : 0, steps, &predicted);
+        out.WriteSigned(s.x - predicted.x);
+        out.WriteSigned(s.z - predicted.z);
+        out.WriteSigned(s.vx - predicted.vx);
+        out.WriteSigned(s.vz - predicted.vz);
+    }
+}
+
+bool DecodeSnapshot(BitReader& in, const NetSnapshot* baseline, NetSnapshot* snapshot)
+{
+    snapshot->tick = in.Read(32);
+    uint32_t baseAge = in.Read(16);
+    int numSkiers = (int)in.Read(16);
+    if (in.Overflowed() || (baseAge != 0 && (baseline == 0 || snapshot->tick - baseline->tick != baseAge))) {
+        return false;           // A bad packet, or not coded against this baseline
+    }
+    if (baseAge == 0) {
+        baseline = 0;
+    }
+    snapshot->skiers.resize(numSkiers);
+    int lastId = -1;
+    for (NetSkier& s : snapshot->skiers) {
+        s.id = lastId + 1 + in.ReadSigned();
+        lastId = s.id;
+        NetSkier predicted;
+        Predict(baseline ? baseline->Find(s.id) : 0, (int)baseAge, &predicted);
+        s.x = predicted.x + in.ReadSigned();
+        s.z = predicted.z + in.ReadSigned();
+        s.vx = predicted.vx + in.ReadSigned();
+        s.vz = predicted.vz + in.ReadSigned();
+        if (in.Overflowed()) {
+            return false;
+        }
+    }
+    return true;
+}
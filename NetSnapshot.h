@@ -0,0 +1,101 @@
+//
+// NetSnapshot.h
+//
+// The state of the skiers sent from the race server to each client, quantized and delta compressed.
+//
+//   A snapshot is the list of skiers a client is told about at one server
+//   step, sorted by id: the players (ids 0 to MaxPlayers - 1), then the AI
+//   skiers (MaxPlayers plus their index). Positions are quantized to
+//   1/PositionScale of a unit, and velocities to 1/VelocityScale of a unit
+//   per step, so both ends have exactly the same numbers.
+//
+//   A snapshot is coded against a baseline: an earlier snapshot the client
+//   has acknowledged. Each skier's position is predicted from the baseline,
+//   moved along its baseline velocity for the steps between them, and only
+//   the difference from the prediction is sent. A skier going steadily costs
+//   a few bits; a skier not in the baseline is sent in full. The ids are
+//   sent as the gap from the previous id, so a skier left out (by interest
+//   management, say) costs nothing. With no baseline, the prediction is zero.
+//
+//   The numbers go through a bit stream, with a short code for small values:
+//   0 for zero, then 2, 3 or 4 bit prefixes for 4, 10, 16 and 32 bit values.
+//
+// How to use:
+//    * EncodeSnapshot() into a BitWriter, with the baseline or null.
+//    * DecodeSnapshot() from a BitReader, with the same baseline.
+//
+
+#pragma once
+#ifndef NET_SNAPSHOT_H
+#define NET_SNAPSHOT_H
+
+#include <stdint.h>
+#include <vector>
+
+class BitWriter {
+public:
+    BitWriter(uint8_t* data, int maxBytes);
+
+    void Write(uint32_t value, int numBits);            // numBits from 1 to 32
+    void WriteSigned(int32_t value);                    // The short code, zigzagged
+    int GetNumBytes() const { return (numBits + 7) >> 3; }
+    bool Overflowed() const { return overflow; }
+
+private:
+    uint8_t* data;
+    int maxBits;
+    int numBits;
+    bool overflow;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, int numBytes);
+
+    uint32_t Read(int numBits);
+    int32_t ReadSigned();
+    bool Overflowed() const { return overflow; }        // Read past the end: the packet is bad
+
+private:
+    const uint8_t* data;
+    int maxBits;
+    int numBits;
+    bool overflow;
+};
+
+struct NetSkier {
+    int id;
+    int32_t x, z;               // In 1/PositionScale units
+    int32_t vx, vz;             // In 1/VelocityScale units per step
+};
+
+struct NetSnapshot {
+    static const int MaxPlayers = 4;
+    static constexpr float PositionScale = 64.0f;
+    static constexpr float VelocityScale = 4096.0f;
+
+    uint32_t tick = 0;          // The server's step
+    std::vector<NetSkier> skiers;   // Sorted by id
+
+    static int32_t QuantizePosition(float p);
+    static int32_t QuantizeVelocity(float v);
+    static float Position(int32_t q) { return (float)q / PositionScale; }
+    static float Velocity(int32_t q) { return (float)q / VelocityScale; }
+
+    const NetSkier* Find(int id) const;                 // Null if the skier is not in the snapshot
+};
+
+// The packets between the race server and its clients start with NetProtocolId, then the type.
+//    Connect:    client to server, asking for a player.
+//    Accept:     server to client: the player's slot, the forest's seed and the course.
+//    Reject:     server to client: the race is full.
+//    Input:      client to server: the last few steering commands, and the last snapshot received.
+//    Snapshot:   server to client: the last command applied, then the coded snapshot.
+//    Disconnect: client to server.
+const uint32_t NetProtocolId = 0x534B;
+enum NetPacketType { NetConnect, NetAccept, NetReject, NetInput, NetSnapshotPacket, NetDisconnect, NumNetPacketTypes };
+
+void EncodeSnapshot(const NetSnapshot& snapshot, const NetSnapshot* baseline, BitWriter& out);
+bool DecodeSnapshot(BitReader& in, const NetSnapshot* baseline, NetSnapshot* snapshot);
+
+#endif  // NET_SNAPSHOT_H
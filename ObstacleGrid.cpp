@@ -0,0 +1,270 @@
+//
+// ObstacleGrid.cpp
+//
+// Ray queries against the trunks and leaves, walking a uniform grid. See ObstacleGrid.h.
+//
+
+#include "ObstacleGrid.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+ObstacleGrid::ObstacleGrid()
+{
+    minX = minZ = 0.0f;
+    numX = numZ = 0;
+}
+
+void ObstacleGrid::Build(const std::vector<std::pair<float, float>>& treeLocs)
+{
+    trees = treeLocs;
+    cellStart.clear();
+    cellShapes.clear();
+    numX = numZ = 0;
+    if (trees.empty()) {
+        return;
+    }
+    float maxX = -FLT_MAX, maxZ = -FLT_MAX;
+    minX = minZ = FLT_MAX;
+    for (const std::pair<float, float>& t : trees) {
+        minX = std::min(minX, t.first - LeavesRadius);
+        maxX = std::max(maxX, t.first + LeavesRadius);
+        minZ = std::min(minZ, t.second - LeavesRadius);
+        maxZ = std::max(maxZ, t.second + LeavesRadius);
+    }
+    numX = (int)ceilf((maxX - minX) / CellSize);
+    numZ = (int)ceilf((maxZ - minZ) / CellSize);
+
+    // Two passes over the shapes: count each cell's shapes, then fill them in.
+    int numCells = NumLayers * numZ * numX;
+    cellStart.assign(numCells + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<int> fill;
+        if (pass == 1) {
+            for (int c = 0; c < numCells; c++) {
+                cellStart[c + 1] += cellStart[c];
+            }
+            cellShapes.resize(cellStart[numCells]);
+            fill.assign(cellStart.begin(), cellStart.end() - 1);
+        }
+        for (int shape = 0; shape < 2 * (int)trees.size(); shape++) {
+            const std::pair<float, float>& t = trees[shape >> 1];
+            bool leaves = (shape & 1) != 0;
+            float r = leaves ? LeavesRadius : TrunkRadius;
+            float y0 = leaves ? LeavesBase : 0.0f;
+            float y1 = leaves ? LeavesTop : TrunkHeight;
+            int ix0 = std::max(0, (int)floorf((t.first - r - minX) / CellSize));
+            int ix1 = std::min(numX - 1, (int)floorf((t.first + r - minX) / CellSize));
+            int iz0 = std::max(0, (int)floorf((t.second - r - minZ) / CellSize));
+            int iz1 = std::min(numZ - 1, (int)floorf((t.second + r - minZ) / CellSize));
+            int layer0 = std::max(0, (int)floorf(y0 / LayerHeight));
+            int layer1 = std::min(NumLayers - 1, (int)ceilf(y1 / LayerHeight) - 1);
+            for (int layer = layer0; layer <= layer1; layer++) {
+                for (int iz = iz0; iz <= iz1; iz++) {
+                    for (int ix = ix0; ix <= ix1; ix++) {
+                        int cell = (layer * numZ + iz) * numX + ix;
+                        if (pass == 0) {
+                            cellStart[cell + 1]++;
+                        }
+                        else {
+                            cellShapes[fill[cell]++] = shape;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The nearest t in [tMin, tMax] where the ray meets the shape, if any.
+bool ObstacleGrid::HitShape(int shape, const Ray& ray, float tMin, float tMax, float* t) const
+{
+    const std::pair<float, float>& tree = trees[shape >> 1];
+    bool leaves = (shape & 1) != 0;
+    float ox = ray.origin[0] - tree.first;
+    float oy = ray.origin[1];
+    float oz = ray.origin[2] - tree.second;
+    float dx = ray.dir[0], dy = ray.dir[1], dz = ray.dir[2];
+    float r = leaves ? LeavesRadius : TrunkRadius;
+    float y0 = leaves ? LeavesBase : 0.0f;
+    float y1 = leaves ? LeavesTop : TrunkHeight;
+    float best = FLT_MAX;
+
+    // The side: a cylinder, or a cone with its tip at y1
+    float a, b, c;
+    if (leaves) {
+        float k = r / (y1 - y0);
+        float w = y1 - oy;
+        a = dx * dx + dz * dz - k * k * dy * dy;
+        b = 2.0f * (ox * dx + oz * dz + k * k * w * dy);
+        c = ox * ox + oz * oz - k * k * w * w;
+    }
+    else {
+        a = dx * dx + dz * dz;
+        b = 2.0f * (ox * dx + oz * dz);
+        c = ox * ox + oz * oz - r * r;
+    }
+    float roots[2];
+    int numRoots = 0;
+    if (fabsf(a) > 1.0e-8f) {
+        float disc = b * b - 4.0f * a * c;
+        if (disc >= 0.0f) {
+            float s = sqrtf(disc);
+            roots[0] = (-b - s) / (2.0f * a);
+            roots[1] = (-b + s) / (2.0f * a);
+            numRoots = 2;
+        }
+    }
+    else if (b != 0.0f) {
+        roots[0] = -c / b;
+        numRoots = 1;
+    }
+    for (int i = 0; i < numRoots; i++) {
+        float y = oy + roots[i] * dy;
+        if (roots[i] >= tMin && roots[i] <= tMax && y >= y0 && y <= y1) {
+            best = std::min(best, roots[i]);
+        }
+    }
+
+    // The flat ends: the base, and the top of the trunk
+    if (dy != 0.0f) {
+        for (int end = 0; end < (leaves ? 1 : 2); end++) {
+            float tEnd = ((end == 0 ? y0 : y1) - oy) / dy;
+            float x = ox + tEnd * dx;
+            float z = oz + tEnd * dz;
+            if (tEnd >= tMin && tEnd <= tMax && x * x + z * z <= r * r) {
+                best = std::min(best, tEnd);
+            }
+        }
+    }
+    if (best == FLT_MAX) {
+        return false;
+    }
+    *t = best;
+    return true;
+}
+
+int ObstacleGrid::Walk(const Ray& ray, WalkMode mode, Hit* hit, int* hitTrees, int maxTrees) const
+{
+    if (numX == 0) {
+        return 0;
+    }
+    // Clip the ray to the grid's box.
+    const float boxMin[3] = { minX, 0.0f, minZ };
+    const float boxMax[3] = { minX + numX * CellSize, NumLayers * LayerHeight, minZ + numZ * CellSize };
+    const float cellSize[3] = { CellSize, LayerHeight, CellSize };
+    const int numCells[3] = { numX, NumLayers, numZ };
+    float tEnter = 0.0f, tExit = ray.maxT;
+    for (int k = 0; k < 3; k++) {
+        if (ray.dir[k] == 0.0f) {
+            if (ray.origin[k] < boxMin[k] || ray.origin[k] > boxMax[k]) {
+                return 0;
+            }
+            continue;
+        }
+        float t0 = (boxMin[k] - ray.origin[k]) / ray.dir[k];
+        float t1 = (boxMax[k] - ray.origin[k]) / ray.dir[k];
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    }
+    if (tEnter > tExit) {
+        return 0;
+    }
+
+    // The first cell, and the t of the next cell boundary on each axis
+    int cell[3], step[3];
+    float tNext[3], tDelta[3];
+    for (int k = 0; k < 3; k++) {
+        float p = ray.origin[k] + tEnter * ray.dir[k];
+        cell[k] = std::min(numCells[k] - 1, std::max(0, (int)floorf((p - boxMin[k]) / cellSize[k])));
+        if (ray.dir[k] > 0.0f) {
+            step[k] = 1;
+            tNext[k] = (boxMin[k] + (cell[k] + 1) * cellSize[k] - ray.origin[k]) / ray.dir[k];
+            tDelta[k] = cellSize[k] / ray.dir[k];
+        }
+        else if (ray.dir[k] < 0.0f) {
+            step[k] = -1;
+            tNext[k] = (boxMin[k] + cell[k] * cellSize[k] - ray.origin[k]) / ray.dir[k];
+            tDelta[k] = -cellSize[k] / ray.dir[k];
+        }
+        else {
+            step[k] = 0;
+            tNext[k] = FLT_MAX;
+            tDelta[k] = FLT_MAX;
+        }
+    }
+
+    int numHits = 0;
+    float bestT = ray.maxT;
+    while (true) {
+        int c = (cell[1] * numZ + cell[2]) * numX + cell[0];
+        int axis = (tNext[0] < tNext[1]) ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+        float cellExit = std::min(tNext[axis], tExit);
+        for (int i = cellStart[c]; i < cellStart[c + 1]; i++) {
+            int shape = cellShapes[i];
+            float t;
+            if (!HitShape(shape, ray, 0.0f, mode == Nearest ? bestT : ray.maxT, &t)) {
+                continue;
+            }
+            if (mode == Any) {
+                return 1;
+            }
+            if (mode == Nearest) {
+                bestT = t;
+                hit->t = t;
+                hit->tree = shape >> 1;
+                hit->leaves = (shape & 1) != 0;
+                numHits = 1;
+                continue;
+            }
+            int tree = shape >> 1;
+            if (std::find(hitTrees, hitTrees + numHits, tree) == hitTrees + numHits && numHits < maxTrees) {
+                hitTrees[numHits++] = tree;
+            }
+        }
+        if (mode == Nearest && numHits > 0 && bestT <= cellExit) {
+            return 1;           // No later cell can have a nearer hit
+        }
+        if (tNext[axis] > tExit) {
+            return numHits;
+        }
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= numCells[axis]) {
+            return numHits;
+        }
+        tNext[axis] += tDelta[axis];
+    }
+}
+
+bool ObstacleGrid::Raycast(const Ray& ray, Hit* hit) const
+{
+    hit->t = ray.maxT;
+    hit->tree = -1;
+    hit->leaves = false;
+    return Walk(ray, Nearest, hit, 0, 0) > 0;
+}
+
+bool ObstacleGrid::IsBlocked(const Ray& ray) const
+{
+    return Walk(ray, Any, 0, 0, 0) > 0;
+}
+
+int ObstacleGrid::RaycastAll(const Ray& ray, int* hitTrees, int maxTrees) const
+{
+    return Walk(ray, All, 0, hitTrees, maxTrees);
+}
+
+void ObstacleGrid::RaycastBatch(const Ray* rays, int numRays, Hit* hits) const
+{
+    for (int i = 0; i < numRays; i++) {
+        Raycast(rays[i], &hits[i]);
+    }
+}
+
+void ObstacleGrid::IsBlockedBatch(const Ray* rays, int numRays, unsigned char* blocked) const
+{
+    for (int i = 0; i < numRays; i++) {
+        blocked[i] = IsBlocked(rays[i]) ? 1 : 0;
+    }
+}
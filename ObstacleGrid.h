@@ -0,0 +1,87 @@
+//
+// ObstacleGrid.h
+//
+// Ray and segment queries against the trees: for the camera, and the AI skiers' line of sight.
+//
+//   Each tree is two shapes, as renderTrunk() and renderLeaves() draw them:
+//   the trunk, a cylinder of radius TrunkRadius from the ground to
+//   TrunkHeight, and the leaves, a cone of radius LeavesRadius from
+//   LeavesBase up to its tip at LeavesTop. The shapes are put in the cells
+//   of a uniform 3D grid that they overlap: CellSize across, and layers of
+//   LayerHeight, so only the trunks are in the lowest layer.
+//
+//   A query walks the cells along the ray with a 3D-DDA (Amanatides and Woo),
+//   nearest first, and tests only the shapes in those cells, exactly. The
+//   nearest hit stops the walk as soon as it lies within the cell being
+//   walked: a shape is in every cell it overlaps, so no nearer hit can be
+//   in a later cell. The queries change nothing, so any number of threads
+//   can make them at once.
+//
+//   Coordinates are world coordinates, with the trees as randomTreeGen() places them.
+//
+// How to use:
+//    * Build() with the tree positions.
+//    * Raycast() for the nearest hit, IsBlocked() for any hit (line of sight),
+//          RaycastAll() for all the trees along a ray; or the batches, for many rays.
+//    * A segment from p0 to p1 is the ray from p0 along p1 - p0, with maxT 1.
+//
+
+#pragma once
+#ifndef OBSTACLE_GRID_H
+#define OBSTACLE_GRID_H
+
+#include <utility>
+#include <vector>
+
+class ObstacleGrid {
+public:
+    static constexpr float TrunkRadius = 0.5f;
+    static constexpr float TrunkHeight = 10.0f;
+    static constexpr float LeavesRadius = 2.5f;
+    static constexpr float LeavesBase = 6.0f;
+    static constexpr float LeavesTop = 14.0f;
+    static constexpr float CellSize = 4.0f;
+    static constexpr float LayerHeight = 6.0f;   // The leaves start at the top of the lowest layer
+    static const int NumLayers = 3;
+
+    struct Ray {
+        float origin[3];
+        float dir[3];               // Need not be a unit vector
+        float maxT;                 // Hits are for t from 0 to maxT
+    };
+    struct Hit {
+        float t;
+        int tree;                   // -1 for no hit
+        bool leaves;                // Whether the hit is on the leaves, or the trunk
+    };
+
+    ObstacleGrid();
+
+    void Build(const std::vector<std::pair<float, float>>& trees);
+
+    bool Raycast(const Ray& ray, Hit* hit) const;
+    bool IsBlocked(const Ray& ray) const;
+    // Each tree hit along the ray, once, nearest cells first. Returns the number of trees.
+    int RaycastAll(const Ray& ray, int* trees, int maxTrees) const;
+
+    void RaycastBatch(const Ray* rays, int numRays, Hit* hits) const;
+    void IsBlockedBatch(const Ray* rays, int numRays, unsigned char* blocked) const;
+
+    int GetNumTrees() const { return (int)trees.size(); }
+    const std::pair<float, float>& GetTree(int i) const { return trees[i]; }
+
+private:
+    enum WalkMode { Nearest, Any, All };
+
+    // Walks the cells along the ray. Returns the number of hits: 0 or 1, or the number of trees for All.
+    int Walk(const Ray& ray, WalkMode mode, Hit* hit, int* trees, int maxTrees) const;
+    bool HitShape(int shape, const Ray& ray, float tMin, float tMax, float* t) const;
+
+    std::vector<std::pair<float, float>> trees;
+    float minX, minZ;                   // Corner of the grid
+    int numX, numZ;                     // Cells across the grid
+    std::vector<int> cellStart;         // Per cell, into cellShapes; one more at the end
+    std::vector<int> cellShapes;        // 2 * tree, plus 1 for the leaves
+};
+
+#endif  // OBSTACLE_GRID_H
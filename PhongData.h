@@ -20,6 +20,7 @@ extern phMaterial myMaterials[3];
 // myLights[0], myLights[1], myLights[2] are the three lights above the scene.
 // myLights[3] is the spotlight.
 extern phLight myLights[1];
+extern VectorR3 myLightPositions[3];   // In the view's coordinates, before the player's offset
 
 void MySetupGlobalLight();
 void MySetupLights();
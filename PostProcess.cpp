@@ -0,0 +1,234 @@
+//
+// PostProcess.cpp
+//
+// The post-processing stage, fused into one fullscreen pass. See PostProcess.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "PostProcess.h"
+#include "FrameGraph.h"
+#include "GlShaderMgr.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+
+// The shader #define for each effect done by the shader, in the order of the Effect bits.
+static const char* EffectDefines[] = { "POST_TONEMAP", "POST_GRADE", "POST_VIGNETTE", "POST_FXAA" };
+static const int NumShaderEffects = sizeof(EffectDefines) / sizeof(EffectDefines[0]);
+
+constexpr float PostProcess::MinRenderScale;     // Defined here too, as std::max() takes it by reference
+constexpr float PostProcess::RenderScaleStep;
+
+int PostProcess::effects = Tonemap | ColorGrade | Vignette | Fxaa;
+int PostProcess::maxSamples = 0;
+int PostProcess::sceneSamples = 0;
+int PostProcess::sceneColor = -1;
+int PostProcess::sceneDepth = -1;
+int PostProcess::sceneWidth = 1;
+int PostProcess::sceneHeight = 1;
+float PostProcess::renderScale = 1.0f;
+double PostProcess::targetFrameTime = 1000.0 / 60.0;
+int PostProcess::framesSinceScaleChange = 0;
+unsigned int PostProcess::emptyVAO = 0;
+std::map<int, PostProcess::Program> PostProcess::programs;
+
+void PostProcess::Setup()
+{
+    // The fullscreen triangle is made from gl_VertexID: no vertex attributes,
+    //    but the core profile still needs a vertex array object bound.
+    glGenVertexArrays(1, &emptyVAO);
+
+    GLint colorSamples = 0, depthSamples = 0;
+    glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &colorSamples);
+    glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &depthSamples);
+    maxSamples = std::min(4, (int)std::min(colorSamples, depthSamples));
+    if (maxSamples < 2) {
+        maxSamples = 0;
+    }
+}
+
+void PostProcess::BeginFrame(FrameGraph& graph, int windowWidth, int windowHeight)
+{
+    if (IsEnabled(DynamicResolution)) {
+        UpdateRenderScale(graph.GetGpuTime());
+    }
+    else {
+        renderScale = 1.0f;
+    }
+    sceneWidth = std::max(1, (int)(renderScale * (float)windowWidth + 0.5f));
+    sceneHeight = std::max(1, (int)(renderScale * (float)windowHeight + 0.5f));
+    sceneSamples = IsEnabled(DynamicResolution) ? 0 : maxSamples;
+
+    FrameGraph::TextureDesc desc;
+    desc.width = sceneWidth;
+    desc.height = sceneHeight;
+    desc.samples = sceneSamples;
+    desc.internalFormat = GL_RGBA16F;       // Room for the highlights above 1, for tonemapping
+    sceneColor = graph.CreateTexture("Scene color", desc);
+    desc.internalFormat = GL_DEPTH_COMPONENT24;
+    sceneDepth = graph.CreateTexture("Scene depth", desc);
+}
+
+// Lowers the render scale a step when the GPU is over the target frame time,
+//    and raises it a step when it is well under. Waits between changes for the
+//    Profiler's averages to reflect the new scale.
+void PostProcess::UpdateRenderScale(double gpuTime)
+{
+    if (++framesSinceScaleChange < FramesBetweenScaleChanges || gpuTime <= 0.0) {
+        return;
+    }
+    float newScale = renderScale;
+    if (gpuTime > targetFrameTime) {
+        newScale = std::max(MinRenderScale, renderScale - RenderScaleStep);
+    }
+    else if (gpuTime < 0.7 * targetFrameTime) {
+        newScale = std::min(1.0f, renderScale + RenderScaleStep);
+    }
+    if (newScale != renderScale) {
+        printf("Render scale %.3f (GPU %.2f ms, target %.2f ms).\n", newScale, gpuTime, targetFrameTime);
+        renderScale = newScale;
+        framesSinceScaleChange = 0;
+    }
+}
+
+void PostProcess::AddPasses(FrameGraph& graph)
+{
+    int shaderFlags = effects & (Tonemap | ColorGrade | Vignette | Fxaa);
+    if (sceneSamples > 0) {
+        shaderFlags = (shaderFlags & ~Fxaa) | MsaaResolve;
+    }
+    int windowWidth = graph.GetDesc(graph.GetBackbufferColor()).width;
+    int windowHeight = graph.GetDesc(graph.GetBackbufferColor()).height;
+    if (sceneWidth != windowWidth || sceneHeight != windowHeight) {
+        shaderFlags |= Upscale;
+    }
+
+    int color = sceneColor;
+    FrameGraph* g = &graph;
+    int postPass = graph.AddPass("Post", [g, color, shaderFlags, windowWidth, windowHeight]() {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture((shaderFlags & MsaaResolve) ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, g->GetTexture(color));
+        Run(shaderFlags, windowWidth, windowHeight);
+    });
+    graph.Read(postPass, sceneColor);
+    graph.Write(postPass, graph.GetBackbufferColor());
+}
+
+void PostProcess::Run(int shaderFlags, int windowWidth, int windowHeight)
+{
+    const Program& p = GetProgram(shaderFlags);
+    if (p.program == 0) {
+        return;
+    }
+    glUseProgram(p.program);
+    glUniform1i(p.sceneColorLoc, 0);
+    glUniform1i(p.numSamplesLoc, sceneSamples);
+    glUniform2f(p.sourceSizeLoc, (float)sceneWidth, (float)sceneHeight);
+    glUniform2f(p.outputSizeLoc, (float)windowWidth, (float)windowHeight);
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindTexture((shaderFlags & MsaaResolve) ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, 0);
+}
+
+// Compiles fragmentShader_Post with a generated code block of #defines,
+//    placed between the #version line and the shader.
+const PostProcess::Program& PostProcess::GetProgram(int shaderFlags)
+{
+    auto it = programs.find(shaderFlags);
+    if (it != programs.end()) {
+        return it->second;
+    }
+
+    std::string defines;
+    for (int i = 0; i < NumShaderEffects; i++) {
+        if (shaderFlags & (1 << i)) {
+            defines += std::string("#define ") + EffectDefines[i] + "\n";
+        }
+    }
+    if (shaderFlags & MsaaResolve) {
+        defines += "#define POST_MSAA\n";
+    }
+    if (shaderFlags & Upscale) {
+        defines += "#define POST_UPSCALE\n";
+    }
+    std::string definesName = "postDefines_" + std::to_string(shaderFlags);
+    GlShaderMgr::LoadSingleShaderString(defines.c_str(), "codeblock", definesName.c_str());
+
+    Program& p = programs[shaderFlags];
+    p.program = 0;
+    const char* fragmentBlocks[3] = { "postVersion", definesName.c_str(), "fragmentShader_Post" };
+    unsigned int shaders[2];
+    shaders[0] = GlShaderMgr::CompileShader("vertexShader_Fullscreen");
+    shaders[1] = GlShaderMgr::CompileShader(3, fragmentBlocks);
+    if (shaders[0] != 0 && shaders[1] != 0) {
+        p.program = GlShaderMgr::LinkShaderProgram(2, shaders);
+    }
+    if (p.program == 0) {
+        fprintf(stderr, "PostProcess: failed to build the post shader for %s.\n", definesName.c_str());
+        return p;
+    }
+    p.sceneColorLoc = glGetUniformLocation(p.program, "sceneColor");
+    p.numSamplesLoc = glGetUniformLocation(p.program, "numSamples");
+    p.sourceSizeLoc = glGetUniformLocation(p.program, "sourceSize");
+    p.outputSizeLoc = glGetUniformLocation(p.program, "outputSize");
+    return p;
+}
+
+void PostProcess::ToggleEffect(int effect)
+{
+    effects ^= effect;
+    if (effect == DynamicResolution) {
+        renderScale = 1.0f;
+        framesSinceScaleChange = 0;
+    }
+    printf("%s is %s.\n", EffectName(effect), IsEnabled(effect) ? "on" : "off");
+    if (effect == Fxaa && maxSamples > 0 && !IsEnabled(DynamicResolution)) {
+        printf("  (The scene is multisampled: FXAA applies only with dynamic resolution.)\n");
+    }
+}
+
+const char* PostProcess::EffectName(int effect)
+{
+    switch (effect) {
+    case Tonemap:
+        return "Tonemapping";
+    case ColorGrade:
+        return "Color grading";
+    case Vignette:
+        return "Vignette";
+    case Fxaa:
+        return "FXAA";
+    case DynamicResolution:
+        return "Dynamic resolution";
+    }
+    return "?";
+}
+
+void PostProcess::PrintStatus()
+{
+    printf("Post processing, in one pass:");
+    for (int i = 0; i < NumEffects; i++) {
+        if (IsEnabled(1 << i)) {
+            printf(" %s.", EffectName(1 << i));
+        }
+    }
+    printf("\n  Scene %dx%d, %s, render scale %.3f.\n", sceneWidth, sceneHeight,
+        sceneSamples > 0 ? "multisampled" : "not multisampled", renderScale);
+    int timer = FrameGraph::PassTimer("Post");
+    if (Profiler::HasValue(timer)) {
+        printf("  Post pass: %.3f ms on the GPU.\n", Profiler::GetValue(timer));
+    }
+}
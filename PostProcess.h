@@ -0,0 +1,104 @@
+//
+// PostProcess.h
+//
+// The post-processing stage: the scene is rendered into transient targets of
+//    the frame graph (see FrameGraph.h), then one fullscreen pass writes the window.
+//
+//   The effects are fused into a single fragment shader, fragmentShader_Post
+//   in MyShaders.glsl, compiled with a #define for each enabled effect. So
+//   however many effects are on, the frame is read once and the window written
+//   once. The programs are compiled when first needed and kept, one per
+//   combination of effects.
+//
+//   The effects:
+//     * Tonemap: compresses the highlights above 1 (specular glints on the
+//         snow) smoothly, instead of clipping them. Colors below the knee are unchanged.
+//     * ColorGrade: a cool tint and loss of saturation on the brightest snow
+//         (glare), and a slight overall contrast.
+//     * Vignette: darkens the corners.
+//     * Fxaa: antialiases edges, when the scene is not multisampled.
+//     * DynamicResolution: renders the scene at a lower resolution when the
+//         GPU takes longer than the target frame time, and upscales it with a
+//         Catmull-Rom filter. The scale is in steps of RenderScaleStep, so the
+//         frame graph reuses its pooled targets.
+//
+//   The scene is multisampled (for alpha to coverage on the leaf cards), when
+//   supported, except while dynamic resolution is enabled. The post shader
+//   then resolves the samples itself, tonemapping each before averaging:
+//   there is no separate resolve pass, and no need for FXAA.
+//
+// How to use:
+//    * Call Setup() once, after glewInit() and loading the shaders.
+//    * Each frame, after FrameGraph::Reset(), call BeginFrame(). Render the
+//          scene into GetSceneColor() and GetSceneDepth(). Then call AddPasses().
+//
+
+#pragma once
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <map>
+
+class FrameGraph;
+
+class PostProcess {
+public:
+    enum Effect {
+        Tonemap = 1,
+        ColorGrade = 2,
+        Vignette = 4,
+        Fxaa = 8,
+        DynamicResolution = 16,
+        NumEffects = 5
+    };
+
+    static constexpr float MinRenderScale = 0.5f;
+    static constexpr float RenderScaleStep = 0.125f;
+    static const int FramesBetweenScaleChanges = 30;    // Lets the GPU times settle
+
+    static void Setup();
+
+    // Declares the scene's targets, at the current render scale.
+    static void BeginFrame(FrameGraph& graph, int windowWidth, int windowHeight);
+    static int GetSceneColor() { return sceneColor; }
+    static int GetSceneDepth() { return sceneDepth; }
+    static int GetSceneWidth() { return sceneWidth; }
+    static int GetSceneHeight() { return sceneHeight; }
+    static bool IsMultisampled() { return sceneSamples > 0; }
+
+    // Adds the fullscreen pass, reading the scene and writing the window.
+    static void AddPasses(FrameGraph& graph);
+
+    static void ToggleEffect(int effect);
+    static bool IsEnabled(int effect) { return (effects & effect) != 0; }
+    static void SetTargetFrameTime(double milliseconds) { targetFrameTime = milliseconds; }
+    static float GetRenderScale() { return renderScale; }
+
+    static void PrintStatus();
+
+private:
+    enum { MsaaResolve = 1 << NumEffects, Upscale = 2 << NumEffects };    // Set by the frame, not the user
+
+    struct Program {
+        unsigned int program;
+        int sceneColorLoc, numSamplesLoc, sourceSizeLoc, outputSizeLoc;
+    };
+
+    static const Program& GetProgram(int shaderFlags);
+    static void UpdateRenderScale(double gpuTime);
+    static void Run(int shaderFlags, int windowWidth, int windowHeight);
+    static const char* EffectName(int effect);
+
+    static int effects;
+    static int maxSamples;              // For the scene, when multisampled
+    static int sceneSamples;            // This frame
+    static int sceneColor, sceneDepth;
+    static int sceneWidth, sceneHeight;
+    static float renderScale;
+    static double targetFrameTime;
+    static int framesSinceScaleChange;
+    static unsigned int emptyVAO;
+    static std::map<int, Program> programs;     // By shader flags
+};
+
+#endif  // POST_PROCESS_H
@@ -0,0 +1,120 @@
+//
+// Profiler.cpp
+//
+// Named GPU counters, measured with OpenGL queries. See Profiler.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "Profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+// Weight of each new value in the running average: about the last 16 frames.
+static const double AverageWeight = 1.0 / 16.0;
+
+std::vector<Profiler::Counter> Profiler::counters;
+int Profiler::frame = 0;
+
+int Profiler::Register(const char* name, unsigned int target)
+{
+    for (int i = 0; i < (int)counters.size(); i++) {
+        if (counters[i].name == name) {
+            assert(counters[i].target == target);
+            return i;
+        }
+    }
+    Counter c;
+    c.name = name;
+    c.target = target;
+    glGenQueries(Latency, c.queries);
+    for (int k = 0; k < Latency; k++) {
+        c.pending[k] = false;
+    }
+    c.begun = false;
+    c.average = 0.0;
+    c.numValues = 0;
+    counters.push_back(c);
+    return (int)counters.size() - 1;
+}
+
+void Profiler::Begin(int id)
+{
+    Counter& c = counters[id];
+    int slot = frame % Latency;
+    if (c.pending[slot] || c.begun) {
+        return;         // Its result was never read: the GPU is over Latency frames behind
+    }
+    glBeginQuery(c.target, c.queries[slot]);
+    c.begun = true;
+}
+
+void Profiler::End(int id)
+{
+    Counter& c = counters[id];
+    if (!c.begun) {
+        return;
+    }
+    glEndQuery(c.target);
+    c.begun = false;
+    c.pending[frame % Latency] = true;
+}
+
+// Reads the results that are ready, oldest first, without waiting.
+void Profiler::EndFrame()
+{
+    frame++;
+    for (Counter& c : counters) {
+        for (int k = 0; k < Latency; k++) {
+            int slot = (frame + k) % Latency;
+            if (!c.pending[slot]) {
+                continue;
+            }
+            GLint available = 0;
+            glGetQueryObjectiv(c.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                break;
+            }
+            GLuint64 result = 0;
+            glGetQueryObjectui64v(c.queries[slot], GL_QUERY_RESULT, &result);
+            c.pending[slot] = false;
+            double value = (c.target == GL_TIME_ELAPSED) ? (double)result * 1.0e-6 : (double)result;
+            c.average = (c.numValues == 0) ? value : c.average + AverageWeight * (value - c.average);
+            c.numValues++;
+        }
+    }
+}
+
+double Profiler::GetValue(int id)
+{
+    return counters[id].average;
+}
+
+bool Profiler::HasValue(int id)
+{
+    return counters[id].numValues > 0;
+}
+
+bool Profiler::IsTimer(int id)
+{
+    return counters[id].target == GL_TIME_ELAPSED;
+}
+
+void Profiler::Print()
+{
+    for (const Counter& c : counters) {
+        if (c.numValues == 0) {
+            printf("  %-28s  (no data)\n", c.name.c_str());
+        }
+        else if (c.target == GL_TIME_ELAPSED) {
+            printf("  %-28s %10.3f ms\n", c.name.c_str(), c.average);
+        }
+        else {
+            printf("  %-28s %10.0f\n", c.name.c_str(), c.average);
+        }
+    }
+}
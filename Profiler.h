@@ -0,0 +1,63 @@
+//
+// Profiler.h
+//
+// Named GPU counters, measured with OpenGL queries without stalling.
+//
+//   Each counter is a query target: GL_SAMPLES_PASSED counts the fragments
+//   that pass the depth test, GL_TIME_ELAPSED measures GPU time in nanoseconds.
+//   Each counter has a ring of Latency query objects, so results are read
+//   a few frames late, once they are available, and never waited for.
+//   Values are averaged over the recent frames.
+//
+//   As in OpenGL, only one query of each target can be active at a time.
+//
+// How to use:
+//    * Call Register() once per counter, with an OpenGL context current.
+//    * Each frame, bracket the work with Begin() and End(), then call EndFrame().
+//    * GetValue() returns the recent average; Print() prints all counters.
+//          GetNumCounters() and GetName() list them.
+//
+
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+
+class Profiler {
+public:
+    static const int Latency = 4;           // Frames of query objects per counter
+
+    // Returns the counter's id. Registering a name again returns the same id.
+    static int Register(const char* name, unsigned int target);
+
+    static void Begin(int id);
+    static void End(int id);
+    static void EndFrame();
+
+    static double GetValue(int id);         // Recent average: milliseconds for GL_TIME_ELAPSED
+    static bool HasValue(int id);
+    static void Print();
+
+    // For listing the counters, e.g., in the HUD.
+    static int GetNumCounters() { return (int)counters.size(); }
+    static const char* GetName(int id) { return counters[id].name.c_str(); }
+    static bool IsTimer(int id);            // Whether the value is a time, in milliseconds
+
+private:
+    struct Counter {
+        std::string name;
+        unsigned int target;
+        unsigned int queries[Latency];
+        bool pending[Latency];              // Issued, result not yet read
+        bool begun;                         // Begin() was called this frame
+        double average;
+        int numValues;
+    };
+
+    static std::vector<Counter> counters;
+    static int frame;
+};
+
+#endif  // PROFILER_H
@@ -32,9 +32,13 @@
 #ifndef BI_RGB
 #define BI_RGB 0
 #endif
+#ifndef BI_BITFIELDS
+#define BI_BITFIELDS 3
+#endif
 
 RgbImage::RgbImage( int numRows, int numCols )
 {
+	ImagePtr = 0;
     AllocateImageData(numRows, numCols);
 
     // Zero out the image
@@ -54,6 +58,7 @@ RgbImage::RgbImage( int numRows, int numCols )
 RgbImage::RgbImage(const RgbImage *image) {
 	NumCols = image->GetNumCols();
 	NumRows = image->GetNumRows();
+	NumChannels = image->GetNumChannels();
 	long size = NumRows*GetNumBytesPerRow();
 	unsigned char *fromImage = image->ImagePtr;
 	ImagePtr = new unsigned char[size];
@@ -73,6 +78,7 @@ RgbImage::RgbImage(const RgbImage *image) {
 /* ********************************************************************
  *  LoadBmpFile
  *  Read into memory an RGB image from an uncompressed BMP file.
+ *  32-bit BMP files (BI_RGB or BI_BITFIELDS) are read as RGBA images.
  *  Return true for success, false for failure.  Error code is available
  *     with a separate call.
  *  Author: Sam Buss December 2001.
@@ -89,6 +95,8 @@ bool RgbImage::LoadBmpFile( const char* filename )
 	}
 
 	bool fileFormatOK = false;
+	int numChannels = 3;
+	unsigned long redMask, greenMask, blueMask, alphaMask;
 	int bChar = fgetc( infile );
 	int mChar = fgetc( infile );
 	if ( bChar=='B' && mChar=='M' ) {			// If starts with "BM" for "BitMap"
@@ -105,30 +113,65 @@ bool RgbImage::LoadBmpFile( const char* filename )
 			compressionMethod = readLong(infile);
 			bytesRead += 4;
 		}
+		// 32-bit pixels: by default BGRA, as written by most programs. BI_BITFIELDS gives the masks.
+		redMask = 0x00ff0000;
+		greenMask = 0x0000ff00;
+		blueMask = 0x000000ff;
+		alphaMask = 0xff000000;
+		if ( bitsPerPixel==32 && compressionMethod==BI_BITFIELDS && headerSize >= 40 ) {
+			skipChars(infile, 20);				// Image size, resolution, colors used and important
+			redMask = readLong(infile);			// The masks follow the header (or are in it, for V4 and V5)
+			greenMask = readLong(infile);
+			blueMask = readLong(infile);
+			bytesRead += 32;
+			if (headerSize >= 56) {
+				alphaMask = readLong(infile);
+				bytesRead += 4;
+			}
+		}
 		skipChars(infile, offset - bytesRead);
 
-		if ( NumCols>0 && NumCols<=100000 && NumRows>0 && NumRows<=100000  
-			&& bitsPerPixel==24 && compressionMethod ==BI_RGB && !feof(infile) ) {
-			fileFormatOK = true;
+		if ( NumCols>0 && NumCols<=100000 && NumRows>0 && NumRows<=100000 && !feof(infile) ) {
+			if ( bitsPerPixel==24 && compressionMethod==BI_RGB ) {
+				fileFormatOK = true;
+				numChannels = 3;
+			}
+			else if ( bitsPerPixel==32 && (compressionMethod==BI_RGB || compressionMethod==BI_BITFIELDS) ) {
+				fileFormatOK = true;
+				numChannels = 4;
+			}
 		}
 	}
 	if ( !fileFormatOK ) {
 		Reset();
 		ErrorCode = FileFormatError;
-		fprintf(stderr, "Not a valid 24-bit, BI_RGB, bitmap file: %s.\n", filename);
+		fprintf(stderr, "Not a valid 24-bit or 32-bit, BI_RGB, bitmap file: %s.\n", filename);
 		fclose ( infile );
 		return false;
 	}
 
 	// Allocate memory
-    if (!AllocateImageData(NumRows, NumCols)) {
+    if (!AllocateImageData(NumRows, NumCols, numChannels)) {
 		fclose ( infile );
 		return false;
 	}
 
 	unsigned char* cPtr = ImagePtr;
+	bool anyAlpha = false;
 	for ( int i=0; i<NumRows; i++ ) {
 		int j;
+		if ( numChannels==4 ) {
+			for ( j=0; j<NumCols; j++ ) {
+				unsigned long pixel = (unsigned long)readLong( infile ) & 0xffffffff;
+				*cPtr = maskedChannel( pixel, redMask );
+				*(cPtr+1) = maskedChannel( pixel, greenMask );
+				*(cPtr+2) = maskedChannel( pixel, blueMask );
+				*(cPtr+3) = maskedChannel( pixel, alphaMask );
+				anyAlpha = anyAlpha || (*(cPtr+3) != 0);
+				cPtr += 4;
+			}
+			continue;						// No padding
+		}
 		for ( j=0; j<NumCols; j++ ) {
 			*(cPtr+2) = (unsigned char)fgetc( infile );	// Blue color value
 			*(cPtr+1) = (unsigned char)fgetc( infile );	// Green color value
@@ -141,6 +184,12 @@ bool RgbImage::LoadBmpFile( const char* filename )
 			*(cPtr++) = 0;
 		}
 	}
+	if ( numChannels==4 && !anyAlpha ) {
+		// The fourth byte was unused (as BI_RGB formally specifies): make the image opaque.
+		for ( long i=0; i<NumRows*NumCols; i++ ) {
+			ImagePtr[4*i+3] = 255;
+		}
+	}
 	if ( feof( infile ) ) {
 		fprintf( stderr, "Premature end of file: %s.\n", filename );
 		Reset();
@@ -185,6 +234,21 @@ long RgbImage::readLong( FILE* infile )
 	return ret;
 }
 
+// Extracts an 8-bit channel value from a 32-bit pixel, with the channel's mask from the BMP file.
+unsigned char RgbImage::maskedChannel( unsigned long pixel, unsigned long mask )
+{
+	if ( mask==0 ) {
+		return 0;
+	}
+	int shift = 0;
+	while ( ((mask>>shift)&1)==0 ) {
+		shift++;
+	}
+	unsigned long maxValue = mask>>shift;
+	unsigned long value = (pixel&mask)>>shift;
+	return (unsigned char)((value*255 + maxValue/2)/maxValue);
+}
+
 void RgbImage::skipChars( FILE* infile, int numChars )
 {
 	for ( int i=0; i<numChars; i++ ) {
@@ -220,7 +284,7 @@ bool RgbImage::WriteBmpFile( const char* filename )
 	writeLong( NumCols, outfile );				// width in pixels
 	writeLong( NumRows, outfile );				// height in pixels (pos for bottom up)
 	writeShort( 1, outfile );		// number of planes
-	writeShort( 24, outfile );		// bits per pixel
+	writeShort( 8*NumChannels, outfile );		// bits per pixel (32 bits for RGBA: BGRA order)
 	writeLong( 0, outfile );		// no compression
 	writeLong( 0, outfile );		// not used if no compression
 	writeLong( 0, outfile );		// Pixels per meter
@@ -237,10 +301,13 @@ bool RgbImage::WriteBmpFile( const char* filename )
 			fputc( *(cPtr+2), outfile);		// Blue color value
 			fputc( *(cPtr+1), outfile);		// Blue color value
 			fputc( *(cPtr+0), outfile);		// Blue color value
-			cPtr+=3;
+			if ( NumChannels==4 ) {
+				fputc( *(cPtr+3), outfile);		// Alpha value
+			}
+			cPtr+=NumChannels;
 		}
 		// Pad row to word boundary
-		int k=3*NumCols;					// Num bytes already read
+		int k=NumChannels*NumCols;			// Num bytes already read
 		for ( ; k<GetNumBytesPerRow(); k++ ) {
 			fputc( 0, outfile );				// Read and ignore padding;
 			cPtr++;
@@ -314,10 +381,13 @@ unsigned char RgbImage::doubleToUnsignedChar( double x )
 	}
 }
 
-bool RgbImage::AllocateImageData(int numRows, int numCols)
+bool RgbImage::AllocateImageData(int numRows, int numCols, int numChannels)
 {
+    assert(numChannels == 3 || numChannels == 4);
+    delete[] ImagePtr;
     NumRows = numRows;
     NumCols = numCols;
+    NumChannels = numChannels;
     ImagePtr = new unsigned char[NumRows*GetNumBytesPerRow()];
     if (!ImagePtr) {
         fprintf(stderr, "Unable to allocate memory for %ld x %ld buffer.\n",
@@ -330,6 +400,28 @@ bool RgbImage::AllocateImageData(int numRows, int numCols)
 }
 
 
+bool RgbImage::AddAlphaChannel()
+{
+    if (HasAlpha()) {
+        return true;
+    }
+    RgbImage rgb(this);
+    if (!AllocateImageData(rgb.GetNumRows(), rgb.GetNumCols(), 4)) {
+        return false;
+    }
+    for (long i = 0; i < NumRows; i++) {
+        for (long j = 0; j < NumCols; j++) {
+            const unsigned char* from = rgb.GetRgbPixel(i, j);
+            unsigned char* to = GetRgbPixel(i, j);
+            to[0] = from[0];
+            to[1] = from[1];
+            to[2] = from[2];
+            to[3] = 255;
+        }
+    }
+    return true;
+}
+
 // Bitmap file format  (24 bit/pixel form)		BITMAPFILEHEADER
 // Header (14 bytes)
 //	 2 bytes: "BM"
@@ -351,6 +443,9 @@ bool RgbImage::AllocateImageData(int numRows, int numCols)
 // "long int" really means "unsigned long int"
 // Pixel data: 3 bytes per pixel: RGB values (in reverse order).
 //	Rows padded to multiples of four.
+// 32 bit/pixel form: 4 bytes per pixel, BGRA, no padding. With compression
+//   BI_BITFIELDS (=3), the red, green and blue masks follow the info header;
+//   longer (V4, V5) headers also give the alpha mask.
 
 
 #ifndef RGBIMAGE_DONT_USE_OPENGL
@@ -377,7 +472,7 @@ bool RgbImage::LoadFromOpenglBuffer()					// Load the bitmap from the current Op
 	glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
 	// Get the frame buffer data.
-	glReadPixels( 0, 0, NumCols, NumRows, GL_RGB, GL_UNSIGNED_BYTE, ImagePtr);
+	glReadPixels( 0, 0, NumCols, NumRows, HasAlpha() ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, ImagePtr);
 
 	// Restore the row length in glPixelStorei  (really ought to restore alignment too).
 	if ( vWidth > NumCols ) {
@@ -412,7 +507,7 @@ bool RgbImage::DrawToOpenglBuffer()
 
 	// Upload the frame buffer data.
 	glRasterPos2i(0,0);		// Position at base of window
-	glDrawPixels( NumCols, NumRows, GL_RGB, GL_UNSIGNED_BYTE, ImagePtr);
+	glDrawPixels( NumCols, NumRows, HasAlpha() ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, ImagePtr);
 
 	// Restore the row length in glPixelStorei  (really ought to restore alignment too).
 	if ( vWidth > NumCols ) {
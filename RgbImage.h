@@ -42,13 +42,17 @@ public:
 	bool LoadFromOpenglBuffer();					// Load the bitmap from the current OpenGL buffer
 	bool DrawToOpenglBuffer();						// Draw the bitmap into the current OpenGL buffer
 #endif
-    bool AllocateImageData(int numRows, int numCols);  // Allocate a bitmap (uninitialized) of this size.   
+    bool AllocateImageData(int numRows, int numCols, int numChannels = 3);  // Allocate a bitmap (uninitialized) of this size.   
 	void Reset();			// Frees image data memory
 
 	long GetNumRows() const { return NumRows; }
 	long GetNumCols() const { return NumCols; }
+	// 3 channels (RGB), or 4 (RGBA) for images loaded from 32-bit BMP files.
+	int GetNumChannels() const { return NumChannels; }
+	bool HasAlpha() const { return NumChannels == 4; }
+	bool AddAlphaChannel();		// Converts an RGB image to RGBA, with alpha 255
 	// Rows are word aligned
-	long GetNumBytesPerRow() const { return ((3*NumCols+3)>>2)<<2; }	
+	long GetNumBytesPerRow() const { return ((NumChannels*NumCols+3)>>2)<<2; }	
 	const void* ImageData() const { return (void*)ImagePtr; }
     bool ImageLoaded() const { return (ImagePtr != 0); }  // Is an image loaded?
 
@@ -61,12 +65,16 @@ public:
 	void SetRgbPixelc( long row, long col, 
 					   unsigned char red, unsigned char green, unsigned char blue );
 
+	// Alpha values, for RGBA images only.
+	unsigned char GetAlpha( long row, long col ) const { assert(HasAlpha()); return GetRgbPixel(row, col)[3]; }
+	void SetAlpha( long row, long col, unsigned char alpha ) { assert(HasAlpha()); GetRgbPixel(row, col)[3] = alpha; }
+
 	// Error reporting. (errors also print message to stderr)
 	int GetErrorCode() const { return ErrorCode; }
 	enum {
 		NoError = 0,
 		OpenError = 1,			// Unable to open file for reading
-		FileFormatError = 2,	// Not recognized as a 24 bit BMP file
+		FileFormatError = 2,	// Not recognized as a 24 bit or 32 bit BMP file
 		MemoryError = 3,		// Unable to allocate memory for image data
 		ReadError = 4,			// End of file reached prematurely
 		WriteError = 5			// Unable to write out data (or no data to write out)
@@ -76,6 +84,7 @@ private:
 	unsigned char* ImagePtr;	// array of pixel values (integers range 0 to 255)
 	long NumRows;				// number of rows in image
 	long NumCols;				// number of columns in image
+	int NumChannels;			// 3 for RGB, 4 for RGBA
 	int ErrorCode;				// error code
 
 	static short readShort( FILE* infile );
@@ -85,6 +94,7 @@ private:
 	static void writeShort( short data, FILE* outfile );
 	
 	static unsigned char doubleToUnsignedChar( double x );
+	static unsigned char maskedChannel( unsigned long pixel, unsigned long mask );
 
 };
 
@@ -92,6 +102,7 @@ inline RgbImage::RgbImage()
 { 
 	NumRows = 0;
 	NumCols = 0;
+	NumChannels = 3;
 	ImagePtr = 0;
 	ErrorCode = 0;
 }
@@ -100,6 +111,7 @@ inline RgbImage::RgbImage( const char* filename )
 {
 	NumRows = 0;
 	NumCols = 0;
+	NumChannels = 3;
 	ImagePtr = 0;
 	ErrorCode = 0;
 	LoadBmpFile( filename );
@@ -110,12 +122,12 @@ inline RgbImage::~RgbImage()
 	delete[] ImagePtr;
 }
 
-// Returned value points to three "unsigned char" values for R,G,B
+// Returned value points to three "unsigned char" values for R,G,B (followed by A for RGBA images)
 inline const unsigned char* RgbImage::GetRgbPixel( long row, long col ) const
 {
 	assert ( row<NumRows && col<NumCols );
 	const unsigned char* ret = ImagePtr;
-	long i = row*GetNumBytesPerRow() + 3*col;
+	long i = row*GetNumBytesPerRow() + NumChannels*col;
 	ret += i;
 	return ret;
 }
@@ -124,7 +136,7 @@ inline unsigned char* RgbImage::GetRgbPixel( long row, long col )
 {
 	assert ( row<NumRows && col<NumCols );
 	unsigned char* ret = ImagePtr;
-	long i = row*GetNumBytesPerRow() + 3*col;
+	long i = row*GetNumBytesPerRow() + NumChannels*col;
 	ret += i;
 	return ret;
 }
@@ -153,6 +165,7 @@ inline void RgbImage::Reset()
 {
 	NumRows = 0;
 	NumCols = 0;
+	NumChannels = 3;
 	delete[] ImagePtr;
 	ImagePtr = 0;
 	ErrorCode = 0;
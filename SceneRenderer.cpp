@@ -24,6 +24,29 @@
 #include "GlGeomCylinder.h"
 #include "GlGeomCone.h"
 #include "GlGeomSphere.h"
+#include "GlGeomModel.h"
+#include "TreeVariantPool.h"
+#include "TreeGenerator.h"
+#include "HiZCuller.h"
+#include "TreeGpuCuller.h"
+#include "VertexPullPool.h"
+#include "TextureStreamer.h"
+#include "FrameGraph.h"
+#include "PostProcess.h"
+#include "Ssao.h"
+#include "Profiler.h"
+#include "SlalomCourse.h"
+#include "FlowField.h"
+#include "AiSkiers.h"
+#include "ObstacleGrid.h"
+#include "LightBaker.h"
+#include "TerrainChunks.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <float.h>
+#include <mutex>
+#include <thread>
 
 // **********************************
 // Material to underlie a texture map.
@@ -33,6 +56,8 @@ phMaterial materialUnderTexture;
 
 // **************************
 // Information for loading textures
+//    The textures are streamed (see TextureStreamer.h): each frame, noteTextureUses()
+//    reports how large they appear on screen.
 // **************************
 const int NumTextures = 6;
 unsigned int TextureNames[NumTextures];     // Texture names generated by OpenGL
@@ -45,15 +70,116 @@ const char* TextureFiles[NumTextures] = {
     "resources/blue.bmp"
 };
 
+// The leaf cards of the tree variants need an RGBA texture (a 32-bit BMP file).
+//    Without the file, one is made from the leaves texture (TextureFiles[2]).
+const char* LeafCardFile = "resources/leaf_card.bmp";
+unsigned int leafCardTexture;
+
+// World extent covered by the full width of each texture, for streaming.
+const float BarkTextureExtent = 2.0f;       // Bark of the tree variants: one repeat per 2 units of branch
+const float TrunkTextureExtent = 3.0f;      // Around the trunk cylinder (radius 0.5)
+const float ConeTextureExtent = 15.0f;      // Around the leaves cone (radius 2.5)
+const float LeafCardExtent = 3.0f;          // Width of a leaf card
+const float SkierTextureExtent = 1.0f;
+const float FloorTextureExtent = 40.0f;
+
 // Initialize shapes
 GlGeomCylinder cylinders(meshRes, meshRes, meshRes);
 GlGeomCone cones(meshRes, meshRes, meshRes);
 GlGeomSphere spheres(meshRes, meshRes);
 
+// Custom models, made with tools/MeshConvert. When a model file is present it
+//    replaces the trees or the skier built from the shapes above.
+GlGeomModel treeModel;
+GlGeomModel skierModel;
+const char* TreeModelFile = "resources/tree.glgm";
+const char* SkierModelFile = "resources/skier.glgm";
+
 const int treeCount = 100;
 
+// Wind sway amplitudes (see vertexShader_Wind), in model coordinates.
+const float ConeWindAmplitude = 0.15f;      // The leaves cone: scaled by 2.5 horizontally
+const float VariantWindAmplitude = 0.5f;    // Procedural tree variants
+const float ModelWindScale = 0.04f;         // Custom tree models: times the height of the model
+
+// Occlusion culling of trees (see HiZCuller.h). The nearest trees are the occluders.
+bool occlusionCulling = true;
+const int MaxOccluderTrees = 24;
+const float OccluderMaxDepth = 40.0f;
+
+// GPU-driven culling of the tree variants (see TreeGpuCuller.h), when OpenGL 4.3 is available.
+bool gpuCulling = true;
+bool gpuCullingUsed = false;                // Whether the last frame culled the trees on the GPU
+
+// The opaque geometry is drawn front to back, as a list of draw items.
+//    With the depth prepass, it is drawn twice: first with depth-only programs,
+//    then with lighting, only for the fragments that are visible (GL_EQUAL depth test).
+bool depthPrepass = true;
+
+// Shading level of detail: the draw items farther than gouraudDistance (their depth, as below)
+//    are lit per vertex, with phShaderPhongGouraud or shaderProgramWindGouraud, so each of their
+//    fragments only interpolates and looks up the texture. They are small on the screen, so the
+//    lighting between their vertices is not missed. The floor and the wall, from near to far, and
+//    the leaf cards, lit on both sides, are always lit per fragment.
+float gouraudDistance = 25.0f;
+
+// Baked lighting (see LightBaker.h): light 0 is baked into the tree variants and the terrain
+//    chunks, as a directional light toward it from BakeLightTarget, in front of the camera where
+//    the trees are seen. Baked trees are lit per fragment at every distance, as the Gouraud
+//    programs would lose their ambient occlusion and shadows; their fragments are cheap anyway.
+bool bakedLighting = true;
+const float BakeLightTarget[3] = { 0.0f, 5.0f, -20.0f };
+
+enum DrawItemKind { DrawSkier, DrawPlayer, DrawAiSkier, DrawNetworkSkier, DrawTrunk, DrawTreeSwaying, DrawTreesGpuCulled, DrawGate, DrawWall, DrawTerrain, DrawFloor };
+struct DrawItem {
+    float depth;            // Distance in front of the camera: nearest first
+    DrawItemKind kind;
+    int tree;               // Index of the tree (or of the gate, skier, other player's view or terrain chunk), or -1
+};
+
+// Split screen: the culling and the draw items of each player's view. The views share
+//    everything else: the trees, the textures, and the buffers of the GPU culling.
+//    The CPU culling of the views is independent, so each view after the first has a
+//    worker thread, started with the first frame that has the view and woken each frame.
+struct ViewState {
+    SceneView view;
+    HiZCuller occlusionCuller;
+    std::vector<unsigned char> treeVisible;                 // Set each frame by cullTrees()
+    std::vector<std::pair<float, int>> occluderCandidates;  // Depth and index of nearby trees
+    std::vector<DrawItem> drawItems;                        // Rebuilt each frame by makeDrawItems()
+    int numCutawayTrees;
+    double cullMs;                                          // CPU time culling the view, last frame
+};
+ViewState viewStates[MaxSceneViews];
+int numSceneViews = 1;
+int litFragmentsCounter = -1;               // Profiler counters, for the overdraw statistics
+int prepassFragmentsCounter = -1;
+std::vector<std::pair<float, float>> frameLocs;    // The trees of the current frame, for the render passes
+
+// The slalom course, placed among the trees.
+SlalomCourse slalomCourse;
+const float GatePoleRadius = 0.06f;
+const float GatePoleHeight = 1.8f;
+const float GateDrawDistance = 120.0f;          // Gates farther than this are not drawn
+
+// The AI skiers, and the flow field that steers them.
+FlowField flowField;
+AiSkiers aiSkiers;
+const float AiSkierDrawDistance = 120.0f;
+
+// The trees, for ray queries. Trees between the camera and the skier are cut away.
+ObstacleGrid obstacleGrid;
+bool cameraCutaway = true;
+int numCutawayTrees = 0;
+
+// The leaf cards are drawn after the opaque geometry, front to back, alpha tested.
+//    With multisampling, alpha to coverage gives them antialiased edges.
+bool alphaToCoverage = true;
+
 // Initialize RNG
 int random[1000];
+unsigned int forestSeed = 0;
+std::vector<NetworkSkier> networkSkiers;
 
 // Animation stuff 
 //double animateIncrement = 0.01;   // Make bigger to speed up animation, smaller to slow it down.
@@ -68,18 +194,59 @@ const int iFloor = 0;
 const int iLeaf = 1;
 const int iWall = 2;            // RESERVED FOR USE BY 155A PROJECT
 
+// The floor quad, which stays in front of the camera: x from -FloorMaxX to FloorMaxX, z from FloorMinZ to FloorMaxZ.
+const float FloorMaxX = 20.0f;
+const float FloorMinZ = -35.0f;
+const float FloorMaxZ = 20.0f;
+
 unsigned int myVBO[NumObjects];  // a Vertex Buffer Object holds an array of data
 unsigned int myVAO[NumObjects];  // a Vertex Array Object - holds info about an array of vertex data;
 unsigned int myEBO[NumObjects];  // a Element Array Buffer Object - holds an array of elements (vertex indices)
 
-// Sets up RNG for tree generation, called only once
+// Sets up RNG for tree generation, called only once. A networked race's server chooses the seed.
 void setupRNG() {
-    srand(time(NULL));
+    if (forestSeed == 0) {
+        forestSeed = (unsigned int)time(NULL);
+    }
+    srand(forestSeed);
     for (int i = 0; i < 1000; i++) {
         random[i] = rand();
     }
 }
 
+// Loads a custom model if its file exists; a missing file is not an error.
+void LoadOptionalModel(GlGeomModel& model, const char* filename) {
+    FILE* infile = fopen(filename, "rb");
+    if (infile == 0) {
+        return;
+    }
+    fclose(infile);
+    if (model.Load(filename, vertPos_loc, vertNormal_loc, vertTexCoords_loc)) {
+        model.LoadTextures();
+    }
+}
+
+// Renders one LOD level of a custom model, loading each submesh's material first.
+void renderModel(GlGeomModel& model, int lod) {
+    phMaterial mat;
+    const GlgmLod& theLod = model.GetLod(lod);
+    for (unsigned int i = theLod.firstSubmesh; i < theLod.firstSubmesh + theLod.numSubmeshes; i++) {
+        int iMaterial = model.GetSubmesh(i).materialIndex;
+        const GlgmMaterial& m = model.GetMaterial(iMaterial);
+        mat.AmbientColor.Load(m.ambientColor);
+        mat.DiffuseColor.Load(m.diffuseColor);
+        mat.SpecularColor.Load(m.specularColor);
+        mat.SpecularExponent = m.specularExponent;
+        mat.LoadIntoShaders();
+        unsigned int texture = model.GetMaterialTexture(iMaterial);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glUniform1i(applyTextureLocation, texture != 0);
+        model.RenderSubmesh(i);
+    }
+    glUniform1i(applyTextureLocation, false);
+    materialUnderTexture.LoadIntoShaders();
+}
+
 // ********************************************
 // This sets up for texture maps. It is called only once
 // ********************************************
@@ -97,38 +264,36 @@ void SetupForTextures()
 	// ***********************************************
     RgbImage texMap;
 
-    glUseProgram(shaderProgramBitmap);
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(NumTextures, TextureNames);
+    TextureStreamer::Start();
     for (int i = 0; i < NumTextures; i++) {
-        texMap.LoadBmpFile(TextureFiles[i]);            // Read i-th texture from the i-th file.
-        glBindTexture(GL_TEXTURE_2D, TextureNames[i]);  // Bind (select) the i-th OpenGL texture
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        // Set best quality filtering.   Also see below for disabling mipmaps.
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);  // Requires that mipmaps be generated (see below)
-        // You may also try GL_LINEAR_MIPMAP_NEAREST -- try looking at the wall from a 30 degree angle, and look for sweeping transitions.
-
-        // Store the texture into the OpenGL texture named TextureNames[i]
-        int textureWidth = texMap.GetNumCols();
-        int textureHeight = texMap.GetNumRows();
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textureWidth, textureHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, texMap.ImageData());
- #if 1
-        // Use mipmaps  (Best!)
-        glGenerateMipmap(GL_TEXTURE_2D);
-#else
-        // Don't use mipmaps.  Try moving away from the brick wall a great distance
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-#endif
-
-    }
-
-    // Make sure that the shaderProgramBitmap uses the GL_TEXTURE_0 texture.
-    glUseProgram(shaderProgramBitmap);
-    glUniform1i(glGetUniformLocation(shaderProgramBitmap, "theTextureMap"), 0);
+        TextureNames[i] = TextureStreamer::Register(TextureFiles[i], GL_REPEAT);   // Loaded in the background
+    }
+
+    // The leaf card texture. It is clamped, so the cut-out edges do not wrap around.
+    FILE* infile = fopen(LeafCardFile, "rb");
+    bool haveCardFile = (infile != 0);
+    if (infile != 0) {
+        fclose(infile);
+    }
+    RgbImage cardMap;
+    if (!haveCardFile || !cardMap.LoadBmpFile(LeafCardFile) || !cardMap.HasAlpha()) {
+        if (haveCardFile) {
+            fprintf(stderr, "%s has no alpha channel: making the leaf cards from %s.\n", LeafCardFile, TextureFiles[2]);
+        }
+        texMap.LoadBmpFile(TextureFiles[2]);
+        TreeGenerator::MakeLeafCardImage(texMap, &cardMap);
+    }
+    leafCardTexture = TextureStreamer::Register(cardMap, "leaf cards", GL_CLAMP_TO_EDGE);
+
+    // Make sure that the shader programs use the GL_TEXTURE_0 texture.
+    unsigned int texturedPrograms[12] = { shaderProgramBitmap, shaderProgramWind, shaderProgramWindInstanced,
+        shaderProgramFoliage, shaderProgramFoliageInstanced, phShaderPhongGouraud, shaderProgramWindGouraud,
+        shaderProgramBaked, shaderProgramWindBaked, shaderProgramWindInstancedBaked, shaderProgramFoliageBaked,
+        shaderProgramFoliageInstancedBaked };
+    for (unsigned int program : texturedPrograms) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "theTextureMap"), 0);
+    }
     glActiveTexture(GL_TEXTURE0);
 
     setupRNG();
@@ -139,6 +304,13 @@ void MySetupSurfaces() {
     cylinders.InitializeAttribLocations(vertPos_loc, vertNormal_loc, vertTexCoords_loc);
     cones.InitializeAttribLocations(vertPos_loc, vertNormal_loc, vertTexCoords_loc);
     spheres.InitializeAttribLocations(vertPos_loc, vertNormal_loc, vertTexCoords_loc);
+    LoadOptionalModel(treeModel, TreeModelFile);
+    LoadOptionalModel(skierModel, SkierModelFile);
+
+    // Procedural tree variants are built, then baked, in the background; see RenderScene().
+    LightBaker::SetLightDirection(myLightPositions[0].x - BakeLightTarget[0], myLightPositions[0].y - BakeLightTarget[1],
+        myLightPositions[0].z - BakeLightTarget[2]);
+    TreeVariantPool::StartBuild(vertPos_loc, vertNormal_loc, vertTexCoords_loc, bakedLight_loc);
 
     // Initialize the VAO's, VBO's and EBO's for the ground plane, the back wall
     // and the surface of rotation. Gives them the "vertPos" location,
@@ -197,6 +369,23 @@ void renderTrunk(float x, float z, float xPos, float zPos) {
     cylinders.RenderBase();
 }
 
+// The two poles of a gate, as thin cylinders, red or blue.
+void renderGate(const SlalomCourse::Gate& gate, float xPos, float zPos) {
+    float matEntries[16];
+    glBindTexture(GL_TEXTURE_2D, TextureNames[gate.red ? 4 : 5]);
+    glUniform1i(applyTextureLocation, true);
+    for (int pole = 0; pole < 2; pole++) {
+        LinearMapR4 mat = viewMatrix;
+        mat.Mult_glTranslate((pole == 0 ? gate.leftX : gate.rightX) + xPos, 0.5f * GatePoleHeight,
+            (pole == 0 ? gate.leftZ : gate.rightZ) + zPos);
+        mat.Mult_glScale(GatePoleRadius, 0.5f * GatePoleHeight, GatePoleRadius);
+        mat.DumpByColumns(matEntries);
+        glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+        cylinders.RenderSide();
+        cylinders.RenderTop();
+    }
+}
+
 void renderLeaves(float x, float z, float xPos, float zPos) {
     LinearMapR4 mat = viewMatrix;
     float matEntries[16];
@@ -213,11 +402,309 @@ void renderLeaves(float x, float z, float xPos, float zPos) {
     cones.RenderBase();
 }
 
-void renderTree(float x, float z, float xPos, float zPos) {
-    renderTrunk(x, z, xPos, zPos);
+// Renders the bark of one of the procedural tree variants from the shared pool.
+//    Its leaf cards are drawn later, by renderTreeVariantLeaves().
+void renderTreeVariant(float x, float z, float xPos, float zPos, int variant) {
+    LinearMapR4 mat = viewMatrix;
+    float matEntries[16];
+    mat.Mult_glTranslate(x + xPos, 0.0f, z + zPos);
+    mat.DumpByColumns(matEntries);
+    glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+    glUniform1i(applyTextureLocation, true);
+    glBindTexture(GL_TEXTURE_2D, TextureNames[0]);
+    TreeVariantPool::RenderBark(variant);
+}
+
+// Renders the leaf cards of a tree variant. The shaderProgramFoliage program must be selected.
+void renderTreeVariantLeaves(float x, float z, float xPos, float zPos, int variant) {
+    LinearMapR4 mat = viewMatrix;
+    float matEntries[16];
+    mat.Mult_glTranslate(x + xPos, 0.0f, z + zPos);
+    mat.DumpByColumns(matEntries);
+    glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+    glUniform1i(applyTextureLocation, true);
+    glBindTexture(GL_TEXTURE_2D, leafCardTexture);
+    TreeVariantPool::RenderLeaves(variant);
+}
+
+// Sets the wind sway for the kind of tree being drawn (see vertexShader_Wind).
+// A program that sways trees must be selected.
+void setWindParams() {
+    unsigned int paramsLoc = windParamsLoc;
+    if (treeModel.IsLoaded()) {
+        float height = treeModel.GetBoundsMax()[1] - treeModel.GetBoundsMin()[1];
+        glUniform3f(paramsLoc, ModelWindScale * height, treeModel.GetBoundsMin()[1], 1.0f / height);
+    }
+    else if (TreeVariantPool::IsReady()) {
+        glUniform3f(paramsLoc, VariantWindAmplitude, 0.0f, 1.0f / 16.0f);
+    }
+    else {
+        glUniform3f(paramsLoc, ConeWindAmplitude, -1.0f, 0.5f);    // The leaves cone: y from -1 to 1
+    }
+}
+
+// Renders the opaque parts of a tree that sway in the wind: all of it, except for the
+//    trunk of a tree made from a cylinder and a cone, and the leaf cards of a tree variant.
+// The shaderProgramWind program (or shaderProgramWindGouraud) must be selected.
+void renderTreeSwaying(float x, float z, float xPos, float zPos, int variant) {
+    if (treeModel.IsLoaded()) {
+        LinearMapR4 mat = viewMatrix;
+        float matEntries[16];
+        float xActual = x + xPos;
+        float zActual = z + zPos;
+        mat.Mult_glTranslate(xActual, 0.0f, zActual);
+        mat.DumpByColumns(matEntries);
+        glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+        renderModel(treeModel, treeModel.SelectLod(sqrtf(xActual * xActual + zActual * zActual)));
+        return;
+    }
+    if (TreeVariantPool::IsReady()) {
+        renderTreeVariant(x, z, xPos, zPos, variant);
+        return;
+    }
     renderLeaves(x, z, xPos, zPos);
 }
 
+// The procedural tree variant used by the i-th tree.
+// It comes from the other end of the random table from the tree's x position.
+int treeVariant(int i) {
+    return random[999 - i] % TreeVariantPool::NumVariants;
+}
+
+// Bounding box of a tree at world position (x,z), with room for the wind sway.
+void getTreeBounds(float x, float z, int variant, float* boxMin, float* boxMax) {
+    const float* treeMin;
+    const float* treeMax;
+    float sway;
+    static const float coneMin[3] = { -2.5f, -2.0f, -2.5f };    // The leaves cone contains the trunk
+    static const float coneMax[3] = { 2.5f, 14.0f, 2.5f };
+    if (treeModel.IsLoaded()) {
+        treeMin = treeModel.GetBoundsMin();
+        treeMax = treeModel.GetBoundsMax();
+        sway = ModelWindScale * (treeMax[1] - treeMin[1]);
+    }
+    else if (TreeVariantPool::IsReady()) {
+        treeMin = TreeVariantPool::GetBoundsMin(variant);
+        treeMax = TreeVariantPool::GetBoundsMax(variant);
+        sway = VariantWindAmplitude;
+    }
+    else {
+        treeMin = coneMin;
+        treeMax = coneMax;
+        sway = 2.5f * ConeWindAmplitude;
+    }
+    boxMin[0] = x + treeMin[0] - sway;
+    boxMin[1] = treeMin[1];
+    boxMin[2] = z + treeMin[2] - sway;
+    boxMax[0] = x + treeMax[0] + sway;
+    boxMax[1] = treeMax[1];
+    boxMax[2] = z + treeMax[2] + sway;
+}
+
+// Adds the occluders for a tree at world position (x,z): the cross sections of its
+//    solid cones through their axes, facing the camera. "right" is the horizontal
+//    direction to the right of the camera. The cross sections are shrunk
+//    about an interior point, so that they stay inside the cones as they sway.
+void addTreeOccluders(HiZCuller& occlusionCuller, float x, float z, int variant, const float* right) {
+    if (treeModel.IsLoaded()) {
+        return;             // Nothing is known about the shape of custom models
+    }
+    if (!TreeVariantPool::IsReady()) {
+        // The leaves cone: apex at y=14, base of radius 2.5 at y=-2. Shrink about its incenter.
+        const float f = 0.8f;
+        const float yIn = 0.14f;
+        float tri[9] = {
+            x, yIn + f * (14.0f - yIn), z,
+            x - f * 2.5f * right[0], yIn + f * (-2.0f - yIn), z - f * 2.5f * right[2],
+            x + f * 2.5f * right[0], yIn + f * (-2.0f - yIn), z + f * 2.5f * right[2] };
+        occlusionCuller.AddOccluderPolygon(tri, 3);
+        return;
+    }
+    for (const TreeOccluder& o : TreeVariantPool::GetOccluders(variant)) {
+        float f = 1.0f - VariantWindAmplitude / o.radius;
+        if (f <= 0.0f) {
+            continue;
+        }
+        float cx = x + o.x;
+        float cz = z + o.z;
+        float r = f * o.radius;
+        float rhombus[12] = {
+            cx, o.yRing + f * (o.yTop - o.yRing), cz,
+            cx - r * right[0], o.yRing, cz - r * right[2],
+            cx, o.yRing - f * (o.yRing - o.yBottom), cz,
+            cx + r * right[0], o.yRing, cz + r * right[2] };
+        occlusionCuller.AddOccluderPolygon(rhombus, 4);
+    }
+}
+
+// Rasterizes the nearest trees as occluders, and builds the view's Hi-Z pyramid.
+void buildOccluders(const std::vector<std::pair<float, float>>& locs, ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
+    HiZCuller& occlusionCuller = vs.occlusionCuller;
+    std::vector<std::pair<float, int>>& occluderCandidates = vs.occluderCandidates;
+    LinearMapR4 viewProj = theProjectionMatrix * viewMatrix;
+    float vp[16];
+    float view[16];
+    viewProj.DumpByColumns(vp);
+    viewMatrix.DumpByColumns(view);
+    float right[3] = { view[0], 0.0f, view[8] };     // First row of the view matrix
+    float len = sqrtf(right[0] * right[0] + right[2] * right[2]);
+    right[0] /= len;
+    right[2] /= len;
+
+    occlusionCuller.BeginFrame(vp);
+    occluderCandidates.clear();
+    for (int i = 0; i < (int)locs.size(); i++) {
+        float x = locs[i].first + xPos;
+        float z = locs[i].second + zPos;
+        float depth = vp[3] * x + vp[11] * z + vp[15];     // w of the base of the trunk
+        if (depth > 0.0f && depth < OccluderMaxDepth) {
+            occluderCandidates.push_back(std::make_pair(depth, i));
+        }
+    }
+    int numOccluders = std::min((int)occluderCandidates.size(), MaxOccluderTrees);
+    std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + numOccluders, occluderCandidates.end());
+    for (int k = 0; k < numOccluders; k++) {
+        int i = occluderCandidates[k].second;
+        addTreeOccluders(occlusionCuller, locs[i].first + xPos, locs[i].second + zPos, treeVariant(i), right);
+    }
+    occlusionCuller.BuildPyramid();
+}
+
+// Hides the trees that block the camera's view of the skier: segments from the camera
+//    to the skier's feet, body and head, walked through the obstacle grid.
+void cutAwayTrees(ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
+    std::vector<unsigned char>& treeVisible = vs.treeVisible;
+    vs.numCutawayTrees = 0;
+    if (!cameraCutaway || obstacleGrid.GetNumTrees() != (int)treeVisible.size()) {
+        return;
+    }
+    // The camera is at -R^T t, for the view matrix [R t]; less the offset, in the world.
+    float m[16];
+    viewMatrix.DumpByColumns(m);
+    float eye[3];
+    for (int k = 0; k < 3; k++) {
+        eye[k] = -(m[4 * k] * m[12] + m[4 * k + 1] * m[13] + m[4 * k + 2] * m[14]);
+    }
+    eye[0] -= xPos;
+    eye[2] -= zPos;
+
+    const float skierHeights[3] = { 0.5f, 2.0f, 3.5f };
+    ObstacleGrid::Ray rays[3];
+    for (int i = 0; i < 3; i++) {
+        float target[3] = { -1.5f - xPos, skierHeights[i], -zPos };
+        for (int k = 0; k < 3; k++) {
+            rays[i].origin[k] = eye[k];
+            rays[i].dir[k] = target[k] - eye[k];
+        }
+        rays[i].maxT = 1.0f;
+    }
+    int blocking[16];
+    for (const ObstacleGrid::Ray& ray : rays) {
+        int n = obstacleGrid.RaycastAll(ray, blocking, 16);
+        for (int j = 0; j < n; j++) {
+            vs.numCutawayTrees += treeVisible[blocking[j]];
+            treeVisible[blocking[j]] = 0;
+        }
+    }
+}
+
+// Decides which trees to draw in the view, setting its treeVisible.
+// The nearest trees are rasterized as occluders, then every tree is tested against them.
+void cullTrees(const std::vector<std::pair<float, float>>& locs, ViewState& vs) {
+    vs.treeVisible.assign(locs.size(), 1);
+    cutAwayTrees(vs);
+    if (!occlusionCulling) {
+        return;
+    }
+    buildOccluders(locs, vs);
+    for (int i = 0; i < (int)locs.size(); i++) {
+        float boxMin[3], boxMax[3];
+        getTreeBounds(locs[i].first + vs.view.xPos, locs[i].second + vs.view.zPos, treeVariant(i), boxMin, boxMax);
+        vs.treeVisible[i] = vs.treeVisible[i] && vs.occlusionCuller.IsVisible(boxMin, boxMax);
+    }
+}
+
+// Whether the tree variants can be culled and drawn by TreeGpuCuller.
+//    The instances are uploaded the first time.
+bool useGpuCulling(const std::vector<std::pair<float, float>>& locs) {
+    if (!gpuCulling || !TreeGpuCuller::IsSupported() || !TreeVariantPool::IsReady() || treeModel.IsLoaded()) {
+        return false;
+    }
+    if (!TreeGpuCuller::IsSetUp()) {
+        std::vector<TreeInstance> trees(locs.size());
+        for (int i = 0; i < (int)locs.size(); i++) {
+            trees[i].x = locs[i].first;
+            trees[i].z = locs[i].second;
+            trees[i].windPhase = (float)(random[999 - i] % 628) * 0.01f;
+            trees[i].variant = (float)treeVariant(i);
+        }
+        if (!TreeGpuCuller::Setup(trees, VariantWindAmplitude, treeInstance_loc, bakedLight_loc)) {
+            gpuCulling = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Culls all the trees on the GPU for the view, with the optional Hi-Z occluders from the CPU.
+//    The views share TreeGpuCuller's buffers, so each view's passes run before the next view culls.
+void cullTreesGpu(const std::vector<std::pair<float, float>>& locs, ViewState& vs) {
+    LinearMapR4 modelview = viewMatrix;
+    modelview.Mult_glTranslate(vs.view.xPos, 0.0f, vs.view.zPos);
+    LinearMapR4 viewProj = theProjectionMatrix * modelview;
+    float matEntries[16];
+    viewProj.DumpByColumns(matEntries);
+    if (occlusionCulling) {
+        buildOccluders(locs, vs);
+    }
+    TreeGpuCuller::Cull(matEntries, occlusionCulling ? &vs.occlusionCuller : 0);
+}
+
+// Draws the bark, or the leaf cards, of the trees culled by cullTreesGpu().
+// The shaderProgramWindInstanced, or shaderProgramFoliageInstanced, program must be selected.
+void renderTreesGpuCulled(float xPos, float zPos, bool leaves) {
+    LinearMapR4 modelview = viewMatrix;
+    modelview.Mult_glTranslate(xPos, 0.0f, zPos);
+    float matEntries[16];
+    modelview.DumpByColumns(matEntries);
+    glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+    glUniform1i(applyTextureLocation, true);
+    if (leaves) {
+        TreeGpuCuller::RenderLeaves(leafCardTexture);
+    }
+    else {
+        TreeGpuCuller::RenderBark(TextureNames[0]);
+    }
+    glUniform1i(applyTextureLocation, false);
+}
+
+void PrintCullingStats() {
+    const HiZCuller& occlusionCuller = viewStates[0].occlusionCuller;
+    if (numSceneViews > 1) {
+        printf("Split screen, %d views: the first view's culling.\n", numSceneViews);
+        for (int v = 0; v < numSceneViews; v++) {
+            printf("  View %d: %.3f ms culling on the CPU.\n", v + 1, viewStates[v].cullMs);
+        }
+    }
+    if (!occlusionCulling) {
+        printf("Occlusion culling is off.\n");
+    }
+    else if (gpuCullingUsed) {
+        printf("Occlusion culling: %d occluders.\n", occlusionCuller.GetNumOccluderPolygons());
+    }
+    else {
+        printf("Occlusion culling: %d occluders, %d of %d trees culled.\n", occlusionCuller.GetNumOccluderPolygons(),
+            occlusionCuller.GetNumCulled(), occlusionCuller.GetNumTested());
+    }
+    if (gpuCullingUsed) {
+        TreeGpuCuller::PrintStats();
+    }
+}
+
 std::vector<std::pair<float, float>> randomTreeGen(float xPos, float zPos) {
     float x = -10.0f;
     float z = -5.0f;
@@ -240,10 +727,51 @@ std::vector<std::pair<float, float>> randomTreeGen(float xPos, float zPos) {
     return locs;
 }
 
+void SetupCourse(bool giantSlalom) {
+    slalomCourse.Generate(randomTreeGen(0.0f, 0.0f), giantSlalom ? SlalomCourse::GiantSlalom : SlalomCourse::Slalom);
+}
+
+void SetupObstacleGrid() {
+    obstacleGrid.Build(randomTreeGen(0.0f, 0.0f));
+}
+
+// The terrain chunks are baked against the obstacle grid, so it must be built first.
+void SetupTerrain() {
+    TerrainChunks::Setup(obstacleGrid, vertPos_loc, vertNormal_loc, vertTexCoords_loc, bakedLight_loc);
+}
+
+void PrintBakeStats() {
+    const char* names[2] = { "Tree variants", "Terrain chunks" };
+    const LightBaker* bakers[2] = { &TreeVariantPool::GetBaker(), &TerrainChunks::GetBaker() };
+    for (int i = 0; i < 2; i++) {
+        if (bakers[i]->IsDone()) {
+            printf("%s: baked in %.0f ms, %.1f million rays.\n", names[i], bakers[i]->GetMilliseconds(),
+                1.0e-6 * (double)bakers[i]->GetNumRays());
+        }
+        else {
+            printf("%s: %s.\n", names[i], bakers[i]->IsBaking() ? "baking" : "not started");
+        }
+    }
+}
+
+void SetupAiSkiers(int count) {
+    flowField.Setup(randomTreeGen(0.0f, 0.0f));
+    aiSkiers.Spawn(count);
+}
+
 void renderSkier() {
     LinearMapR4 mat;
     float matEntries[16];
 
+    if (skierModel.IsLoaded()) {
+        mat = viewMatrix;
+        mat.Mult_glTranslate(-1.5, 0.0, 0.0);
+        mat.DumpByColumns(matEntries);
+        glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+        renderModel(skierModel, 0);
+        return;
+    }
+
     // LEFT LEG
     mat = viewMatrix;
     mat.Mult_glTranslate(-2.0, 0.5, 0.0);
@@ -314,53 +842,788 @@ void renderSkier() {
     spheres.Render();
 }
 
+// A skier at world position (x,z), turned to its direction of travel (vx,vz): the player's
+//    figure, made of the shapes, with the body in one texture and the skis in another.
+//    The AI skiers are blue, with red skis; the other players in split screen are red, with blue skis.
+void renderFigure(float x, float z, float vx, float vz, float xPos, float zPos, int bodyTexture, int skiTexture) {
+    struct Part {
+        float x, y, z;              // Relative to the skier
+        float sx, sy, sz;
+        bool sphere;
+        bool ski;
+    };
+    static const Part parts[] = {
+        { -0.5f, 0.5f, 0.0f, 0.3f, 0.5f, 0.3f, false, false },     // Legs
+        { 0.5f, 0.5f, 0.0f, 0.3f, 0.5f, 0.3f, false, false },
+        { 0.0f, 2.0f, 0.0f, 1.0f, 1.0f, 1.0f, false, false },      // Body
+        { 0.0f, 3.0f, 0.0f, 1.0f, 1.0f, 1.0f, true, false },       // Head
+        { -0.5f, 0.1f, 0.0f, 0.2f, 0.1f, 3.0f, true, true },       // Skis
+        { 0.5f, 0.1f, 0.0f, 0.2f, 0.1f, 3.0f, true, true },
+    };
+    float matEntries[16];
+    LinearMapR4 base = viewMatrix;
+    base.Mult_glTranslate(x + xPos, 0.0, z + zPos);
+    base.Mult_glRotate(atan2f(-vx, -vz), 0.0, 1.0, 0.0);
+    glUniform1i(applyTextureLocation, true);
+    for (const Part& p : parts) {
+        LinearMapR4 mat = base;
+        mat.Mult_glTranslate(p.x, p.y, p.z);
+        mat.Mult_glScale(p.sx, p.sy, p.sz);
+        mat.DumpByColumns(matEntries);
+        glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+        glBindTexture(GL_TEXTURE_2D, TextureNames[p.ski ? skiTexture : bodyTexture]);
+        if (p.sphere) {
+            spheres.Render();
+        }
+        else {
+            cylinders.Render();
+        }
+    }
+}
+
 // **********************************************
 // MODIFY THIS ROUTINE TO RENDER THE FLOOR, THE BACK WALL,
 //    AND THE SPHERES AND THE CYLINDER. -- WITH TEXTURES
 // **********************************************
 
-std::vector<std::pair<float, float>> RenderScene(float xPos, float zPos) {
+// Adds the opaque draw items of the view for this frame to its drawItems, sorted front to back.
+void makeDrawItems(const std::vector<std::pair<float, float>>& locs, ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
+    std::vector<DrawItem>& drawItems = vs.drawItems;
+    LinearMapR4 viewProj = theProjectionMatrix * viewMatrix;
+    float vp[16];
+    viewProj.DumpByColumns(vp);
+    drawItems.clear();
+
+    DrawItem item;
+    item.tree = -1;
+    item.kind = DrawSkier;
+    item.depth = vp[3] * -1.5f + vp[7] * 2.0f + vp[15];     // w of the skier's body
+    drawItems.push_back(item);
+    if (gpuCullingUsed) {
+        item.kind = DrawTreesGpuCulled;         // Ordered on the GPU, so just before the background
+        item.depth = 0.5f * FLT_MAX;
+        drawItems.push_back(item);
+    }
+    else {
+        bool drawTrunks = !treeModel.IsLoaded() && !TreeVariantPool::IsReady();
+        for (int i = 0; i < (int)locs.size(); i++) {
+            if (!vs.treeVisible[i]) {
+                continue;
+            }
+            item.tree = i;
+            item.depth = vp[3] * (locs[i].first + xPos) + vp[7] * 5.0f + vp[11] * (locs[i].second + zPos) + vp[15];
+            if (drawTrunks) {
+                item.kind = DrawTrunk;
+                drawItems.push_back(item);
+            }
+            item.kind = DrawTreeSwaying;
+            drawItems.push_back(item);
+        }
+    }
+    item.kind = DrawAiSkier;
+    for (int i = 0; i < aiSkiers.GetNumSkiers(); i++) {
+        const AiSkiers::Skier& s = aiSkiers.GetSkier(i);
+        item.depth = vp[3] * (s.x + xPos) + vp[7] * 2.0f + vp[11] * (s.z + zPos) + vp[15];
+        if (item.depth > 0.0f && item.depth < AiSkierDrawDistance) {
+            item.tree = i;
+            drawItems.push_back(item);
+        }
+    }
+    item.kind = DrawNetworkSkier;
+    for (int i = 0; i < (int)networkSkiers.size(); i++) {
+        const NetworkSkier& s = networkSkiers[i];
+        item.depth = vp[3] * (s.x + xPos) + vp[7] * 2.0f + vp[11] * (s.z + zPos) + vp[15];
+        if (item.depth > 0.0f && item.depth < AiSkierDrawDistance) {
+            item.tree = i;
+            drawItems.push_back(item);
+        }
+    }
+    // The other players, in split screen
+    item.kind = DrawPlayer;
+    for (int v = 0; v < numSceneViews; v++) {
+        const SceneView& other = viewStates[v].view;
+        if (&other == &vs.view) {
+            continue;
+        }
+        float x = SkierX - other.xPos + xPos;
+        float z = -other.zPos + zPos;
+        item.depth = vp[3] * x + vp[7] * 2.0f + vp[11] * z + vp[15];
+        if (item.depth > 0.0f && item.depth < AiSkierDrawDistance) {
+            item.tree = v;
+            drawItems.push_back(item);
+        }
+    }
+    // The gates still ahead of the view's player, and not too far.
+    item.kind = DrawGate;
+    for (int i = vs.view.firstGate; i < slalomCourse.GetNumGates(); i++) {
+        const SlalomCourse::Gate& g = slalomCourse.GetGate(i);
+        float x = 0.5f * (g.leftX + g.rightX) + xPos;
+        float z = 0.5f * (g.leftZ + g.rightZ) + zPos;
+        item.depth = vp[3] * x + vp[7] * 0.5f * GatePoleHeight + vp[11] * z + vp[15];
+        if (item.depth > GateDrawDistance) {
+            break;              // The gates go down the slope, so the rest are farther still
+        }
+        if (item.depth > 0.0f) {
+            item.tree = i;
+            drawItems.push_back(item);
+        }
+    }
+    // The floor and the wall are behind everything standing on them, and the terrain chunks
+    //    over the floor just in front of it: only those over the floor, as the wall hides the rest.
+    item.tree = -1;
+    item.depth = FLT_MAX;
+    item.kind = DrawWall;
+    drawItems.push_back(item);
+    if (bakedLighting && TerrainChunks::IsReady()) {
+        item.kind = DrawTerrain;
+        for (int i = 0; i < TerrainChunks::GetNumChunks(); i++) {
+            float x = TerrainChunks::GetChunkX(i) + xPos;
+            float z = TerrainChunks::GetChunkZ(i) + zPos;
+            if (x < FloorMaxX && x + TerrainChunks::ChunkSize > -FloorMaxX
+                && z < FloorMaxZ && z + TerrainChunks::ChunkSize > FloorMinZ) {
+                item.tree = i;
+                drawItems.push_back(item);
+            }
+        }
+        item.tree = -1;
+    }
+    item.kind = DrawFloor;
+    drawItems.push_back(item);
+
+    std::stable_sort(drawItems.begin(), drawItems.end(),
+        [](const DrawItem& a, const DrawItem& b) { return a.depth < b.depth; });
+}
 
+// Selects the shader program for a draw item, if it is not already selected.
+void selectItemProgram(unsigned int program, unsigned int& currentProgram) {
+    if (program == currentProgram) {
+        return;
+    }
+    selectShaderProgram(program);
+    if (program != shaderProgramBitmap && program != phShaderPhongGouraud && program != shaderProgramBaked) {
+        setWindParams();
+    }
+    currentProgram = program;
+}
+
+// Draws all the view's draw items, in order. Used for both the depth prepass and the lighting pass.
+void renderDrawItems(const std::vector<std::pair<float, float>>& locs, const ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
     float matEntries[16];       // Temporary storage for floats
-    // ******
-    // Render the Floor - using a procedural texture map
-    // ******
-    selectShaderProgram(shaderProgramBitmap);
-    glBindTexture(GL_TEXTURE_2D, TextureNames[3]);
-    glBindVertexArray(myVAO[iFloor]);                // Select the floor VAO (Vertex Array Object)
+    unsigned int currentProgram = 0;
+    bool bakedTrees = bakedLighting && TreeVariantPool::IsBaked() && !treeModel.IsLoaded();
     materialUnderTexture.LoadIntoShaders();         // Use the bright underlying color
-    viewMatrix.DumpByColumns(matEntries);           // Apply the model view matrix
-    glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
-    glUniform1i(applyTextureLocation, true);           // Enable applying the texture!
-    // Draw the floor as a single triangle strip
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_INT, (void*)0);    
-    glUniform1i(applyTextureLocation, false);           // Turn off applying texture!
+    for (const DrawItem& item : vs.drawItems) {
+        bool gouraud = item.depth > gouraudDistance;
+        unsigned int bitmapProgram = gouraud ? phShaderPhongGouraud : shaderProgramBitmap;
+        switch (item.kind) {
+        case DrawSkier:
+            selectItemProgram(shaderProgramBitmap, currentProgram);
+            renderSkier();
+            materialUnderTexture.LoadIntoShaders();     // Custom models load their own materials
+            break;
+        case DrawTrunk:
+            selectItemProgram(bitmapProgram, currentProgram);
+            renderTrunk(locs[item.tree].first, locs[item.tree].second, xPos, zPos);
+            break;
+        case DrawTreeSwaying:
+            selectItemProgram(bakedTrees ? shaderProgramWindBaked : gouraud ? shaderProgramWindGouraud : shaderProgramWind,
+                currentProgram);
+            glUniform1f(windPhaseLoc, (float)(random[999 - item.tree] % 628) * 0.01f);
+            renderTreeSwaying(locs[item.tree].first, locs[item.tree].second, xPos, zPos, treeVariant(item.tree));
+            if (treeModel.IsLoaded()) {
+                materialUnderTexture.LoadIntoShaders();
+            }
+            break;
+        case DrawTreesGpuCulled:
+            selectItemProgram(bakedTrees ? shaderProgramWindInstancedBaked : shaderProgramWindInstanced, currentProgram);
+            renderTreesGpuCulled(xPos, zPos, false);
+            break;
+        case DrawPlayer: {
+            selectItemProgram(bitmapProgram, currentProgram);
+            const SceneView& other = viewStates[item.tree].view;
+            renderFigure(SkierX - other.xPos, -other.zPos, -other.xVel, -other.zVel, xPos, zPos, 4, 5);
+            break;
+        }
+        case DrawAiSkier: {
+            selectItemProgram(bitmapProgram, currentProgram);
+            const AiSkiers::Skier& skier = aiSkiers.GetSkier(item.tree);
+            renderFigure(skier.x, skier.z, skier.vx, skier.vz, xPos, zPos, 5, 4);
+            break;
+        }
+        case DrawNetworkSkier: {
+            selectItemProgram(bitmapProgram, currentProgram);
+            const NetworkSkier& skier = networkSkiers[item.tree];
+            renderFigure(skier.x, skier.z, skier.vx, skier.vz, xPos, zPos, skier.player ? 4 : 5, skier.player ? 5 : 4);
+            break;
+        }
+        case DrawGate:
+            selectItemProgram(bitmapProgram, currentProgram);
+            renderGate(slalomCourse.GetGate(item.tree), xPos, zPos);
+            break;
+        case DrawTerrain: {
+            selectItemProgram(shaderProgramBaked, currentProgram);
+            glBindTexture(GL_TEXTURE_2D, TextureNames[3]);
+            LinearMapR4 mat = viewMatrix;
+            mat.Mult_glTranslate(xPos, 0.0f, zPos);
+            mat.DumpByColumns(matEntries);
+            glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+            glUniform1i(applyTextureLocation, true);
+            TerrainChunks::Render(item.tree);
+            break;
+        }
+        case DrawFloor:
+            // ******
+            // Render the Floor - using a procedural texture map
+            // ******
+            selectItemProgram(shaderProgramBitmap, currentProgram);
+            glBindTexture(GL_TEXTURE_2D, TextureNames[3]);
+            glBindVertexArray(myVAO[iFloor]);                // Select the floor VAO (Vertex Array Object)
+            viewMatrix.DumpByColumns(matEntries);           // Apply the model view matrix
+            glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+            glUniform1i(applyTextureLocation, true);           // Enable applying the texture!
+            // Draw the floor as a single triangle strip
+            glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_INT, (void*)0);
+            break;
+        case DrawWall:
+            // ************ 
+            // Render the back wall
+            //  YOU MUST WRITE THIS. IT WILL BE SIMILAR TO THE FLOOR ABOVE. 
+            //  BUT USE A BITMAP (shaderProgramBitmap) INSTEAD OF A PROCEDURAL TEXTURE.
+            selectItemProgram(shaderProgramBitmap, currentProgram);
+            glBindTexture(GL_TEXTURE_2D, TextureNames[0]);
+            glBindVertexArray(myVAO[iWall]);                // Select the floor VAO (Vertex Array Object)
+            viewMatrix.DumpByColumns(matEntries);           // Apply the model view matrix
+            glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
+            glUniform1i(applyTextureLocation, true);           // Enable applying the texture!
+            // Draw the wall as a single triangle strip
+            glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_INT, (void*)0);
+            break;
+        }
+        glUniform1i(applyTextureLocation, false);           // Turn off applying texture!
+    }
     check_for_opengl_errors();
+}
 
-    // ************ 
-    // Render the back wall
-    //  YOU MUST WRITE THIS. IT WILL BE SIMILAR TO THE FLOOR ABOVE. 
-    //  BUT USE A BITMAP (shaderProgramBitmap) INSTEAD OF A PROCEDURAL TEXTURE.
-    selectShaderProgram(shaderProgramBitmap);
-    glBindTexture(GL_TEXTURE_2D, TextureNames[0]);
-    glBindVertexArray(myVAO[iWall]);                // Select the floor VAO (Vertex Array Object)
-    materialUnderTexture.LoadIntoShaders();         // Use the bright underlying color
-    viewMatrix.DumpByColumns(matEntries);           // Apply the model view matrix
-    glUniformMatrix4fv(modelviewMatLocation, 1, false, matEntries);
-    glUniform1i(applyTextureLocation, true);           // Enable applying the texture!
-    // Draw the wall as a single triangle strip
-    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_INT, (void*)0);
-    glUniform1i(applyTextureLocation, false);           // Turn off applying texture!
+// Draws the leaf cards of the tree variants, after the opaque geometry, with depth testing and writing.
+//    The cards are not in the depth prepass: alpha testing would make it as costly as the lighting pass.
+//    The draw items are already sorted front to back, so nearer cards hide the farther ones.
+void renderFoliage(const std::vector<std::pair<float, float>>& locs, const ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
+    if (treeModel.IsLoaded() || !TreeVariantPool::IsReady()) {
+        return;                 // The other trees have no leaf cards
+    }
+    bool useCoverage = multisampled && alphaToCoverage;
+    if (useCoverage) {
+        glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    }
+    bool bakedTrees = bakedLighting && TreeVariantPool::IsBaked();
+    unsigned int foliageProgram = bakedTrees ? shaderProgramFoliageBaked : shaderProgramFoliage;
+    unsigned int foliageInstancedProgram = bakedTrees ? shaderProgramFoliageInstancedBaked : shaderProgramFoliageInstanced;
+    unsigned int foliagePrograms[2] = { foliageProgram, foliageInstancedProgram };
+    for (unsigned int program : foliagePrograms) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "alphaToCoverage"), useCoverage);
+    }
+    unsigned int currentProgram = 0;
+    materialUnderTexture.LoadIntoShaders();
+    for (const DrawItem& item : vs.drawItems) {
+        if (item.kind == DrawTreeSwaying) {
+            selectItemProgram(foliageProgram, currentProgram);
+            glUniform1f(windPhaseLoc, (float)(random[999 - item.tree] % 628) * 0.01f);
+            renderTreeVariantLeaves(locs[item.tree].first, locs[item.tree].second, xPos, zPos, treeVariant(item.tree));
+        }
+        else if (item.kind == DrawTreesGpuCulled) {
+            selectItemProgram(foliageInstancedProgram, currentProgram);
+            renderTreesGpuCulled(xPos, zPos, true);
+        }
+    }
+    glUniform1i(applyTextureLocation, false);
+    if (useCoverage) {
+        glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    }
     check_for_opengl_errors();
+}
+
+// Tells the texture streamer how large each texture appears in the view this frame,
+//    from the distance of the nearest object using it. The streamer keeps the largest over the views.
+void noteTextureUses(const std::vector<std::pair<float, float>>& locs, const ViewState& vs) {
+    float xPos = vs.view.xPos;
+    float zPos = vs.view.zPos;
+    LinearMapR4 viewProj = theProjectionMatrix * viewMatrix;
+    float vp[16];
+    viewProj.DumpByColumns(vp);
+    float p[16];
+    theProjectionMatrix.DumpByColumns(p);
+    const float minDepth = 1.0f;
+    float viewHeight = (float)PostProcess::GetSceneHeight() * (float)vs.view.viewport[3] / (float)screenHeight;
+    float pixelsPerUnit = p[5] * 0.5f * viewHeight;      // At a distance of one
 
-    std::vector<std::pair<float, float>> locs = randomTreeGen(xPos, zPos);
-    std::pair<float, float> loc;
-    for (int i = 0; i < locs.size(); i++) {
-        loc = locs[i];
-        renderTree(loc.first, loc.second, xPos, zPos);
+    float skierDepth = fmaxf(vp[3] * -1.5f + vp[7] * 2.0f + vp[15], minDepth);
+    TextureStreamer::NoteUse(TextureNames[4], SkierTextureExtent * pixelsPerUnit / skierDepth);
+    TextureStreamer::NoteUse(TextureNames[5], SkierTextureExtent * pixelsPerUnit / skierDepth);
+
+    // The floor's nearest edge
+    float floorDepth = fmaxf(vp[11] * 20.0f + vp[15], minDepth);
+    TextureStreamer::NoteUse(TextureNames[3], FloorTextureExtent * pixelsPerUnit / floorDepth);
+
+    if (treeModel.IsLoaded() || locs.empty()) {
+        return;                 // Custom models have their own textures
+    }
+    float treeDepth = FLT_MAX;
+    for (const std::pair<float, float>& loc : locs) {
+        float w = vp[3] * (loc.first + xPos) + vp[7] * 5.0f + vp[11] * (loc.second + zPos) + vp[15];
+        treeDepth = fminf(treeDepth, w);
+    }
+    treeDepth = fmaxf(treeDepth, minDepth);
+    if (TreeVariantPool::IsReady()) {
+        TextureStreamer::NoteUse(TextureNames[0], BarkTextureExtent * pixelsPerUnit / treeDepth);
+        TextureStreamer::NoteUse(leafCardTexture, LeafCardExtent * pixelsPerUnit / treeDepth);
+    }
+    else {
+        TextureStreamer::NoteUse(TextureNames[0], TrunkTextureExtent * pixelsPerUnit / treeDepth);
+        TextureStreamer::NoteUse(TextureNames[1], TrunkTextureExtent * pixelsPerUnit / treeDepth);
+        TextureStreamer::NoteUse(TextureNames[2], ConeTextureExtent * pixelsPerUnit / treeDepth);
     }
-    renderSkier();
+}
 
-    return locs;
+void PrintOverdrawStats() {
+    if (!Profiler::HasValue(litFragmentsCounter)) {
+        printf("No overdraw statistics yet.\n");
+        return;
+    }
+    // In split screen, the counters are of the first view's passes.
+    const int* viewport = viewStates[0].view.viewport;
+    double numPixels = (double)PostProcess::GetSceneWidth() * (double)PostProcess::GetSceneHeight()
+        * ((double)viewport[2] * (double)viewport[3]) / ((double)screenWidth * (double)screenHeight);
+    double litFragments = Profiler::GetValue(litFragmentsCounter);
+    printf("Depth prepass %s: %.0f lit fragments, %.2f per pixel.\n", depthPrepass ? "on" : "off",
+        litFragments, litFragments / numPixels);
+    if (depthPrepass && Profiler::HasValue(prepassFragmentsCounter)) {
+        printf("  Depth prepass: %.0f fragments, %.2f per pixel.\n", Profiler::GetValue(prepassFragmentsCounter),
+            Profiler::GetValue(prepassFragmentsCounter) / numPixels);
+    }
+    int prepassTimer = FrameGraph::PassTimer("Depth prepass");
+    int opaqueTimer = FrameGraph::PassTimer("Opaque");
+    int foliageTimer = FrameGraph::PassTimer("Leaf cards");
+    if (depthPrepass && Profiler::HasValue(prepassTimer)) {
+        printf("  Depth prepass: %.3f ms on the GPU.\n", Profiler::GetValue(prepassTimer));
+    }
+    if (Profiler::HasValue(opaqueTimer)) {
+        printf("  Opaque geometry: %.3f ms on the GPU.\n", Profiler::GetValue(opaqueTimer));
+    }
+    if (Profiler::HasValue(foliageTimer)) {
+        printf("  Leaf cards (%s): %.3f ms on the GPU.\n",
+            (multisampled && alphaToCoverage) ? "alpha to coverage" : "alpha tested", Profiler::GetValue(foliageTimer));
+    }
 }
 
+// **********************************************
+// The render benchmark: draws the same BenchmarkDraws meshes (bark of the
+//    tree variants, with a cylinder, cone or sphere every fourth draw) into
+//    the window, first each with its own VAO, then all by vertex pulling from
+//    VertexPullPool, with one VAO. Reports the CPU time to submit the draws,
+//    and the GPU time, the best of BenchmarkRuns runs of each.
+//    The next frame draws over the window.
+// **********************************************
+const int BenchmarkDraws = 4000;
+const int BenchmarkRuns = 5;
+int pullCylinder, pullCone, pullSphere;     // Meshes in the VertexPullPool
+
+void RunRenderBenchmark() {
+    if (shaderProgramPulled == 0) {
+        printf("Vertex pulling needs OpenGL 4.3.\n");
+        return;
+    }
+    if (!VertexPullPool::IsBuilt()) {
+        if (!TreeVariantPool::IsReady()) {
+            printf("The tree variants are still being built: try again shortly.\n");
+            return;
+        }
+        pullCylinder = VertexPullPool::AddShape(cylinders);
+        pullCone = VertexPullPool::AddShape(cones);
+        pullSphere = VertexPullPool::AddShape(spheres);
+        if (!VertexPullPool::Build()) {
+            return;
+        }
+        printf("Vertex pull pool: %d meshes, %.1f MB.\n", VertexPullPool::GetNumMeshes(),
+            (double)VertexPullPool::GetNumBytes() / (1 << 20));
+    }
+
+    // A grid of draws in front of the camera. Kind 0 to 2: a shape, 3: a tree variant.
+    std::vector<int> kinds(BenchmarkDraws), pullMeshes(BenchmarkDraws);
+    std::vector<float> matrices(16 * BenchmarkDraws);
+    for (int i = 0; i < BenchmarkDraws; i++) {
+        int variant = i % TreeVariantPool::NumVariants;
+        kinds[i] = (i % 4 == 3) ? (i / 4) % 3 : 3;
+        pullMeshes[i] = (kinds[i] == 0) ? pullCylinder : (kinds[i] == 1) ? pullCone
+            : (kinds[i] == 2) ? pullSphere : VertexPullPool::GetBarkMesh(variant);
+        LinearMapR4 mat = viewMatrix;
+        mat.Mult_glTranslate(2.0f * (float)(i % 50 - 25), 0.0f, -2.0f * (float)(i / 50));
+        mat.DumpByColumns(&matrices[16 * i]);
+    }
+
+    unsigned int query;
+    glGenQueries(1, &query);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+    double bestCpu[2] = { 1.0e30, 1.0e30 };
+    double bestGpu[2] = { 1.0e30, 1.0e30 };
+    for (int run = 0; run < BenchmarkRuns; run++) {
+        for (int path = 0; path < 2; path++) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            double start = glfwGetTime();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            selectShaderProgram(path == 0 ? shaderProgramBitmap : shaderProgramPulled);
+            materialUnderTexture.LoadIntoShaders();
+            glBindTexture(GL_TEXTURE_2D, TextureNames[0]);
+            glUniform1i(applyTextureLocation, true);
+            if (path == 1) {
+                VertexPullPool::Bind();
+            }
+            for (int i = 0; i < BenchmarkDraws; i++) {
+                glUniformMatrix4fv(modelviewMatLocation, 1, false, &matrices[16 * i]);
+                if (path == 1) {
+                    VertexPullPool::Draw(pullMeshes[i]);
+                    continue;
+                }
+                switch (kinds[i]) {
+                case 0:
+                    cylinders.Render();
+                    break;
+                case 1:
+                    cones.Render();
+                    break;
+                case 2:
+                    spheres.Render();
+                    break;
+                default:
+                    TreeVariantPool::RenderBark(i % TreeVariantPool::NumVariants);
+                    break;
+                }
+            }
+            if (path == 1) {
+                VertexPullPool::Unbind();
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            double cpu = 1000.0 * (glfwGetTime() - start);
+            GLuint64 gpu = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu);     // Waits for the GPU
+            bestCpu[path] = std::min(bestCpu[path], cpu);
+            bestGpu[path] = std::min(bestGpu[path], (double)gpu * 1.0e-6);
+        }
+    }
+    glUniform1i(applyTextureLocation, false);
+    glDeleteQueries(1, &query);
+
+    printf("Render benchmark, %d draws, best of %d runs:\n", BenchmarkDraws, BenchmarkRuns);
+    printf("  VAO per mesh:    %7.3f ms CPU, %7.3f ms GPU.\n", bestCpu[0], bestGpu[0]);
+    printf("  Vertex pulling:  %7.3f ms CPU, %7.3f ms GPU.\n", bestCpu[1], bestGpu[1]);
+    check_for_opengl_errors();
+}
+
+// **********************************************
+// The shading benchmark: draws the first view's opaque draw items, as the last
+//    frame made them, lit three ways: all per fragment, with the shading level of
+//    detail at gouraudDistance, and all per vertex. Each is drawn after a depth
+//    prepass, so the timed lighting pass shades each visible pixel once. Reports
+//    the GPU time and the lit fragments, the best of BenchmarkRuns runs of each.
+//    The next frame draws over the window.
+// **********************************************
+void RunShadingBenchmark() {
+    ViewState& vs = viewStates[0];
+    if (vs.drawItems.empty()) {
+        printf("No frame to measure yet.\n");
+        return;
+    }
+    const float savedDistance = gouraudDistance;
+    const float distances[3] = { FLT_MAX, savedDistance, 0.0f };
+    int numGouraud = 0;
+    for (const DrawItem& item : vs.drawItems) {
+        numGouraud += (item.depth > savedDistance && item.kind != DrawSkier && item.kind != DrawFloor
+            && item.kind != DrawWall && item.kind != DrawTreesGpuCulled);
+    }
+
+    unsigned int queries[2];
+    glGenQueries(2, queries);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(vs.view.viewport[0], vs.view.viewport[1], vs.view.viewport[2], vs.view.viewport[3]);
+    double bestGpu[3] = { 1.0e30, 1.0e30, 1.0e30 };
+    GLuint64 fragments[3] = { 0, 0, 0 };
+    for (int run = 0; run < BenchmarkRuns; run++) {
+        for (int mode = 0; mode < 3; mode++) {
+            gouraudDistance = distances[mode];
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            depthOnlyPass = true;
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            renderDrawItems(frameLocs, vs);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            depthOnlyPass = false;
+
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+            glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+            renderDrawItems(frameLocs, vs);
+            glEndQuery(GL_SAMPLES_PASSED);
+            glEndQuery(GL_TIME_ELAPSED);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_TRUE);
+            GLuint64 gpu = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &gpu);     // Waits for the GPU
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &fragments[mode]);
+            bestGpu[mode] = std::min(bestGpu[mode], (double)gpu * 1.0e-6);
+        }
+    }
+    gouraudDistance = savedDistance;
+    glDeleteQueries(2, queries);
+
+    const char* names[3] = { "All Phong:  ", "Shading LOD:", "All Gouraud:" };
+    if (savedDistance < FLT_MAX) {
+        printf("Shading benchmark, %d draw items, %d of them beyond %.0f units, best of %d runs:\n",
+            (int)vs.drawItems.size(), numGouraud, savedDistance, BenchmarkRuns);
+    }
+    else {
+        printf("Shading benchmark, %d draw items, the shading LOD off, best of %d runs:\n",
+            (int)vs.drawItems.size(), BenchmarkRuns);
+    }
+    for (int mode = 0; mode < 3; mode++) {
+        printf("  %s %7.3f ms GPU, %9.0f lit fragments, %.1f%% less time than all Phong.\n", names[mode],
+            bestGpu[mode], (double)fragments[mode], 100.0 * (1.0 - bestGpu[mode] / bestGpu[0]));
+    }
+    check_for_opengl_errors();
+}
+
+// **********************************************
+// MODIFY THIS ROUTINE TO RENDER THE FLOOR, THE BACK WALL,
+//    AND THE SPHERES AND THE CYLINDER. -- WITH TEXTURES
+// **********************************************
+
+// The view's part of the scene target, which may be scaled from the window.
+void GetSceneViewport(const SceneView& view, int rect[4]) {
+    float sx = (float)PostProcess::GetSceneWidth() / (float)screenWidth;
+    float sy = (float)PostProcess::GetSceneHeight() / (float)screenHeight;
+    int x0 = (int)(sx * view.viewport[0] + 0.5f);
+    int y0 = (int)(sy * view.viewport[1] + 0.5f);
+    int x1 = (int)(sx * (view.viewport[0] + view.viewport[2]) + 0.5f);
+    int y1 = (int)(sy * (view.viewport[1] + view.viewport[3]) + 0.5f);
+    rect[0] = x0;
+    rect[1] = y0;
+    rect[2] = x1 - x0;
+    rect[3] = y1 - y0;
+}
+
+// Restricts drawing to the view's part of the scene target.
+void SetSceneViewport(const SceneView& view) {
+    int rect[4];
+    GetSceneViewport(view, rect);
+    glViewport(rect[0], rect[1], rect[2], rect[3]);
+}
+
+// Culls the trees of a view on the CPU, and makes its draw items. Called on a thread per view
+//    (see cullViews()): it writes only to the view's state.
+void cullView(const std::vector<std::pair<float, float>>& locs, ViewState& vs) {
+    double start = glfwGetTime();
+    if (!gpuCullingUsed) {
+        cullTrees(locs, vs);
+    }
+    makeDrawItems(locs, vs);
+    vs.cullMs = 1000.0 * (glfwGetTime() - start);
+}
+
+// The workers culling the views after the first. Each frame, RenderScene() sets cullNumViews and
+//    advances cullFrame under cullMutex, then waits on cullDone until cullViewsLeft is 0.
+std::thread cullWorkers[MaxSceneViews];     // Index 0 is unused: the first view is culled on the main thread
+std::mutex cullMutex;
+std::condition_variable cullStart;
+std::condition_variable cullDone;
+int cullFrame = 0;                          // Frames started
+int cullNumViews = 0;                       // Views of the frame started
+int cullViewsLeft = 0;                      // Views of the frame the workers have not culled yet
+bool cullStopping = false;
+
+void cullWorkerMain(int v, int lastFrame) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(cullMutex);
+            cullStart.wait(lock, [lastFrame] { return cullStopping || cullFrame != lastFrame; });
+            if (cullStopping) {
+                return;
+            }
+            lastFrame = cullFrame;
+            if (v >= cullNumViews) {
+                continue;           // This frame has fewer views
+            }
+        }
+        cullView(frameLocs, viewStates[v]);
+        std::lock_guard<std::mutex> lock(cullMutex);
+        if (--cullViewsLeft == 0) {
+            cullDone.notify_one();
+        }
+    }
+}
+
+// Culls all the views at once: the first on this thread, the others on their workers.
+void cullViews() {
+    std::unique_lock<std::mutex> lock(cullMutex);
+    for (int v = 1; v < numSceneViews; v++) {
+        if (!cullWorkers[v].joinable()) {
+            cullWorkers[v] = std::thread(cullWorkerMain, v, cullFrame);
+        }
+    }
+    cullFrame++;
+    cullNumViews = numSceneViews;
+    cullViewsLeft = numSceneViews - 1;
+    lock.unlock();
+    cullStart.notify_all();
+
+    cullView(frameLocs, viewStates[0]);
+    lock.lock();
+    cullDone.wait(lock, [] { return cullViewsLeft == 0; });
+}
+
+void StopCullWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(cullMutex);
+        cullStopping = true;
+    }
+    cullStart.notify_all();
+    for (std::thread& w : cullWorkers) {
+        if (w.joinable()) {
+            w.join();
+        }
+    }
+}
+
+double GetViewCullTime(int view) {
+    return viewStates[view].cullMs;
+}
+
+// The names of the passes of each view. The first view's are the names of a single view,
+//    so the passes are timed (see FrameGraph::PassTimer) as before.
+const char* CullPassNames[MaxSceneViews] = { "Tree culling", "Tree culling 2", "Tree culling 3", "Tree culling 4" };
+const char* PrepassNames[MaxSceneViews] = { "Depth prepass", "Depth prepass 2", "Depth prepass 3", "Depth prepass 4" };
+const char* OpaqueNames[MaxSceneViews] = { "Opaque", "Opaque 2", "Opaque 3", "Opaque 4" };
+const char* FoliageNames[MaxSceneViews] = { "Leaf cards", "Leaf cards 2", "Leaf cards 3", "Leaf cards 4" };
+
+std::vector<std::pair<float, float>> RenderScene(const SceneView* views, int numViews) {
+
+    if (litFragmentsCounter < 0) {
+        litFragmentsCounter = Profiler::Register("Lit fragments", GL_SAMPLES_PASSED);
+        prepassFragmentsCounter = Profiler::Register("Depth prepass fragments", GL_SAMPLES_PASSED);
+    }
+
+    TreeVariantPool::Update();      // Starts using the tree variants once they are built, and their baked lighting once baked
+    TerrainChunks::Update();
+    frameLocs = randomTreeGen(0.0f, 0.0f);
+    const std::vector<std::pair<float, float>>& locs = frameLocs;
+    gpuCullingUsed = useGpuCulling(locs);
+
+    numSceneViews = std::min(numViews, MaxSceneViews);
+    for (int v = 0; v < numSceneViews; v++) {
+        viewStates[v].view = views[v];
+    }
+    cullViews();
+    numCutawayTrees = 0;
+    for (int v = 0; v < numSceneViews; v++) {
+        numCutawayTrees += viewStates[v].numCutawayTrees;
+        noteTextureUses(locs, viewStates[v]);
+    }
+    TextureStreamer::Update();
+
+    // The render passes of each view, in its own viewport of the scene targets. They run later,
+    //    in frameGraph.Execute(), so they capture what they need. The views share the GPU
+    //    culling's draw lists: each view's culling writes over them, so it runs after the
+    //    passes of the view before have read them.
+    int sceneColor = PostProcess::GetSceneColor();
+    int sceneDepth = PostProcess::GetSceneDepth();
+    int treeLists = gpuCullingUsed ? frameGraph.CreateVirtual("Tree draw lists") : -1;
+    for (int v = 0; v < numSceneViews; v++) {
+        ViewState* vs = &viewStates[v];
+        if (gpuCullingUsed) {
+            int cullPass = frameGraph.AddPass(CullPassNames[v], [vs]() {
+                cullTreesGpu(frameLocs, *vs);
+            });
+            frameGraph.Write(cullPass, treeLists);
+        }
+
+        bool prepass = depthPrepass;
+        if (prepass) {
+            // Lay down the depths with the depth-only programs, then light only the nearest fragments.
+            int prepassPass = frameGraph.AddPass(PrepassNames[v], [vs]() {
+                SetSceneViewport(vs->view);
+                depthOnlyPass = true;
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                Profiler::Begin(prepassFragmentsCounter);
+                renderDrawItems(frameLocs, *vs);
+                Profiler::End(prepassFragmentsCounter);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                depthOnlyPass = false;
+            });
+            frameGraph.Read(prepassPass, sceneDepth);
+            frameGraph.Write(prepassPass, sceneDepth);
+            if (treeLists >= 0) {
+                frameGraph.Read(prepassPass, treeLists);
+            }
+        }
+
+        // The ambient occlusion, from the depths of the prepass, for the ambient terms of the lighting
+        int ao = -1;
+        if (prepass) {
+            int rect[4];
+            GetSceneViewport(vs->view, rect);
+            ao = Ssao::AddPasses(frameGraph, v, rect);
+        }
+
+        int opaquePass = frameGraph.AddPass(OpaqueNames[v], [vs, prepass, ao]() {
+            SetSceneViewport(vs->view);
+            if (prepass) {
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+            }
+            if (ao >= 0) {
+                Ssao::Apply(frameGraph.GetTexture(ao));
+            }
+            Profiler::Begin(litFragmentsCounter);
+            renderDrawItems(frameLocs, *vs);
+            Profiler::End(litFragmentsCounter);
+            if (ao >= 0) {
+                Ssao::Apply(0);
+            }
+            if (prepass) {
+                glDepthFunc(GL_LEQUAL);
+                glDepthMask(GL_TRUE);
+            }
+        });
+        frameGraph.Read(opaquePass, sceneDepth);
+        if (ao >= 0) {
+            frameGraph.Read(opaquePass, ao);
+        }
+        frameGraph.Write(opaquePass, sceneColor);
+        if (!prepass) {
+            frameGraph.Write(opaquePass, sceneDepth);
+        }
+        if (treeLists >= 0) {
+            frameGraph.Read(opaquePass, treeLists);
+        }
+
+        int foliagePass = frameGraph.AddPass(FoliageNames[v], [vs]() {
+            SetSceneViewport(vs->view);
+            renderFoliage(frameLocs, *vs);
+            selectShaderProgram(shaderProgramBitmap);
+        });
+        frameGraph.Read(foliagePass, sceneDepth);
+        frameGraph.Write(foliagePass, sceneDepth);
+        frameGraph.Write(foliagePass, sceneColor);
+        if (treeLists >= 0) {
+            frameGraph.Read(foliagePass, treeLists);
+        }
+    }
+
+    return locs;
+}
@@ -7,8 +7,69 @@
 //
 void MySetupSurfaces();                // Called once, before rendering begins.
 void SetupForTextures();               // Loads textures, sets Phong material
+extern unsigned int forestSeed;        // Seeds the trees' placement; 0 for a new forest each run
+void setupRNG();                       // Called by SetupForTextures(); without graphics, call it first
 
-std::vector<std::pair<float, float>> RenderScene(float xPos, float zPos); // Renders the entire scene
+// Split screen: each player's view of the scene. The player's skier is drawn at x = SkierX, z = 0,
+//    and the world offset by (xPos, zPos). The viewport is in window pixels, from the lower left corner.
+const float SkierX = -1.5f;
+const int MaxSceneViews = 4;
+struct SceneView {
+    float xPos = 0.0f, zPos = 0.0f;
+    float xVel = 0.0f, zVel = 0.0f;    // Per simulation step, to turn the other players' figures
+    int firstGate = 0;                  // The gates before it are passed, and not drawn
+    int viewport[4] = { 0, 0, 1, 1 };   // x, y, width, height
+};
 
+// Adds the passes of the views to frameGraph. The views' culling runs at once, on a thread per view.
+std::vector<std::pair<float, float>> RenderScene(const SceneView* views, int numViews);
+void StopCullWorkers();                         // Before exiting: stops the threads culling the views
+void GetSceneViewport(const SceneView& view, int rect[4]);    // The view's part of the scene targets: x, y, width, height
+void SetSceneViewport(const SceneView& view);   // Sets glViewport to the view's part of the scene targets
+double GetViewCullTime(int view);               // CPU milliseconds culling the view, last frame
 
+// In a networked race, the other skiers as the server last sent them (see NetClient.h), drawn
+//    instead of the local AI skiers. Positions in the world, velocities per simulation step.
+struct NetworkSkier {
+    float x, z;
+    float vx, vz;
+    bool player;                        // Another player, or an AI skier
+};
+extern std::vector<NetworkSkier> networkSkiers;
 
+class SlalomCourse;
+extern SlalomCourse slalomCourse;      // The gates through the forest, and the timing of the run
+void SetupCourse(bool giantSlalom);    // Generates the course from the trees
+
+class FlowField;
+class AiSkiers;
+extern FlowField flowField;            // The ways down through the trees, for the AI skiers
+extern AiSkiers aiSkiers;
+void SetupAiSkiers(int count);         // Sets up the flow field from the trees, and spawns the skiers
+
+class ObstacleGrid;
+extern ObstacleGrid obstacleGrid;      // The trunks and leaves, for ray and segment queries
+void SetupObstacleGrid();
+extern bool cameraCutaway;             // Hide the trees between the camera and the skier (when culling on the CPU)
+extern int numCutawayTrees;            // Hidden in the last frame, in all the views
+
+extern bool occlusionCulling;          // Skip drawing trees hidden behind nearer trees
+extern bool gpuCulling;                // Cull the trees in a compute shader, on OpenGL 4.3 and later
+void PrintCullingStats();              // Reports the last frame's occlusion culling
+
+extern bool depthPrepass;              // Draw the opaque geometry's depths first, then light only visible fragments
+void PrintOverdrawStats();             // Reports the lit fragments per pixel, averaged over recent frames
+
+extern bool alphaToCoverage;           // Antialias the leaf cards' edges, when the framebuffer is multisampled
+
+extern float gouraudDistance;          // Trees, skiers and gates farther than this are lit per vertex; FLT_MAX for none
+void RunShadingBenchmark();            // Times the lighting of the last frame: all Phong, the shading LOD, all Gouraud
+
+extern bool bakedLighting;             // Light the tree variants and the terrain chunks with their baked lighting, once baked
+void SetupTerrain();                   // Builds and starts baking the terrain chunks; after SetupObstacleGrid()
+void PrintBakeStats();                 // Reports the time and rays of the bakes
+
+
+
+
+void RunRenderBenchmark();             // Times drawing meshes with their VAOs, and with vertex pulling
@@ -0,0 +1,150 @@
+//
+// SlalomCourse.cpp
+//
+// Generating a slalom course, and timing a run through its gates. See SlalomCourse.h.
+//
+
+#include "SlalomCourse.h"
+
+#include <float.h>
+#include <math.h>
+
+// Per discipline: gates per chunk, width of the gates, and how far they swing from the fall line.
+static const int GatesPerChunk[2] = { 2, 1 };
+static const float GateWidth[2] = { 4.0f, 6.0f };
+static const float GateSwing[2] = { 3.0f, 5.0f };
+static const float MinClearance = 1.5f;         // Wanted between the poles and the trunks
+static const float CandidateStep = 0.5f;        // Spacing of the candidate gate positions across the slope
+
+SlalomCourse::SlalomCourse()
+{
+    discipline = Slalom;
+    Reset();
+}
+
+void SlalomCourse::Generate(const std::vector<std::pair<float, float>>& trees, Discipline d)
+{
+    discipline = d;
+    gates.clear();
+    float bottom = StartZ;
+    for (const std::pair<float, float>& t : trees) {
+        bottom = fminf(bottom, t.second);
+    }
+    bottom -= 5.0f;             // The finish is below the last row of trees
+
+    Gate start = { -CourseHalfWidth, StartZ, CourseHalfWidth, StartZ, false };
+    gates.push_back(start);
+
+    float spacing = (float)ChunkDepth / (float)GatesPerChunk[d];
+    float halfWidth = 0.5f * GateWidth[d];
+    int side = 1;
+    for (float z = StartZ - spacing; z > bottom + 0.5f * spacing; z -= spacing, side = -side) {
+        float target = side * GateSwing[d];
+        float bestX = target;
+        float bestScore = -FLT_MAX;
+        for (float x = -CourseHalfWidth + halfWidth; x <= CourseHalfWidth - halfWidth; x += CandidateStep) {
+            float clearance = fminf(Clearance(trees, x, z),
+                fminf(Clearance(trees, x - halfWidth, z), Clearance(trees, x + halfWidth, z)));
+            // A clear gate always beats a blocked one; then the nearest to the rhythm wins.
+            float score = -fabsf(x - target);
+            if (clearance < MinClearance) {
+                score -= 100.0f * (MinClearance - clearance);
+            }
+            if (score > bestScore) {
+                bestScore = score;
+                bestX = x;
+            }
+        }
+        Gate g = { bestX - halfWidth, z, bestX + halfWidth, z, (gates.size() % 2) == 1 };
+        gates.push_back(g);
+    }
+
+    Gate finish = { -CourseHalfWidth, bottom, CourseHalfWidth, bottom, false };
+    gates.push_back(finish);
+    splits.resize(gates.size());
+    Reset();
+}
+
+// Distance from (x,z) to the nearest trunk.
+float SlalomCourse::Clearance(const std::vector<std::pair<float, float>>& trees, float x, float z) const
+{
+    float nearest = FLT_MAX;
+    for (const std::pair<float, float>& t : trees) {
+        float dx = t.first - x;
+        float dz = t.second - z;
+        nearest = fminf(nearest, dx * dx + dz * dz);
+    }
+    return sqrtf(nearest) - TrunkRadius;
+}
+
+void SlalomCourse::Reset()
+{
+    nextGate = 0;
+    numMissed = 0;
+    lastGateTimed = -1;
+    startTime = 0.0;
+    splits.assign(splits.size(), -1.0);
+}
+
+// Whether the motion from (x0,z0) to (x1,z1) crosses the gate's line downhill, that is,
+//    from the uphill side (left of the direction from the left pole to the right pole).
+//    Returns the fraction of the motion at the crossing, and whether it is between the poles.
+bool SlalomCourse::Crosses(const Gate& g, float x0, float z0, float x1, float z1, float* fraction, bool* between) const
+{
+    float ex = g.rightX - g.leftX;
+    float ez = g.rightZ - g.leftZ;
+    float side0 = ex * (z0 - g.leftZ) - ez * (x0 - g.leftX);
+    float side1 = ex * (z1 - g.leftZ) - ez * (x1 - g.leftX);
+    if (!(side0 > 0.0f && side1 <= 0.0f)) {
+        return false;
+    }
+    float f = side0 / (side0 - side1);
+    float cx = x0 + f * (x1 - x0) - g.leftX;
+    float cz = z0 + f * (z1 - z0) - g.leftZ;
+    float u = (cx * ex + cz * ez) / (ex * ex + ez * ez);
+    *fraction = f;
+    *between = (u >= 0.0f && u <= 1.0f);
+    return true;
+}
+
+SlalomCourse::Event SlalomCourse::Tick(float x0, float z0, float x1, float z1, double t0, double dt)
+{
+    Event event = NoEvent;
+    int last = (int)gates.size() - 1;
+    while (nextGate <= last) {
+        float fraction;
+        bool between;
+        if (!Crosses(gates[nextGate], x0, z0, x1, z1, &fraction, &between)) {
+            break;
+        }
+        double t = t0 + fraction * dt;
+        if (nextGate == 0) {
+            startTime = t;
+            splits[0] = 0.0;
+            lastGateTimed = 0;
+            event = Started;
+        }
+        else if (between || nextGate == last) {
+            splits[nextGate] = t - startTime;
+            lastGateTimed = nextGate;
+            event = (nextGate == last) ? Finished : PassedGate;
+        }
+        else {
+            numMissed++;
+            event = MissedGate;
+        }
+        nextGate++;
+    }
+    return event;
+}
+
+double SlalomCourse::GetRunTime(double now) const
+{
+    if (nextGate == 0) {
+        return 0.0;
+    }
+    if (IsFinished()) {
+        return splits.back();
+    }
+    return now - startTime;
+}
@@ -0,0 +1,87 @@
+//
+// SlalomCourse.h
+//
+// A slalom or giant slalom course through the forest, and the timing of a run.
+//
+//   Generate() places the gates down the slope, chunk by chunk (chunks of
+//   ChunkDepth along z, as in TreeGpuCuller): two slalom gates or one giant
+//   slalom gate per chunk. Each gate swings to alternate sides of the fall
+//   line, as far as the trees allow: its position is chosen, among the
+//   candidates across the slope, for clearance from the nearby trunks and
+//   closeness to the rhythm of the course. The first gate is the start and
+//   the last the finish; both span the whole slope.
+//
+//   A gate is the segment between its two poles. Tick() is called for each
+//   step of the fixed-step simulation with the skier's motion during the
+//   step. Crossing a gate's line downhill between the poles passes the
+//   gate; crossing it outside the poles misses it. The time of the crossing
+//   is interpolated within the step, so splits are finer than the step.
+//   Only the next gate is tested, so a tick costs the same for any course,
+//   and nothing is allocated during a run.
+//
+//   Coordinates are world x and z, with the slope going down towards -z.
+//
+// How to use:
+//    * Generate() the course from the tree positions.
+//    * Call Tick() each simulation step. Reset() starts a new run.
+//
+
+#pragma once
+#ifndef SLALOM_COURSE_H
+#define SLALOM_COURSE_H
+
+#include <utility>
+#include <vector>
+
+class SlalomCourse {
+public:
+    enum Discipline { Slalom, GiantSlalom };
+    enum Event { NoEvent, Started, PassedGate, MissedGate, Finished };
+
+    struct Gate {
+        float leftX, leftZ;         // The poles
+        float rightX, rightZ;
+        bool red;                   // Gates alternate red and blue
+    };
+
+    static const int ChunkDepth = 20;
+    static constexpr float CourseHalfWidth = 12.0f;     // Gates are placed within this of x = 0
+    static constexpr float StartZ = -2.0f;
+    static constexpr float TrunkRadius = 0.5f;          // As drawn by renderTrunk()
+
+    SlalomCourse();
+
+    void Generate(const std::vector<std::pair<float, float>>& trees, Discipline discipline);
+    void Reset();
+
+    // The skier moves from (x0, z0) to (x1, z1) during the step from time t0 to t0 + dt.
+    //    Returns the last event in the step.
+    Event Tick(float x0, float z0, float x1, float z1, double t0, double dt);
+
+    Discipline GetDiscipline() const { return discipline; }
+    int GetNumGates() const { return (int)gates.size(); }
+    const Gate& GetGate(int i) const { return gates[i]; }
+    int GetNextGate() const { return nextGate; }
+    bool IsRunning() const { return nextGate > 0 && nextGate < (int)gates.size(); }
+    bool IsFinished() const { return nextGate == (int)gates.size() && !gates.empty(); }
+    int GetNumMissed() const { return numMissed; }
+
+    // Times from the start, in seconds. A gate's split is negative if it was missed, or not reached yet.
+    double GetSplit(int gate) const { return splits[gate]; }
+    double GetRunTime(double now) const;
+    int GetLastGateTimed() const { return lastGateTimed; }
+
+private:
+    bool Crosses(const Gate& g, float x0, float z0, float x1, float z1, float* fraction, bool* between) const;
+    float Clearance(const std::vector<std::pair<float, float>>& trees, float x, float z) const;
+
+    Discipline discipline;
+    std::vector<Gate> gates;
+    std::vector<double> splits;             // Sized by Generate(): no allocation during a run
+    int nextGate;
+    int numMissed;
+    int lastGateTimed;
+    double startTime;
+};
+
+#endif  // SLALOM_COURSE_H
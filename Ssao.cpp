@@ -0,0 +1,273 @@
+//
+// Ssao.cpp
+//
+// Screen-space ambient occlusion at half resolution, with a depth-aware upsample. See Ssao.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "Ssao.h"
+#include "FrameGraph.h"
+#include "GlShaderMgr.h"
+#include "PostProcess.h"
+#include "Profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static const int NumSamples[Ssao::NumQualities] = { 0, 4, 8, 16 };
+static const int UpsampleWidth[Ssao::NumQualities] = { 0, 2, 4, 4 };     // In half resolution texels
+
+// The passes of each view. The first view's are the names of a single view.
+static const int MaxViews = 4;
+static const char* SsaoPassNames[MaxViews] = { "SSAO", "SSAO 2", "SSAO 3", "SSAO 4" };
+static const char* UpsamplePassNames[MaxViews] = { "SSAO upsample", "SSAO upsample 2", "SSAO upsample 3", "SSAO upsample 4" };
+
+Ssao::Quality Ssao::quality = Ssao::Medium;
+float Ssao::projInfo[4] = { 1.0f, 1.0f, 1.0f, 2.0f };
+int Ssao::aoRaw = -1;
+int Ssao::ao = -1;
+int Ssao::numViews = 0;
+unsigned int Ssao::emptyVAO = 0;
+std::map<int, Ssao::Program> Ssao::programs;
+std::vector<Ssao::LitProgram> Ssao::litPrograms;
+
+void Ssao::RegisterProgram(unsigned int program)
+{
+    if (program == 0) {
+        return;
+    }
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "ssaoTexture"), TextureUnit);
+    LitProgram p;
+    p.program = program;
+    p.applyLoc = glGetUniformLocation(program, "applySsao");
+    glUniform1i(p.applyLoc, false);
+    litPrograms.push_back(p);
+}
+
+void Ssao::Setup()
+{
+    glGenVertexArrays(1, &emptyVAO);
+
+    // Software renderers rasterize on the CPU: take the cheapest tier.
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    if (renderer != 0 && (strstr(renderer, "llvmpipe") != 0 || strstr(renderer, "softpipe") != 0
+        || strstr(renderer, "SwiftShader") != 0)) {
+        quality = Low;
+        printf("SSAO: a software renderer, so the low quality tier.\n");
+    }
+}
+
+void Ssao::SetProjection(float xScale, float yScale, float zNear, float zFar)
+{
+    projInfo[0] = xScale;
+    projInfo[1] = yScale;
+    projInfo[2] = zNear;
+    projInfo[3] = zFar;
+}
+
+void Ssao::BeginFrame(FrameGraph& graph)
+{
+    numViews = 0;
+    aoRaw = ao = -1;
+    if (quality == Off) {
+        return;
+    }
+    FrameGraph::TextureDesc desc;
+    desc.width = (PostProcess::GetSceneWidth() + 1) / 2;
+    desc.height = (PostProcess::GetSceneHeight() + 1) / 2;
+    desc.samples = 0;
+    desc.internalFormat = GL_RG16F;         // Occlusion, and distance for the upsample
+    aoRaw = graph.CreateTexture("SSAO half resolution", desc);
+    desc.width = PostProcess::GetSceneWidth();
+    desc.height = PostProcess::GetSceneHeight();
+    desc.internalFormat = GL_R8;
+    ao = graph.CreateTexture("SSAO", desc);
+}
+
+int Ssao::AddPasses(FrameGraph& graph, int view, const int rect[4])
+{
+    if (quality == Off || ao < 0) {
+        return -1;
+    }
+    assert(view < MaxViews);
+    numViews++;
+
+    // The view's rectangle at half resolution covers every texel of its rectangle at full resolution.
+    int r[4] = { rect[0], rect[1], rect[2], rect[3] };
+    int h[4] = { rect[0] / 2, rect[1] / 2, 0, 0 };
+    h[2] = (rect[0] + rect[2] + 1) / 2 - h[0];
+    h[3] = (rect[1] + rect[3] + 1) / 2 - h[1];
+
+    int flags = quality | (PostProcess::IsMultisampled() ? Msaa : 0);
+    int depth = PostProcess::GetSceneDepth();
+    int raw = aoRaw;
+    FrameGraph* g = &graph;
+    int ssaoPass = graph.AddPass(SsaoPassNames[view], [g, flags, depth, r, h]() {
+        Run(GetProgram(flags), false, g->GetTexture(depth), 0, r, h);
+    });
+    graph.Read(ssaoPass, depth);
+    graph.Write(ssaoPass, aoRaw);
+
+    int upsamplePass = graph.AddPass(UpsamplePassNames[view], [g, flags, depth, raw, r, h]() {
+        Run(GetProgram(flags), true, g->GetTexture(depth), g->GetTexture(raw), r, h);
+    });
+    graph.Read(upsamplePass, depth);
+    graph.Read(upsamplePass, aoRaw);
+    graph.Write(upsamplePass, ao);
+    return ao;
+}
+
+void Ssao::Run(const Program& p, bool upsample, unsigned int depthTexture, unsigned int rawTexture,
+    const int rect[4], const int halfRect[4])
+{
+    if (p.ssao == 0 || p.upsample == 0) {
+        return;
+    }
+    GLenum depthTarget = PostProcess::IsMultisampled() ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    glUseProgram(upsample ? p.upsample : p.ssao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(depthTarget, depthTexture);
+    if (upsample) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, rawTexture);
+        glUniform4fv(p.upProjLoc, 1, projInfo);
+        glUniform4f(p.upRectLoc, (float)rect[0], (float)rect[1], (float)rect[2], (float)rect[3]);
+        glUniform4i(p.upHalfRectLoc, halfRect[0], halfRect[1], halfRect[0] + halfRect[2] - 1, halfRect[1] + halfRect[3] - 1);
+        glViewport(rect[0], rect[1], rect[2], rect[3]);
+    }
+    else {
+        glUniform4fv(p.ssaoProjLoc, 1, projInfo);
+        glUniform4f(p.ssaoRectLoc, (float)rect[0], (float)rect[1], (float)rect[2], (float)rect[3]);
+        glViewport(halfRect[0], halfRect[1], halfRect[2], halfRect[3]);
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    if (upsample) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glBindTexture(depthTarget, 0);
+}
+
+void Ssao::Apply(unsigned int texture)
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+    for (const LitProgram& p : litPrograms) {
+        glUseProgram(p.program);
+        glUniform1i(p.applyLoc, texture != 0);
+    }
+}
+
+// Compiles the two shaders of a quality tier with a generated code block of #defines,
+//    placed between the #version line and the shared code.
+const Ssao::Program& Ssao::GetProgram(int flags)
+{
+    auto it = programs.find(flags);
+    if (it != programs.end()) {
+        return it->second;
+    }
+
+    Quality q = (Quality)(flags & ~Msaa);
+    std::string defines = "#define SSAO_SAMPLES " + std::to_string(NumSamples[q]) + "\n"
+        + "#define SSAO_UPSAMPLE " + std::to_string(UpsampleWidth[q]) + "\n";
+    if (flags & Msaa) {
+        defines += "#define SSAO_MSAA\n";
+    }
+    std::string definesName = "ssaoDefines_" + std::to_string(flags);
+    GlShaderMgr::LoadSingleShaderString(defines.c_str(), "codeblock", definesName.c_str());
+
+    Program& p = programs[flags];
+    p.ssao = p.upsample = 0;
+    const char* ssaoBlocks[4] = { "postVersion", definesName.c_str(), "ssaoCommon", "fragmentShader_Ssao" };
+    const char* upsampleBlocks[4] = { "postVersion", definesName.c_str(), "ssaoCommon", "fragmentShader_SsaoUpsample" };
+    unsigned int shaders[2];
+    shaders[0] = GlShaderMgr::CompileShader("vertexShader_Fullscreen");
+    shaders[1] = GlShaderMgr::CompileShader(4, ssaoBlocks);
+    if (shaders[0] != 0 && shaders[1] != 0) {
+        p.ssao = GlShaderMgr::LinkShaderProgram(2, shaders);
+    }
+    shaders[1] = GlShaderMgr::CompileShader(4, upsampleBlocks);
+    if (shaders[0] != 0 && shaders[1] != 0) {
+        p.upsample = GlShaderMgr::LinkShaderProgram(2, shaders);
+    }
+    if (p.ssao == 0 || p.upsample == 0) {
+        fprintf(stderr, "Ssao: failed to build the shaders for %s.\n", definesName.c_str());
+        return p;
+    }
+
+    glUseProgram(p.ssao);
+    p.ssaoDepthLoc = glGetUniformLocation(p.ssao, "sceneDepth");
+    p.ssaoProjLoc = glGetUniformLocation(p.ssao, "projInfo");
+    p.ssaoRectLoc = glGetUniformLocation(p.ssao, "viewRect");
+    glUniform1i(p.ssaoDepthLoc, 0);
+    glUniform3f(glGetUniformLocation(p.ssao, "aoParams"), Radius, Bias, Strength);
+
+    glUseProgram(p.upsample);
+    p.upDepthLoc = glGetUniformLocation(p.upsample, "sceneDepth");
+    p.upRawLoc = glGetUniformLocation(p.upsample, "rawAo");
+    p.upProjLoc = glGetUniformLocation(p.upsample, "projInfo");
+    p.upRectLoc = glGetUniformLocation(p.upsample, "viewRect");
+    p.upHalfRectLoc = glGetUniformLocation(p.upsample, "halfRect");
+    glUniform1i(p.upDepthLoc, 0);
+    glUniform1i(p.upRawLoc, 1);
+    glUniform1f(glGetUniformLocation(p.upsample, "depthFalloff"), DepthFalloff);
+    return p;
+}
+
+void Ssao::CycleQuality()
+{
+    quality = (Quality)((quality + 1) % NumQualities);
+    PrintStatus();
+}
+
+const char* Ssao::QualityName(Quality q)
+{
+    switch (q) {
+    case Off:
+        return "off";
+    case Low:
+        return "low";
+    case Medium:
+        return "medium";
+    case High:
+        return "high";
+    default:
+        return "?";
+    }
+}
+
+void Ssao::PrintStatus()
+{
+    printf("SSAO is %s", QualityName(quality));
+    if (quality == Off) {
+        printf(".\n");
+        return;
+    }
+    printf(": %d samples at half resolution, a %dx%d depth-aware upsample.\n",
+        NumSamples[quality], UpsampleWidth[quality], UpsampleWidth[quality]);
+    if (aoRaw >= 0 && numViews == 0) {
+        printf("  Not applied: it needs the depth prepass (Z).\n");
+    }
+    int ssaoTimer = FrameGraph::PassTimer(SsaoPassNames[0]);
+    int upsampleTimer = FrameGraph::PassTimer(UpsamplePassNames[0]);
+    if (Profiler::HasValue(ssaoTimer) && Profiler::HasValue(upsampleTimer)) {
+        printf("  SSAO pass %.3f ms, upsample pass %.3f ms on the GPU.\n",
+            Profiler::GetValue(ssaoTimer), Profiler::GetValue(upsampleTimer));
+    }
+}
@@ -0,0 +1,105 @@
+//
+// Ssao.h
+//
+// Screen-space ambient occlusion: the contact shading where the trees, the skiers
+//    and the gates stand on the snow, from the depths of the depth prepass.
+//
+//   For each view, two passes of the frame graph (see FrameGraph.h) run
+//   between its depth prepass and its opaque pass:
+//     * "SSAO", at half the scene's resolution: each pixel's position is
+//         rebuilt from the scene depth, and its normal from the neighboring
+//         depths. Samples in the hemisphere about the normal, within Radius,
+//         are tested against the depth buffer, turned by an ordered dither so
+//         that the upsample averages the noise away. It writes the occlusion
+//         and the pixel's distance.
+//     * "SSAO upsample", at the scene's resolution: a blur of the half
+//         resolution occlusion, each texel weighted by how near its distance
+//         is to the pixel's, so that the occlusion does not bleed across silhouettes.
+//   The opaque pass then scales the ambient terms of CalculatePhongLighting()
+//   (and of calcPhongLightingBaked) by the occlusion: see fragmentShader_PhongPhong.
+//   The Gouraud shaded meshes, lit at their vertices, and the leaf cards,
+//   which are not in the depth prepass, are not occluded.
+//
+//   The quality tiers trade the number of samples against the width of the blur:
+//     * Low: 4 samples, a 2x2 upsample. Chosen by Setup() for a software
+//         renderer (llvmpipe, softpipe, SwiftShader), as in continuous integration.
+//     * Medium: 8 samples, a 4x4 upsample.
+//     * High: 16 samples, a 4x4 upsample.
+//   Without the depth prepass there are no depths before the opaque pass, so no SSAO.
+//
+// How to use:
+//    * RegisterProgram() each program made with fragmentShader_PhongPhong, then
+//          call Setup() once.
+//    * SetProjection() whenever the projection matrix changes.
+//    * Each frame, after PostProcess::BeginFrame(), call BeginFrame(). After each
+//          view's depth prepass, AddPasses(): the opaque pass reads the texture
+//          it returns, and calls Apply() with it before drawing, Apply(0) after.
+//
+
+#pragma once
+#ifndef SSAO_H
+#define SSAO_H
+
+#include <map>
+#include <vector>
+
+class FrameGraph;
+
+class Ssao {
+public:
+    enum Quality { Off, Low, Medium, High, NumQualities };
+
+    static constexpr float Radius = 1.2f;           // Of the hemisphere of samples, in scene units
+    static constexpr float Bias = 0.05f;            // Depth difference not counted as occlusion
+    static constexpr float Strength = 1.0f;
+    static constexpr float DepthFalloff = 30.0f;    // Upsample weight exp(-DepthFalloff * relative depth difference)
+    static const int TextureUnit = 2;               // For the occlusion, in the lit programs
+
+    static void RegisterProgram(unsigned int program);
+    static void Setup();
+
+    // The entries (0,0) and (1,1) of the projection matrix, and its near and far distances.
+    static void SetProjection(float xScale, float yScale, float zNear, float zFar);
+
+    // Declares the occlusion targets, at the scene's resolution and half of it.
+    static void BeginFrame(FrameGraph& graph);
+
+    // Adds the passes of a view, in the rectangle (x, y, width, height) of the
+    //    scene targets. Returns the occlusion texture, or -1 when SSAO is off.
+    static int AddPasses(FrameGraph& graph, int view, const int rect[4]);
+
+    // Binds the occlusion texture for the registered programs; 0 turns the occlusion off.
+    static void Apply(unsigned int texture);
+
+    static void CycleQuality();
+    static Quality GetQuality() { return quality; }
+    static void PrintStatus();
+
+private:
+    enum { Msaa = 8 };              // Added to the quality in the program flags
+
+    struct Program {
+        unsigned int ssao, upsample;
+        int ssaoDepthLoc, ssaoProjLoc, ssaoRectLoc;
+        int upDepthLoc, upRawLoc, upProjLoc, upRectLoc, upHalfRectLoc;
+    };
+    struct LitProgram {
+        unsigned int program;
+        int applyLoc;
+    };
+
+    static const Program& GetProgram(int flags);
+    static void Run(const Program& p, bool upsample, unsigned int depthTexture, unsigned int rawTexture,
+        const int rect[4], const int halfRect[4]);
+    static const char* QualityName(Quality q);
+
+    static Quality quality;
+    static float projInfo[4];           // xScale, yScale, zNear, zFar
+    static int aoRaw, ao;               // This frame's targets
+    static int numViews;                // Given passes this frame
+    static unsigned int emptyVAO;
+    static std::map<int, Program> programs;     // By flags
+    static std::vector<LitProgram> litPrograms;
+};
+
+#endif  // SSAO_H
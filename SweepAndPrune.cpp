@@ -0,0 +1,187 @@
+//
+// SweepAndPrune.cpp
+//
+// Incremental sweep and prune along z, with persistent pairs. See SweepAndPrune.h.
+//
+
+#include "SweepAndPrune.h"
+
+static const uint64_t EmptyKey = ~(uint64_t)0;
+static const int MinTableSize = 256;
+
+static unsigned int HashKey(uint64_t key)
+{
+    key *= 0x9E3779B97F4A7C15ull;
+    return (unsigned int)(key >> 32);
+}
+
+SweepAndPrune::SweepAndPrune()
+{
+    tableKeys.assign(MinTableSize, EmptyKey);
+    tablePairs.assign(MinTableSize, -1);
+    numSwaps = 0;
+}
+
+void SweepAndPrune::Clear()
+{
+    boxes.clear();
+    ends.clear();
+    pairs.clear();
+    overlaps.clear();
+    tableKeys.assign(tableKeys.size(), EmptyKey);
+    numSwaps = 0;
+}
+
+// The ends are added at the end of the list: the next Update() sorts them in,
+//    and finds the new body's pairs as it does.
+int SweepAndPrune::AddBody(float minX, float maxX, float minZ, float maxZ)
+{
+    Box b = { minX, maxX, minZ, maxZ };
+    boxes.push_back(b);
+    int body = (int)boxes.size() - 1;
+    End e = { minZ, body, false };
+    ends.push_back(e);
+    e.z = maxZ;
+    e.isMax = true;
+    ends.push_back(e);
+    return body;
+}
+
+void SweepAndPrune::SetBox(int body, float minX, float maxX, float minZ, float maxZ)
+{
+    Box& b = boxes[body];
+    b.minX = minX;
+    b.maxX = maxX;
+    b.minZ = minZ;
+    b.maxZ = maxZ;
+}
+
+void SweepAndPrune::Update()
+{
+    for (End& e : ends) {
+        e.z = e.isMax ? boxes[e.body].maxZ : boxes[e.body].minZ;
+    }
+
+    // Insertion sort. An end moving down past another changes a pair.
+    //    At equal z, ends go before starts: boxes that only touch do not overlap.
+    numSwaps = 0;
+    for (int i = 1; i < (int)ends.size(); i++) {
+        End e = ends[i];
+        int j = i;
+        while (j > 0 && (ends[j - 1].z > e.z || (ends[j - 1].z == e.z && !ends[j - 1].isMax && e.isMax))) {
+            const End& f = ends[j - 1];
+            if (e.body == f.body) {
+                // The box's own ends, for a box of no depth
+            }
+            else if (!e.isMax && f.isMax) {
+                // The start of e's box is now below the end of f's box
+                const Box& a = boxes[e.body];
+                const Box& b = boxes[f.body];
+                if (b.minZ < a.maxZ) {
+                    AddPair(e.body, f.body);
+                }
+            }
+            else if (e.isMax && !f.isMax) {
+                RemovePair(e.body, f.body);     // The end of e's box is now below the start of f's box
+            }
+            ends[j] = f;
+            j--;
+            numSwaps++;
+        }
+        ends[j] = e;
+    }
+
+    overlaps.clear();
+    for (const std::pair<int, int>& p : pairs) {
+        const Box& a = boxes[p.first];
+        const Box& b = boxes[p.second];
+        if (a.minX < b.maxX && b.minX < a.maxX) {
+            overlaps.push_back(p);
+        }
+    }
+}
+
+uint64_t SweepAndPrune::PairKey(int a, int b)
+{
+    if (a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    return ((uint64_t)(unsigned int)a << 32) | (uint64_t)(unsigned int)b;
+}
+
+// The slot holding the key, or the empty slot where it would go.
+int SweepAndPrune::FindSlot(uint64_t key) const
+{
+    unsigned int mask = (unsigned int)tableKeys.size() - 1;
+    unsigned int slot = HashKey(key) & mask;
+    while (tableKeys[slot] != key && tableKeys[slot] != EmptyKey) {
+        slot = (slot + 1) & mask;
+    }
+    return (int)slot;
+}
+
+void SweepAndPrune::AddPair(int a, int b)
+{
+    uint64_t key = PairKey(a, b);
+    int slot = FindSlot(key);
+    if (tableKeys[slot] == key) {
+        return;
+    }
+    if (2 * (pairs.size() + 1) > tableKeys.size()) {
+        GrowTable();
+        slot = FindSlot(key);
+    }
+    tableKeys[slot] = key;
+    tablePairs[slot] = (int)pairs.size();
+    pairs.push_back(a < b ? std::make_pair(a, b) : std::make_pair(b, a));
+}
+
+void SweepAndPrune::RemovePair(int a, int b)
+{
+    uint64_t key = PairKey(a, b);
+    int slot = FindSlot(key);
+    if (tableKeys[slot] != key) {
+        return;
+    }
+    int index = tablePairs[slot];
+
+    // Empty the slot, moving back the keys after it that probed past it.
+    unsigned int mask = (unsigned int)tableKeys.size() - 1;
+    unsigned int hole = (unsigned int)slot;
+    for (unsigned int next = (hole + 1) & mask; tableKeys[next] != EmptyKey; next = (next + 1) & mask) {
+        unsigned int home = HashKey(tableKeys[next]) & mask;
+        bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            tableKeys[hole] = tableKeys[next];
+            tablePairs[hole] = tablePairs[next];
+            hole = next;
+        }
+    }
+    tableKeys[hole] = EmptyKey;
+
+    // Keep the pairs dense: the last pair takes the removed pair's place.
+    if (index != (int)pairs.size() - 1) {
+        pairs[index] = pairs.back();
+        tablePairs[FindSlot(PairKey(pairs[index].first, pairs[index].second))] = index;
+    }
+    pairs.pop_back();
+}
+
+void SweepAndPrune::GrowTable()
+{
+    std::vector<uint64_t> oldKeys;
+    std::vector<int> oldPairs;
+    oldKeys.swap(tableKeys);
+    oldPairs.swap(tablePairs);
+    tableKeys.assign(2 * oldKeys.size(), EmptyKey);
+    tablePairs.assign(2 * oldKeys.size(), -1);
+    for (int i = 0; i < (int)oldKeys.size(); i++) {
+        if (oldKeys[i] != EmptyKey) {
+            int slot = FindSlot(oldKeys[i]);
+            tableKeys[slot] = oldKeys[i];
+            tablePairs[slot] = oldPairs[i];
+        }
+    }
+}
@@ -0,0 +1,76 @@
+//
+// SweepAndPrune.h
+//
+// Broadphase for moving bodies: skiers colliding with each other.
+//
+//   Each body is a box in x and z. The ends of the boxes along z (the
+//   downhill axis, along which the skiers spread out) are kept in one
+//   sorted list. Update() re-sorts the list with an insertion sort: between
+//   steps the bodies move little, so the list is nearly sorted and the sort
+//   takes about one pass, plus one swap for each pair of ends that crossed.
+//   The pairs overlapping along z are kept from step to step: a pair starts
+//   when the start of one box crosses the end of the other, and ends when
+//   the end of one crosses the start of the other. So the pairs are only
+//   touched where something changed. Then the kept pairs that also overlap
+//   in x are the overlaps of the step.
+//
+//   The pairs are in a dense list, indexed by an open addressing hash table:
+//   nothing is allocated once they have grown to the largest number needed.
+//
+// How to use:
+//    * AddBody() each body; the handles count up from 0, after Clear().
+//    * Each step, SetBox() the bodies that moved, then call Update().
+//    * GetNumOverlaps() and GetOverlap() give the pairs of bodies whose boxes overlap.
+//
+
+#pragma once
+#ifndef SWEEP_AND_PRUNE_H
+#define SWEEP_AND_PRUNE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+class SweepAndPrune {
+public:
+    SweepAndPrune();
+
+    void Clear();
+    int AddBody(float minX, float maxX, float minZ, float maxZ);
+    void SetBox(int body, float minX, float maxX, float minZ, float maxZ);
+    void Update();
+
+    int GetNumBodies() const { return (int)boxes.size(); }
+    int GetNumOverlaps() const { return (int)overlaps.size(); }
+    const std::pair<int, int>& GetOverlap(int i) const { return overlaps[i]; }
+
+    int GetNumPairs() const { return (int)pairs.size(); }   // Overlapping along z
+    int GetNumSwaps() const { return numSwaps; }            // In the last Update()
+
+private:
+    struct Box {
+        float minX, maxX;
+        float minZ, maxZ;
+    };
+    struct End {
+        float z;
+        int body;
+        bool isMax;
+    };
+
+    void AddPair(int a, int b);
+    void RemovePair(int a, int b);
+    static uint64_t PairKey(int a, int b);
+    int FindSlot(uint64_t key) const;
+    void GrowTable();
+
+    std::vector<Box> boxes;
+    std::vector<End> ends;                      // Sorted by z
+    std::vector<std::pair<int, int>> pairs;     // Overlapping along z, the lower body first
+    std::vector<std::pair<int, int>> overlaps;
+    std::vector<uint64_t> tableKeys;            // Open addressing, with linear probing
+    std::vector<int> tablePairs;                // Index into pairs
+    int numSwaps;
+};
+
+#endif  // SWEEP_AND_PRUNE_H
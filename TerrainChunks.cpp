@@ -0,0 +1,150 @@
+//
+// TerrainChunks.cpp
+//
+// The chunks of snow under the forest, and their bake. See TerrainChunks.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TerrainChunks.h"
+#include "ObstacleGrid.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+
+unsigned int TerrainChunks::theVAO = 0;
+unsigned int TerrainChunks::theVBO = 0;
+unsigned int TerrainChunks::theBakedVBO = 0;
+unsigned int TerrainChunks::theEBO = 0;
+int TerrainChunks::numElements = 0;
+bool TerrainChunks::isReady = false;
+std::vector<std::pair<float, float>> TerrainChunks::chunkCorners;
+std::vector<float> TerrainChunks::verts;
+std::vector<float> TerrainChunks::bakedLight;
+LightBaker TerrainChunks::baker;
+
+void TerrainChunks::Setup(const ObstacleGrid& grid, unsigned int pos_loc, unsigned int normal_loc,
+    unsigned int texcoords_loc, unsigned int bakedLight_loc)
+{
+    assert(theVAO == 0);
+    if (grid.GetNumTrees() == 0) {
+        return;
+    }
+
+    // The chunks cover the forest, with a chunk to spare all around.
+    float minX = FLT_MAX, maxX = -FLT_MAX, minZ = FLT_MAX, maxZ = -FLT_MAX;
+    for (int i = 0; i < grid.GetNumTrees(); i++) {
+        const std::pair<float, float>& t = grid.GetTree(i);
+        minX = fminf(minX, t.first);
+        maxX = fmaxf(maxX, t.first);
+        minZ = fminf(minZ, t.second);
+        maxZ = fmaxf(maxZ, t.second);
+    }
+    float x0 = ChunkSize * (floorf(minX / ChunkSize) - 1.0f);
+    float z0 = ChunkSize * (floorf(minZ / ChunkSize) - 1.0f);
+    int numX = (int)ceilf((maxX - x0) / ChunkSize) + 1;
+    int numZ = (int)ceilf((maxZ - z0) / ChunkSize) + 1;
+
+    const int vertsPerChunk = VertsAcross * VertsAcross;
+    chunkCorners.clear();
+    verts.clear();
+    verts.reserve(numX * numZ * vertsPerChunk * 8);
+    for (int cz = 0; cz < numZ; cz++) {
+        for (int cx = 0; cx < numX; cx++) {
+            float cornerX = x0 + cx * ChunkSize;
+            float cornerZ = z0 + cz * ChunkSize;
+            chunkCorners.push_back(std::make_pair(cornerX, cornerZ));
+            for (int j = 0; j < VertsAcross; j++) {
+                for (int i = 0; i < VertsAcross; i++) {
+                    float x = cornerX + i * VertexSpacing;
+                    float z = cornerZ + j * VertexSpacing;
+                    float v[8] = { x, Lift, z, 0.0f, 1.0f, 0.0f, x / TextureExtent, -z / TextureExtent };
+                    verts.insert(verts.end(), v, v + 8);
+                }
+            }
+        }
+    }
+    std::vector<unsigned int> elts;
+    for (int j = 0; j < VertsAcross - 1; j++) {
+        for (int i = 0; i < VertsAcross - 1; i++) {
+            unsigned int k = j * VertsAcross + i;
+            unsigned int quad[6] = { k, k + VertsAcross, k + 1, k + 1, k + VertsAcross, k + VertsAcross + 1 };
+            elts.insert(elts.end(), quad, quad + 6);
+        }
+    }
+    numElements = (int)elts.size();
+
+    glGenVertexArrays(1, &theVAO);
+    glGenBuffers(1, &theVBO);
+    glGenBuffers(1, &theBakedVBO);
+    glGenBuffers(1, &theEBO);
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, theVBO);
+    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(pos_loc);
+    glVertexAttribPointer(normal_loc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(normal_loc);
+    glVertexAttribPointer(texcoords_loc, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(texcoords_loc);
+    glBindBuffer(GL_ARRAY_BUFFER, theBakedVBO);
+    glBufferData(GL_ARRAY_BUFFER, (verts.size() / 8) * 2 * sizeof(float), 0, GL_STATIC_DRAW);
+    glVertexAttribPointer(bakedLight_loc, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(bakedLight_loc);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, elts.size() * sizeof(unsigned int), elts.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // One job per chunk
+    bakedLight.assign((verts.size() / 8) * 2, 0.0f);
+    std::vector<LightBaker::Job> jobs;
+    for (int c = 0; c < (int)chunkCorners.size(); c++) {
+        LightBaker::Job job;
+        job.grid = &grid;
+        job.verts = &verts[c * vertsPerChunk * 8];
+        job.numVerts = vertsPerChunk;
+        job.stride = 8;
+        job.scale[0] = job.scale[1] = job.scale[2] = 1.0f;
+        job.twoSided = false;
+        job.ignoreTrunks = false;
+        job.baked = &bakedLight[c * vertsPerChunk * 2];
+        jobs.push_back(job);
+    }
+    baker.Start(jobs);
+}
+
+bool TerrainChunks::Update()
+{
+    if (isReady || theVAO == 0 || !baker.Update()) {
+        return isReady;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, theBakedVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bakedLight.size() * sizeof(float), bakedLight.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    verts.clear();
+    verts.shrink_to_fit();
+    bakedLight.clear();
+    bakedLight.shrink_to_fit();
+    isReady = true;
+    return true;
+}
+
+void TerrainChunks::Shutdown()
+{
+    baker.Shutdown();
+}
+
+void TerrainChunks::Render(int chunk)
+{
+    assert(isReady);
+    glBindVertexArray(theVAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, numElements, GL_UNSIGNED_INT, (void*)0,
+        chunk * VertsAcross * VertsAcross);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,66 @@
+//
+// TerrainChunks.h
+//
+// The snow under the forest, in square chunks, with the static lighting baked into its vertices.
+//
+//   The floor quad of SceneRenderer stays in front of the camera, so it
+//   cannot hold lighting that belongs to the trees. The chunks are in the
+//   trees' coordinates, and cover the forest with a margin of a chunk; each
+//   is ChunkSize across, with a vertex every VertexSpacing. The ambient
+//   occlusion under the trees, and the trees' shadows, are baked against the
+//   obstacle grid (see LightBaker.h), one job per chunk. The chunks lie Lift
+//   above the floor, so they hide it where they are drawn.
+//
+//   All chunks share one VAO: one VBO of vertices, one of baked lighting,
+//   and one EBO with the triangles of a single chunk, drawn with a base vertex.
+//
+// How to use:
+//    * Setup() once the obstacle grid is built. It starts the bake.
+//    * Call Update() once per frame. It returns true once the chunks are baked:
+//          until then, draw only the floor.
+//    * Cull the chunks with GetChunkX() and GetChunkZ(), and Render() the others,
+//          with shaderProgramBaked selected and the snow texture bound.
+//    * Call Shutdown() before exiting, to wait for any worker threads.
+//
+
+#pragma once
+#ifndef TERRAIN_CHUNKS_H
+#define TERRAIN_CHUNKS_H
+
+#include "LightBaker.h"
+
+#include <vector>
+
+class TerrainChunks {
+public:
+    static constexpr float ChunkSize = 16.0f;
+    static const int VertsAcross = 17;              // A vertex every VertexSpacing
+    static constexpr float VertexSpacing = ChunkSize / (VertsAcross - 1);
+    static constexpr float Lift = 0.05f;            // Height above the floor
+    static constexpr float TextureExtent = 40.0f;   // The floor's width: the snow texture, once
+
+    static void Setup(const ObstacleGrid& grid, unsigned int pos_loc, unsigned int normal_loc,
+        unsigned int texcoords_loc, unsigned int bakedLight_loc);
+    static bool Update();
+    static bool IsReady() { return isReady; }
+    static const LightBaker& GetBaker() { return baker; }
+    static void Shutdown();
+
+    static int GetNumChunks() { return (int)chunkCorners.size(); }
+    // The corner of a chunk with the least x and z
+    static float GetChunkX(int chunk) { return chunkCorners[chunk].first; }
+    static float GetChunkZ(int chunk) { return chunkCorners[chunk].second; }
+    static void Render(int chunk);
+
+private:
+    static unsigned int theVAO, theVBO, theBakedVBO, theEBO;
+    static int numElements;
+    static bool isReady;
+
+    static std::vector<std::pair<float, float>> chunkCorners;
+    static std::vector<float> verts;            // Until baked
+    static std::vector<float> bakedLight;
+    static LightBaker baker;
+};
+
+#endif  // TERRAIN_CHUNKS_H
@@ -0,0 +1,382 @@
+//
+// TextureStreamer.cpp
+//
+// Streams the mip levels of textures within a memory budget. See TextureStreamer.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TextureStreamer.h"
+#include "RgbImage.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+std::deque<TextureStreamer::Entry> TextureStreamer::entries;
+std::unordered_map<unsigned int, int> TextureStreamer::entryOfName;
+size_t TextureStreamer::budget = 64 << 20;
+size_t TextureStreamer::residentBytes = 0;
+int TextureStreamer::frame = 0;
+std::thread TextureStreamer::worker;
+std::mutex TextureStreamer::queueMutex;
+std::condition_variable TextureStreamer::queueReady;
+std::deque<TextureStreamer::Entry*> TextureStreamer::queue;
+bool TextureStreamer::stopping = false;
+
+void TextureStreamer::Start()
+{
+    assert(!worker.joinable());
+    stopping = false;
+    worker = std::thread(WorkerMain);
+}
+
+void TextureStreamer::Shutdown()
+{
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;            // The worker stops after its current texture
+    }
+    queueReady.notify_one();
+    worker.join();
+}
+
+// Creates the OpenGL texture, holding one gray texel until the texture is decoded.
+TextureStreamer::Entry& TextureStreamer::AddEntry(int wrapMode)
+{
+    entries.emplace_back();
+    Entry& e = entries.back();
+    e.fromFile = false;
+    e.numChannels = 3;
+    e.failed = false;
+    e.coarseLevel = 0;
+    e.residentLevel = -1;
+    e.wantedLevel = 0;
+    e.pixelsThisFrame = 0.0f;
+    e.lastUsedFrame = -StaleFrames;
+    e.numUploads = 0;
+    e.numEvictions = 0;
+
+    static const unsigned char gray[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &e.name);
+    glBindTexture(GL_TEXTURE_2D, e.name);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    entryOfName[e.name] = (int)entries.size() - 1;
+    return e;
+}
+
+unsigned int TextureStreamer::Register(const char* filename, int wrapMode)
+{
+    Entry& e = AddEntry(wrapMode);
+    e.filename = filename;
+    e.fromFile = true;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(&e);
+    }
+    queueReady.notify_one();
+    return e.name;
+}
+
+unsigned int TextureStreamer::Register(const RgbImage& image, const char* label, int wrapMode)
+{
+    Entry& e = AddEntry(wrapMode);
+    e.filename = label;
+    if (!image.ImageLoaded()) {
+        e.failed = true;
+        e.decoded = true;
+        return e.name;
+    }
+    // Copy the image now: the worker builds the rest of the mip chain.
+    int cols = (int)image.GetNumCols();
+    int rows = (int)image.GetNumRows();
+    e.numChannels = image.GetNumChannels();
+    e.widths.push_back(cols);
+    e.heights.push_back(rows);
+    e.levels.resize(1);
+    e.levels[0].resize((size_t)cols * rows * e.numChannels);
+    for (int row = 0; row < rows; row++) {
+        const unsigned char* src = image.GetRgbPixel(row, 0);
+        std::copy(src, src + cols * e.numChannels, e.levels[0].begin() + (size_t)row * cols * e.numChannels);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(&e);
+    }
+    queueReady.notify_one();
+    return e.name;
+}
+
+void TextureStreamer::SetBudget(size_t bytes)
+{
+    budget = bytes;
+}
+
+void TextureStreamer::NoteUse(unsigned int texture, float pixelsOnScreen)
+{
+    std::unordered_map<unsigned int, int>::const_iterator it = entryOfName.find(texture);
+    if (it == entryOfName.end()) {
+        return;
+    }
+    Entry& e = entries[it->second];
+    e.pixelsThisFrame = (e.lastUsedFrame == frame) ? fmaxf(e.pixelsThisFrame, pixelsOnScreen) : pixelsOnScreen;
+    e.lastUsedFrame = frame;
+}
+
+void TextureStreamer::WorkerMain()
+{
+    for (;;) {
+        Entry* e;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            e = queue.front();
+            queue.pop_front();
+        }
+        Decode(*e);
+    }
+}
+
+// Runs on the background thread: reads the file if there is one, then builds
+//    the mip chain with a 2x2 box filter. The last row or column of an odd
+//    sized level is dropped.
+void TextureStreamer::Decode(Entry& e)
+{
+    if (e.fromFile) {
+        RgbImage image;
+        if (!image.LoadBmpFile(e.filename.c_str())) {
+            e.failed = true;
+            e.decoded = true;
+            return;
+        }
+        int cols = (int)image.GetNumCols();
+        int rows = (int)image.GetNumRows();
+        e.numChannels = image.GetNumChannels();
+        e.widths.assign(1, cols);
+        e.heights.assign(1, rows);
+        e.levels.resize(1);
+        e.levels[0].resize((size_t)cols * rows * e.numChannels);
+        for (int row = 0; row < rows; row++) {
+            const unsigned char* src = image.GetRgbPixel(row, 0);
+            std::copy(src, src + cols * e.numChannels, e.levels[0].begin() + (size_t)row * cols * e.numChannels);
+        }
+    }
+
+    const int nc = e.numChannels;
+    while (e.widths.back() > 1 || e.heights.back() > 1) {
+        int w = e.widths.back();
+        int h = e.heights.back();
+        int nw = w > 1 ? w / 2 : 1;
+        int nh = h > 1 ? h / 2 : 1;
+        const std::vector<unsigned char>& src = e.levels.back();
+        std::vector<unsigned char> dst((size_t)nw * nh * nc);
+        for (int y = 0; y < nh; y++) {
+            int y0 = (2 * y < h) ? 2 * y : h - 1;
+            int y1 = (y0 + 1 < h) ? y0 + 1 : y0;
+            for (int x = 0; x < nw; x++) {
+                int x0 = (2 * x < w) ? 2 * x : w - 1;
+                int x1 = (x0 + 1 < w) ? x0 + 1 : x0;
+                for (int c = 0; c < nc; c++) {
+                    int sum = src[((size_t)y0 * w + x0) * nc + c] + src[((size_t)y0 * w + x1) * nc + c]
+                        + src[((size_t)y1 * w + x0) * nc + c] + src[((size_t)y1 * w + x1) * nc + c];
+                    dst[((size_t)y * nw + x) * nc + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        e.widths.push_back(nw);
+        e.heights.push_back(nh);
+        e.levels.push_back(std::move(dst));
+    }
+
+    int level = 0;
+    while (e.widths[level] > MinResidentSize || e.heights[level] > MinResidentSize) {
+        level++;
+    }
+    e.coarseLevel = level;
+    e.wantedLevel = level;
+    e.decoded = true;
+}
+
+// Counted as four bytes per texel, since GPUs usually store RGB textures that way.
+size_t TextureStreamer::LevelBytes(const Entry& e, int level)
+{
+    return (size_t)e.widths[level] * (size_t)e.heights[level] * 4;
+}
+
+// Uploads the next finer level, or the first (coarsest) one.
+void TextureStreamer::UploadLevel(Entry& e, int level)
+{
+    int numLevels = (int)e.levels.size();
+    assert(level == (e.residentLevel < 0 ? numLevels - 1 : e.residentLevel - 1));
+    GLenum format = (e.numChannels == 4) ? GL_RGBA : GL_RGB;
+    glBindTexture(GL_TEXTURE_2D, e.name);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);      // The rows are tightly packed
+    glTexImage2D(GL_TEXTURE_2D, level, (e.numChannels == 4) ? GL_RGBA8 : GL_RGB8,
+        e.widths[level], e.heights[level], 0, format, GL_UNSIGNED_BYTE, e.levels[level].data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (e.residentLevel < 0) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    e.residentLevel = level;
+    residentBytes += LevelBytes(e, level);
+    e.numUploads++;
+}
+
+// Frees the finest resident level. The base level is raised first, so the texture stays complete.
+void TextureStreamer::EvictLevel(Entry& e)
+{
+    int level = e.residentLevel;
+    assert(level >= 0 && level < e.coarseLevel);
+    glBindTexture(GL_TEXTURE_2D, e.name);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glTexImage2D(GL_TEXTURE_2D, level, (e.numChannels == 4) ? GL_RGBA8 : GL_RGB8, 0, 0, 0,
+        (e.numChannels == 4) ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    e.residentLevel = level + 1;
+    residentBytes -= LevelBytes(e, level);
+    e.numEvictions++;
+}
+
+// Evicts levels until bytesNeeded more fit in the budget. Returns false if it cannot.
+//    Stale textures go first, oldest first; then levels finer than wanted, largest excess
+//    first; then, unless onlyUnneeded, wanted levels, least recently used first.
+bool TextureStreamer::EvictFor(size_t bytesNeeded, const Entry* requester, bool onlyUnneeded)
+{
+    while (residentBytes + bytesNeeded > budget) {
+        Entry* victim = 0;
+        int victimRank = 0, victimOrder = 0;
+        for (Entry& e : entries) {
+            if (&e == requester || e.residentLevel < 0 || e.residentLevel >= e.coarseLevel) {
+                continue;
+            }
+            int excess = e.wantedLevel - e.residentLevel;
+            int rank, order;
+            if (frame - e.lastUsedFrame >= StaleFrames) {
+                rank = 0;
+                order = e.lastUsedFrame;
+            }
+            else if (excess > 0) {
+                rank = 1;
+                order = -excess;
+            }
+            else if (!onlyUnneeded) {
+                rank = 2;
+                order = e.lastUsedFrame;
+            }
+            else {
+                continue;
+            }
+            if (victim == 0 || rank < victimRank || (rank == victimRank && order < victimOrder)) {
+                victim = &e;
+                victimRank = rank;
+                victimOrder = order;
+            }
+        }
+        if (victim == 0) {
+            return false;
+        }
+        EvictLevel(*victim);
+    }
+    return true;
+}
+
+void TextureStreamer::Update()
+{
+    // Newly decoded textures get their coarse levels at once.
+    for (Entry& e : entries) {
+        if (e.residentLevel < 0 && e.decoded && !e.failed) {
+            for (int level = (int)e.levels.size() - 1; level >= e.coarseLevel; level--) {
+                UploadLevel(e, level);
+            }
+        }
+    }
+
+    // The wanted level gives at least one texel per pixel.
+    std::vector<Entry*> needy;
+    for (Entry& e : entries) {
+        if (e.residentLevel < 0) {
+            continue;
+        }
+        if (e.lastUsedFrame == frame) {
+            float texels = (float)(e.widths[0] > e.heights[0] ? e.widths[0] : e.heights[0]);
+            int level = e.coarseLevel;
+            if (e.pixelsThisFrame > 0.0f) {
+                level = (int)floorf(log2f(texels / e.pixelsThisFrame));
+                level = level < 0 ? 0 : (level > e.coarseLevel ? e.coarseLevel : level);
+            }
+            e.wantedLevel = level;
+        }
+        if (e.residentLevel > e.wantedLevel && frame - e.lastUsedFrame < StaleFrames) {
+            needy.push_back(&e);
+        }
+    }
+
+    // Upload one level at a time to the neediest texture, making room only from levels not needed.
+    size_t uploaded = 0;
+    while (!needy.empty()) {
+        int best = 0;
+        for (int i = 1; i < (int)needy.size(); i++) {
+            if (needy[i]->residentLevel - needy[i]->wantedLevel > needy[best]->residentLevel - needy[best]->wantedLevel) {
+                best = i;
+            }
+        }
+        Entry& e = *needy[best];
+        int level = e.residentLevel - 1;
+        size_t bytes = LevelBytes(e, level);
+        if (uploaded > 0 && uploaded + bytes > (size_t)UploadBytesPerFrame) {
+            break;
+        }
+        if (EvictFor(bytes, &e, true)) {
+            UploadLevel(e, level);
+            uploaded += bytes;
+        }
+        if (e.residentLevel <= e.wantedLevel || residentBytes + LevelBytes(e, e.residentLevel - 1) > budget) {
+            needy.erase(needy.begin() + best);
+        }
+    }
+
+    // If the budget was lowered, even wanted levels must go.
+    if (residentBytes > budget) {
+        EvictFor(0, 0, false);
+    }
+    frame++;
+}
+
+void TextureStreamer::PrintStats()
+{
+    printf("Texture streaming: %.1f MB resident, budget %.1f MB.\n",
+        (double)residentBytes / (1 << 20), (double)budget / (1 << 20));
+    for (const Entry& e : entries) {
+        if (e.decoded && e.failed) {        // failed is written by the worker before decoded
+            printf("  %-28s  (failed to load)\n", e.filename.c_str());
+        }
+        else if (e.residentLevel < 0) {
+            printf("  %-28s  (loading)\n", e.filename.c_str());
+        }
+        else {
+            printf("  %-28s %5dx%-5d resident %5dx%-5d wanted %5dx%-5d %4d uploads %4d evictions\n",
+                e.filename.c_str(), e.widths[0], e.heights[0],
+                e.widths[e.residentLevel], e.heights[e.residentLevel],
+                e.widths[e.wantedLevel], e.heights[e.wantedLevel], e.numUploads, e.numEvictions);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+//
+// TextureStreamer.h
+//
+// Streams the mip levels of textures according to how large they appear on screen,
+//    within a budget of texture memory.
+//
+//   A registered texture is decoded (from a BMP file, or from an RgbImage)
+//   and its mip chain is built on a background thread. Until then it is a
+//   single gray texel. Once decoded, its coarse levels, up to MinResidentSize,
+//   are uploaded at once and stay resident. Finer levels are uploaded only
+//   when an object using the texture is close enough to need them, at most
+//   UploadBytesPerFrame each frame, finest level last.
+//
+//   The resident levels of a texture are always a complete mip chain from
+//   its base level (GL_TEXTURE_BASE_LEVEL) down to 1x1: finer levels are
+//   evicted by lowering the resolution, never by leaving holes.
+//
+//   When the resident levels exceed the budget, levels are evicted: first
+//   from textures not used for a while, then levels finer than needed, and
+//   only then levels that are still wanted, least recently used first.
+//
+//   The decoded mip chains stay in main memory, so evicted levels can be
+//   uploaded again without reading the files. OpenGL is only called from
+//   the main thread.
+//
+// How to use:
+//    * Call Start() once, with an OpenGL context current.
+//    * Register() each texture. It returns the OpenGL texture name, usable at once.
+//    * Each frame, call NoteUse() for the textures used, with the size on
+//          screen, in pixels, of the texture's full extent. Then call Update().
+//    * Call Shutdown() before exiting, to stop the background thread.
+//
+
+#pragma once
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class RgbImage;
+
+class TextureStreamer {
+public:
+    static const int MinResidentSize = 32;              // Levels no larger than this are always resident
+    static const int UploadBytesPerFrame = 4 << 20;     // But at least one level is uploaded each frame
+    static const int StaleFrames = 120;                 // Textures unused this long are evicted first
+
+    static void Start();
+    static void Shutdown();
+
+    // wrapMode is GL_REPEAT, GL_CLAMP_TO_EDGE, etc.
+    static unsigned int Register(const char* filename, int wrapMode);
+    static unsigned int Register(const RgbImage& image, const char* label, int wrapMode);  // Copies the image
+
+    static void SetBudget(size_t bytes);
+    static size_t GetBudget() { return budget; }
+    static size_t GetResidentBytes() { return residentBytes; }
+
+    // The texture's full width (or height, whichever is larger) covers pixelsOnScreen pixels.
+    //    If it is used several times in a frame, the largest size counts.
+    static void NoteUse(unsigned int texture, float pixelsOnScreen);
+    static void Update();
+
+    static void PrintStats();
+
+private:
+    struct Entry {
+        std::string filename;           // Or the label of an image registered directly
+        bool fromFile;
+        unsigned int name;              // OpenGL texture name
+        int numChannels;                // 3 (RGB) or 4 (RGBA)
+        std::vector<int> widths, heights;
+        std::vector<std::vector<unsigned char>> levels;     // Tightly packed rows, level 0 finest
+        std::atomic<bool> decoded;      // Set by the background thread once levels is filled
+        bool failed;
+        int coarseLevel;                // Finest of the levels that are always resident
+        int residentLevel;              // Finest resident level; -1 until the coarse levels are uploaded
+        int wantedLevel;
+        float pixelsThisFrame;
+        int lastUsedFrame;
+        int numUploads, numEvictions;
+        Entry() : decoded(false) {}
+    };
+
+    static Entry& AddEntry(int wrapMode);
+    static void WorkerMain();
+    static void Decode(Entry& e);
+    static size_t LevelBytes(const Entry& e, int level);
+    static void UploadLevel(Entry& e, int level);
+    static void EvictLevel(Entry& e);
+    static bool EvictFor(size_t bytesNeeded, const Entry* requester, bool onlyUnneeded);
+
+    static std::deque<Entry> entries;                  // A deque, so entries do not move
+    static std::unordered_map<unsigned int, int> entryOfName;
+    static size_t budget;
+    static size_t residentBytes;
+    static int frame;
+
+    static std::thread worker;
+    static std::mutex queueMutex;
+    static std::condition_variable queueReady;
+    static std::deque<Entry*> queue;                    // Entries to decode
+    static bool stopping;
+};
+
+#endif  // TEXTURE_STREAMER_H
@@ -0,0 +1,319 @@
+//
+// TreeGenerator.cpp
+//
+// Procedural trees from a stochastic L-system. See TreeGenerator.h.
+//
+
+#include "TreeGenerator.h"
+#include "LinearR3.h"
+#include "MathMisc.h"
+#include "RgbImage.h"
+
+#include <math.h>
+#include <vector>
+
+namespace {
+
+// A small, self-contained random number generator (xorshift32), so that
+//   a seed gives the same tree regardless of the C++ library in use.
+class TreeRandom {
+public:
+    TreeRandom(uint32_t seed, uint32_t stream) {
+        state = (seed * 2654435761u) ^ (stream * 0x9E3779B9u);
+        if (state == 0) {
+            state = 0x6A09E667u;
+        }
+        Next();
+    }
+    uint32_t Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    double Uniform(double lo, double hi) {
+        return lo + (hi - lo) * (double)(Next() >> 8) * (1.0 / 16777216.0);
+    }
+private:
+    uint32_t state;
+};
+
+// The rewriting rules for the apex symbol A. One is chosen at random for each rewrite.
+const char* const ApexRules[] = {
+    "![&FA]/////[&FA]///////[&FA]",
+    "![&FA]////////[&FA]",
+    "!FL[&FA]////[&FA]/////[&FA]",
+    "![&FA]///[&FL]////[&FA]",
+};
+const int NumApexRules = sizeof(ApexRules) / sizeof(ApexRules[0]);
+
+// Parameters for interpreting the string, drawn per tree.
+struct TreeShape {
+    double trunkLength;         // Length of each trunk segment
+    double trunkWidth;          // Radius at the base of the trunk
+    double branchAngle;         // Pitch angle for & and ^ (radians)
+    double turnAngle;           // Yaw angle for + and -
+    double rollAngle;           // Roll angle for / and \ (radians)
+    double shrinkLength;        // Scale of segment lengths at each !
+    double shrinkWidth;         // Scale of segment widths at each !
+    double taper;               // Scale of the width along each segment
+    double leafSize;            // Radius of the leaf clusters on the trunk
+    double jitter;              // Random turning at each segment (radians)
+};
+
+struct Turtle {
+    VectorR3 pos;
+    VectorR3 H, L, U;           // Heading, left and up: an orthonormal frame with H*L == U
+    double length;
+    double width;
+    double barkT;               // Texture coordinate along the bark
+};
+
+// Appends a tapered tube from the turtle's position along its heading.
+void AddSegment(const Turtle& t, double length, double endWidth, TreeMesh* mesh)
+{
+    const int n = TreeGenerator::BarkSlices;
+    unsigned int base = (unsigned int)(mesh->barkVerts.size() / 8);
+    for (int end = 0; end < 2; end++) {
+        VectorR3 center = t.pos;
+        center.AddScaled(t.H, end * length);
+        double radius = end == 0 ? t.width : endWidth;
+        for (int j = 0; j <= n; j++) {
+            double theta = PI2 * (double)j / (double)n;
+            VectorR3 dir = t.L * cos(theta) + t.U * sin(theta);
+            VectorR3 p = center;
+            p.AddScaled(dir, radius);
+            float v[8] = { (float)p.x, (float)p.y, (float)p.z,
+                (float)dir.x, (float)dir.y, (float)dir.z,
+                (float)j / (float)n, (float)(t.barkT + end * length * 0.5) };
+            mesh->barkVerts.insert(mesh->barkVerts.end(), v, v + 8);
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        unsigned int b0 = base + j;
+        unsigned int t0 = base + (n + 1) + j;
+        unsigned int elts[6] = { b0, b0 + 1, t0 + 1, b0, t0 + 1, t0 };
+        mesh->barkElts.insert(mesh->barkElts.end(), elts, elts + 6);
+    }
+}
+
+// The shape of a leaf cluster: the outline of a double cone, as seen from the side.
+//    The cards span from depth below the ring to height above it.
+const double ClusterHeight = 1.6;       // Times the size of the cluster
+const double ClusterDepth = 0.5;
+const double RingV = ClusterDepth / (ClusterHeight + ClusterDepth);    // Texture v coordinate of the ring
+
+// The leaf card texture is opaque inside the outline shrunk horizontally by
+//    CoreFraction, and leafy (partly transparent) out to the full outline.
+const double CoreFraction = 0.8;
+
+// Half width of the outline at texture coordinate v, as a fraction of the card's half width.
+double OutlineHalfWidth(double v)
+{
+    return v < RingV ? v / RingV : (1.0 - v) / (1.0 - RingV);
+}
+
+// Appends a leaf cluster: LeafCards vertical cards crossing at pos, turned by yaw.
+//    Each card is a quad, with the corners in the order bottom left, bottom right,
+//    top right, top left. The normals point away from the middle of the cluster,
+//    so the cluster is lit like a round mass of leaves.
+void AddLeafCluster(const VectorR3& pos, double size, double yaw, TreeMesh* mesh)
+{
+    const double height = ClusterHeight * size;
+    const double depth = ClusterDepth * size;
+    VectorR3 middle(pos.x, pos.y + 0.5 * (height - depth), pos.z);
+    for (int card = 0; card < TreeGenerator::LeafCards; card++) {
+        unsigned int base = (unsigned int)(mesh->leafVerts.size() / 8);
+        double theta = yaw + PI * (double)card / (double)TreeGenerator::LeafCards;
+        VectorR3 across(cos(theta), 0.0, sin(theta));
+        for (int corner = 0; corner < 4; corner++) {
+            double u = (corner == 1 || corner == 2) ? 1.0 : 0.0;
+            double v = (corner >= 2) ? 1.0 : 0.0;
+            VectorR3 p = pos;
+            p.AddScaled(across, (2.0 * u - 1.0) * size);
+            p.y += (v == 0.0) ? -depth : height;
+            VectorR3 normal = p - middle;
+            normal.Normalize();
+            float vert[8] = { (float)p.x, (float)p.y, (float)p.z,
+                (float)normal.x, (float)normal.y, (float)normal.z, (float)u, (float)v };
+            mesh->leafVerts.insert(mesh->leafVerts.end(), vert, vert + 8);
+        }
+        unsigned int elts[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+        mesh->leafElts.insert(mesh->leafElts.end(), elts, elts + 6);
+    }
+}
+
+// A smooth random value in [0,1] on a grid of cells (value noise), for the leafy fringe.
+double FringeNoise(double u, double v, int cells)
+{
+    double x = u * cells;
+    double y = v * cells;
+    int i = (int)floor(x);
+    int j = (int)floor(y);
+    double fx = x - i;
+    double fy = y - j;
+    double corner[4];
+    for (int k = 0; k < 4; k++) {
+        uint32_t h = (uint32_t)(i + (k & 1)) * 73856093u ^ (uint32_t)(j + (k >> 1)) * 19349663u;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        corner[k] = (double)(h & 0xffff) / 65535.0;
+    }
+    fx = fx * fx * (3.0 - 2.0 * fx);
+    fy = fy * fy * (3.0 - 2.0 * fy);
+    double bottom = corner[0] + fx * (corner[1] - corner[0]);
+    double top = corner[2] + fx * (corner[3] - corner[2]);
+    return bottom + fy * (top - bottom);
+}
+
+}   // namespace
+
+std::string TreeGenerator::Expand(uint32_t seed)
+{
+    TreeRandom rng(seed, 1);
+    std::string str = "FFA";
+    for (int iter = 0; iter < NumIterations; iter++) {
+        std::string next;
+        next.reserve(str.size() * 4);
+        for (char c : str) {
+            if (c == 'A') {
+                next += ApexRules[rng.Next() % NumApexRules];
+            }
+            else {
+                next += c;
+            }
+        }
+        str.swap(next);
+    }
+    return str;
+}
+
+void TreeGenerator::Generate(uint32_t seed, TreeMesh* mesh)
+{
+    mesh->barkVerts.clear();
+    mesh->barkElts.clear();
+    mesh->leafVerts.clear();
+    mesh->leafElts.clear();
+
+    TreeRandom rng(seed, 2);
+    TreeShape shape;
+    shape.trunkLength = rng.Uniform(2.0, 3.0);
+    shape.trunkWidth = rng.Uniform(0.35, 0.55);
+    shape.branchAngle = rng.Uniform(22.0, 40.0) * PI / 180.0;
+    shape.turnAngle = rng.Uniform(15.0, 30.0) * PI / 180.0;
+    shape.rollAngle = rng.Uniform(125.0, 150.0) / 5.0 * PI / 180.0;
+    shape.shrinkLength = rng.Uniform(0.7, 0.85);
+    shape.shrinkWidth = rng.Uniform(0.55, 0.7);
+    shape.taper = rng.Uniform(0.8, 0.92);
+    shape.leafSize = rng.Uniform(1.2, 1.8);
+    shape.jitter = rng.Uniform(0.05, 0.15);
+
+    Turtle t;
+    t.pos.Set(0.0, 0.0, 0.0);
+    t.H.Set(0.0, 1.0, 0.0);
+    t.L.Set(0.0, 0.0, 1.0);
+    t.U.Set(1.0, 0.0, 0.0);
+    t.length = shape.trunkLength;
+    t.width = shape.trunkWidth;
+    t.barkT = 0.0;
+    double startWidth = t.width;
+
+    std::vector<Turtle> stack;
+    std::string str = Expand(seed);
+    for (char c : str) {
+        switch (c) {
+        case 'F': {
+            double endWidth = t.width * shape.taper;
+            AddSegment(t, t.length, endWidth, mesh);
+            t.pos.AddScaled(t.H, t.length);
+            t.barkT += t.length * 0.5;
+            t.width = endWidth;
+            // A little random bending, so no two branches are alike
+            double bend = rng.Uniform(-shape.jitter, shape.jitter);
+            t.H.Rotate(bend, t.U);
+            t.L.Rotate(bend, t.U);
+            break;
+        }
+        case 'L':
+        case 'A':
+            // Clusters shrink with the branch width, but not as fast
+            AddLeafCluster(t.pos, shape.leafSize * sqrt(t.width / startWidth), rng.Uniform(0.0, PI), mesh);
+            break;
+        case '+': case '-': {
+            double theta = (c == '+' ? 1.0 : -1.0) * shape.turnAngle;
+            t.H.Rotate(theta, t.U);
+            t.L.Rotate(theta, t.U);
+            break;
+        }
+        case '&': case '^': {
+            double theta = (c == '&' ? 1.0 : -1.0) * shape.branchAngle * rng.Uniform(0.8, 1.2);
+            t.H.Rotate(theta, t.L);
+            t.U.Rotate(theta, t.L);
+            break;
+        }
+        case '/': case '\\': {
+            double theta = (c == '/' ? 1.0 : -1.0) * shape.rollAngle;
+            t.L.Rotate(theta, t.H);
+            t.U.Rotate(theta, t.H);
+            break;
+        }
+        case '!':
+            t.length *= shape.shrinkLength;
+            t.width *= shape.shrinkWidth;
+            break;
+        case '[':
+            stack.push_back(t);
+            break;
+        case ']':
+            t = stack.back();
+            stack.pop_back();
+            break;
+        }
+    }
+}
+
+// The cards of a cluster are at most 30 degrees from facing any horizontal
+//    view direction, so their opaque cores, seen from the side, cover the
+//    core outline narrowed by cos(30 degrees). That is the cross section of
+//    the double cone returned.
+void TreeGenerator::GetLeafCore(const float* clusterVerts, float* x, float* z, float* radius,
+    float* yBottom, float* yRing, float* yTop)
+{
+    const float* bottomLeft = clusterVerts;
+    const float* bottomRight = clusterVerts + 8;
+    const float* topRight = clusterVerts + 16;
+    float dx = bottomRight[0] - bottomLeft[0];
+    float dz = bottomRight[2] - bottomLeft[2];
+    *x = 0.5f * (bottomLeft[0] + bottomRight[0]);
+    *z = 0.5f * (bottomLeft[2] + bottomRight[2]);
+    *radius = (float)(CoreFraction * cos(PI / 6.0)) * 0.5f * sqrtf(dx * dx + dz * dz);
+    *yBottom = bottomLeft[1];
+    *yTop = topRight[1];
+    *yRing = *yBottom + (float)RingV * (*yTop - *yBottom);
+}
+
+bool TreeGenerator::MakeLeafCardImage(const RgbImage& leaves, RgbImage* card)
+{
+    const int size = 256;
+    if (!leaves.ImageLoaded() || !card->AllocateImageData(size, size, 4)) {
+        return false;
+    }
+    for (int row = 0; row < size; row++) {
+        double v = ((double)row + 0.5) / (double)size;
+        double halfWidth = OutlineHalfWidth(v);
+        for (int col = 0; col < size; col++) {
+            double u = ((double)col + 0.5) / (double)size;
+            double d = fabs(2.0 * u - 1.0);     // 0 in the middle, 1 at the sides
+            // Solid inside the core, ragged leaves out to the outline
+            double reach = halfWidth * (CoreFraction + (1.0 - CoreFraction) * 1.2 * FringeNoise(u, v, 24));
+            bool opaque = d <= CoreFraction * halfWidth || d <= fmin(reach, 0.98);
+            const unsigned char* c = leaves.GetRgbPixel(row % leaves.GetNumRows(), col % leaves.GetNumCols());
+            double shade = 0.7 + 0.3 * v;   // Darker low down, inside the tree
+            card->SetRgbPixelc(row, col, (unsigned char)(shade * c[0]), (unsigned char)(shade * c[1]),
+                (unsigned char)(shade * c[2]));
+            card->SetAlpha(row, col, opaque ? 255 : 0);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+//
+// TreeGenerator.h
+//
+// Procedural trees from a stochastic L-system.
+//
+//   Each seed gives a different tree: the rewriting rules, branching angles,
+//   trunk height, taper and leaf size are all drawn from a random number
+//   generator seeded by the seed. The same seed always gives the same tree,
+//   so trees can be cached on disk by seed.
+//
+//   Generate() is pure CPU code with no OpenGL calls, and may be called
+//   from worker threads. TreeVariantPool builds many trees this way and
+//   loads them into one shared VBO and EBO.
+//
+//   Leaf clusters are crossed vertical cards, to be drawn alpha tested with
+//   an RGBA texture as made by MakeLeafCardImage(). The texture's opaque
+//   core is laid out so that every cluster hides a solid double cone,
+//   given by GetLeafCore(), which makes the clusters usable as occluders.
+//
+// L-system alphabet (turtle interpretation, with H the heading):
+//    F     Draw a branch segment and move forward
+//    L     Draw a leaf cluster
+//    A     Apex: rewritten each iteration; any left at the end become leaf clusters
+//    + -   Turn left/right (yaw)
+//    & ^   Pitch down/up
+//    / \   Roll right/left
+//    !     Make later segments thinner and shorter
+//    [ ]   Push/pop the turtle state (start/end a branch)
+//
+
+#pragma once
+#ifndef TREE_GENERATOR_H
+#define TREE_GENERATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The mesh of one tree, in two parts since bark and leaves use different textures.
+//    Vertices have 8 floats: position, normal, texture coordinates, as for the
+//    GlGeomShape classes. Elements are for GL_TRIANGLES, and are relative to
+//    the first vertex of their part. The base of the trunk is at the origin.
+class RgbImage;
+
+struct TreeMesh {
+    std::vector<float> barkVerts;
+    std::vector<unsigned int> barkElts;
+    std::vector<float> leafVerts;
+    std::vector<unsigned int> leafElts;
+};
+
+class TreeGenerator {
+public:
+    // Bump whenever the generated meshes change, so cached trees are rebuilt.
+    static const uint32_t GeneratorVersion = 2;
+
+    static const int NumIterations = 3;     // L-system rewriting steps
+    static const int BarkSlices = 6;        // Sides of each branch segment
+    static const int LeafCards = 3;         // Crossed cards in each leaf cluster, 60 degrees apart
+    static const int LeafClusterVerts = 4 * LeafCards;
+
+    // Build the tree for a seed.
+    static void Generate(uint32_t seed, TreeMesh* mesh);
+
+    // The opaque core of a leaf cluster, given its LeafClusterVerts vertices (8 floats each):
+    //    a solid double cone with axis (x,z), widest at yRing.
+    static void GetLeafCore(const float* clusterVerts, float* x, float* z, float* radius,
+        float* yBottom, float* yRing, float* yTop);
+
+    // Makes the RGBA texture for the leaf cards, taking the colors from "leaves".
+    static bool MakeLeafCardImage(const RgbImage& leaves, RgbImage* card);
+
+    // The L-system string for a seed (after rewriting). Exposed for debugging.
+    static std::string Expand(uint32_t seed);
+};
+
+#endif  // TREE_GENERATOR_H
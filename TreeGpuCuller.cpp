@@ -0,0 +1,276 @@
+//
+// TreeGpuCuller.cpp
+//
+// GPU-driven culling of the tree variants. See TreeGpuCuller.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TreeGpuCuller.h"
+#include "TreeVariantPool.h"
+#include "HiZCuller.h"
+#include "GlShaderMgr.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+// The texture unit used for the Hi-Z pyramid; unit 0 is left for the texture maps.
+static const int HiZTextureUnit = 1;
+
+unsigned int TreeGpuCuller::cullProgram = 0;
+int TreeGpuCuller::viewProjLoc = -1;
+int TreeGpuCuller::numVariantsLoc = -1;
+int TreeGpuCuller::barkLodDistanceLoc = -1;
+int TreeGpuCuller::useHiZLoc = -1;
+int TreeGpuCuller::hiZLoc = -1;
+unsigned int TreeGpuCuller::theVAO = 0;
+unsigned int TreeGpuCuller::instanceBuffer = 0;
+unsigned int TreeGpuCuller::chunkBuffer = 0;
+unsigned int TreeGpuCuller::boundsBuffer = 0;
+unsigned int TreeGpuCuller::commandTemplate = 0;
+unsigned int TreeGpuCuller::commandBuffer = 0;
+unsigned int TreeGpuCuller::visibleBuffer = 0;
+unsigned int TreeGpuCuller::hiZTexture = 0;
+int TreeGpuCuller::numTrees = 0;
+int TreeGpuCuller::numChunks = 0;
+
+bool TreeGpuCuller::IsSupported()
+{
+    return GLEW_VERSION_4_3 != 0;
+}
+
+bool TreeGpuCuller::Setup(const std::vector<TreeInstance>& trees, float sway, unsigned int instance_loc,
+    unsigned int bakedLight_loc)
+{
+    assert(IsSupported() && TreeVariantPool::IsReady() && !IsSetUp());
+    const int numVariants = TreeVariantPool::NumVariants;
+
+    unsigned int computeShader = GlShaderMgr::CompileShader("computeShader_TreeCull");
+    if (computeShader == 0) {
+        return false;
+    }
+    unsigned int program = GlShaderMgr::LinkShaderProgram(1, &computeShader);
+    if (program == 0) {
+        return false;
+    }
+
+    // Group the trees into chunks, by rows along z.
+    std::vector<std::pair<int, int>> order;        // Chunk number and index of each tree
+    order.reserve(trees.size());
+    for (int i = 0; i < (int)trees.size(); i++) {
+        order.push_back(std::make_pair((int)floorf(trees[i].z / (float)ChunkDepth), i));
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<TreeInstance> sorted;
+    std::vector<Chunk> chunks;
+    sorted.reserve(trees.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        if (k == 0 || order[k].first != order[k - 1].first) {
+            Chunk c;
+            for (int j = 0; j < 3; j++) {
+                c.boxMin[j] = FLT_MAX;
+                c.boxMax[j] = -FLT_MAX;
+            }
+            c.boxMin[3] = c.boxMax[3] = 0.0f;
+            c.firstInstance = (unsigned int)k;
+            c.numInstances = 0;
+            c.pad[0] = c.pad[1] = 0;
+            chunks.push_back(c);
+        }
+        const TreeInstance& t = trees[order[k].second];
+        Chunk& c = chunks.back();
+        const float* treeMin = TreeVariantPool::GetBoundsMin((int)t.variant);
+        const float* treeMax = TreeVariantPool::GetBoundsMax((int)t.variant);
+        c.boxMin[0] = fminf(c.boxMin[0], t.x + treeMin[0] - sway);
+        c.boxMin[1] = fminf(c.boxMin[1], treeMin[1]);
+        c.boxMin[2] = fminf(c.boxMin[2], t.z + treeMin[2] - sway);
+        c.boxMax[0] = fmaxf(c.boxMax[0], t.x + treeMax[0] + sway);
+        c.boxMax[1] = fmaxf(c.boxMax[1], treeMax[1]);
+        c.boxMax[2] = fmaxf(c.boxMax[2], t.z + treeMax[2] + sway);
+        c.numInstances++;
+        sorted.push_back(t);
+    }
+
+    // Each variant's visible instances get a range of the visible buffer, as big as its number
+    //    of trees: first the ranges for the bark, then those for the leaves.
+    std::vector<unsigned int> numPerVariant(numVariants, 0);
+    for (const TreeInstance& t : trees) {
+        numPerVariant[(int)t.variant]++;
+    }
+    std::vector<DrawCommand> commands(2 * numVariants);
+    std::vector<float> variantBounds(8 * numVariants);
+    unsigned int base = 0;
+    for (int v = 0; v < numVariants; v++) {
+        for (int part = 0; part < 2; part++) {
+            const TreeVariantPool::Range& r = (part == 0) ? TreeVariantPool::GetBarkRange(v) : TreeVariantPool::GetLeafRange(v);
+            DrawCommand& cmd = commands[part * numVariants + v];
+            cmd.count = r.numElements;
+            cmd.instanceCount = 0;
+            cmd.firstIndex = r.firstElement;
+            cmd.baseVertex = (int)r.baseVertex;
+            cmd.baseInstance = base + part * (unsigned int)trees.size();
+        }
+        base += numPerVariant[v];
+        const float* treeMin = TreeVariantPool::GetBoundsMin(v);
+        const float* treeMax = TreeVariantPool::GetBoundsMax(v);
+        float* b = &variantBounds[8 * v];
+        b[0] = treeMin[0] - sway;
+        b[1] = treeMin[1];
+        b[2] = treeMin[2] - sway;
+        b[3] = 0.0f;
+        b[4] = treeMax[0] + sway;
+        b[5] = treeMax[1];
+        b[6] = treeMax[2] + sway;
+        b[7] = 0.0f;
+    }
+
+    unsigned int buffers[6];
+    glGenBuffers(6, buffers);
+    instanceBuffer = buffers[0];
+    chunkBuffer = buffers[1];
+    boundsBuffer = buffers[2];
+    commandTemplate = buffers[3];
+    commandBuffer = buffers[4];
+    visibleBuffer = buffers[5];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sorted.size() * sizeof(TreeInstance), sorted.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunkBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, chunks.size() * sizeof(Chunk), chunks.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, variantBounds.size() * sizeof(float), variantBounds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandTemplate);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * trees.size() * sizeof(TreeInstance), 0, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // The VAO reads the pool's vertices and baked lighting, and one visible instance per tree.
+    glGenVertexArrays(1, &theVAO);
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, TreeVariantPool::GetVBO());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, TreeVariantPool::GetBakedVBO());
+    glVertexAttribPointer(bakedLight_loc, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(bakedLight_loc);
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glVertexAttribPointer(instance_loc, 4, GL_FLOAT, GL_FALSE, sizeof(TreeInstance), (void*)0);
+    glVertexAttribDivisor(instance_loc, 1);
+    glEnableVertexAttribArray(instance_loc);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TreeVariantPool::GetEBO());
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // A copy of the Hi-Z pyramid: one mipmap level per pyramid level.
+    glGenTextures(1, &hiZTexture);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    glTexStorage2D(GL_TEXTURE_2D, HiZCuller::NumLevels, GL_R32F, HiZCuller::Width, HiZCuller::Height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    cullProgram = program;
+    viewProjLoc = glGetUniformLocation(program, "viewProj");
+    numVariantsLoc = glGetUniformLocation(program, "numVariants");
+    barkLodDistanceLoc = glGetUniformLocation(program, "barkLodDistance");
+    useHiZLoc = glGetUniformLocation(program, "useHiZ");
+    hiZLoc = glGetUniformLocation(program, "hiZ");
+    numTrees = (int)trees.size();
+    numChunks = (int)chunks.size();
+    return true;
+}
+
+void TreeGpuCuller::Cull(const float* viewProj, const HiZCuller* hiZ)
+{
+    assert(IsSetUp());
+
+    // Start from instance counts of zero.
+    glBindBuffer(GL_COPY_READ_BUFFER, commandTemplate);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 2 * TreeVariantPool::NumVariants * sizeof(DrawCommand));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + HiZTextureUnit);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    if (hiZ != 0) {
+        for (int k = 0; k < HiZCuller::NumLevels; k++) {
+            glTexSubImage2D(GL_TEXTURE_2D, k, 0, 0, HiZCuller::Width >> k, HiZCuller::Height >> k,
+                GL_RED, GL_FLOAT, hiZ->GetLevel(k));
+        }
+    }
+
+    glUseProgram(cullProgram);
+    glUniformMatrix4fv(viewProjLoc, 1, false, viewProj);
+    glUniform1ui(numVariantsLoc, TreeVariantPool::NumVariants);
+    glUniform1f(barkLodDistanceLoc, (float)BarkLodDistance);
+    glUniform1i(useHiZLoc, hiZ != 0);
+    glUniform1i(hiZLoc, HiZTextureUnit);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, chunkBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, visibleBuffer);
+    glDispatchCompute(numChunks, 1, 1);
+
+    // The draws read the commands and the visible instances written above.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void TreeGpuCuller::RenderBark(unsigned int barkTexture)
+{
+    assert(IsSetUp());
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindTexture(GL_TEXTURE_2D, barkTexture);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, TreeVariantPool::NumVariants, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void TreeGpuCuller::RenderLeaves(unsigned int leafTexture)
+{
+    assert(IsSetUp());
+    const int numVariants = TreeVariantPool::NumVariants;
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindTexture(GL_TEXTURE_2D, leafTexture);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(numVariants * sizeof(DrawCommand)), numVariants, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void TreeGpuCuller::PrintStats()
+{
+    if (!IsSetUp()) {
+        printf("GPU culling is not set up.\n");
+        return;
+    }
+    const int numVariants = TreeVariantPool::NumVariants;
+    std::vector<DrawCommand> commands(2 * numVariants);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    int numWithBark = 0;
+    int numDrawn = 0;
+    for (int v = 0; v < numVariants; v++) {
+        numWithBark += commands[v].instanceCount;
+        numDrawn += commands[numVariants + v].instanceCount;
+    }
+    printf("GPU culling: %d of %d trees culled, %d drawn with bark (%d chunks).\n",
+        numTrees - numDrawn, numTrees, numWithBark, numChunks);
+}
@@ -0,0 +1,99 @@
+//
+// TreeGpuCuller.h
+//
+// GPU-driven culling of the tree variants (see TreeVariantPool.h), for OpenGL 4.3 and later.
+//
+//   The tree instances are uploaded once, grouped into chunks along z. Each
+//   frame a compute shader (computeShader_TreeCull in MyShaders.glsl) tests
+//   every chunk, then every tree of the visible chunks, against the view
+//   frustum and optionally a Hi-Z pyramid (see HiZCuller.h). Visible trees
+//   are appended to a per-variant list of instances, and the instance counts
+//   of the indirect draw commands are incremented. The trees are then drawn
+//   with one glMultiDrawElementsIndirect() for the bark and one for the leaves.
+//   The CPU never touches individual trees, nor waits for the GPU.
+//
+//   Distance LOD: trees farther than BarkLodDistance are drawn without bark.
+//
+//   On older OpenGL versions IsSupported() returns false: cull on the CPU instead.
+//
+// How to use:
+//    * Once the tree variant pool is ready, call Setup() with all the trees.
+//    * Each frame, call Cull(), then select shaderProgramWindInstanced and call RenderBark(),
+//          then select shaderProgramFoliageInstanced and call RenderLeaves(). Once the pool
+//          IsBaked(), their Baked versions may be used instead.
+//
+
+#pragma once
+#ifndef TREE_GPU_CULLER_H
+#define TREE_GPU_CULLER_H
+
+#include <vector>
+
+class HiZCuller;
+
+// A tree, as stored in the instance buffers: four floats.
+struct TreeInstance {
+    float x, z;                 // Base of the trunk, relative to the player's offset
+    float windPhase;            // See vertexShader_Wind
+    float variant;              // Index into the tree variant pool
+};
+
+class TreeGpuCuller {
+public:
+    static const int ChunkDepth = 20;           // Extent of a chunk along z
+    static const int BarkLodDistance = 35;      // Distance (clip w) beyond which bark is not drawn
+
+    static bool IsSupported();                  // Call after glewInit()
+
+    // Uploads the trees. "sway" is added to the bounding boxes, to allow for the wind.
+    //    instance_loc is the vertex attribute location of treeInstance in vertexShader_WindInstanced,
+    //    and bakedLight_loc that of the pool's baked lighting in vertexShader_WindInstancedBaked.
+    static bool Setup(const std::vector<TreeInstance>& trees, float sway, unsigned int instance_loc,
+        unsigned int bakedLight_loc);
+    static bool IsSetUp() { return cullProgram != 0; }
+
+    // viewProj is the projection times modelview matrix, by columns, for the trees' coordinates.
+    // hiZ is null, or a HiZCuller with its pyramid built for the same matrix.
+    // Changes the current shader program.
+    static void Cull(const float* viewProj, const HiZCuller* hiZ);
+
+    // The modelview matrix must be the view matrix with the player's offset.
+    //    The leaves are alpha-tested cards, so they are drawn separately, after the opaque geometry.
+    static void RenderBark(unsigned int barkTexture);
+    static void RenderLeaves(unsigned int leafTexture);
+
+    // Reads back and prints the counts from the last Cull(). This waits for the GPU.
+    static void PrintStats();
+
+private:
+    // The layout of a chunk in its shader storage buffer (std430).
+    struct Chunk {
+        float boxMin[4];
+        float boxMax[4];
+        unsigned int firstInstance;
+        unsigned int numInstances;
+        unsigned int pad[2];
+    };
+
+    // As read by glMultiDrawElementsIndirect().
+    struct DrawCommand {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    static unsigned int cullProgram;
+    static int viewProjLoc, numVariantsLoc, barkLodDistanceLoc, useHiZLoc, hiZLoc;
+    static unsigned int theVAO;
+    static unsigned int instanceBuffer, chunkBuffer, boundsBuffer;
+    static unsigned int commandTemplate;        // The commands with instance counts of zero
+    static unsigned int commandBuffer;
+    static unsigned int visibleBuffer;          // The visible instances, written by the compute shader
+    static unsigned int hiZTexture;
+    static int numTrees;
+    static int numChunks;
+};
+
+#endif  // TREE_GPU_CULLER_H
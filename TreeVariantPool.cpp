@@ -0,0 +1,325 @@
+//
+// TreeVariantPool.cpp
+//
+// A shared geometry pool holding many procedural tree variants. See TreeVariantPool.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "TreeVariantPool.h"
+#include "GlGeomMeshCache.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+unsigned int TreeVariantPool::posLoc = 0;
+unsigned int TreeVariantPool::normalLoc = 0;
+unsigned int TreeVariantPool::texcoordsLoc = 0;
+unsigned int TreeVariantPool::bakedLightLoc = 0;
+unsigned int TreeVariantPool::theVAO = 0;
+unsigned int TreeVariantPool::theVBO = 0;
+unsigned int TreeVariantPool::theEBO = 0;
+unsigned int TreeVariantPool::theBakedVBO = 0;
+bool TreeVariantPool::isReady = false;
+bool TreeVariantPool::isBaked = false;
+std::vector<TreeMesh> TreeVariantPool::meshes;
+std::vector<TreeVariantPool::Range> TreeVariantPool::barkRanges;
+std::vector<TreeVariantPool::Range> TreeVariantPool::leafRanges;
+std::vector<TreeVariantPool::Bounds> TreeVariantPool::bounds;
+std::vector<std::vector<TreeOccluder>> TreeVariantPool::occluders;
+ObstacleGrid TreeVariantPool::proxyTree;
+LightBaker TreeVariantPool::baker;
+std::vector<float> TreeVariantPool::bakedLight;
+std::vector<int> TreeVariantPool::jobs;
+std::vector<std::thread> TreeVariantPool::workers;
+std::atomic<int> TreeVariantPool::nextJob(0);
+std::atomic<int> TreeVariantPool::numJobsDone(0);
+
+// The cache key for the bark or leaves of a tree.
+static GlGeomMeshKey TreeMeshKey(uint32_t seed, bool leaves)
+{
+    GlGeomMeshKey key;
+    memset(&key, 0, sizeof(key));
+    key.shapeId = leaves ? GlGeomMeshShape_TreeLeaves : GlGeomMeshShape_TreeBark;
+    key.generatorVersion = TreeGenerator::GeneratorVersion;
+    key.params[0] = (int32_t)seed;
+    key.params[1] = TreeGenerator::NumIterations;
+    key.layout[0] = 0;          // Positions, normals, texture coordinates: tightly packed
+    key.layout[1] = 3;
+    key.layout[2] = 6;
+    key.layout[3] = 8;
+    return key;
+}
+
+void TreeVariantPool::StartBuild(unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc,
+    unsigned int bakedLight_loc)
+{
+    assert(workers.empty() && !isReady);
+    posLoc = pos_loc;
+    normalLoc = normal_loc;
+    texcoordsLoc = texcoords_loc;
+    bakedLightLoc = bakedLight_loc;
+
+    // Copy cached variants now: the cache's pointers do not outlive its next Save().
+    meshes.assign(NumVariants, TreeMesh());
+    jobs.clear();
+    for (int i = 0; i < NumVariants; i++) {
+        const float* barkVerts;
+        const float* leafVerts;
+        const unsigned int* barkElts;
+        const unsigned int* leafElts;
+        uint32_t numBarkFloats, numLeafFloats, numBarkElts, numLeafElts;
+        if (GlGeomMeshCache::FindAnySize(TreeMeshKey(FirstSeed + i, false), &barkVerts, &numBarkFloats, &barkElts, &numBarkElts)
+            && GlGeomMeshCache::FindAnySize(TreeMeshKey(FirstSeed + i, true), &leafVerts, &numLeafFloats, &leafElts, &numLeafElts)) {
+            TreeMesh& mesh = meshes[i];
+            mesh.barkVerts.assign(barkVerts, barkVerts + numBarkFloats);
+            mesh.barkElts.assign(barkElts, barkElts + numBarkElts);
+            mesh.leafVerts.assign(leafVerts, leafVerts + numLeafFloats);
+            mesh.leafElts.assign(leafElts, leafElts + numLeafElts);
+        }
+        else {
+            jobs.push_back(i);
+        }
+    }
+
+    // Generate the rest in the background. The main thread keeps one core.
+    nextJob = 0;
+    numJobsDone = 0;
+    if (!jobs.empty()) {
+        int numWorkers = (int)std::thread::hardware_concurrency() - 1;
+        numWorkers = numWorkers < 1 ? 1 : (numWorkers > 8 ? 8 : numWorkers);
+        numWorkers = numWorkers > (int)jobs.size() ? (int)jobs.size() : numWorkers;
+        for (int i = 0; i < numWorkers; i++) {
+            workers.push_back(std::thread(WorkerMain));
+        }
+    }
+}
+
+void TreeVariantPool::WorkerMain()
+{
+    for (int j = nextJob++; j < (int)jobs.size(); j = nextJob++) {
+        int i = jobs[j];
+        TreeGenerator::Generate(FirstSeed + i, &meshes[i]);
+        numJobsDone++;
+    }
+}
+
+bool TreeVariantPool::Update()
+{
+    if (isReady) {
+        if (!isBaked && baker.Update()) {
+            glBindBuffer(GL_ARRAY_BUFFER, theBakedVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bakedLight.size() * sizeof(float), bakedLight.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            meshes.clear();
+            meshes.shrink_to_fit();
+            bakedLight.clear();
+            bakedLight.shrink_to_fit();
+            isBaked = true;
+        }
+        return true;
+    }
+    if (meshes.empty() || numJobsDone < (int)jobs.size()) {
+        return false;
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    workers.clear();
+
+    // Add the newly generated variants to the on-disk cache
+    for (int i : jobs) {
+        const TreeMesh& mesh = meshes[i];
+        GlGeomMeshCache::Store(TreeMeshKey(FirstSeed + i, false), mesh.barkVerts.data(), (uint32_t)mesh.barkVerts.size(),
+            mesh.barkElts.data(), (uint32_t)mesh.barkElts.size());
+        GlGeomMeshCache::Store(TreeMeshKey(FirstSeed + i, true), mesh.leafVerts.data(), (uint32_t)mesh.leafVerts.size(),
+            mesh.leafElts.data(), (uint32_t)mesh.leafElts.size());
+    }
+    if (!jobs.empty()) {
+        GlGeomMeshCache::Save();
+    }
+
+    Upload();
+    FindBoundsAndOccluders();
+    StartBake();
+    isReady = true;
+    return true;
+}
+
+// Merge all the variants into one VBO and one EBO.
+void TreeVariantPool::Upload()
+{
+    size_t numFloats = 0;
+    size_t numElts = 0;
+    for (const TreeMesh& mesh : meshes) {
+        numFloats += mesh.barkVerts.size() + mesh.leafVerts.size();
+        numElts += mesh.barkElts.size() + mesh.leafElts.size();
+    }
+
+    glGenVertexArrays(1, &theVAO);
+    glGenBuffers(1, &theVBO);
+    glGenBuffers(1, &theEBO);
+    glBindVertexArray(theVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, theVBO);
+    glBufferData(GL_ARRAY_BUFFER, numFloats * sizeof(float), 0, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, numElts * sizeof(unsigned int), 0, GL_STATIC_DRAW);
+
+    barkRanges.resize(meshes.size());
+    leafRanges.resize(meshes.size());
+    size_t floatPos = 0;
+    size_t eltPos = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const TreeMesh& mesh = meshes[i];
+        for (int part = 0; part < 2; part++) {
+            const std::vector<float>& verts = (part == 0) ? mesh.barkVerts : mesh.leafVerts;
+            const std::vector<unsigned int>& elts = (part == 0) ? mesh.barkElts : mesh.leafElts;
+            Range& range = (part == 0) ? barkRanges[i] : leafRanges[i];
+            range.firstElement = (unsigned int)eltPos;
+            range.numElements = (unsigned int)elts.size();
+            range.baseVertex = (unsigned int)(floatPos / 8);
+            glBufferSubData(GL_ARRAY_BUFFER, floatPos * sizeof(float), verts.size() * sizeof(float), verts.data());
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, eltPos * sizeof(unsigned int), elts.size() * sizeof(unsigned int), elts.data());
+            floatPos += verts.size();
+            eltPos += elts.size();
+        }
+    }
+
+    glVertexAttribPointer(posLoc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(posLoc);
+    glVertexAttribPointer(normalLoc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(normalLoc);
+    glVertexAttribPointer(texcoordsLoc, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(texcoordsLoc);
+
+    // The baked lighting, filled in when the bake is done
+    glGenBuffers(1, &theBakedVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, theBakedVBO);
+    glBufferData(GL_ARRAY_BUFFER, (numFloats / 8) * 2 * sizeof(float), 0, GL_STATIC_DRAW);
+    glVertexAttribPointer(bakedLightLoc, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(bakedLightLoc);
+
+    // Good practice to unbind things: helps with debugging if nothing else
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// The leaf clusters are recovered from the leaf vertices, as laid out by
+//    TreeGenerator: LeafClusterVerts vertices per cluster. Only the opaque
+//    core of each cluster is used as an occluder, as the rest of the cards
+//    may be cut away by alpha testing.
+void TreeVariantPool::FindBoundsAndOccluders()
+{
+    const size_t clusterFloats = 8 * TreeGenerator::LeafClusterVerts;
+    bounds.resize(meshes.size());
+    occluders.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const TreeMesh& mesh = meshes[i];
+        Bounds& b = bounds[i];
+        for (int k = 0; k < 3; k++) {
+            b.boundsMin[k] = FLT_MAX;
+            b.boundsMax[k] = -FLT_MAX;
+        }
+        for (int part = 0; part < 2; part++) {
+            const std::vector<float>& verts = (part == 0) ? mesh.barkVerts : mesh.leafVerts;
+            for (size_t v = 0; v < verts.size(); v += 8) {
+                for (int k = 0; k < 3; k++) {
+                    b.boundsMin[k] = fminf(b.boundsMin[k], verts[v + k]);
+                    b.boundsMax[k] = fmaxf(b.boundsMax[k], verts[v + k]);
+                }
+            }
+        }
+
+        std::vector<TreeOccluder>& occ = occluders[i];
+        occ.clear();
+        for (size_t c = 0; c + clusterFloats <= mesh.leafVerts.size(); c += clusterFloats) {
+            TreeOccluder o;
+            TreeGenerator::GetLeafCore(&mesh.leafVerts[c], &o.x, &o.z, &o.radius, &o.yBottom, &o.yRing, &o.yTop);
+            occ.push_back(o);
+        }
+        std::sort(occ.begin(), occ.end(),
+            [](const TreeOccluder& a, const TreeOccluder& b) { return a.radius > b.radius; });
+        if (occ.size() > (size_t)MaxOccludersPerVariant) {
+            occ.resize(MaxOccludersPerVariant);
+        }
+    }
+}
+
+// The bark and the leaves of each variant are two jobs. The variant is scaled to fit the proxy
+//    tree: its top to the tip of the leaves, and its widest to their base. The tree's own trunk
+//    is passed through, as the variant's bark stands inside it.
+void TreeVariantPool::StartBake()
+{
+    if (proxyTree.GetNumTrees() == 0) {
+        proxyTree.Build(std::vector<std::pair<float, float>>(1, std::make_pair(0.0f, 0.0f)));
+    }
+    size_t numFloats = 0;
+    for (const TreeMesh& mesh : meshes) {
+        numFloats += mesh.barkVerts.size() + mesh.leafVerts.size();
+    }
+    bakedLight.assign((numFloats / 8) * 2, 0.0f);
+
+    std::vector<LightBaker::Job> bakeJobs;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Bounds& b = bounds[i];
+        float width = std::max(std::max(-b.boundsMin[0], b.boundsMax[0]), std::max(-b.boundsMin[2], b.boundsMax[2]));
+        float scaleXZ = (width > 0.0f) ? ObstacleGrid::LeavesRadius / width : 1.0f;
+        float scaleY = (b.boundsMax[1] > 0.0f) ? ObstacleGrid::LeavesTop / b.boundsMax[1] : 1.0f;
+        for (int part = 0; part < 2; part++) {
+            const std::vector<float>& verts = (part == 0) ? meshes[i].barkVerts : meshes[i].leafVerts;
+            const Range& range = (part == 0) ? barkRanges[i] : leafRanges[i];
+            if (verts.empty()) {
+                continue;
+            }
+            LightBaker::Job job;
+            job.grid = &proxyTree;
+            job.verts = verts.data();
+            job.numVerts = (int)(verts.size() / 8);
+            job.stride = 8;
+            job.scale[0] = job.scale[2] = scaleXZ;
+            job.scale[1] = scaleY;
+            job.twoSided = (part == 1);
+            job.ignoreTrunks = true;
+            job.baked = &bakedLight[2 * range.baseVertex];
+            bakeJobs.push_back(job);
+        }
+    }
+    baker.Start(bakeJobs);
+}
+
+void TreeVariantPool::RenderBark(int variant)
+{
+    assert(isReady);
+    const Range& r = barkRanges[variant];
+    glBindVertexArray(theVAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, r.numElements, GL_UNSIGNED_INT,
+        (void*)(r.firstElement * sizeof(unsigned int)), r.baseVertex);
+    glBindVertexArray(0);
+}
+
+void TreeVariantPool::RenderLeaves(int variant)
+{
+    assert(isReady);
+    const Range& r = leafRanges[variant];
+    glBindVertexArray(theVAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, r.numElements, GL_UNSIGNED_INT,
+        (void*)(r.firstElement * sizeof(unsigned int)), r.baseVertex);
+    glBindVertexArray(0);
+}
+
+void TreeVariantPool::Shutdown()
+{
+    nextJob = (int)jobs.size();     // Workers stop after their current tree
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    workers.clear();
+    baker.Shutdown();
+}
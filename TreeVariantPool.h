@@ -0,0 +1,120 @@
+//
+// TreeVariantPool.h
+//
+// A shared geometry pool holding many procedural tree variants (see TreeGenerator.h).
+//
+//   All variants live in one VAO, with one VBO and one EBO. Each variant is
+//   two ranges of the EBO (bark and leaves) drawn with glDrawElementsBaseVertex,
+//   so a forest gets variety without any per-tree geometry.
+//
+//   Variants are looked up in the on-disk mesh cache (GlGeomMeshCache) by seed.
+//   Missing ones are generated on worker threads while the game keeps running;
+//   the pool is uploaded, and new variants added to the cache, once all are done.
+//
+//   Then the static light is baked into each vertex (see LightBaker.h), again
+//   on worker threads, into a second VBO read by the same VAO. The variants
+//   are baked against a single tree of the obstacle grid, fitted to each
+//   variant's bounds, for the shade of its own leaves: the bake is the same
+//   wherever the variant stands.
+//
+// How to use:
+//    * Call StartBuild() once, after GlGeomMeshCache::Open().
+//    * Call Update() once per frame. It returns true once the pool is ready:
+//          until then, draw something else for the trees. IsBaked() once the
+//          baked lighting is in too: until then, light the trees in full.
+//    * Call RenderBark() and RenderLeaves() for a variant, binding the bark
+//          and leaf textures first.
+//    * Call Shutdown() before exiting, to wait for any worker threads.
+//
+
+#pragma once
+#ifndef TREE_VARIANT_POOL_H
+#define TREE_VARIANT_POOL_H
+
+#include "TreeGenerator.h"
+#include "LightBaker.h"
+#include "ObstacleGrid.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// The opaque core of a leaf cluster of a tree variant, a solid double cone, for use
+//    as an occluder (see HiZCuller.h). Its cross section through the axis is a rhombus.
+struct TreeOccluder {
+    float x, z;                 // Axis, relative to the base of the trunk
+    float radius;               // Radius of the ring
+    float yBottom, yRing, yTop;
+};
+
+class TreeVariantPool {
+public:
+    static const int NumVariants = 256;
+    static const uint32_t FirstSeed = 1;        // Variant i uses seed FirstSeed+i
+
+    // bakedLight_loc is the vertex attribute location of the baked lighting (see vertexShader_WindBaked).
+    static void StartBuild(unsigned int pos_loc, unsigned int normal_loc, unsigned int texcoords_loc,
+        unsigned int bakedLight_loc);
+    static bool Update();
+    static bool IsReady() { return isReady; }
+    static bool IsBaked() { return isBaked; }
+    static const LightBaker& GetBaker() { return baker; }
+    static void Shutdown();
+
+    static void RenderBark(int variant);
+    static void RenderLeaves(int variant);
+
+    // Bounding box and largest leaf clusters of a variant, relative to the base of the trunk.
+    static const int MaxOccludersPerVariant = 6;
+    static const float* GetBoundsMin(int variant) { return bounds[variant].boundsMin; }
+    static const float* GetBoundsMax(int variant) { return bounds[variant].boundsMax; }
+    static const std::vector<TreeOccluder>& GetOccluders(int variant) { return occluders[variant]; }
+
+    static int GetNumGenerated() { return (int)jobs.size(); }   // Variants not found in the cache
+
+    // Where a variant's bark or leaves lie in the pool, for drawing with other VAOs (see TreeGpuCuller.h).
+    //   Vertices have 8 floats: position, normal, texture coordinates.
+    struct Range {
+        unsigned int firstElement;
+        unsigned int numElements;
+        unsigned int baseVertex;
+    };
+    static const Range& GetBarkRange(int variant) { return barkRanges[variant]; }
+    static const Range& GetLeafRange(int variant) { return leafRanges[variant]; }
+    static unsigned int GetVBO() { return theVBO; }
+    static unsigned int GetEBO() { return theEBO; }
+    static unsigned int GetBakedVBO() { return theBakedVBO; }   // Two floats per vertex
+
+private:
+    struct Bounds {
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    static void WorkerMain();
+    static void Upload();
+    static void FindBoundsAndOccluders();
+    static void StartBake();
+
+    static unsigned int posLoc, normalLoc, texcoordsLoc, bakedLightLoc;
+    static unsigned int theVAO, theVBO, theEBO, theBakedVBO;
+    static bool isReady;
+    static bool isBaked;
+
+    static std::vector<TreeMesh> meshes;        // Until uploaded and baked
+    static std::vector<Range> barkRanges;
+    static std::vector<Range> leafRanges;
+    static std::vector<Bounds> bounds;
+    static std::vector<std::vector<TreeOccluder>> occluders;
+
+    static ObstacleGrid proxyTree;              // One tree, at the origin, for the bake
+    static LightBaker baker;
+    static std::vector<float> bakedLight;       // Until uploaded
+
+    static std::vector<int> jobs;               // Variants to generate
+    static std::vector<std::thread> workers;
+    static std::atomic<int> nextJob;
+    static std::atomic<int> numJobsDone;
+};
+
+#endif  // TREE_VARIANT_POOL_H
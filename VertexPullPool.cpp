@@ -0,0 +1,140 @@
+//
+// VertexPullPool.cpp
+//
+// Meshes in shader storage buffers, drawn by vertex pulling. See VertexPullPool.h.
+//
+
+// Use the static library (so glew32.dll is not needed):
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "VertexPullPool.h"
+#include "GlGeomBase.h"
+#include "TreeVariantPool.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+static const int FloatsPerVertex = 8;
+
+std::vector<float> VertexPullPool::vertices;
+std::vector<unsigned int> VertexPullPool::indices;
+std::vector<VertexPullPool::Mesh> VertexPullPool::meshes;
+int VertexPullPool::firstTreeMesh = -1;
+unsigned int VertexPullPool::vertexBuffer = 0;
+unsigned int VertexPullPool::indexBuffer = 0;
+unsigned int VertexPullPool::emptyVAO = 0;
+size_t VertexPullPool::numBytes = 0;
+
+bool VertexPullPool::IsSupported()
+{
+    return GLEW_VERSION_4_3 != 0;
+}
+
+// The shape's mesh is generated again, with normals and texture coordinates,
+//    in the layout of the pool.
+int VertexPullPool::AddShape(GlGeomBase& shape)
+{
+    assert(!IsBuilt());
+    unsigned int baseVertex = (unsigned int)(vertices.size() / FloatsPerVertex);
+    int numVertices = shape.GetNumVerticesTexCoords();
+    std::vector<unsigned int> elts(shape.GetNumElementsMax());
+    vertices.resize(vertices.size() + FloatsPerVertex * numVertices);
+    shape.CalcVboAndEbo(&vertices[FloatsPerVertex * baseVertex], elts.data(), 0, 3, 6, FloatsPerVertex);
+
+    Mesh m;
+    m.firstIndex = (unsigned int)indices.size();
+    m.numIndices = (unsigned int)shape.GetNumElementsRender();
+    for (unsigned int i = 0; i < m.numIndices; i++) {
+        indices.push_back(elts[i] + baseVertex);
+    }
+    meshes.push_back(m);
+    return (int)meshes.size() - 1;
+}
+
+bool VertexPullPool::Build()
+{
+    assert(IsSupported() && !IsBuilt());
+
+    // Append the tree variants, read back from their buffers.
+    if (TreeVariantPool::IsReady()) {
+        GLint vboBytes = 0, eboBytes = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, TreeVariantPool::GetVBO());
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vboBytes);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TreeVariantPool::GetEBO());
+        glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &eboBytes);
+        std::vector<float> treeVerts(vboBytes / sizeof(float));
+        std::vector<unsigned int> treeElts(eboBytes / sizeof(unsigned int));
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, vboBytes, treeVerts.data());
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, eboBytes, treeElts.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        unsigned int baseVertex = (unsigned int)(vertices.size() / FloatsPerVertex);
+        vertices.insert(vertices.end(), treeVerts.begin(), treeVerts.end());
+        firstTreeMesh = (int)meshes.size();
+        for (int variant = 0; variant < TreeVariantPool::NumVariants; variant++) {
+            for (int part = 0; part < 2; part++) {
+                const TreeVariantPool::Range& r = (part == 0) ? TreeVariantPool::GetBarkRange(variant)
+                    : TreeVariantPool::GetLeafRange(variant);
+                Mesh m;
+                m.firstIndex = (unsigned int)indices.size();
+                m.numIndices = r.numElements;
+                for (unsigned int i = 0; i < r.numElements; i++) {
+                    indices.push_back(treeElts[r.firstElement + i] + r.baseVertex + baseVertex);
+                }
+                meshes.push_back(m);
+            }
+        }
+    }
+    if (indices.empty()) {
+        fprintf(stderr, "VertexPullPool: no meshes to build.\n");
+        return false;
+    }
+
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenVertexArrays(1, &emptyVAO);
+
+    numBytes = vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int);
+    std::vector<float>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+    return true;
+}
+
+int VertexPullPool::GetBarkMesh(int variant)
+{
+    return firstTreeMesh < 0 ? -1 : firstTreeMesh + 2 * variant;
+}
+
+int VertexPullPool::GetLeafMesh(int variant)
+{
+    return firstTreeMesh < 0 ? -1 : firstTreeMesh + 2 * variant + 1;
+}
+
+void VertexPullPool::Bind()
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VertexBinding, vertexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndexBinding, indexBuffer);
+    glBindVertexArray(emptyVAO);
+}
+
+// gl_VertexID counts from the first index of the mesh.
+void VertexPullPool::Draw(int mesh)
+{
+    const Mesh& m = meshes[mesh];
+    glDrawArrays(GL_TRIANGLES, (GLint)m.firstIndex, (GLsizei)m.numIndices);
+}
+
+void VertexPullPool::Unbind()
+{
+    glBindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VertexBinding, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndexBinding, 0);
+}
@@ -0,0 +1,72 @@
+//
+// VertexPullPool.h
+//
+// Programmable vertex pulling, for OpenGL 4.3 and later.
+//
+//   All the meshes are held in two shader storage buffers: one of vertices
+//   (8 floats each: position, normal, texture coordinates) and one of
+//   indices. vertexShader_Pulled (in MyShaders.glsl) fetches its vertex
+//   with gl_VertexID, instead of using vertex attributes. So every mesh in
+//   the pool is drawn with the same (empty) VAO: a draw is one
+//   glDrawArrays() over the mesh's range of indices, with no VAO switch.
+//   The indices are stored already offset to their mesh's first vertex.
+//
+//   The pool holds GlGeom shapes (as drawn by their Render()), and the bark
+//   and leaves of the tree variants (see TreeVariantPool.h), read back from
+//   their buffers.
+//
+//   On older OpenGL versions IsSupported() returns false: use the VAOs.
+//
+// How to use:
+//    * AddShape() the shapes, then call Build(), once the tree variants are ready.
+//    * Select a program using vertexShader_Pulled and call Bind(). Then
+//          Draw() any of the meshes, and finally Unbind().
+//
+
+#pragma once
+#ifndef VERTEX_PULL_POOL_H
+#define VERTEX_PULL_POOL_H
+
+#include <stddef.h>
+#include <vector>
+
+class GlGeomBase;
+
+class VertexPullPool {
+public:
+    static const int VertexBinding = 6;     // Shader storage binding points, as in vertexShader_Pulled
+    static const int IndexBinding = 7;
+
+    static bool IsSupported();              // Call after glewInit()
+
+    // Returns the mesh's id. Must be called before Build().
+    static int AddShape(GlGeomBase& shape);
+    static bool Build();
+    static bool IsBuilt() { return vertexBuffer != 0; }
+
+    // The meshes of a tree variant, or -1 if the tree variants were not ready at Build().
+    static int GetBarkMesh(int variant);
+    static int GetLeafMesh(int variant);
+
+    static void Bind();
+    static void Draw(int mesh);
+    static void Unbind();
+
+    static int GetNumMeshes() { return (int)meshes.size(); }
+    static size_t GetNumBytes() { return numBytes; }
+
+private:
+    struct Mesh {
+        unsigned int firstIndex;
+        unsigned int numIndices;
+    };
+
+    static std::vector<float> vertices;     // Until Build()
+    static std::vector<unsigned int> indices;
+    static std::vector<Mesh> meshes;
+    static int firstTreeMesh;               // Bark then leaves of each variant; -1 if none
+    static unsigned int vertexBuffer, indexBuffer, emptyVAO;
+    static size_t numBytes;
+};
+
+#endif  // VERTEX_PULL_POOL_H
@@ -0,0 +1,385 @@
+//
+// MeshConvert.cpp
+//
+// Offline converter from Wavefront OBJ files to the binary ".glgm" model
+//    container loaded by GlGeomModel (see GlGeomModelFormat.h).
+//    This is a separate command line program: it is not part of the game.
+//
+// Usage:
+//    MeshConvert <output.glgm> <lod0.obj> <maxDistance0> [<lod1.obj> <maxDistance1> ...]
+//
+//    Each OBJ file gives one LOD level, most detailed first. The level is used
+//    up to its maxDistance. Materials come from the OBJ's mtllib file (Ka, Kd,
+//    Ks, Ns and map_Kd are used). Each material used by a LOD level becomes one
+//    submesh. Polygons are triangulated as fans. Missing normals are computed
+//    by averaging face normals; missing texture coordinates are set to zero.
+//    16-bit indices are written whenever every submesh has fewer than 65536 vertices.
+//
+// Build, for example:
+//    g++ -std=c++11 -O2 -I.. MeshConvert.cpp -o MeshConvert
+//
+
+#define _CRT_SECURE_NO_DEPRECATE 1
+
+#include "GlGeomModelFormat.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct ObjMaterial {
+    std::string name;
+    GlgmMaterial mat;
+};
+
+// A corner of an OBJ face: indices (zero based, -1 if absent) of position, texture coordinates and normal
+struct ObjCorner {
+    int v, vt, vn;
+    bool operator<(const ObjCorner& o) const {
+        if (v != o.v) return v < o.v;
+        if (vt != o.vt) return vt < o.vt;
+        return vn < o.vn;
+    }
+};
+
+struct ObjModel {
+    std::vector<float> positions;       // x,y,z triples
+    std::vector<float> texCoords;       // s,t pairs
+    std::vector<float> normals;         // x,y,z triples
+    std::vector<ObjMaterial> materials;
+    // Triangles (as triples of corners) for each material used
+    std::map<int, std::vector<ObjCorner>> trianglesByMaterial;
+};
+
+static std::string DirectoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+}
+
+static GlgmMaterial DefaultMaterial()
+{
+    GlgmMaterial mat;
+    memset(&mat, 0, sizeof(mat));
+    for (int i = 0; i < 3; i++) {
+        mat.ambientColor[i] = 0.3f;
+        mat.diffuseColor[i] = 0.7f;
+        mat.specularColor[i] = 0.2f;
+    }
+    mat.specularExponent = 20.0f;
+    return mat;
+}
+
+static void LoadMtl(const std::string& filename, std::vector<ObjMaterial>& materials)
+{
+    std::ifstream in(filename.c_str());
+    if (in.fail()) {
+        fprintf(stderr, "MeshConvert: Unable to open material file %s.\n", filename.c_str());
+        return;
+    }
+    ObjMaterial* cur = 0;
+    for (std::string line; std::getline(in, line); ) {
+        std::stringstream ss(line);
+        std::string w;
+        ss >> w;
+        if (w == "newmtl") {
+            materials.push_back(ObjMaterial());
+            cur = &materials.back();
+            ss >> cur->name;
+            cur->mat = DefaultMaterial();
+        }
+        else if (cur == 0) {
+            continue;
+        }
+        else if (w == "Ka") {
+            ss >> cur->mat.ambientColor[0] >> cur->mat.ambientColor[1] >> cur->mat.ambientColor[2];
+        }
+        else if (w == "Kd") {
+            ss >> cur->mat.diffuseColor[0] >> cur->mat.diffuseColor[1] >> cur->mat.diffuseColor[2];
+        }
+        else if (w == "Ks") {
+            ss >> cur->mat.specularColor[0] >> cur->mat.specularColor[1] >> cur->mat.specularColor[2];
+        }
+        else if (w == "Ns") {
+            ss >> cur->mat.specularExponent;
+        }
+        else if (w == "map_Kd") {
+            std::string tex;
+            ss >> tex;
+            if (tex.size() >= (size_t)GlgmTextureNameLen) {
+                fprintf(stderr, "MeshConvert: Texture name too long, ignored: %s.\n", tex.c_str());
+            }
+            else {
+                strcpy(cur->mat.textureName, tex.c_str());
+            }
+        }
+    }
+}
+
+// Converts an OBJ index (one based, or negative for relative) to zero based.
+static int ObjIndex(const std::string& s, int count)
+{
+    if (s.empty()) {
+        return -1;
+    }
+    int i = atoi(s.c_str());
+    return (i < 0) ? count + i : i - 1;
+}
+
+static bool LoadObj(const std::string& filename, ObjModel& model)
+{
+    std::ifstream in(filename.c_str());
+    if (in.fail()) {
+        fprintf(stderr, "MeshConvert: Unable to open %s.\n", filename.c_str());
+        return false;
+    }
+    int curMaterial = -1;
+    int lineNumber = 1;
+    for (std::string line; std::getline(in, line); lineNumber++) {
+        std::stringstream ss(line);
+        std::string w;
+        ss >> w;
+        if (w == "v") {
+            float x = 0, y = 0, z = 0;
+            ss >> x >> y >> z;
+            model.positions.push_back(x); model.positions.push_back(y); model.positions.push_back(z);
+        }
+        else if (w == "vt") {
+            float s = 0, t = 0;
+            ss >> s >> t;
+            model.texCoords.push_back(s); model.texCoords.push_back(t);
+        }
+        else if (w == "vn") {
+            float x = 0, y = 0, z = 0;
+            ss >> x >> y >> z;
+            model.normals.push_back(x); model.normals.push_back(y); model.normals.push_back(z);
+        }
+        else if (w == "mtllib") {
+            std::string mtl;
+            ss >> mtl;
+            LoadMtl(DirectoryOf(filename) + mtl, model.materials);
+        }
+        else if (w == "usemtl") {
+            std::string name;
+            ss >> name;
+            curMaterial = -1;
+            for (size_t i = 0; i < model.materials.size(); i++) {
+                if (model.materials[i].name == name) {
+                    curMaterial = (int)i;
+                }
+            }
+        }
+        else if (w == "f") {
+            std::vector<ObjCorner> face;
+            for (std::string c; ss >> c; ) {
+                std::string parts[3];
+                int k = 0;
+                for (char ch : c) {
+                    if (ch == '/') {
+                        if (++k > 2) break;
+                    }
+                    else {
+                        parts[k] += ch;
+                    }
+                }
+                ObjCorner corner;
+                corner.v = ObjIndex(parts[0], (int)model.positions.size() / 3);
+                corner.vt = ObjIndex(parts[1], (int)model.texCoords.size() / 2);
+                corner.vn = ObjIndex(parts[2], (int)model.normals.size() / 3);
+                if (corner.v < 0 || corner.v >= (int)model.positions.size() / 3
+                    || corner.vt >= (int)model.texCoords.size() / 2 || corner.vn >= (int)model.normals.size() / 3) {
+                    fprintf(stderr, "MeshConvert: %s, line %d: Bad face index.\n", filename.c_str(), lineNumber);
+                    return false;
+                }
+                face.push_back(corner);
+            }
+            std::vector<ObjCorner>& tris = model.trianglesByMaterial[curMaterial];
+            for (size_t i = 2; i < face.size(); i++) {
+                tris.push_back(face[0]);
+                tris.push_back(face[i - 1]);
+                tris.push_back(face[i]);
+            }
+        }
+    }
+    return true;
+}
+
+// Averaged face normals for each position, used for corners without a normal.
+static std::vector<float> SmoothNormals(const ObjModel& model)
+{
+    std::vector<float> n(model.positions.size(), 0.0f);
+    for (const auto& group : model.trianglesByMaterial) {
+        const std::vector<ObjCorner>& tris = group.second;
+        for (size_t i = 0; i + 2 < tris.size(); i += 3) {
+            const float* a = &model.positions[3 * tris[i].v];
+            const float* b = &model.positions[3 * tris[i + 1].v];
+            const float* c = &model.positions[3 * tris[i + 2].v];
+            float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float f[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+            for (int k = 0; k < 3; k++) {
+                for (int j = 0; j < 3; j++) {
+                    n[3 * tris[i + k].v + j] += f[j];
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < n.size(); i += 3) {
+        float len = sqrtf(n[i] * n[i] + n[i + 1] * n[i + 1] + n[i + 2] * n[i + 2]);
+        if (len > 0.0f) {
+            n[i] /= len; n[i + 1] /= len; n[i + 2] /= len;
+        }
+    }
+    return n;
+}
+
+// The contents of the output file, before the indices are narrowed to 16 bits (if possible).
+struct GlgmBuilder {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<GlgmSubmesh> submeshes;
+    std::vector<GlgmMaterial> materials;
+    std::vector<GlgmLod> lods;
+    std::map<std::string, uint32_t> materialIndex;  // Materials shared by name between LOD levels
+};
+
+static void AddLod(const ObjModel& model, float maxDistance, GlgmBuilder& out)
+{
+    std::vector<float> smoothNormals = SmoothNormals(model);
+    GlgmLod lod;
+    lod.firstSubmesh = (uint32_t)out.submeshes.size();
+    lod.maxDistance = maxDistance;
+    for (const auto& group : model.trianglesByMaterial) {
+        GlgmSubmesh sm;
+        sm.firstIndex = (uint32_t)out.indices.size();
+        sm.baseVertex = (uint32_t)(out.vertices.size() / GlgmVertexFloats);
+        std::string name = (group.first >= 0) ? model.materials[group.first].name : std::string();
+        auto found = out.materialIndex.find(name);
+        if (found == out.materialIndex.end()) {
+            found = out.materialIndex.insert(std::make_pair(name, (uint32_t)out.materials.size())).first;
+            out.materials.push_back(group.first >= 0 ? model.materials[group.first].mat : DefaultMaterial());
+        }
+        sm.materialIndex = found->second;
+
+        std::map<ObjCorner, uint32_t> vertexOf;       // Removes duplicate corners
+        for (const ObjCorner& c : group.second) {
+            auto it = vertexOf.find(c);
+            if (it == vertexOf.end()) {
+                uint32_t idx = (uint32_t)(out.vertices.size() / GlgmVertexFloats) - sm.baseVertex;
+                it = vertexOf.insert(std::make_pair(c, idx)).first;
+                const float* p = &model.positions[3 * c.v];
+                const float* n = (c.vn >= 0) ? &model.normals[3 * c.vn] : &smoothNormals[3 * c.v];
+                out.vertices.insert(out.vertices.end(), p, p + 3);
+                out.vertices.insert(out.vertices.end(), n, n + 3);
+                if (c.vt >= 0) {
+                    out.vertices.push_back(model.texCoords[2 * c.vt]);
+                    out.vertices.push_back(model.texCoords[2 * c.vt + 1]);
+                }
+                else {
+                    out.vertices.push_back(0.0f);
+                    out.vertices.push_back(0.0f);
+                }
+            }
+            out.indices.push_back(it->second);
+        }
+        sm.numIndices = (uint32_t)out.indices.size() - sm.firstIndex;
+        out.submeshes.push_back(sm);
+    }
+    lod.numSubmeshes = (uint32_t)out.submeshes.size() - lod.firstSubmesh;
+    out.lods.push_back(lod);
+}
+
+static uint32_t Align4(uint32_t offset)
+{
+    return (offset + 3) & ~3u;
+}
+
+static bool WriteGlgm(const char* filename, const GlgmBuilder& in)
+{
+    GlgmHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GlgmMagic, sizeof(GlgmMagic));
+    header.version = GlgmVersion;
+    header.numVertices = (uint32_t)(in.vertices.size() / GlgmVertexFloats);
+    header.numIndices = (uint32_t)in.indices.size();
+    header.numSubmeshes = (uint32_t)in.submeshes.size();
+    header.numMaterials = (uint32_t)in.materials.size();
+    header.numLods = (uint32_t)in.lods.size();
+
+    bool use16 = true;
+    for (size_t i = 0; i < in.submeshes.size(); i++) {
+        uint32_t end = (i + 1 < in.submeshes.size()) ? in.submeshes[i + 1].baseVertex : header.numVertices;
+        use16 = use16 && (end - in.submeshes[i].baseVertex <= 65536);
+    }
+    header.indexSize = use16 ? 2 : 4;
+
+    for (int j = 0; j < 3; j++) {
+        header.boundsMin[j] = header.numVertices > 0 ? in.vertices[j] : 0.0f;
+        header.boundsMax[j] = header.boundsMin[j];
+    }
+    for (size_t i = 0; i < in.vertices.size(); i += GlgmVertexFloats) {
+        for (int j = 0; j < 3; j++) {
+            header.boundsMin[j] = fminf(header.boundsMin[j], in.vertices[i + j]);
+            header.boundsMax[j] = fmaxf(header.boundsMax[j], in.vertices[i + j]);
+        }
+    }
+
+    header.vertexOffset = sizeof(GlgmHeader);
+    header.indexOffset = header.vertexOffset + header.numVertices * GlgmVertexFloats * sizeof(float);
+    header.submeshOffset = Align4(header.indexOffset + header.numIndices * header.indexSize);
+    header.materialOffset = header.submeshOffset + header.numSubmeshes * sizeof(GlgmSubmesh);
+    header.lodOffset = header.materialOffset + header.numMaterials * sizeof(GlgmMaterial);
+
+    FILE* outfile = fopen(filename, "wb");
+    if (!outfile) {
+        fprintf(stderr, "MeshConvert: Unable to write %s.\n", filename);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, outfile) == 1;
+    ok = ok && fwrite(in.vertices.data(), sizeof(float), in.vertices.size(), outfile) == in.vertices.size();
+    if (use16) {
+        std::vector<uint16_t> narrow(in.indices.begin(), in.indices.end());
+        ok = ok && fwrite(narrow.data(), sizeof(uint16_t), narrow.size(), outfile) == narrow.size();
+    }
+    else {
+        ok = ok && fwrite(in.indices.data(), sizeof(uint32_t), in.indices.size(), outfile) == in.indices.size();
+    }
+    static const char zeros[4] = { 0, 0, 0, 0 };
+    uint32_t pad = header.submeshOffset - (header.indexOffset + header.numIndices * header.indexSize);
+    ok = ok && fwrite(zeros, 1, pad, outfile) == pad;
+    ok = ok && fwrite(in.submeshes.data(), sizeof(GlgmSubmesh), in.submeshes.size(), outfile) == in.submeshes.size();
+    ok = ok && fwrite(in.materials.data(), sizeof(GlgmMaterial), in.materials.size(), outfile) == in.materials.size();
+    ok = ok && fwrite(in.lods.data(), sizeof(GlgmLod), in.lods.size(), outfile) == in.lods.size();
+    ok = (fclose(outfile) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "MeshConvert: Error writing %s.\n", filename);
+        return false;
+    }
+    printf("Wrote %s: %u vertices, %u indices (%u bit), %u submeshes, %u materials, %u LODs.\n",
+        filename, header.numVertices, header.numIndices, 8 * header.indexSize,
+        header.numSubmeshes, header.numMaterials, header.numLods);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4 || (argc % 2) != 0) {
+        fprintf(stderr, "Usage: MeshConvert <output.glgm> <lod0.obj> <maxDistance0> [<lod1.obj> <maxDistance1> ...]\n");
+        return 1;
+    }
+    GlgmBuilder builder;
+    for (int i = 2; i < argc; i += 2) {
+        ObjModel model;
+        if (!LoadObj(argv[i], model)) {
+            return 1;
+        }
+        AddLod(model, (float)atof(argv[i + 1]), builder);
+    }
+    return WriteGlgm(argv[1], builder) ? 0 : 1;
+}